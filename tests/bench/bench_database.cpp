@@ -0,0 +1,143 @@
+#include "calendar.hpp"
+#include "constants.hpp"
+#include "database_manager.hpp"
+#include "logger.hpp"
+#include "synthetic.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <map>
+#include <memory>
+#include <span>
+#include <spdlog/common.h>
+#include <vector>
+
+namespace typetrace::bench {
+
+namespace {
+
+using backend::DatabaseManager;
+
+/// Last day of the synthetic histories, 2025-01-01
+constexpr DayNumber LAST_DAY = 20089;
+
+/// Distinct keys pressed per synthetic day, about what a day of writing prose touches
+constexpr std::size_t KEYS_PER_DAY = 48;
+
+/// Database holding `years` of synthetic history up to `LAST_DAY`
+struct SyntheticDatabase
+{
+    TempDir dir;
+    std::unique_ptr<DatabaseManager> manager;
+};
+
+/// Fills a database with one row per key and day, written through the regular batch path so
+/// the rollup tables are populated as well
+auto createHistory(const std::size_t years) -> std::unique_ptr<SyntheticDatabase>
+{
+    auto database = std::make_unique<SyntheticDatabase>();
+    database->manager = std::make_unique<DatabaseManager>(database->dir.path());
+
+    const auto days = static_cast<DayNumber>(years * 365);
+    const auto key_codes = generateKeyCodes(KeyDistribution::uniform, KEYS_PER_DAY);
+
+    std::vector<KeystrokeEvent> batch;
+    batch.reserve(MAX_BUFFER_SIZE);
+
+    for (DayNumber day = LAST_DAY - days + 1; day <= LAST_DAY; ++day) {
+        for (const auto key_code : key_codes) {
+            batch.push_back({ .key_code = key_code, .day = day });
+
+            if (batch.size() == MAX_BUFFER_SIZE) {
+                database->manager->writeToDatabase(batch);
+                batch.clear();
+            }
+        }
+    }
+    database->manager->writeToDatabase(batch);
+
+    return database;
+}
+
+/// Returns the database with `years` of history, creating it on first use
+auto getHistory(const std::size_t years) -> DatabaseManager &
+{
+    static std::map<std::size_t, std::unique_ptr<SyntheticDatabase>> histories;
+
+    auto &database = histories[years];
+    if (database == nullptr) {
+        database = createHistory(years);
+    }
+    return *database->manager;
+}
+
+} // namespace
+
+TEST_CASE("Batch writes", "[bench][database]")
+{
+    getLogger().set_level(spdlog::level::warn);
+
+    const TempDir dir;
+    DatabaseManager manager{ dir.path() };
+
+    for (const auto distribution :
+         { KeyDistribution::single, KeyDistribution::uniform, KeyDistribution::skewed }) {
+        for (const std::size_t batch_size :
+             std::array<std::size_t, 4>{ 1, BUFFER_SIZE, 500, MAX_BUFFER_SIZE }) {
+            const auto events = generateEvents(distribution, batch_size, LAST_DAY);
+
+            // Each iteration commits one transaction, so this includes the WAL append
+            BENCHMARK(std::format("{} keystrokes, {}", batch_size, distributionName(distribution)))
+            {
+                manager.writeToDatabase(events);
+            };
+        }
+    }
+}
+
+TEST_CASE("Read queries", "[bench][database]")
+{
+    getLogger().set_level(spdlog::level::warn);
+
+    for (const std::size_t years : std::array<std::size_t, 3>{ 1, 5, 20 }) {
+        DatabaseManager &manager = getHistory(years);
+
+        BENCHMARK(std::format("{} years: total key counts", years))
+        {
+            return manager.getTotalKeyCounts();
+        };
+
+        BENCHMARK(std::format("{} years: key counts of a day", years))
+        {
+            return manager.getDayKeyCounts(LAST_DAY);
+        };
+
+        BENCHMARK(std::format("{} years: key counts of a week", years))
+        {
+            return manager.getWeeklyKeyCounts(weekOf(LAST_DAY));
+        };
+
+        BENCHMARK(std::format("{} years: key counts of a month", years))
+        {
+            return manager.getMonthlyKeyCounts(monthOf(LAST_DAY));
+        };
+
+        BENCHMARK(std::format("{} years: daily counts of the last year", years))
+        {
+            return manager.getDailyCounts(LAST_DAY - 364);
+        };
+
+        BENCHMARK(std::format("{} years: top 10 keys of all time", years))
+        {
+            return manager.getTopKeys(0, 10);
+        };
+    }
+}
+
+} // namespace typetrace::bench
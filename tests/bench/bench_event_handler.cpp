@@ -0,0 +1,168 @@
+#include "config.hpp"
+#include "constants.hpp"
+#include "day_clock.hpp"
+#include "event_handler.hpp"
+#include "file_descriptor.hpp"
+#include "input_source.hpp"
+#include "logger.hpp"
+#include "synthetic.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <memory>
+#include <span>
+#include <spdlog/common.h>
+#include <sys/eventfd.h>
+#include <utility>
+#include <vector>
+
+namespace typetrace::bench {
+
+namespace {
+
+using backend::BufferSettings;
+using backend::DayClock;
+using backend::EventHandler;
+using backend::FileDescriptor;
+using backend::InputRead;
+using backend::InputSettings;
+using backend::InputSource;
+using backend::KeyPress;
+
+/// Keystrokes fed through the event loop per measured run
+constexpr std::size_t KEYSTROKES_PER_RUN = 100'000;
+
+/// Input source that replays a fixed list of key presses as fast as the event loop reads them.
+///
+/// Its fd is an eventfd that is never read, so it stays readable and every loop iteration
+/// drains it. Once all presses are delivered it calls `on_exhausted`.
+class SyntheticSource : public InputSource
+{
+  public:
+    explicit SyntheticSource(std::vector<std::uint16_t> keys)
+      : InputSource(InputSettings{}), key_codes(std::move(keys)),
+        event_fd(eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC))
+    {
+    }
+
+    [[nodiscard]] auto fd() const -> int override { return event_fd.get(); }
+
+    auto read(const std::span<KeyPress> presses) -> InputRead override
+    {
+        const std::size_t count = std::min(presses.size(), key_codes.size() - position);
+        for (std::size_t i = 0; i < count; ++i) {
+            presses[i] = { .key_code = key_codes[position + i], .device = nullptr };
+        }
+        position += count;
+
+        if (count == 0 && on_exhausted) {
+            on_exhausted();
+        }
+        return { .events = count, .key_presses = count, .backlog = false };
+    }
+
+    /// Starts over with the first key press
+    auto rewind() -> void { position = 0; }
+
+    std::function<void()> on_exhausted;
+
+  private:
+    std::vector<std::uint16_t> key_codes;
+    std::size_t position{ 0 };
+    FileDescriptor event_fd;
+};
+
+/// Silences the per-run info logs of the event loop, they would dominate the measurements
+auto quietLogger() -> void
+{
+    getLogger().set_level(spdlog::level::warn);
+}
+
+} // namespace
+
+TEST_CASE("Keystroke event construction", "[bench][input]")
+{
+    quietLogger();
+
+    const auto key_codes = generateKeyCodes(KeyDistribution::skewed, MAX_BUFFER_SIZE);
+    std::vector<KeystrokeEvent> events(key_codes.size());
+    DayClock day_clock;
+
+    // What the libinput path did before drains were batched: a day lookup per event
+    BENCHMARK("clock read per keystroke")
+    {
+        for (std::size_t i = 0; i < key_codes.size(); ++i) {
+            events[i] = { .key_code = key_codes[i], .day = day_clock.today() };
+        }
+        return events.back().day;
+    };
+
+    BENCHMARK("clock read per drain")
+    {
+        const auto now = std::chrono::system_clock::now();
+        const DayNumber today = day_clock.dayOf(now);
+        const std::size_t hour = day_clock.hourOf(now);
+
+        for (std::size_t i = 0; i < key_codes.size(); ++i) {
+            events[i] = { .key_code = key_codes[i], .day = today };
+        }
+        return events.back().day + hour;
+    };
+}
+
+TEST_CASE("Event loop buffering and flushing", "[bench][input]")
+{
+    quietLogger();
+
+    const auto key_codes = generateKeyCodes(KeyDistribution::skewed, KEYSTROKES_PER_RUN);
+
+    struct Scenario
+    {
+        std::size_t flush_size;
+        bool adaptive;
+    };
+
+    for (const auto scenario : std::array{ Scenario{ BUFFER_SIZE, false },
+                                           Scenario{ 500, false },
+                                           Scenario{ MAX_BUFFER_SIZE, false },
+                                           Scenario{ BUFFER_SIZE, true } }) {
+        auto source = std::make_unique<SyntheticSource>(key_codes);
+        SyntheticSource &input = *source;
+
+        const BufferSettings settings{ .flush_size = scenario.flush_size,
+                                       .adaptive = scenario.adaptive };
+        EventHandler handler{ settings, std::move(source) };
+        input.on_exhausted = [&handler]() -> void { handler.stop(); };
+
+        std::size_t flushed{ 0 };
+        handler.setBufferCallback(
+          [&flushed](const std::span<const KeystrokeEvent> buffer) -> bool {
+              flushed += buffer.size();
+              return true;
+          });
+
+        // Every press goes through pushKeystroke, shouldFlush and flushBuffer
+        BENCHMARK_ADVANCED(std::format("{} keystrokes, flush size {}{}",
+                                       KEYSTROKES_PER_RUN,
+                                       scenario.flush_size,
+                                       scenario.adaptive ? ", adaptive" : ""))
+        (Catch::Benchmark::Chronometer meter)
+        {
+            meter.measure([&]() -> std::size_t {
+                input.rewind();
+                handler.run();
+                return flushed;
+            });
+        };
+    }
+}
+
+} // namespace typetrace::bench
@@ -0,0 +1,115 @@
+#ifndef TYPETRACE_BENCH_SYNTHETIC_HPP
+#define TYPETRACE_BENCH_SYNTHETIC_HPP
+
+#include "types.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <linux/input-event-codes.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace typetrace::bench {
+
+/// How the key codes of synthetic keystrokes are spread
+enum class KeyDistribution : std::uint8_t
+{
+    single,  ///< Every keystroke is the same key
+    uniform, ///< All typing keys are equally likely
+    skewed,  ///< Zipf-like, a few keys make up most keystrokes like in real text
+};
+
+/// Returns a readable name for benchmark titles
+inline auto distributionName(const KeyDistribution distribution) -> std::string_view
+{
+    switch (distribution) {
+        case KeyDistribution::single:
+            return "single key";
+        case KeyDistribution::uniform:
+            return "uniform";
+        case KeyDistribution::skewed:
+            return "skewed";
+    }
+    return "unknown";
+}
+
+/// Returns `count` key codes from `distribution`, the same ones on every call
+inline auto generateKeyCodes(const KeyDistribution distribution, const std::size_t count)
+  -> std::vector<std::uint16_t>
+{
+    // Number row, letters, punctuation and space
+    constexpr std::uint16_t FIRST_TYPING_KEY = KEY_1;
+    constexpr std::uint16_t LAST_TYPING_KEY = KEY_SPACE;
+    constexpr std::size_t TYPING_KEYS = LAST_TYPING_KEY - FIRST_TYPING_KEY + 1;
+
+    std::mt19937 generator{ 0x7479 }; // NOLINT(cert-msc32-c, cert-msc51-cpp): reproducible
+    std::vector<double> weights(TYPING_KEYS, 1.0);
+    if (distribution == KeyDistribution::skewed) {
+        for (std::size_t rank = 0; rank < weights.size(); ++rank) {
+            weights.at(rank) = 1.0 / static_cast<double>(rank + 1);
+        }
+    }
+    std::discrete_distribution<std::size_t> pick{ weights.begin(), weights.end() };
+
+    std::vector<std::uint16_t> key_codes(count, KEY_E);
+    if (distribution != KeyDistribution::single) {
+        for (auto &key_code : key_codes) {
+            key_code = static_cast<std::uint16_t>(FIRST_TYPING_KEY + pick(generator));
+        }
+    }
+    return key_codes;
+}
+
+/// Returns keystrokes of `distribution` that all fall on `day`
+inline auto generateEvents(const KeyDistribution distribution,
+                           const std::size_t count,
+                           const DayNumber day) -> std::vector<KeystrokeEvent>
+{
+    std::vector<KeystrokeEvent> events;
+    events.reserve(count);
+    for (const auto key_code : generateKeyCodes(distribution, count)) {
+        events.push_back({ .key_code = key_code, .day = day });
+    }
+    return events;
+}
+
+/// Temporary directory that is removed with everything in it when it goes out of scope
+class TempDir
+{
+  public:
+    TempDir()
+    {
+        std::string pattern
+          = (std::filesystem::temp_directory_path() / "typetrace-bench-XXXXXX").string();
+        if (::mkdtemp(pattern.data()) == nullptr) {
+            throw std::system_error(errno, std::generic_category(), "Failed to create temp dir");
+        }
+        dir = pattern;
+    }
+
+    ~TempDir()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(dir, error);
+    }
+
+    TempDir(const TempDir &) = delete;
+    auto operator=(const TempDir &) -> TempDir & = delete;
+    TempDir(TempDir &&) = delete;
+    auto operator=(TempDir &&) -> TempDir & = delete;
+
+    [[nodiscard]] auto path() const -> const std::filesystem::path & { return dir; }
+
+  private:
+    std::filesystem::path dir;
+};
+
+} // namespace typetrace::bench
+
+#endif
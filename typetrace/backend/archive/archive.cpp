@@ -0,0 +1,236 @@
+#include "archive.hpp"
+
+#include "blob_codec.hpp"
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "logger.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// First bytes of every archive
+constexpr std::string_view ARCHIVE_MAGIC = "TTKA";
+
+/// Format version, bumped whenever the layout changes
+constexpr std::uint8_t ARCHIVE_VERSION = 1;
+
+/// Longest key name an archive may hold, guards against allocating for a corrupt length
+constexpr std::uint64_t MAX_KEY_NAME_SIZE = 256;
+
+/// Writes a buffer to the stream
+auto writeBytes(std::ostream &out, const std::span<const std::uint8_t> bytes) -> void
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    out.write(reinterpret_cast<const char *>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+}
+
+} // namespace
+
+ArchiveWriter::ArchiveWriter(std::ostream &output, const std::span<const ArchiveKey> keys)
+  : out(output)
+{
+    key_indices.fill(NO_KEY_INDEX);
+
+    block.insert(block.end(), ARCHIVE_MAGIC.begin(), ARCHIVE_MAGIC.end());
+    block.push_back(ARCHIVE_VERSION);
+
+    // Imported rows may hold scan codes outside the key range, the reader would reject them
+    const auto in_range = [](const ArchiveKey &key) { return key.key_code < KEY_CODE_COUNT; };
+    writeVarint(block, static_cast<std::uint64_t>(std::ranges::count_if(keys, in_range)));
+
+    std::uint16_t previous_code{ 0 };
+    std::uint32_t index{ 0 };
+    for (const ArchiveKey &key : keys) {
+        if (!in_range(key)) {
+            getLogger().warn("Leaving key {} out of the archive, its code is out of range",
+                             key.key_code);
+            continue;
+        }
+        key_indices.at(key.key_code) = index++;
+
+        writeVarint(block, key.key_code - previous_code);
+        writeVarint(block, key.name.size());
+        block.insert(block.end(), key.name.begin(), key.name.end());
+        previous_code = key.key_code;
+    }
+
+    writeBytes(out, block);
+    block.clear();
+}
+
+auto ArchiveWriter::add(const DayNumber day,
+                        const std::uint16_t key_code,
+                        const std::uint64_t count) -> bool
+{
+    const std::uint32_t index = key_code < KEY_CODE_COUNT ? key_indices.at(key_code) : NO_KEY_INDEX;
+    if (index == NO_KEY_INDEX) {
+        getLogger().warn("Skipping a row of key {} on day {}, the key is not in the archive",
+                         key_code,
+                         day);
+        return false;
+    }
+
+    if (day != current_day && !row_keys.empty()) {
+        writeDay();
+    }
+    current_day = day;
+
+    row_keys.push_back(index);
+    row_counts.push_back(count);
+    return true;
+}
+
+auto ArchiveWriter::finish() -> void
+{
+    if (!row_keys.empty()) {
+        writeDay();
+    }
+
+    // An empty block ends the archive
+    writeVarint(block, 0);
+    writeVarint(block, 0);
+    writeBytes(out, block);
+    block.clear();
+
+    out.flush();
+    if (!out) {
+        throw SystemError("Failed to write the archive");
+    }
+}
+
+auto ArchiveWriter::writeDay() -> void
+{
+    writeVarint(block, current_day - previous_day);
+    writeVarint(block, row_keys.size());
+
+    // Key indices and counts are stored as separate columns, small deltas pack tightly
+    std::uint32_t previous_index{ 0 };
+    for (const std::uint32_t index : row_keys) {
+        writeVarint(block, index - previous_index);
+        previous_index = index;
+    }
+    for (const std::uint64_t count : row_counts) {
+        writeVarint(block, count);
+    }
+
+    writeBytes(out, block);
+    block.clear();
+    row_keys.clear();
+    row_counts.clear();
+    previous_day = current_day;
+}
+
+ArchiveReader::ArchiveReader(std::istream &input) : in(*input.rdbuf())
+{
+    std::string magic(ARCHIVE_MAGIC.size(), '\0');
+    const auto magic_size = static_cast<std::streamsize>(magic.size());
+    if (in.sgetn(magic.data(), magic_size) != magic_size || magic != ARCHIVE_MAGIC) {
+        throw DatabaseError("Not a TypeTrace archive");
+    }
+
+    if (const auto version = in.sbumpc(); version != ARCHIVE_VERSION) {
+        throw DatabaseError(std::format("Unsupported archive version {}", version));
+    }
+
+    const std::uint64_t key_count = varint();
+    if (key_count > KEY_CODE_COUNT) {
+        throw DatabaseError("Archive key table is too large");
+    }
+
+    std::uint64_t key_code{ 0 };
+    for (std::uint64_t index = 0; index < key_count; ++index) {
+        key_code += varint();
+        const std::uint64_t name_size = varint();
+        if (key_code >= KEY_CODE_COUNT || name_size > MAX_KEY_NAME_SIZE) {
+            throw DatabaseError("Archive key table is corrupt");
+        }
+
+        std::string name(name_size, '\0');
+        const auto size = static_cast<std::streamsize>(name_size);
+        if (in.sgetn(name.data(), size) != size) {
+            throw DatabaseError("Archive ends inside the key table");
+        }
+
+        key_table.push_back({ .key_code = static_cast<std::uint16_t>(key_code), .name = name });
+    }
+}
+
+auto ArchiveReader::keys() const -> const std::vector<ArchiveKey> &
+{
+    return key_table;
+}
+
+auto ArchiveReader::next(ArchiveDay &day) -> bool
+{
+    if (finished) {
+        return false;
+    }
+
+    const std::uint64_t day_delta = varint();
+    const std::uint64_t rows = varint();
+    if (rows == 0) {
+        finished = true;
+        return false;
+    }
+
+    if (rows > key_table.size() || previous_day + day_delta > UINT32_MAX) {
+        throw DatabaseError("Archive day block is corrupt");
+    }
+
+    day.day = static_cast<DayNumber>(previous_day + day_delta);
+    day.counts.resize(rows);
+    previous_day = day.day;
+
+    std::uint64_t index{ 0 };
+    for (auto &count : day.counts) {
+        index += varint();
+        if (index >= key_table.size()) {
+            throw DatabaseError("Archive row refers to an unknown key");
+        }
+        count.key_code = key_table.at(index).key_code;
+    }
+    for (auto &count : day.counts) {
+        count.count = varint();
+    }
+
+    return true;
+}
+
+auto ArchiveReader::varint() -> std::uint64_t
+{
+    constexpr std::uint64_t PAYLOAD_MASK = 0x7F;
+    constexpr unsigned CONTINUATION = 0x80;
+    constexpr unsigned MAX_SHIFT = 63;
+
+    std::uint64_t value{ 0 };
+    for (unsigned shift = 0;; shift += 7) {
+        const auto byte = in.sbumpc();
+        if (byte == std::char_traits<char>::eof()) {
+            throw DatabaseError("Archive ends unexpectedly");
+        }
+        if (shift > MAX_SHIFT) {
+            throw DatabaseError("Archive holds an oversized varint");
+        }
+
+        value |= (static_cast<std::uint64_t>(byte) & PAYLOAD_MASK) << shift;
+        if ((static_cast<unsigned>(byte) & CONTINUATION) == 0) {
+            return value;
+        }
+    }
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,99 @@
+#ifndef TYPETRACE_ARCHIVE_HPP
+#define TYPETRACE_ARCHIVE_HPP
+
+#include "constants.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// A key of the archive's key table
+struct ArchiveKey
+{
+    std::uint16_t key_code{ 0 };
+    std::string name; ///< Empty if the exporting database had no name for the key
+};
+
+/// The key counts of one day of an archive, sorted by key code
+struct ArchiveDay
+{
+    DayNumber day{ 0 };
+    std::vector<KeyCount> counts;
+};
+
+/// Writes per-day key counts as a compact, schema independent archive.
+///
+/// Layout, all integers are unsigned LEB128 varints:
+/// - the magic bytes `TTKA` and a format version byte
+/// - the key table: number of keys, then per key the code as delta to the previous code and
+///   its name as length and bytes
+/// - one block per day: the day as delta to the previous day, the number of rows, the key table
+///   indices of all rows as deltas, then all counts. A block with zero rows ends the archive.
+///
+/// Days are written one block at a time, so neither side needs the whole history in memory.
+class ArchiveWriter
+{
+  public:
+    /// Writes the header and the key table, `keys` must be sorted by key code. Keys with a code
+    /// of at least `KEY_CODE_COUNT` are left out with a warning.
+    ArchiveWriter(std::ostream &output, std::span<const ArchiveKey> keys);
+
+    /// Appends a row, rows must come sorted by day and key code. A row of a key that is not in
+    /// the table is skipped with a warning, returns whether the row was written.
+    auto add(DayNumber day, std::uint16_t key_code, std::uint64_t count) -> bool;
+
+    /// Writes the last day block and the end marker, throws `SystemError` if writing failed
+    auto finish() -> void;
+
+  private:
+    /// Marks key codes that are missing from the key table
+    static constexpr std::uint32_t NO_KEY_INDEX = UINT32_MAX;
+
+    /// Writes the rows collected for the current day as one block
+    auto writeDay() -> void;
+
+    std::ostream &out;
+    std::array<std::uint32_t, KEY_CODE_COUNT> key_indices{};
+
+    DayNumber previous_day{ 0 };
+    DayNumber current_day{ 0 };
+    std::vector<std::uint32_t> row_keys;
+    std::vector<std::uint64_t> row_counts;
+    std::vector<std::uint8_t> block;
+};
+
+/// Reads an archive written by `ArchiveWriter` one day at a time.
+/// Throws `DatabaseError` if the input is not a valid archive.
+class ArchiveReader
+{
+  public:
+    /// Reads the header and the key table
+    explicit ArchiveReader(std::istream &input);
+
+    /// Returns the key table
+    [[nodiscard]] auto keys() const -> const std::vector<ArchiveKey> &;
+
+    /// Reads the next day into `day`, returns false at the end of the archive
+    auto next(ArchiveDay &day) -> bool;
+
+  private:
+    /// Reads one varint
+    auto varint() -> std::uint64_t;
+
+    std::streambuf &in;
+    std::vector<ArchiveKey> key_table;
+    DayNumber previous_day{ 0 };
+    bool finished{ false };
+};
+
+} // namespace typetrace::backend
+
+#endif
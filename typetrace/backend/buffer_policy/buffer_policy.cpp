@@ -0,0 +1,74 @@
+#include "buffer_policy.hpp"
+
+#include "config.hpp"
+#include "constants.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+namespace typetrace::backend {
+
+BufferPolicy::BufferPolicy(const BufferSettings &buffer_settings) :
+  settings(buffer_settings),
+  threshold(std::clamp<std::size_t>(buffer_settings.flush_size, 1, MAX_BUFFER_SIZE))
+{
+    getLogger().info("Buffering policy: {} mode, flush size {}, max latency {}s",
+                     settings.adaptive ? "adaptive" : "fixed",
+                     threshold,
+                     settings.max_latency.count());
+}
+
+auto BufferPolicy::setDeferred(const bool defer) -> void
+{
+    if (defer == deferred) {
+        return;
+    }
+
+    deferred = defer;
+    if (deferred) {
+        getLogger().info("Deferring writes: flush size {}, max latency {}s",
+                         MAX_BUFFER_SIZE,
+                         settings.battery_max_latency.count());
+    } else {
+        getLogger().info("No longer deferring writes: flush size {}, max latency {}s",
+                         threshold,
+                         settings.max_latency.count());
+    }
+}
+
+auto BufferPolicy::onFlush(const std::size_t flushed,
+                           const std::chrono::steady_clock::duration fill_duration) -> void
+{
+    if (!settings.adaptive || flushed == 0) {
+        return;
+    }
+
+    // Avoid dividing by zero when a whole batch arrived within a single dispatch
+    constexpr double MIN_FILL_SECONDS = 0.001;
+    const double fill_seconds
+      = std::max(std::chrono::duration<double>(fill_duration).count(), MIN_FILL_SECONDS);
+    const double batch_rate = static_cast<double>(flushed) / fill_seconds;
+
+    events_per_second = (events_per_second == 0.0)
+                          ? batch_rate
+                          : (RATE_SMOOTHING * batch_rate)
+                              + ((1.0 - RATE_SMOOTHING) * events_per_second);
+
+    const double seconds_per_commit = 60.0 / static_cast<double>(settings.max_commits_per_minute);
+    const auto target = static_cast<std::size_t>(std::ceil(events_per_second * seconds_per_commit));
+    const std::size_t previous = threshold;
+
+    threshold = std::clamp(target, std::max<std::size_t>(settings.flush_size, 1), MAX_BUFFER_SIZE);
+
+    if (threshold != previous) {
+        getLogger().debug("Adaptive flush threshold changed from {} to {} ({:.1f} keys/s)",
+                          previous,
+                          threshold,
+                          events_per_second);
+    }
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,60 @@
+#ifndef TYPETRACE_BUFFER_POLICY_HPP
+#define TYPETRACE_BUFFER_POLICY_HPP
+
+#include "config.hpp"
+#include "constants.hpp"
+
+#include <chrono>
+#include <cstddef>
+
+namespace typetrace::backend {
+
+/// Decides at runtime how many keystrokes are buffered before they are written.
+///
+/// In fixed mode the threshold is the configured flush size. In adaptive mode the typing rate
+/// observed while each batch filled up is smoothed, and the threshold becomes the number of
+/// keystrokes expected per `60 / max_commits_per_minute` seconds, clamped between the flush size
+/// and the buffer capacity. The latency bound applies in both modes.
+///
+/// While deferred, e.g. on battery, the buffer only flushes once it is full or after the
+/// battery latency bound, so the disk is woken up as rarely as possible.
+class BufferPolicy
+{
+  public:
+    /// Constructs a policy from the buffering settings
+    explicit BufferPolicy(const BufferSettings &buffer_settings);
+
+    /// Returns the number of buffered keystrokes that triggers a flush
+    [[nodiscard]] auto flushThreshold() const -> std::size_t
+    {
+        return deferred ? MAX_BUFFER_SIZE : threshold;
+    }
+
+    /// Returns the longest time a keystroke may stay buffered
+    [[nodiscard]] auto maxLatency() const -> std::chrono::seconds
+    {
+        return deferred ? settings.battery_max_latency : settings.max_latency;
+    }
+
+    /// Returns true while writes are deferred
+    [[nodiscard]] auto isDeferred() const -> bool { return deferred; }
+
+    /// Starts or stops deferring writes
+    auto setDeferred(bool defer) -> void;
+
+    /// Updates the threshold after a batch that took `fill_duration` to collect was flushed
+    auto onFlush(std::size_t flushed, std::chrono::steady_clock::duration fill_duration) -> void;
+
+  private:
+    /// Weight of the newest batch in the smoothed typing rate
+    static constexpr double RATE_SMOOTHING = 0.3;
+
+    BufferSettings settings;
+    std::size_t threshold;
+    double events_per_second{ 0.0 };
+    bool deferred{ false };
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,99 @@
+#include "bus_watch.hpp"
+
+#include "exceptions.hpp"
+#include "logger.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <format>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <systemd/sd-bus.h>
+#include <unistd.h>
+
+namespace typetrace::backend {
+
+BusWatch::BusWatch(sd_bus *const connection) : bus(connection)
+{
+    epoll_fd.reset(epoll_create1(EPOLL_CLOEXEC));
+    timer_fd.reset(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (!epoll_fd || !timer_fd) {
+        throw SystemError(std::format("Failed to create bus watch: {}", std::strerror(errno)));
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    if (epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, timer_fd.get(), &event) < 0
+        || epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, sd_bus_get_fd(bus), &event) < 0) {
+        throw SystemError(std::format("Failed to watch the bus: {}", std::strerror(errno)));
+    }
+
+    // The connection may already have queued the handshake and the calls made so far
+    update();
+}
+
+auto BusWatch::process() -> void
+{
+    std::uint64_t expirations{ 0 };
+    [[maybe_unused]] const auto bytes_read
+      = ::read(timer_fd.get(), &expirations, sizeof(expirations));
+
+    int result = 0;
+    while ((result = sd_bus_process(bus, nullptr)) > 0) {
+    }
+
+    if (result < 0) {
+        getLogger().warn("Failed to process D-Bus messages: {}", std::strerror(-result));
+    }
+
+    update();
+}
+
+auto BusWatch::update() -> void
+{
+    const int events = sd_bus_get_events(bus);
+    if (events < 0) {
+        getLogger().warn("Failed to read D-Bus events: {}", std::strerror(-events));
+        return;
+    }
+
+    struct epoll_event event{};
+    event.events = ((static_cast<unsigned int>(events) & POLLIN) != 0 ? EPOLLIN : 0U)
+                   | ((static_cast<unsigned int>(events) & POLLOUT) != 0 ? EPOLLOUT : 0U);
+    if (epoll_ctl(epoll_fd.get(), EPOLL_CTL_MOD, sd_bus_get_fd(bus), &event) < 0) {
+        getLogger().warn("Failed to watch the bus: {}", std::strerror(errno));
+    }
+
+    std::uint64_t timeout{ 0 };
+    if (const int result = sd_bus_get_timeout(bus, &timeout); result < 0) {
+        getLogger().warn("Failed to read D-Bus timeout: {}", std::strerror(-result));
+        return;
+    }
+
+    // The timeout is absolute on the monotonic clock and zero if there is work right now. An
+    // expiration in the past fires right away, a zero one would disarm the timer instead.
+    struct itimerspec spec{};
+    if (timeout != UINT64_MAX) {
+        constexpr std::uint64_t USEC_PER_SEC = 1'000'000;
+        constexpr std::uint64_t NSEC_PER_USEC = 1'000;
+        spec.it_value.tv_sec = static_cast<time_t>(timeout / USEC_PER_SEC);
+        spec.it_value.tv_nsec = static_cast<long>((timeout % USEC_PER_SEC) * NSEC_PER_USEC);
+        if (timeout == 0) {
+            spec.it_value.tv_nsec = 1;
+        }
+    }
+
+    if (timerfd_settime(timer_fd.get(), TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+        getLogger().warn("Failed to set D-Bus timer: {}", std::strerror(errno));
+    }
+}
+
+auto BusWatch::fd() const -> int
+{
+    return epoll_fd.get();
+}
+
+} // namespace typetrace::backend
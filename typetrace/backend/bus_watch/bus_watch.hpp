@@ -0,0 +1,40 @@
+#ifndef TYPETRACE_BUS_WATCH_HPP
+#define TYPETRACE_BUS_WATCH_HPP
+
+#include "file_descriptor.hpp"
+
+#include <systemd/sd-bus.h>
+
+namespace typetrace::backend {
+
+/// Drives an sd-bus connection from an event loop that only waits for readable descriptors.
+///
+/// sd-bus also needs to be woken up when its socket can take queued messages and when a method
+/// call times out. The watch keeps the connection's socket and a timerfd in an epoll instance
+/// of its own, armed with what `sd_bus_get_events()` and `sd_bus_get_timeout()` ask for. Its
+/// descriptor is readable whenever the connection has work to do, so outgoing messages are
+/// written as the socket accepts them instead of blocking in `sd_bus_flush()`.
+class BusWatch
+{
+  public:
+    /// Watches `connection`, which must outlive the watch. Throws `SystemError` on failure.
+    explicit BusWatch(sd_bus *connection);
+
+    /// Handles all pending messages and timeouts, to be called when `fd()` is readable
+    auto process() -> void;
+
+    /// Re-arms the watch, to be called after queueing messages outside of `process()`
+    auto update() -> void;
+
+    /// Returns the descriptor the event loop watches for readability
+    [[nodiscard]] auto fd() const -> int;
+
+  private:
+    sd_bus *bus;
+    FileDescriptor epoll_fd;
+    FileDescriptor timer_fd;
+};
+
+} // namespace typetrace::backend
+
+#endif
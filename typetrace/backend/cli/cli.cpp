@@ -1,40 +1,277 @@
 #include "cli.hpp"
 
+#include "config.hpp"
 #include "constants.hpp"
 #include "database_manager.hpp"
+#include "day_clock.hpp"
+#include "dbus.hpp"
+#include "delta_log.hpp"
+#include "dimension_matrix.hpp"
 #include "event_handler.hpp"
 #include "exceptions.hpp"
+#include "input_source.hpp"
+#include "instance_lock.hpp"
+#include "latency_histogram.hpp"
+#include "live_counters.hpp"
+#include "live_segment.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
+#include "paths.hpp"
+#include "rhythm_stats.hpp"
+#include "snapshot_file.hpp"
 #include "types.hpp"
 #include "version.hpp"
+#include "writer.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
+#include <format>
+#include <fstream>
+#include <ios>
 #include <memory>
+#include <optional>
 #include <print>
+#include <set>
 #include <span>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <system_error>
+#include <utility>
 #include <vector>
 
 namespace typetrace::backend {
 
 Cli::Cli(std::span<char *> args)
 {
-    parseArguments(args);
+    const CliOptions options = parseArguments(args);
+    replay_mode = options.config.input.backend == InputBackend::replay;
 
-    db_manager = std::make_unique<DatabaseManager>(getDatabaseDir());
-    event_handler = std::make_unique<EventHandler>();
+    // A replay is a load test, its keystrokes must not end up in the history
+    database_dir = replay_mode ? std::filesystem::temp_directory_path() / REPLAY_DIR_NAME
+                               : getDatabaseDir();
+
+    // Every seat is served by this process, a second backend would compete for the WAL. Taken
+    // before the database is opened, so a second backend never migrates it under the first.
+    // The vacuum locks the database for its whole rewrite, so it must not run next to one.
+    const bool exclusive = !options.export_path && !options.import_path && !options.merge_path;
+    if (exclusive) {
+        std::filesystem::create_directories(database_dir);
+        instance_lock = std::make_unique<InstanceLock>(database_dir / LOCK_FILE_NAME);
+    }
+
+    db_manager = std::make_unique<DatabaseManager>(database_dir, options.config.database);
+
+    if (options.export_path || options.import_path) {
+        runArchiveCommand(options);
+        return;
+    }
+
+    if (options.merge_path) {
+        runMergeCommand(options);
+        return;
+    }
+
+    if (options.vacuum_mode) {
+        runVacuumCommand(database_dir / DB_FILE_NAME);
+        return;
+    }
+
+    // Attached before the spill file is replayed, so the replayed keystrokes are logged too
+    if (options.sync_mode) {
+        const std::string host = getSyncHost(options.config.sync);
+        const std::filesystem::path log_file = getSyncDir(options.config.sync, database_dir)
+                                               / (host + std::string{ DELTA_LOG_EXTENSION });
+        delta_log = std::make_unique<DeltaLogWriter>(log_file, host);
+        db_manager->setDeltaLog(delta_log.get());
+    }
+
+    if (options.spill_mode) {
+        spill_file = std::make_unique<SpillFile>(database_dir / SPILL_FILE_NAME);
+        replaySpillFile();
+    }
+
+    if (options.shm_mode) {
+        createLiveSegment();
+    }
+
+    // A frontend started before the first flush can already show the history
+    snapshot_file = std::make_unique<SnapshotFile>(database_dir / STATS_SNAPSHOT_FILE_NAME);
+    updateSnapshot();
+
+    // The signals its loop handles were blocked before the first thread was started
+    event_handler = std::make_unique<EventHandler>(options.config.buffer,
+                                                    createInputSource(options.config.input));
+    event_handler->setSpillFile(spill_file.get());
+
+    if (options.stats_mode) {
+        event_handler->setStatsCallback([database_file = database_dir / DB_FILE_NAME]() -> void {
+            std::print("{}", formatMetrics(snapshotMetrics(database_file)));
+            std::fflush(stdout);
+        });
+    }
+
+    if (options.dbus_mode) {
+        const DayNumber today = DayClock{}.today();
+        dbus_service = std::make_unique<DbusService>(
+          database_dir / DB_FILE_NAME, today, db_manager->getDayKeyCounts(today));
+
+        event_handler->setLiveCallback([this](std::span<const KeystrokeEvent> keystrokes) -> void {
+            dbus_service->addKeystrokes(keystrokes);
+        });
+        event_handler->watchFileDescriptor(dbus_service->busFd(),
+                                           [this]() -> void { dbus_service->processBus(); });
+        event_handler->watchFileDescriptor(dbus_service->signalTimerFd(),
+                                           [this]() -> void { dbus_service->onSignalTimer(); });
+        event_handler->watchFileDescriptor(dbus_service->flushEventFd(),
+                                           [this]() -> void { dbus_service->onFlushed(); });
+    }
+
+    if (options.power_mode) {
+        power_monitor = std::make_unique<PowerMonitor>(database_dir);
+
+        power_monitor->setPowerCallback(
+          [this](const bool on_battery) -> void { event_handler->setDeferred(on_battery); });
+        power_monitor->setSleepCallback([this]() -> void {
+            if (!event_handler->flush(SLEEP_FLUSH_TIMEOUT)) {
+                getLogger().warn("Buffered keystrokes were not committed before the suspend");
+            }
+        });
+        event_handler->setDeferred(power_monitor->onBattery());
+        event_handler->setDiskActivityProbe([this](const bool count_writes) -> bool {
+            return power_monitor->diskActive(count_writes);
+        });
+        event_handler->watchFileDescriptor(power_monitor->busFd(),
+                                           [this]() -> void { power_monitor->processBus(); });
+    }
+
+    if (options.extended_mode) {
+        event_handler->setDimensionsCallback([this](DimensionMatrix matrix) -> void {
+            if (writer) {
+                writer->submitDimensions(std::move(matrix));
+                return;
+            }
+
+            try {
+                db_manager->writeDayDimensions(matrix);
+            } catch (const DatabaseError &e) {
+                getLogger().warn("{}", e.what());
+            }
+        });
+    }
+
+    if (options.rhythm_mode) {
+        event_handler->setRhythmCallback([this](RhythmStats stats) -> void {
+            if (writer) {
+                writer->submitRhythm(std::move(stats));
+                return;
+            }
+
+            try {
+                db_manager->writeDayRhythm(stats);
+            } catch (const DatabaseError &e) {
+                getLogger().warn("{}", e.what());
+            }
+        });
+    }
+
+    if (options.threaded_mode) {
+        // The writer thread owns the connection from now on
+        writer = std::make_unique<Writer>(
+          std::move(db_manager),
+          [this](const bool written) -> void {
+              // A dropped batch is confirmed too, its keystrokes would fail again on a replay
+              event_handler->confirmFlush();
+              if (written && dbus_service) {
+                  dbus_service->notifyFlushed();
+              }
+          },
+          snapshot_file.get());
+
+        event_handler->setBufferCallback([this](std::span<const KeystrokeEvent> buffer) -> bool {
+            // A rejected buffer is handed over again, it must only be published once
+            if (!writer->submit(buffer)) {
+                return false;
+            }
+            publishFlush(buffer);
+            return true;
+        });
+        event_handler->setMaintenanceCallback(
+          [this]() -> void {
+              writer->requestCheckpoint();
+              writer->requestSnapshot();
+              writer->requestRetention();
+          },
+          options.config.database.checkpoint_interval);
+        return;
+    }
 
     // Set up callback for EventHandler to flush buffer to database
-    event_handler->setBufferCallback([this](const std::vector<KeystrokeEvent> &buffer) -> void {
+    event_handler->setBufferCallback([this](std::span<const KeystrokeEvent> buffer) -> bool {
+        publishFlush(buffer);
         db_manager->writeToDatabase(buffer);
+        event_handler->confirmFlush();
+
+        if (dbus_service) {
+            dbus_service->notifyFlushed();
+        }
+        return true;
     });
+
+    // Checkpoint the WAL, rewrite the snapshot and prune ourselves instead of after every commit
+    event_handler->setMaintenanceCallback(
+      [this]() -> void {
+          if (!pruning) {
+              try {
+                  db_manager->checkpoint(CheckpointMode::passive);
+              } catch (const DatabaseError &e) {
+                  getLogger().warn("{}", e.what());
+              }
+          }
+
+          // One batch per run like on the writer thread, input is handled before the next one
+          try {
+              pruning = db_manager->pruneExpiredDays();
+          } catch (const DatabaseError &e) {
+              getLogger().warn("{}", e.what());
+              pruning = false;
+          }
+
+          if (pruning) {
+              event_handler->scheduleMaintenance(RETENTION_BATCH_INTERVAL);
+              return;
+          }
+          updateSnapshot();
+      },
+      options.config.database.checkpoint_interval);
 }
 
 auto Cli::run() -> void
 {
-    while (true) { // TODO(domi): Use eventhandler to quit
-        event_handler->trace();
+    if (!event_handler) {
+        return;
+    }
+
+    event_handler->run();
+
+    // The final flush may have come after the last maintenance run
+    if (writer) {
+        writer->requestSnapshot();
+
+        // Waits until the queued batches are committed, then the spill file can forget them
+        writer.reset();
+        event_handler->releaseSpill();
+    } else {
+        updateSnapshot();
+    }
+
+    if (replay_mode) {
+        printReplayReport();
     }
 }
 
@@ -47,15 +284,72 @@ Version: {}
 Usage: {} [OPTION…]
 
 Options:
- -h, --help      Display help then exit.
- -v, --version   Display version then exit.
- -d, --debug     Enable debug mode.
+ -h, --help                      Display help then exit.
+ -v, --version                   Display version then exit.
+ -d, --debug                     Enable debug mode.
+     --async-log                 Write log messages on a background thread.
+     --log-file PATH             Also log to PATH, rotated at {} MiB keeping {} old files.
+ -t, --threaded                  Write to the database on a dedicated thread.
+ -s, --spill                     Keep buffered keystrokes in a file that is replayed after a crash.
+ -b, --dbus                      Publish live keystroke counts on the session bus.
+ -m, --shm                       Publish live keystroke counts in shared memory.
+ -e, --extended                  Record keystrokes per keyboard and hour of day.
+ -r, --rhythm                    Record intervals between key presses and pairs of keys.
+ -p, --power-aware               Defer database writes while running on battery.
+ -y, --sync                      Append every write to this host's delta log for other hosts.
+     --stats                     Print hot path metrics to stdout on SIGUSR1.
+ -c, --config PATH               Read settings from PATH instead of the default config file.
+
+Buffering:
+     --flush-size N              Write to the database every N keystrokes (default: {}).
+     --max-latency SECONDS       Write keystrokes after at most SECONDS (default: {}).
+     --adaptive                  Grow batches while typing in bursts, shrink them when idle.
+     --max-commits-per-minute N  Commit rate the adaptive mode aims for (default: {}).
+     --battery-max-latency SECONDS
+                                 Write keystrokes after at most SECONDS on battery (default: {}).
+
+Input:
+     --input-backend NAME        Read keyboards through `libinput` (default) or raw `evdev`.
+     --seats LIST                Read the keyboards of the comma separated seats (default: {}).
+
+Archive (exits when done):
+     --export PATH               Write all key counts to the archive PATH.
+     --import PATH               Add the key counts of the archive PATH to the database.
+
+Sync (exits when done):
+     --merge PATH                Add the new records of the delta log PATH, or of every delta log
+                                 in the directory PATH, to the database.
+
+Maintenance (exits when done):
+     --vacuum                    Rewrite the database so pruned days give their space back. Only
+                                 needed once for databases created by older versions, while no
+                                 backend is running.
+
+Replay (load testing, exits when done):
+     --replay PATTERN            Feed generated `typing` or `flood` keystrokes instead of keyboards.
+     --replay-trace PATH         Feed the `key_code` or `day key_code` lines of PATH instead.
+     --replay-rate N             Keystrokes per second, 0 for full speed (default: {} or {}).
+     --replay-keystrokes N       Number of generated keystrokes (default: {}).
+     --replay-days N             Spread the keystrokes over N days ending today (default: 1).
+
+Settings can also be given as `key = value` lines in the config file, using the option names
+with underscores (e.g. `flush_size = 200`). Command line options take precedence.
 
 Warning: This is the backend and is not designed to run by users.
 You should run the frontend of TypeTrace which will run this.
 )",
                PROJECT_VERSION,
-               program_name);
+               program_name,
+               LOG_FILE_MAX_SIZE / (1024 * 1024),
+               LOG_FILE_COUNT,
+               BUFFER_SIZE,
+               BUFFER_TIMEOUT,
+               DEFAULT_MAX_COMMITS_PER_MINUTE,
+               DEFAULT_BATTERY_MAX_LATENCY,
+               DEFAULT_SEAT,
+               REPLAY_TYPING_RATE,
+               REPLAY_FLOOD_RATE,
+               REPLAY_KEYSTROKES);
 }
 
 auto Cli::showVersion() -> void
@@ -63,28 +357,201 @@ auto Cli::showVersion() -> void
     std::println(PROJECT_VERSION);
 }
 
-auto Cli::getDatabaseDir() -> std::filesystem::path
+auto Cli::runArchiveCommand(const CliOptions &options) -> void
+{
+    using Seconds = std::chrono::duration<double>;
+    const auto start = std::chrono::steady_clock::now();
+
+    if (options.export_path) {
+        const std::filesystem::path &path = *options.export_path;
+        std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+        if (!file) {
+            throw SystemError(std::format("Failed to create archive: {}", path.string()));
+        }
+
+        const std::size_t rows = db_manager->exportArchive(file);
+        std::println("Exported {} rows to {} in {:.2f}s",
+                     rows,
+                     path.string(),
+                     Seconds{ std::chrono::steady_clock::now() - start }.count());
+        return;
+    }
+
+    const std::filesystem::path &path = *options.import_path;
+    std::ifstream file{ path, std::ios::binary };
+    if (!file) {
+        throw SystemError(std::format("Failed to open archive: {}", path.string()));
+    }
+
+    const std::size_t rows = db_manager->importArchive(file);
+    std::println("Imported {} rows from {} in {:.2f}s",
+                 rows,
+                 path.string(),
+                 Seconds{ std::chrono::steady_clock::now() - start }.count());
+}
+
+auto Cli::runMergeCommand(const CliOptions &options) -> void
+{
+    using Seconds = std::chrono::duration<double>;
+    const auto start = std::chrono::steady_clock::now();
+
+    const std::filesystem::path &path = *options.merge_path;
+    const std::string own_host = getSyncHost(options.config.sync);
+
+    // A directory is typically the synced one, it holds this host's log next to the others
+    std::vector<std::filesystem::path> logs;
+    if (std::filesystem::is_directory(path)) {
+        for (const auto &entry : std::filesystem::directory_iterator{ path }) {
+            if (entry.is_regular_file() && entry.path().extension() == DELTA_LOG_EXTENSION) {
+                logs.push_back(entry.path());
+            }
+        }
+        std::ranges::sort(logs);
+    } else {
+        logs.push_back(path);
+    }
+
+    std::size_t records{ 0 };
+    std::size_t merged_logs{ 0 };
+    std::set<std::uint64_t> merged_log_ids;
+    for (const std::filesystem::path &log_path : logs) {
+        try {
+            DeltaLogReader log{ log_path };
+            if (log.host() == own_host) {
+                getLogger().info("Skipping this host's own delta log: {}", log_path.string());
+                continue;
+            }
+
+            // Sync tools leave conflict copies behind, the same log is only merged once
+            if (merged_log_ids.contains(log.logId())) {
+                getLogger().info("Skipping another copy of a merged delta log: {}",
+                                 log_path.string());
+                continue;
+            }
+
+            records += db_manager->mergeDeltaLog(log);
+            merged_log_ids.insert(log.logId());
+            ++merged_logs;
+        } catch (const DatabaseError &e) {
+            // One broken log does not keep the others from being merged
+            getLogger().error("{}", e.what());
+        }
+    }
+
+    std::println("Merged {} records from {} delta logs in {:.2f}s",
+                 records,
+                 merged_logs,
+                 Seconds{ std::chrono::steady_clock::now() - start }.count());
+}
+
+auto Cli::runVacuumCommand(const std::filesystem::path &database_file) -> void
+{
+    using Seconds = std::chrono::duration<double>;
+    const auto start = std::chrono::steady_clock::now();
+
+    db_manager->vacuum();
+    std::println("Vacuumed {} in {:.2f}s",
+                 database_file.string(),
+                 Seconds{ std::chrono::steady_clock::now() - start }.count());
+}
+
+auto Cli::replaySpillFile() -> void
+{
+    const auto pending = spill_file->pending();
+    if (pending.empty()) {
+        return;
+    }
+
+    getLogger().info("Replaying {} keystrokes from the spill file", pending.size());
+    db_manager->writeToDatabase(pending);
+    spill_file->clear();
+}
+
+auto Cli::createLiveSegment() -> void
 {
-    if (const char *xdg_path = std::getenv("XDG_DATA_HOME")) {
-        getLogger()->debug("Found XDG data directory: {}", xdg_path);
-        return std::filesystem::path{ xdg_path } / PROJECT_DIR_NAME;
+    const DayNumber today = DayClock{}.today();
+
+    live_segment = std::make_unique<LiveSegment>(getLiveCountersPath(),
+                                                 today,
+                                                 db_manager->getDayKeyCounts(today),
+                                                 db_manager->getTotalKeyCounts());
+}
+
+auto Cli::publishFlush(const std::span<const KeystrokeEvent> buffer) -> void
+{
+    if (live_segment) {
+        live_segment->publish(buffer);
+    }
+}
+
+auto Cli::updateSnapshot() -> void
+{
+    try {
+        snapshot_file->update(*db_manager);
+    } catch (const std::runtime_error &e) {
+        getLogger().warn("{}", e.what());
     }
+}
+
+auto Cli::printReplayReport() -> void
+{
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    using Seconds = std::chrono::duration<double>;
+
+    const InputStats &stats = event_handler->getInputStats();
+
+    // Wait for queued batches and close the connection, so the size is the one left on disk
+    writer.reset();
+    db_manager.reset();
+
+    const std::filesystem::path database_file = database_dir / DB_FILE_NAME;
+    const std::filesystem::path wal_file{ database_file.string() + "-wal" };
 
-    const char *home = std::getenv("HOME");
-    if (home == nullptr) {
-        throw SystemError("HOME environment variable is not set");
+    std::uintmax_t database_size{ 0 };
+    for (const auto &path : { database_file, wal_file }) {
+        std::error_code error;
+        if (const auto size = std::filesystem::file_size(path, error); !error) {
+            database_size += size;
+        }
     }
 
-    getLogger()->debug("Using default home directory: {}", home);
-    return std::filesystem::path{ home } / ".local" / "share" / PROJECT_DIR_NAME;
+    const double elapsed
+      = std::chrono::duration_cast<Seconds>(stats.stopped - stats.started).count();
+    const auto to_milliseconds = [](const LatencyHistogram::Duration duration) -> double {
+        return std::chrono::duration_cast<Milliseconds>(duration).count();
+    };
+
+    std::println("Replayed {} keystrokes in {:.2f}s ({:.0f} keystrokes/s)",
+                 stats.keystrokes,
+                 elapsed,
+                 elapsed > 0 ? static_cast<double>(stats.keystrokes) / elapsed : 0.0);
+    std::println("Flushes: {}, latency p50 {:.2f}ms, p99 {:.2f}ms, max {:.2f}ms",
+                 stats.flush_latency.count(),
+                 to_milliseconds(stats.flush_latency.percentile(0.5)),
+                 to_milliseconds(stats.flush_latency.percentile(0.99)),
+                 to_milliseconds(stats.flush_latency.max()));
+    std::println("Database size: {} bytes ({})", database_size, database_file.string());
 }
 
-auto Cli::parseArguments(std::span<char *> args) -> void
+auto Cli::parseArguments(std::span<char *> args) -> CliOptions
 {
-    bool debug_mode{ false };
+    CliOptions options;
+    std::optional<std::filesystem::path> config_path = getDefaultConfigPath();
+    bool config_required{ false };
+    std::vector<std::pair<std::string_view, std::string_view>> overrides;
 
-    for (const auto &arg_str : args.subspan(1)) {
-        std::string_view arg{ arg_str };
+    for (std::size_t index = 1; index < args.size(); ++index) {
+        std::string_view arg{ args[index] };
+
+        // Returns the argument following an option that requires a value
+        const auto next_value = [&]() -> std::string_view {
+            if (index + 1 >= args.size()) {
+                std::println("Missing value for option: {}", arg);
+                showHelp(args[0]);
+                std::exit(1);
+            }
+            return args[++index];
+        };
 
         if (arg == "-h" || arg == "--help") {
             showHelp(args[0]);
@@ -93,7 +560,66 @@ auto Cli::parseArguments(std::span<char *> args) -> void
             showVersion();
             std::exit(0);
         } else if (arg == "-d" || arg == "--debug") {
-            debug_mode = true;
+            options.logging.debug_mode = true;
+        } else if (arg == "-t" || arg == "--threaded") {
+            options.threaded_mode = true;
+        } else if (arg == "-s" || arg == "--spill") {
+            options.spill_mode = true;
+        } else if (arg == "-b" || arg == "--dbus") {
+            options.dbus_mode = true;
+        } else if (arg == "-m" || arg == "--shm") {
+            options.shm_mode = true;
+        } else if (arg == "-e" || arg == "--extended") {
+            options.extended_mode = true;
+        } else if (arg == "-r" || arg == "--rhythm") {
+            options.rhythm_mode = true;
+        } else if (arg == "-p" || arg == "--power-aware") {
+            options.power_mode = true;
+        } else if (arg == "-y" || arg == "--sync") {
+            options.sync_mode = true;
+        } else if (arg == "--async-log") {
+            options.logging.async = true;
+        } else if (arg == "--log-file") {
+            options.logging.file = std::filesystem::path{ next_value() };
+        } else if (arg == "--stats") {
+            options.stats_mode = true;
+        } else if (arg == "-c" || arg == "--config") {
+            config_path = std::filesystem::path{ next_value() };
+            config_required = true;
+        } else if (arg == "--flush-size") {
+            overrides.emplace_back("flush_size", next_value());
+        } else if (arg == "--max-latency") {
+            overrides.emplace_back("max_latency", next_value());
+        } else if (arg == "--adaptive") {
+            overrides.emplace_back("adaptive", "true");
+        } else if (arg == "--max-commits-per-minute") {
+            overrides.emplace_back("max_commits_per_minute", next_value());
+        } else if (arg == "--battery-max-latency") {
+            overrides.emplace_back("battery_max_latency", next_value());
+        } else if (arg == "--input-backend") {
+            overrides.emplace_back("input_backend", next_value());
+        } else if (arg == "--seats") {
+            overrides.emplace_back("seats", next_value());
+        } else if (arg == "--export") {
+            options.export_path = std::filesystem::path{ next_value() };
+        } else if (arg == "--import") {
+            options.import_path = std::filesystem::path{ next_value() };
+        } else if (arg == "--merge") {
+            options.merge_path = std::filesystem::path{ next_value() };
+        } else if (arg == "--vacuum") {
+            options.vacuum_mode = true;
+        } else if (arg == "--replay") {
+            overrides.emplace_back("input_backend", "replay");
+            overrides.emplace_back("replay_pattern", next_value());
+        } else if (arg == "--replay-trace") {
+            overrides.emplace_back("input_backend", "replay");
+            overrides.emplace_back("replay_trace", next_value());
+        } else if (arg == "--replay-rate") {
+            overrides.emplace_back("replay_rate", next_value());
+        } else if (arg == "--replay-keystrokes") {
+            overrides.emplace_back("replay_keystrokes", next_value());
+        } else if (arg == "--replay-days") {
+            overrides.emplace_back("replay_days", next_value());
         } else {
             std::println("Unknown option: {}", arg);
             showHelp(args[0]);
@@ -101,7 +627,39 @@ auto Cli::parseArguments(std::span<char *> args) -> void
         }
     }
 
-    initLogger(debug_mode);
+    if (static_cast<int>(options.export_path.has_value())
+          + static_cast<int>(options.import_path.has_value())
+          + static_cast<int>(options.merge_path.has_value())
+          + static_cast<int>(options.vacuum_mode)
+        > 1) {
+        std::println("--export, --import, --merge and --vacuum can't be combined");
+        std::exit(1);
+    }
+
+    // Archive, sync and maintenance commands keep the default actions, so they can be interrupted
+    if (!options.export_path && !options.import_path && !options.merge_path
+        && !options.vacuum_mode) {
+        // Before the async logger starts its worker, so that thread inherits the mask as well
+        EventHandler::blockLoopSignals();
+    }
+
+    initLogger(options.logging);
+
+    if (config_path) {
+        loadConfigFile(*config_path, options.config, config_required);
+    }
+
+    for (const auto &[key, value] : overrides) {
+        applySetting(options.config, key, value);
+    }
+
+    // The replay's database is a scratch one, but other hosts would merge its keystrokes
+    if (options.sync_mode && options.config.input.backend == InputBackend::replay) {
+        std::println("--sync can't be combined with the replay backend");
+        std::exit(1);
+    }
+
+    return options;
 }
 
 } // namespace typetrace::backend
@@ -1,27 +1,60 @@
 #ifndef TYPETRACE_CLI_HPP
 #define TYPETRACE_CLI_HPP
 
+#include "config.hpp"
 #include "database_manager.hpp"
+#include "dbus.hpp"
+#include "delta_log.hpp"
 #include "event_handler.hpp"
+#include "instance_lock.hpp"
+#include "live_segment.hpp"
+#include "logger.hpp"
+#include "power_monitor.hpp"
+#include "snapshot_file.hpp"
+#include "spill_file.hpp"
+#include "writer.hpp"
 
 #include <filesystem>
 #include <memory>
+#include <optional>
 #include <span>
 
 namespace typetrace::backend {
 
+/// Options collected from the command line
+struct CliOptions
+{
+    bool threaded_mode{ false }; ///< Write to the database on a dedicated thread
+    bool spill_mode{ false };    ///< Mirror buffered keystrokes to a crash-safe spill file
+    bool dbus_mode{ false };     ///< Publish live keystroke deltas on the session bus
+    bool shm_mode{ false };      ///< Publish live counters in a shared-memory segment
+    bool extended_mode{ false }; ///< Record keystrokes per keyboard and hour of day
+    bool rhythm_mode{ false };   ///< Record inter-key intervals and key pairs
+    bool power_mode{ false };    ///< Defer database writes while on battery
+    bool sync_mode{ false };     ///< Append every write to this host's delta log
+    bool stats_mode{ false };    ///< Print the hot path metrics on SIGUSR1
+    LoggerSettings logging;      ///< Log level, async mode and log file
+    std::optional<std::filesystem::path> export_path; ///< Write an archive instead of tracing
+    std::optional<std::filesystem::path> import_path; ///< Merge an archive instead of tracing
+    std::optional<std::filesystem::path> merge_path;  ///< Merge delta logs instead of tracing
+    bool vacuum_mode{ false };   ///< Rewrite the database with incremental vacuum instead
+    Config config;               ///< Settings from the config file and command line
+};
+
 class Cli
 {
   public:
     /// Constructs a CLI instance and parses command line arguments
     explicit Cli(std::span<char *> args);
 
-    /// Runs the main event loop for keystroke tracing
+    /// Runs the main event loop for keystroke tracing until the event handler is stopped.
+    /// Returns right away if an archive was exported or imported, delta logs were merged or the
+    /// database was vacuumed.
     auto run() -> void;
 
   private:
-    /// Parses and processes command line arguments
-    static auto parseArguments(std::span<char *> args) -> void;
+    /// Parses command line arguments and merges them with the config file
+    [[nodiscard]] static auto parseArguments(std::span<char *> args) -> CliOptions;
 
     /// Displays help information and usage instructions
     static auto showHelp(const char *program_name) -> void;
@@ -29,11 +62,46 @@ class Cli
     /// Displays the program version information
     static auto showVersion() -> void;
 
-    /// Gets the database directory path using XDG or fallback locations
-    [[nodiscard]] static auto getDatabaseDir() -> std::filesystem::path;
+    /// Exports or imports the archive given on the command line
+    auto runArchiveCommand(const CliOptions &options) -> void;
+
+    /// Merges the delta logs given on the command line, this host's own log is skipped
+    auto runMergeCommand(const CliOptions &options) -> void;
+
+    /// Rewrites the database with incremental vacuum, the instance lock was taken before the
+    /// database was opened
+    auto runVacuumCommand(const std::filesystem::path &database_file) -> void;
+
+    /// Writes keystrokes left in the spill file by a previous run to the database
+    auto replaySpillFile() -> void;
 
+    /// Creates the live counter segment from the counts in the database
+    auto createLiveSegment() -> void;
+
+    /// Updates the statistics snapshot from the main thread's connection, failures are logged
+    auto updateSnapshot() -> void;
+
+    /// Hands a flushed batch to everything that consumes flushes besides the database
+    auto publishFlush(std::span<const KeystrokeEvent> buffer) -> void;
+
+    /// Closes the database and prints throughput, flush latency and database size of a replay
+    auto printReplayReport() -> void;
+
+    /// Declared first so the database is closed before another backend can take over
+    std::unique_ptr<InstanceLock> instance_lock;
+    std::unique_ptr<SpillFile> spill_file;
+    std::unique_ptr<DeltaLogWriter> delta_log; ///< Outlives the writer thread appending to it
+    std::unique_ptr<DbusService> dbus_service;
+    std::unique_ptr<PowerMonitor> power_monitor;
+    std::unique_ptr<LiveSegment> live_segment;
+    std::unique_ptr<SnapshotFile> snapshot_file;
     std::unique_ptr<EventHandler> event_handler;
     std::unique_ptr<DatabaseManager> db_manager;
+    std::unique_ptr<Writer> writer;
+
+    std::filesystem::path database_dir; ///< A scratch directory during a replay
+    bool replay_mode{ false };
+    bool pruning{ false }; ///< Set while expired rows are left for the next maintenance run
 };
 
 } // namespace typetrace::backend
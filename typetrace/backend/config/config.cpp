@@ -0,0 +1,292 @@
+#include "config.hpp"
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// Removes leading and trailing whitespace
+auto trim(std::string_view text) -> std::string_view
+{
+    constexpr std::string_view WHITESPACE = " \t\r";
+
+    const auto first = text.find_first_not_of(WHITESPACE);
+    if (first == std::string_view::npos) {
+        return {};
+    }
+
+    return text.substr(first, text.find_last_not_of(WHITESPACE) - first + 1);
+}
+
+/// Cuts off a comment, a `#` at the start of the line or after whitespace. One inside a value,
+/// like in a path or a host name, is kept.
+auto stripComment(const std::string_view line) -> std::string_view
+{
+    for (std::size_t index = 0; index < line.size(); ++index) {
+        if (line[index] == '#'
+            && (index == 0 || std::isspace(static_cast<unsigned char>(line[index - 1])) != 0)) {
+            return line.substr(0, index);
+        }
+    }
+    return line;
+}
+
+/// Parses an unsigned number within the given bounds
+auto parseNumber(const std::string_view key,
+                 const std::string_view value,
+                 const std::size_t min,
+                 const std::size_t max) -> std::size_t
+{
+    const char *const value_end = std::to_address(value.end());
+
+    std::size_t number{ 0 };
+    const auto [end, error] = std::from_chars(value.data(), value_end, number);
+
+    if (error != std::errc{} || end != value_end) {
+        throw ConfigurationError(std::format("'{}' expects a number, got '{}'", key, value));
+    }
+
+    if (number < min || number > max) {
+        throw ConfigurationError(
+          std::format("'{}' must be between {} and {}, got {}", key, min, max, number));
+    }
+
+    return number;
+}
+
+/// Parses a boolean written as true/false, yes/no, on/off or 1/0
+auto parseBool(const std::string_view key, const std::string_view value) -> bool
+{
+    if (value == "true" || value == "yes" || value == "on" || value == "1") {
+        return true;
+    }
+
+    if (value == "false" || value == "no" || value == "off" || value == "0") {
+        return false;
+    }
+
+    throw ConfigurationError(std::format("'{}' expects a boolean, got '{}'", key, value));
+}
+
+/// Parses the name of an input backend
+auto parseInputBackend(const std::string_view key, const std::string_view value) -> InputBackend
+{
+    if (value == "libinput") {
+        return InputBackend::libinput;
+    }
+
+    if (value == "evdev") {
+        return InputBackend::evdev;
+    }
+
+    if (value == "replay") {
+        return InputBackend::replay;
+    }
+
+    throw ConfigurationError(
+      std::format("'{}' expects 'libinput', 'evdev' or 'replay', got '{}'", key, value));
+}
+
+/// Parses the name of a replay pattern
+auto parseReplayPattern(const std::string_view key, const std::string_view value) -> ReplayPattern
+{
+    if (value == "typing") {
+        return ReplayPattern::typing;
+    }
+
+    if (value == "flood") {
+        return ReplayPattern::flood;
+    }
+
+    throw ConfigurationError(std::format("'{}' expects 'typing' or 'flood', got '{}'", key, value));
+}
+
+/// Parses a host ID, it becomes a file name so only a safe set of characters is allowed
+auto parseSyncHost(const std::string_view key, const std::string_view value) -> std::string
+{
+    const auto is_allowed = [](const char character) -> bool {
+        return std::isalnum(static_cast<unsigned char>(character)) != 0 || character == '-'
+               || character == '_' || character == '.';
+    };
+
+    if (value.empty() || value.size() > MAX_SYNC_HOST_SIZE || value.front() == '.'
+        || !std::ranges::all_of(value, is_allowed)) {
+        throw ConfigurationError(std::format("'{}' expects up to {} letters, digits, '-', '_' or "
+                                             "'.' that don't start with a '.', got '{}'",
+                                             key,
+                                             MAX_SYNC_HOST_SIZE,
+                                             value));
+    }
+
+    return std::string{ value };
+}
+
+/// Splits a comma separated list, empty items are skipped
+auto parseList(const std::string_view value) -> std::vector<std::string>
+{
+    std::vector<std::string> items;
+
+    for (std::size_t start = 0; start <= value.size();) {
+        const auto end = std::min(value.find(',', start), value.size());
+        if (const auto item = trim(value.substr(start, end - start)); !item.empty()) {
+            items.emplace_back(item);
+        }
+        start = end + 1;
+    }
+
+    return items;
+}
+
+} // namespace
+
+auto applySetting(Config &config, const std::string_view key, const std::string_view value)
+  -> void
+{
+    constexpr std::size_t MAX_LATENCY_SECONDS = 24 * 60 * 60;
+    constexpr std::size_t MAX_COMMITS_PER_MINUTE = 600;
+    constexpr std::size_t MAX_REPLAY_RATE = 1'000'000;
+    constexpr std::size_t MAX_REPLAY_DAYS = 100 * 366;
+    constexpr std::size_t MAX_RETENTION_DAYS = 100 * 366;
+    constexpr auto MAX_DB_SETTING = static_cast<std::size_t>(std::numeric_limits<int>::max());
+    constexpr auto MAX_MMAP_SIZE
+      = static_cast<std::size_t>(std::numeric_limits<std::int64_t>::max());
+
+    if (key == "flush_size") {
+        config.buffer.flush_size = parseNumber(key, value, 1, MAX_BUFFER_SIZE);
+    } else if (key == "max_latency") {
+        config.buffer.max_latency
+          = std::chrono::seconds{ parseNumber(key, value, 1, MAX_LATENCY_SECONDS) };
+    } else if (key == "adaptive") {
+        config.buffer.adaptive = parseBool(key, value);
+    } else if (key == "max_commits_per_minute") {
+        config.buffer.max_commits_per_minute = parseNumber(key, value, 1, MAX_COMMITS_PER_MINUTE);
+    } else if (key == "battery_max_latency") {
+        config.buffer.battery_max_latency
+          = std::chrono::seconds{ parseNumber(key, value, 1, MAX_LATENCY_SECONDS) };
+    } else if (key == "db_mmap_size") {
+        config.database.mmap_size = parseNumber(key, value, 0, MAX_MMAP_SIZE);
+    } else if (key == "db_cache_size") {
+        config.database.cache_size = parseNumber(key, value, 0, MAX_DB_SETTING);
+    } else if (key == "db_wal_autocheckpoint") {
+        config.database.wal_autocheckpoint = parseNumber(key, value, 0, MAX_DB_SETTING);
+    } else if (key == "db_busy_timeout") {
+        config.database.busy_timeout_ms = parseNumber(key, value, 0, MAX_DB_SETTING);
+    } else if (key == "db_checkpoint_interval") {
+        config.database.checkpoint_interval
+          = std::chrono::seconds{ parseNumber(key, value, 1, MAX_LATENCY_SECONDS) };
+    } else if (key == "db_retention_days") {
+        config.database.retention_days = parseNumber(key, value, 0, MAX_RETENTION_DAYS);
+    } else if (key == "input_backend") {
+        config.input.backend = parseInputBackend(key, value);
+    } else if (key == "device_allow") {
+        config.input.allowed_devices = parseList(value);
+    } else if (key == "device_deny") {
+        config.input.denied_devices = parseList(value);
+    } else if (key == "seats") {
+        config.input.seats = parseList(value);
+        if (config.input.seats.empty()) {
+            throw ConfigurationError(std::format("'{}' expects at least one seat", key));
+        }
+
+        // A seat read twice would count every key press twice
+        auto seats = config.input.seats;
+        std::ranges::sort(seats);
+        if (const auto duplicate = std::ranges::adjacent_find(seats); duplicate != seats.end()) {
+            throw ConfigurationError(std::format("'{}' lists '{}' twice", key, *duplicate));
+        }
+    } else if (key == "replay_pattern") {
+        config.input.replay.pattern = parseReplayPattern(key, value);
+    } else if (key == "replay_trace") {
+        config.input.replay.trace = std::filesystem::path{ value };
+    } else if (key == "replay_rate") {
+        config.input.replay.rate = parseNumber(key, value, 0, MAX_REPLAY_RATE);
+    } else if (key == "replay_keystrokes") {
+        config.input.replay.keystrokes
+          = parseNumber(key, value, 1, std::numeric_limits<std::size_t>::max());
+    } else if (key == "replay_days") {
+        config.input.replay.days = parseNumber(key, value, 1, MAX_REPLAY_DAYS);
+    } else if (key == "sync_dir") {
+        config.sync.dir = std::filesystem::path{ value };
+    } else if (key == "sync_host") {
+        config.sync.host = parseSyncHost(key, value);
+    } else {
+        throw ConfigurationError(std::format("Unknown setting '{}'", key));
+    }
+}
+
+auto loadConfigFile(const std::filesystem::path &path, Config &config, const bool required)
+  -> void
+{
+    std::ifstream file{ path };
+    if (!file && required) {
+        throw ConfigurationError(std::format("Can't read config file '{}'", path.string()));
+    }
+    if (!file) {
+        getLogger().debug("No config file found at: {}", path.string());
+        return;
+    }
+
+    getLogger().info("Loading config file: {}", path.string());
+
+    std::string line;
+    std::size_t line_number{ 0 };
+
+    while (std::getline(file, line)) {
+        ++line_number;
+
+        const std::string_view content = trim(stripComment(line));
+        if (content.empty()) {
+            continue;
+        }
+
+        const auto separator = content.find('=');
+        if (separator == std::string_view::npos) {
+            throw ConfigurationError(
+              std::format("{}:{}: expected 'key = value'", path.string(), line_number));
+        }
+
+        try {
+            applySetting(
+              config, trim(content.substr(0, separator)), trim(content.substr(separator + 1)));
+        } catch (const ConfigurationError &) {
+            getLogger().error("Invalid setting in {}:{}", path.string(), line_number);
+            throw;
+        }
+    }
+}
+
+auto getDefaultConfigPath() -> std::optional<std::filesystem::path>
+{
+    if (const char *xdg_path = std::getenv("XDG_CONFIG_HOME")) {
+        return std::filesystem::path{ xdg_path } / PROJECT_DIR_NAME / CONFIG_FILE_NAME;
+    }
+
+    if (const char *home = std::getenv("HOME")) {
+        return std::filesystem::path{ home } / ".config" / PROJECT_DIR_NAME / CONFIG_FILE_NAME;
+    }
+
+    return std::nullopt;
+}
+
+} // namespace typetrace::backend
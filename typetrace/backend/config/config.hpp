@@ -0,0 +1,148 @@
+#ifndef TYPETRACE_CONFIG_HPP
+#define TYPETRACE_CONFIG_HPP
+
+#include "constants.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// Settings controlling when buffered keystrokes are written to the database
+struct BufferSettings
+{
+    /// Number of keystrokes per write, the smallest batch size in adaptive mode
+    std::size_t flush_size{ BUFFER_SIZE };
+
+    /// Longest time a keystroke stays buffered before it is written
+    std::chrono::seconds max_latency{ BUFFER_TIMEOUT };
+
+    /// Grows the batch size while the user types in bursts and shrinks it when input goes idle
+    bool adaptive{ false };
+
+    /// Commit rate the adaptive mode aims to stay below
+    std::size_t max_commits_per_minute{ DEFAULT_MAX_COMMITS_PER_MINUTE };
+
+    /// Longest time a keystroke stays buffered while writes are deferred on battery
+    std::chrono::seconds battery_max_latency{ DEFAULT_BATTERY_MAX_LATENCY };
+};
+
+/// Settings applied to the SQLite connection of the backend
+struct DatabaseSettings
+{
+    /// Size of the memory-mapped I/O window in bytes, 0 disables memory-mapped I/O
+    std::size_t mmap_size{ DEFAULT_DB_MMAP_SIZE };
+
+    /// Number of pages kept in the page cache
+    std::size_t cache_size{ DEFAULT_DB_CACHE_SIZE };
+
+    /// WAL size in pages that triggers an automatic checkpoint, 0 disables auto-checkpoints
+    std::size_t wal_autocheckpoint{ DEFAULT_DB_WAL_AUTOCHECKPOINT };
+
+    /// Time in milliseconds to wait for a lock held by another connection
+    std::size_t busy_timeout_ms{ DEFAULT_DB_BUSY_TIMEOUT_MS };
+
+    /// Longest time written data stays in the WAL before a passive checkpoint runs
+    std::chrono::seconds checkpoint_interval{ DEFAULT_DB_CHECKPOINT_INTERVAL };
+
+    /// Days whose keystroke rows are kept, older ones only live on in the rollups. 0 keeps
+    /// every day.
+    std::size_t retention_days{ DEFAULT_DB_RETENTION_DAYS };
+};
+
+/// Library the backend reads key presses through
+enum class InputBackend : std::uint8_t
+{
+    libinput, ///< Full libinput context, handles device quirks
+    evdev,    ///< Raw `input_event`s read from the keyboards' device nodes
+    replay,   ///< Synthetic or recorded keystrokes, for load testing without a keyboard
+};
+
+/// Keystroke stream the replay backend generates when it has no trace file
+enum class ReplayPattern : std::uint8_t
+{
+    typing, ///< Zipf distributed keys, like the letter frequencies of prose
+    flood,  ///< A macro repeating the same short key sequence
+};
+
+/// Settings of the replay backend
+struct ReplaySettings
+{
+    ReplayPattern pattern{ ReplayPattern::typing };
+
+    /// File with one `key_code` or `day key_code` per line, replaces the pattern if set
+    std::optional<std::filesystem::path> trace;
+
+    /// Keystrokes per second, 0 replays as fast as the backend can take them. Defaults to
+    /// `REPLAY_TYPING_RATE` or `REPLAY_FLOOD_RATE` depending on the pattern.
+    std::optional<std::size_t> rate;
+
+    /// Number of keystrokes generated, a trace is replayed once regardless
+    std::size_t keystrokes{ REPLAY_KEYSTROKES };
+
+    /// Generated keystrokes are spread evenly over this many days ending today, so the replay
+    /// crosses midnight `days - 1` times
+    std::size_t days{ 1 };
+};
+
+/// Settings controlling how key presses are read
+struct InputSettings
+{
+    InputBackend backend{ InputBackend::libinput };
+
+    /// Only keyboards matching one of these patterns are read, all of them if it is empty
+    std::vector<std::string> allowed_devices;
+
+    /// Keyboards matching one of these patterns are never read, even if they are allowed
+    std::vector<std::string> denied_devices;
+
+    /// Seats whose keyboards are read, all of them feed the same database. Keyboards of other
+    /// seats than `DEFAULT_SEAT` are told apart by a `seat/` prefix of their device ID.
+    std::vector<std::string> seats{ std::string{ DEFAULT_SEAT } };
+
+    /// Only used by `InputBackend::replay`
+    ReplaySettings replay;
+};
+
+/// Settings of the per-host delta logs that combine the statistics of several machines
+struct SyncSettings
+{
+    /// Directory of the delta logs, `SYNC_DIR_NAME` in the database directory if unset
+    std::optional<std::filesystem::path> dir;
+
+    /// ID of this machine, it names its delta log. The host name is used if unset.
+    std::optional<std::string> host;
+};
+
+/// Runtime configuration of the backend
+struct Config
+{
+    BufferSettings buffer;
+    DatabaseSettings database;
+    InputSettings input;
+    SyncSettings sync;
+};
+
+/// Applies a single `key = value` setting, throws `ConfigurationError` if it is not valid
+auto applySetting(Config &config, std::string_view key, std::string_view value) -> void;
+
+/// Applies all settings of a config file. A missing file is only an error if it is `required`,
+/// like one given on the command line.
+///
+/// The file consists of `key = value` lines, empty lines are ignored. A `#` at the start of a
+/// line or after whitespace starts a comment that runs to the end of the line.
+auto loadConfigFile(const std::filesystem::path &path, Config &config, bool required = false)
+  -> void;
+
+/// Gets the default config file path using XDG or fallback locations
+[[nodiscard]] auto getDefaultConfigPath() -> std::optional<std::filesystem::path>;
+
+} // namespace typetrace::backend
+
+#endif
@@ -1,30 +1,66 @@
 #include "database_manager.hpp"
 
+#include "archive.hpp"
+#include "calendar.hpp"
+#include "config.hpp"
 #include "constants.hpp"
+#include "day_clock.hpp"
+#include "delta_log.hpp"
+#include "dimension_matrix.hpp"
 #include "exceptions.hpp"
+#include "key_table.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
+#include "rhythm_stats.hpp"
 #include "spdlog/common.h"
 #include "sql.hpp"
 #include "types.hpp"
 
+#include <SQLiteCpp/Column.h>
 #include <SQLiteCpp/Database.h>
 #include <SQLiteCpp/Exception.h>
 #include <SQLiteCpp/Statement.h>
 #include <SQLiteCpp/Transaction.h>
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <format>
+#include <istream>
+#include <iterator>
 #include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <sqlite3.h>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace typetrace::backend {
 
-DatabaseManager::DatabaseManager(const std::filesystem::path &db_dir) :
-  db_file(db_dir / DB_FILE_NAME)
+namespace {
+
+/// Returns true for SQLite errors that may pass by themselves, so the write is worth retrying
+auto isTransient(const SQLite::Exception &e) -> bool
+{
+    const int code = e.getErrorCode();
+    return code == SQLITE_BUSY || code == SQLITE_LOCKED || code == SQLITE_FULL
+           || code == SQLITE_IOERR;
+}
+
+} // namespace
+
+DatabaseManager::DatabaseManager(const std::filesystem::path &db_dir,
+                                 const DatabaseSettings &settings) :
+  db_file(db_dir / DB_FILE_NAME), retention_days(settings.retention_days)
 {
-    getLogger()->info("Initializing database at: {}", db_file.string());
+    getLogger().info("Initializing database at: {}", db_file.string());
 
     if (!db_dir.empty() && !std::filesystem::exists(db_dir)) {
-        getLogger()->debug("Creating parent directories for database path: {}", db_dir.string());
+        getLogger().debug("Creating parent directories for database path: {}", db_dir.string());
         std::filesystem::create_directories(db_dir);
     }
 
@@ -34,53 +70,878 @@ DatabaseManager::DatabaseManager(const std::filesystem::path &db_dir) :
                                                   | static_cast<unsigned int>(SQLite::OPEN_CREATE));
         // WAL mode
         db->exec(OPTIMIZE_DATABASE_SQL);
+        applySettings(settings);
 
-        createTables();
-        getLogger()->info("Database tables created successfully");
+        migrateSchema();
+        prepareStatements();
     } catch (const SQLite::Exception &e) {
         throw DatabaseError(
           std::format("Failed to open database '{}': {}", db_file.string(), e.what()));
     }
 }
 
-auto DatabaseManager::writeToDatabase(const std::vector<KeystrokeEvent> &buffer) -> void
+DatabaseManager::~DatabaseManager()
+{
+    // Leave an empty WAL behind so the next start and other readers have nothing to replay
+    try {
+        checkpoint(CheckpointMode::truncate);
+    } catch (const DatabaseError &e) {
+        getLogger().warn("{}", e.what());
+    }
+}
+
+auto DatabaseManager::writeToDatabase(const std::span<const KeystrokeEvent> buffer) -> void
 {
     if (buffer.empty()) {
         return;
     }
 
+    aggregateBuffer(buffer);
+
+    // Encoded up front, the record is committed with the counts it holds
+    const std::span<const std::uint8_t> record
+      = delta_log != nullptr ? delta_log->encode(daily_counts) : std::span<const std::uint8_t>{};
+
     // TODO(domi): There's a bug that if the .db file gets deleted during runtime, the following
     // error occurs: `Database error: Failed to write to database: attempt to write a readonly
     // database`
+    const auto transaction_start = std::chrono::steady_clock::now();
+
     try {
         SQLite::Transaction transaction(*db);
-        SQLite::Statement stmt(*db, UPSERT_KEYSTROKE_SQL);
+        std::bitset<KEY_CODE_COUNT> new_key_names;
+        std::size_t rows{ 0 };
+
+        key_totals.fill(0);
+
+        // The rollups are updated in the same transaction so they never disagree with the days
+        for (const auto &day : daily_counts) {
+            const auto week = static_cast<std::int64_t>(weekOf(day.day));
+            const auto month = static_cast<std::int64_t>(monthOf(day.day));
 
-        for (const auto &event : buffer) {
-            stmt.bind(1, static_cast<int>(event.key_code));
-            stmt.bind(2, event.key_name.data());
-            stmt.bind(3, event.date.data());
+            for (std::size_t key_code = 0; key_code < day.counts.size(); ++key_code) {
+                const std::uint32_t count = day.counts.at(key_code);
+                if (count == 0) {
+                    continue;
+                }
+
+                upsertCount(
+                  *upsert_keystroke_stmt, static_cast<std::int64_t>(day.day), key_code, count);
+                upsertCount(*upsert_weekly_count_stmt, week, key_code, count);
+                upsertCount(*upsert_monthly_count_stmt, month, key_code, count);
+                key_totals.at(key_code) += count;
+                ++rows;
+
+                if (!stored_key_names.test(key_code)) {
+                    new_key_names.set(key_code);
+                }
+            }
+        }
+
+        for (std::size_t key_code = 0; key_code < key_totals.size(); ++key_code) {
+            if (key_totals.at(key_code) != 0) {
+                upsert_key_total_stmt->bind(1, static_cast<int>(key_code));
+                upsert_key_total_stmt->bind(2, static_cast<std::int64_t>(key_totals.at(key_code)));
+                upsert_key_total_stmt->exec();
+                upsert_key_total_stmt->reset();
+            }
+        }
 
-            stmt.exec();
-            stmt.reset();
+        // Key names live in their own table and only need to be written once per key
+        for (std::size_t key_code = 0; key_code < new_key_names.size(); ++key_code) {
+            if (new_key_names.test(key_code)) {
+                upsert_key_name_stmt->bind(1, static_cast<int>(key_code));
+                upsert_key_name_stmt->bindNoCopy(2, getKeyName(key_code).data());
+                upsert_key_name_stmt->exec();
+                upsert_key_name_stmt->reset();
+            }
+        }
+
+        if (!record.empty()) {
+            storeDeltaRecord(record);
         }
 
         transaction.commit();
+        getMetrics().transaction_time.record(std::chrono::steady_clock::now() - transaction_start);
+        stored_key_names |= new_key_names;
+        if (!record.empty()) {
+            ++committed_sequence;
+        }
+        appendToDeltaLog(record);
 
-        getLogger()->debug(
-          "Inserted {} keystrokes into the database: {}", buffer.size(), db_file.string());
+        getLogger().debug("Inserted {} keystrokes as {} rows into the database: {}",
+                          buffer.size(),
+                          rows,
+                          db_file.string());
     } catch (const SQLite::Exception &e) {
-        throw DatabaseError(std::format("Failed to write to database: {}", e.what()));
+        // The statements are kept for the next flush, so they must not stay in a failed state
+        upsert_keystroke_stmt->tryReset();
+        upsert_key_total_stmt->tryReset();
+        upsert_weekly_count_stmt->tryReset();
+        upsert_monthly_count_stmt->tryReset();
+        upsert_key_name_stmt->tryReset();
+        insert_delta_outbox_stmt->tryReset();
+        delete_delta_outbox_stmt->tryReset();
+        update_delta_log_sequence_stmt->tryReset();
+        addTo(getMetrics().failed_transactions, 1);
+        throw DatabaseError(std::format("Failed to write to database: {}", e.what()),
+                            isTransient(e));
     }
 }
 
-auto DatabaseManager::createTables() -> void
+auto DatabaseManager::exportArchive(std::ostream &output) -> std::size_t
 {
     try {
-        db->exec(CREATE_KEYSTROKES_TABLE_SQL);
+        // Both queries read from the same snapshot, even while the backend keeps writing
+        SQLite::Transaction transaction(*db);
+
+        std::vector<ArchiveKey> keys;
+        SQLite::Statement key_stmt(*db, EXPORT_KEY_TABLE_SQL);
+        while (key_stmt.executeStep()) {
+            keys.push_back({ .key_code = static_cast<std::uint16_t>(key_stmt.getColumn(0).getInt()),
+                             .name = key_stmt.getColumn(1).getString() });
+        }
+
+        ArchiveWriter writer{ output, keys };
+        std::size_t rows{ 0 };
+
+        SQLite::Statement row_stmt(*db, EXPORT_KEYSTROKES_SQL);
+        while (row_stmt.executeStep()) {
+            if (writer.add(static_cast<DayNumber>(row_stmt.getColumn(0).getInt64()),
+                           static_cast<std::uint16_t>(row_stmt.getColumn(1).getInt()),
+                           static_cast<std::uint64_t>(row_stmt.getColumn(2).getInt64()))) {
+                ++rows;
+            }
+        }
+
+        writer.finish();
+        transaction.commit();
+
+        getLogger().info("Exported {} rows of {} keys", rows, keys.size());
+        return rows;
+    } catch (const SQLite::Exception &e) {
+        throw DatabaseError(std::format("Failed to export keystrokes: {}", e.what()));
+    }
+}
+
+auto DatabaseManager::importArchive(std::istream &input) -> std::size_t
+{
+    ArchiveReader reader{ input };
+
+    try {
+        db->exec(BEGIN_BULK_IMPORT_SQL);
+    } catch (const SQLite::Exception &e) {
+        throw DatabaseError(std::format("Failed to prepare import: {}", e.what()));
+    }
+
+    std::size_t rows{ 0 };
+
+    try {
+        SQLite::Transaction transaction(*db);
+        db->exec(CREATE_IMPORT_TABLE_SQL);
+
+        SQLite::Statement name_stmt(*db, INSERT_IMPORT_KEY_NAME_SQL);
+        for (const ArchiveKey &key : reader.keys()) {
+            if (!key.name.empty()) {
+                name_stmt.bind(1, static_cast<int>(key.key_code));
+                name_stmt.bind(2, key.name);
+                name_stmt.exec();
+                name_stmt.reset();
+            }
+        }
+
+        // Rows are only appended to the staging table here, the merge is one upsert per table
+        SQLite::Statement row_stmt(*db, INSERT_IMPORT_ROW_SQL);
+        ArchiveDay day;
+        while (reader.next(day)) {
+            for (const KeyCount &count : day.counts) {
+                row_stmt.bind(1, static_cast<std::int64_t>(day.day));
+                row_stmt.bind(2, static_cast<int>(count.key_code));
+                row_stmt.bind(3, static_cast<std::int64_t>(count.count));
+                row_stmt.exec();
+                row_stmt.reset();
+            }
+            rows += day.counts.size();
+        }
+
+        db->exec(MERGE_IMPORT_SQL);
+        db->exec(BUMP_HISTORY_EPOCH_SQL);
+        transaction.commit();
+    } catch (const SQLite::Exception &e) {
+        db->tryExec(END_BULK_IMPORT_SQL);
+        throw DatabaseError(std::format("Failed to import keystrokes: {}", e.what()));
+    } catch (const DatabaseError &) {
+        db->tryExec(END_BULK_IMPORT_SQL);
+        throw;
+    }
+
+    db->tryExec(END_BULK_IMPORT_SQL);
+    getLogger().info("Imported {} rows of {} keys", rows, reader.keys().size());
+    return rows;
+}
+
+auto DatabaseManager::mergeDeltaLog(DeltaLogReader &log) -> std::size_t
+{
+    std::size_t records{ 0 };
+    std::size_t rows{ 0 };
+
+    try {
+        SQLite::Transaction transaction(*db);
+
+        // A log with a new ID was recreated after its host lost it, its records are all new
+        SQLite::Statement offset_stmt(*db, GET_SYNC_OFFSET_SQL);
+        offset_stmt.bind(1, log.host());
+        offset_stmt.bind(2, static_cast<std::int64_t>(log.logId()));
+        if (offset_stmt.executeStep()) {
+            log.seek(static_cast<std::uint64_t>(offset_stmt.getColumn(0).getInt64()));
+        }
+        offset_stmt.reset();
+
+        std::bitset<KEY_CODE_COUNT> merged_keys;
+        records = stageDeltaRecords(log, rows, merged_keys);
+        if (records == 0) {
+            getLogger().debug("Delta log of '{}' has no new records", log.host());
+            return 0;
+        }
+
+        const std::bitset<KEY_CODE_COUNT> new_key_names = mergeStagedRows(merged_keys);
+
+        // Committed with the counts, so a log is never merged twice or only in part
+        SQLite::Statement upsert_offset_stmt(*db, UPSERT_SYNC_OFFSET_SQL);
+        upsert_offset_stmt.bind(1, log.host());
+        upsert_offset_stmt.bind(2, static_cast<std::int64_t>(log.logId()));
+        upsert_offset_stmt.bind(3, static_cast<std::int64_t>(log.offset()));
+        upsert_offset_stmt.exec();
+
+        transaction.commit();
+        stored_key_names |= new_key_names;
+    } catch (const SQLite::Exception &e) {
+        throw DatabaseError(
+          std::format("Failed to merge delta log of '{}': {}", log.host(), e.what()));
+    }
+
+    getLogger().info(
+      "Merged {} records with {} rows from the delta log of '{}'", records, rows, log.host());
+    return records;
+}
+
+auto DatabaseManager::vacuum() -> void
+{
+    getLogger().info("Rewriting database with incremental vacuum: {}", db_file.string());
+
+    try {
+        db->exec(ENABLE_INCREMENTAL_VACUUM_SQL);
     } catch (const SQLite::Exception &e) {
-        throw DatabaseError(std::format("Failed to create tables: {}", e.what()));
+        throw DatabaseError(std::format("Failed to vacuum database: {}", e.what()));
     }
 }
 
+auto DatabaseManager::setDeltaLog(DeltaLogWriter *const log) -> void
+{
+    delta_log = log;
+    if (delta_log == nullptr) {
+        return;
+    }
+
+    logged_sequence = delta_log->records();
+
+    try {
+        SQLite::Statement state_stmt(*db, GET_DELTA_LOG_STATE_SQL);
+        const bool known_log = state_stmt.executeStep()
+                               && static_cast<std::uint64_t>(state_stmt.getColumn(0).getInt64())
+                                    == delta_log->logId();
+        committed_sequence = known_log
+                               ? static_cast<std::uint64_t>(state_stmt.getColumn(1).getInt64())
+                               : logged_sequence;
+
+        // Records kept for a log that is gone can't be told apart from the new log's, so a new
+        // log starts counting at its own records and the database forgets the old one
+        if (!known_log) {
+            SQLite::Transaction transaction(*db);
+            SQLite::Statement upsert_stmt(*db, UPSERT_DELTA_LOG_STATE_SQL);
+            upsert_stmt.bind(1, static_cast<std::int64_t>(delta_log->logId()));
+            upsert_stmt.bind(2, static_cast<std::int64_t>(logged_sequence));
+            upsert_stmt.exec();
+            db->exec(CLEAR_DELTA_OUTBOX_SQL);
+            transaction.commit();
+            return;
+        }
+
+        if (committed_sequence > logged_sequence) {
+            getLogger().info("Appending {} committed batches missing from the delta log",
+                             committed_sequence - logged_sequence);
+            if (!appendUnlogged()) {
+                getLogger().warn("{} batches are no longer kept, other hosts won't see them",
+                                 committed_sequence - logged_sequence);
+
+                // Renumbered, so the next batch is again the next record of the log
+                SQLite::Transaction transaction(*db);
+                update_delta_log_sequence_stmt->bind(1, static_cast<std::int64_t>(logged_sequence));
+                update_delta_log_sequence_stmt->exec();
+                update_delta_log_sequence_stmt->reset();
+                db->exec(CLEAR_DELTA_OUTBOX_SQL);
+                transaction.commit();
+                committed_sequence = logged_sequence;
+            }
+        } else if (committed_sequence < logged_sequence) {
+            replayDeltaLog(committed_sequence);
+        }
+    } catch (const SQLite::Exception &e) {
+        update_delta_log_sequence_stmt->tryReset();
+        throw DatabaseError(std::format("Failed to reconcile delta log: {}", e.what()));
+    } catch (const SystemError &e) {
+        // What is left is appended with the next batch
+        getLogger().warn("Other hosts won't see the missing batches yet: {}", e.what());
+    }
+}
+
+auto DatabaseManager::checkpoint(const CheckpointMode mode) -> void
+{
+    const bool truncate = mode == CheckpointMode::truncate;
+
+    try {
+        SQLite::Statement stmt(*db,
+                               truncate ? WAL_CHECKPOINT_TRUNCATE_SQL : WAL_CHECKPOINT_PASSIVE_SQL);
+
+        if (stmt.executeStep()) {
+            getLogger().debug("{} WAL checkpoint: {} of {} frames checkpointed{}",
+                              truncate ? "Truncating" : "Passive",
+                              stmt.getColumn(2).getInt(),
+                              stmt.getColumn(1).getInt(),
+                              stmt.getColumn(0).getInt() != 0 ? " (database busy)" : "");
+        }
+    } catch (const SQLite::Exception &e) {
+        throw DatabaseError(std::format("Failed to checkpoint WAL: {}", e.what()));
+    }
+}
+
+auto DatabaseManager::pruneExpiredDays() -> bool
+{
+    const DayNumber today = day_clock.today();
+    if (retention_days == 0 || today < retention_days) {
+        return false;
+    }
+
+    const auto first_kept_day = static_cast<DayNumber>(today - (retention_days - 1));
+    if (first_kept_day <= pruned_until) {
+        return false;
+    }
+
+    std::size_t deleted{ 0 };
+    try {
+        SQLite::Transaction transaction(*db);
+        prune_keystrokes_stmt->bind(1, static_cast<std::int64_t>(first_kept_day));
+        prune_keystrokes_stmt->bind(2, static_cast<std::int64_t>(RETENTION_BATCH_ROWS));
+        deleted = static_cast<std::size_t>(prune_keystrokes_stmt->exec());
+        prune_keystrokes_stmt->reset();
+        transaction.commit();
+    } catch (const SQLite::Exception &e) {
+        prune_keystrokes_stmt->tryReset();
+        throw DatabaseError(std::format("Failed to prune keystrokes: {}", e.what()));
+    }
+
+    pruned_rows += deleted;
+    if (deleted == RETENTION_BATCH_ROWS) {
+        return true;
+    }
+
+    pruned_until = first_kept_day;
+    if (pruned_rows != 0) {
+        getLogger().info(
+          "Pruned {} keystroke rows of days before day {}", pruned_rows, first_kept_day);
+        pruned_rows = 0;
+        releaseFreePages();
+    }
+    return false;
+}
+
+auto DatabaseManager::getTotalKeyCounts() -> std::vector<KeyCount>
+{
+    try {
+        total_key_counts_stmt->reset();
+        return collectKeyCounts(*total_key_counts_stmt);
+    } catch (const SQLite::Exception &e) {
+        total_key_counts_stmt->tryReset();
+        throw DatabaseError(std::format("Failed to read total key counts: {}", e.what()));
+    }
+}
+
+auto DatabaseManager::getDayKeyCounts(const DayNumber day) -> std::vector<KeyCount>
+{
+    try {
+        // Only needed once at startup, so not worth keeping prepared
+        SQLite::Statement stmt(*db, GET_DAY_KEY_COUNTS_SQL);
+        stmt.bind(1, static_cast<std::int64_t>(day));
+        return collectKeyCounts(stmt);
+    } catch (const SQLite::Exception &e) {
+        throw DatabaseError(std::format("Failed to read key counts of day {}: {}", day, e.what()));
+    }
+}
+
+auto DatabaseManager::writeDayDimensions(const DimensionMatrix &matrix) -> void
+{
+    if (matrix.empty()) {
+        return;
+    }
+
+    // Written once per day close, so the statements are not kept prepared
+    try {
+        SQLite::Transaction transaction(*db);
+
+        // The day may already have counts from before a restart, they are merged, not replaced
+        DimensionMatrix merged{ matrix.day() };
+        try {
+            if (auto stored = getDayDimensions(matrix.day())) {
+                merged = std::move(*stored);
+            }
+        } catch (const DatabaseError &e) {
+            getLogger().warn("Replacing unreadable dimensions: {}", e.what());
+        }
+        merged.merge(matrix);
+
+        const std::vector<std::uint8_t> blob = merged.encode();
+        SQLite::Statement stmt(*db, UPSERT_DAY_DIMENSIONS_SQL);
+        stmt.bind(1, static_cast<std::int64_t>(matrix.day()));
+        stmt.bind(2, blob.data(), static_cast<int>(blob.size()));
+        stmt.exec();
+
+        transaction.commit();
+        getLogger().debug("Stored dimensions of day {} in {} bytes", matrix.day(), blob.size());
+    } catch (const SQLite::Exception &e) {
+        throw DatabaseError(
+          std::format("Failed to write dimensions of day {}: {}", matrix.day(), e.what()));
+    }
+}
+
+auto DatabaseManager::getDayDimensions(const DayNumber day) -> std::optional<DimensionMatrix>
+{
+    try {
+        SQLite::Statement stmt(*db, GET_DAY_DIMENSIONS_SQL);
+        stmt.bind(1, static_cast<std::int64_t>(day));
+
+        if (!stmt.executeStep()) {
+            return std::nullopt;
+        }
+
+        const SQLite::Column column = stmt.getColumn(0);
+        const std::span blob{ static_cast<const std::uint8_t *>(column.getBlob()),
+                              static_cast<std::size_t>(column.getBytes()) };
+        return DimensionMatrix::decode(day, blob);
+    } catch (const SQLite::Exception &e) {
+        throw DatabaseError(std::format("Failed to read dimensions of day {}: {}", day, e.what()));
+    }
+}
+
+auto DatabaseManager::writeDayRhythm(const RhythmStats &stats) -> void
+{
+    if (stats.empty()) {
+        return;
+    }
+
+    // Written with every flush, so unlike the dimensions the statements are kept prepared. The
+    // stored blob has a bounded size, so merging into it costs the same late in the day.
+    try {
+        SQLite::Transaction transaction(*db);
+
+        RhythmStats merged{ stats.day() };
+        try {
+            if (auto stored = getDayRhythm(stats.day())) {
+                merged = std::move(*stored);
+            }
+        } catch (const DatabaseError &e) {
+            getLogger().warn("Replacing unreadable rhythm: {}", e.what());
+        }
+        merged.merge(stats);
+
+        const std::vector<std::uint8_t> blob = merged.encode();
+        upsert_day_rhythm_stmt->bind(1, static_cast<std::int64_t>(stats.day()));
+        upsert_day_rhythm_stmt->bind(2, blob.data(), static_cast<int>(blob.size()));
+        upsert_day_rhythm_stmt->exec();
+        upsert_day_rhythm_stmt->reset();
+
+        transaction.commit();
+        getLogger().debug("Stored rhythm of day {} in {} bytes ({:.1f} words per minute)",
+                          stats.day(),
+                          blob.size(),
+                          merged.wordsPerMinute());
+    } catch (const SQLite::Exception &e) {
+        upsert_day_rhythm_stmt->tryReset();
+        throw DatabaseError(
+          std::format("Failed to write rhythm of day {}: {}", stats.day(), e.what()));
+    }
+}
+
+auto DatabaseManager::getDayRhythm(const DayNumber day) -> std::optional<RhythmStats>
+{
+    try {
+        SQLite::Statement &stmt = *day_rhythm_stmt;
+        stmt.reset();
+        stmt.bind(1, static_cast<std::int64_t>(day));
+
+        if (!stmt.executeStep()) {
+            return std::nullopt;
+        }
+
+        // The statement is kept, it must not hold on to its read snapshot until the next call
+        const SQLite::Column column = stmt.getColumn(0);
+        const auto *const data = static_cast<const std::uint8_t *>(column.getBlob());
+        const std::vector<std::uint8_t> blob(data, std::next(data, column.getBytes()));
+        stmt.reset();
+
+        return RhythmStats::decode(day, blob);
+    } catch (const SQLite::Exception &e) {
+        day_rhythm_stmt->tryReset();
+        throw DatabaseError(std::format("Failed to read rhythm of day {}: {}", day, e.what()));
+    }
+}
+
+auto DatabaseManager::getWeeklyKeyCounts(const WeekNumber week) -> std::vector<KeyCount>
+{
+    try {
+        weekly_key_counts_stmt->reset();
+        weekly_key_counts_stmt->bind(1, static_cast<std::int64_t>(week));
+        return collectKeyCounts(*weekly_key_counts_stmt);
+    } catch (const SQLite::Exception &e) {
+        weekly_key_counts_stmt->tryReset();
+        throw DatabaseError(std::format("Failed to read weekly key counts: {}", e.what()));
+    }
+}
+
+auto DatabaseManager::getMonthlyKeyCounts(const MonthNumber month) -> std::vector<KeyCount>
+{
+    try {
+        monthly_key_counts_stmt->reset();
+        monthly_key_counts_stmt->bind(1, static_cast<std::int64_t>(month));
+        return collectKeyCounts(*monthly_key_counts_stmt);
+    } catch (const SQLite::Exception &e) {
+        monthly_key_counts_stmt->tryReset();
+        throw DatabaseError(std::format("Failed to read monthly key counts: {}", e.what()));
+    }
+}
+
+auto DatabaseManager::getDailyCounts(const DayNumber first_day) -> std::vector<DailyCount>
+{
+    try {
+        SQLite::Statement &stmt = *daily_counts_stmt;
+        stmt.reset();
+        stmt.bind(1, static_cast<std::int64_t>(first_day));
+
+        std::vector<DailyCount> counts;
+        while (stmt.executeStep()) {
+            counts.push_back(DailyCount{
+              .day = static_cast<DayNumber>(stmt.getColumn(0).getInt64()),
+              .count = static_cast<std::uint64_t>(stmt.getColumn(1).getInt64()),
+            });
+        }
+
+        return counts;
+    } catch (const SQLite::Exception &e) {
+        daily_counts_stmt->tryReset();
+        throw DatabaseError(std::format("Failed to read daily counts: {}", e.what()));
+    }
+}
+
+auto DatabaseManager::getTopKeys(const DayNumber first_day, const std::size_t limit)
+  -> std::vector<KeyCount>
+{
+    try {
+        SQLite::Statement &stmt = *top_keys_stmt;
+        stmt.reset();
+        stmt.bind(1, static_cast<std::int64_t>(first_day));
+        stmt.bind(2, static_cast<std::int64_t>(limit));
+
+        return collectKeyCounts(stmt);
+    } catch (const SQLite::Exception &e) {
+        top_keys_stmt->tryReset();
+        throw DatabaseError(std::format("Failed to read top keys: {}", e.what()));
+    }
+}
+
+auto DatabaseManager::migrateSchema() -> void
+{
+    try {
+        int version = db->execAndGet(GET_SCHEMA_VERSION_SQL).getInt();
+
+        if (version == DB_SCHEMA_VERSION) {
+            getLogger().debug("Database schema is up to date (version {})", version);
+            return;
+        }
+
+        if (version > DB_SCHEMA_VERSION) {
+            throw DatabaseError(
+              std::format("Database schema version {} is newer than the supported version {}",
+                          version,
+                          DB_SCHEMA_VERSION));
+        }
+
+        SQLite::Transaction transaction(*db);
+
+        // The original schema predates `user_version` and is recognized by its table
+        if (version == 0 && db->tableExists("keystrokes")) {
+            version = 1;
+        }
+
+        if (version == 0) {
+            db->exec(CREATE_KEYSTROKES_TABLE_SQL);
+            db->exec(CREATE_KEY_NAMES_TABLE_SQL);
+            db->exec(CREATE_KEY_TOTALS_TABLE_SQL);
+            db->exec(CREATE_WEEKLY_COUNTS_TABLE_SQL);
+            db->exec(CREATE_MONTHLY_COUNTS_TABLE_SQL);
+            db->exec(CREATE_DAY_DIMENSIONS_TABLE_SQL);
+            db->exec(CREATE_DAY_RHYTHM_TABLE_SQL);
+            db->exec(CREATE_SYNC_OFFSETS_TABLE_SQL);
+            db->exec(CREATE_HISTORY_EPOCH_TABLE_SQL);
+            db->exec(CREATE_DELTA_LOG_TABLES_SQL);
+            getLogger().info("Database tables created successfully");
+        } else {
+            getLogger().info(
+              "Migrating database schema from version {} to {}", version, DB_SCHEMA_VERSION);
+
+            for (; version < DB_SCHEMA_VERSION; ++version) {
+                db->exec(SCHEMA_MIGRATIONS_SQL.at(static_cast<std::size_t>(version - 1)));
+            }
+        }
+
+        db->exec(std::format("PRAGMA user_version = {};", DB_SCHEMA_VERSION));
+        transaction.commit();
+    } catch (const SQLite::Exception &e) {
+        throw DatabaseError(std::format("Failed to migrate database schema: {}", e.what()));
+    }
+}
+
+auto DatabaseManager::applySettings(const DatabaseSettings &settings) -> void
+{
+    db->exec(std::format("PRAGMA mmap_size = {};", settings.mmap_size));
+    db->exec(std::format("PRAGMA cache_size = {};", settings.cache_size));
+    db->exec(std::format("PRAGMA wal_autocheckpoint = {};", settings.wal_autocheckpoint));
+    db->setBusyTimeout(static_cast<int>(settings.busy_timeout_ms));
+
+    getLogger().debug(
+      "Database settings: mmap_size={} cache_size={} wal_autocheckpoint={} busy_timeout={}ms",
+      settings.mmap_size,
+      settings.cache_size,
+      settings.wal_autocheckpoint,
+      settings.busy_timeout_ms);
+}
+
+auto DatabaseManager::prepareStatements() -> void
+{
+    upsert_keystroke_stmt = std::make_unique<SQLite::Statement>(*db, UPSERT_KEYSTROKE_SQL);
+    upsert_key_total_stmt = std::make_unique<SQLite::Statement>(*db, UPSERT_KEY_TOTAL_SQL);
+    upsert_weekly_count_stmt = std::make_unique<SQLite::Statement>(*db, UPSERT_WEEKLY_COUNT_SQL);
+    upsert_monthly_count_stmt = std::make_unique<SQLite::Statement>(*db, UPSERT_MONTHLY_COUNT_SQL);
+    upsert_key_name_stmt = std::make_unique<SQLite::Statement>(*db, UPSERT_KEY_NAME_SQL);
+    upsert_day_rhythm_stmt = std::make_unique<SQLite::Statement>(*db, UPSERT_DAY_RHYTHM_SQL);
+    day_rhythm_stmt = std::make_unique<SQLite::Statement>(*db, GET_DAY_RHYTHM_SQL);
+    total_key_counts_stmt = std::make_unique<SQLite::Statement>(*db, GET_TOTAL_KEY_COUNTS_SQL);
+    weekly_key_counts_stmt = std::make_unique<SQLite::Statement>(*db, GET_WEEKLY_KEY_COUNTS_SQL);
+    monthly_key_counts_stmt = std::make_unique<SQLite::Statement>(*db, GET_MONTHLY_KEY_COUNTS_SQL);
+    daily_counts_stmt = std::make_unique<SQLite::Statement>(*db, GET_DAILY_COUNTS_SQL);
+    top_keys_stmt = std::make_unique<SQLite::Statement>(*db, GET_TOP_KEYS_SQL);
+    prune_keystrokes_stmt = std::make_unique<SQLite::Statement>(*db, PRUNE_KEYSTROKES_SQL);
+    insert_delta_outbox_stmt = std::make_unique<SQLite::Statement>(*db, INSERT_DELTA_OUTBOX_SQL);
+    delete_delta_outbox_stmt = std::make_unique<SQLite::Statement>(*db, DELETE_DELTA_OUTBOX_SQL);
+    update_delta_log_sequence_stmt
+      = std::make_unique<SQLite::Statement>(*db, UPDATE_DELTA_LOG_SEQUENCE_SQL);
+}
+
+auto DatabaseManager::releaseFreePages() -> void
+{
+    constexpr int INCREMENTAL = 2;
+
+    try {
+        // Converting a database created before incremental vacuum rewrites the whole file, which
+        // would hold up the writer for as long, so that is left to `--vacuum`
+        if (db->execAndGet(GET_AUTO_VACUUM_SQL).getInt() != INCREMENTAL) {
+            getLogger().info("Freed pages stay in the database until --vacuum converts it");
+            return;
+        }
+
+        db->exec(INCREMENTAL_VACUUM_SQL);
+    } catch (const SQLite::Exception &e) {
+        throw DatabaseError(std::format("Failed to vacuum database: {}", e.what()));
+    }
+}
+
+auto DatabaseManager::aggregateBuffer(const std::span<const KeystrokeEvent> buffer) -> void
+{
+    daily_counts.clear();
+
+    for (const auto &event : buffer) {
+        if (event.key_code >= KEY_CODE_COUNT) {
+            getLogger().warn("Ignoring keystroke with out of range key code: {}", event.key_code);
+            continue;
+        }
+
+        // A buffer rarely spans more than one day, so a linear search is sufficient
+        auto day = std::ranges::find(daily_counts, event.day, &DailyKeyCounts::day);
+        if (day == daily_counts.end()) {
+            day = daily_counts.insert(daily_counts.end(), DailyKeyCounts{ .day = event.day });
+        }
+
+        ++day->counts.at(event.key_code);
+    }
+}
+
+auto DatabaseManager::storeDeltaRecord(const std::span<const std::uint8_t> record) -> void
+{
+    const auto sequence = static_cast<std::int64_t>(committed_sequence + 1);
+
+    insert_delta_outbox_stmt->bind(1, sequence);
+    insert_delta_outbox_stmt->bind(2, record.data(), static_cast<int>(record.size()));
+    insert_delta_outbox_stmt->exec();
+    insert_delta_outbox_stmt->reset();
+
+    update_delta_log_sequence_stmt->bind(1, sequence);
+    update_delta_log_sequence_stmt->exec();
+    update_delta_log_sequence_stmt->reset();
+
+    // Records the log holds are only needed until then, so the table stays at a row or two
+    delete_delta_outbox_stmt->bind(1, static_cast<std::int64_t>(logged_sequence));
+    delete_delta_outbox_stmt->exec();
+    delete_delta_outbox_stmt->reset();
+}
+
+auto DatabaseManager::appendToDeltaLog(const std::span<const std::uint8_t> record) -> void
+{
+    if (delta_log == nullptr || logged_sequence == committed_sequence) {
+        return;
+    }
+
+    // Only committed counts are logged, so other hosts never merge presses this one lost
+    try {
+        if (!record.empty() && logged_sequence + 1 == committed_sequence) {
+            delta_log->append(record);
+            logged_sequence = committed_sequence;
+        } else {
+            // An earlier append failed, its record is still kept in the database
+            appendUnlogged();
+        }
+    } catch (const SystemError &e) {
+        getLogger().warn("Other hosts won't see this batch until the delta log takes it: {}",
+                         e.what());
+    } catch (const SQLite::Exception &e) {
+        getLogger().warn("Failed to read batches missing from the delta log: {}", e.what());
+    }
+}
+
+auto DatabaseManager::appendUnlogged() -> bool
+{
+    // Rarely more than a row, so the statement is not kept prepared
+    SQLite::Statement stmt(*db, GET_DELTA_OUTBOX_SQL);
+    stmt.bind(1, static_cast<std::int64_t>(logged_sequence));
+
+    while (stmt.executeStep()) {
+        if (static_cast<std::uint64_t>(stmt.getColumn(0).getInt64()) != logged_sequence + 1) {
+            return false;
+        }
+
+        const SQLite::Column column = stmt.getColumn(1);
+        delta_log->append({ static_cast<const std::uint8_t *>(column.getBlob()),
+                            static_cast<std::size_t>(column.getBytes()) });
+        ++logged_sequence;
+    }
+
+    return logged_sequence == committed_sequence;
+}
+
+auto DatabaseManager::replayDeltaLog(const std::uint64_t sequence) -> void
+{
+    getLogger().warn("Database lost {} committed batches, merging them from the delta log",
+                     logged_sequence - sequence);
+
+    DeltaLogReader log{ delta_log->path() };
+    // The log holds more records than the database, so all of those it has are there
+    std::vector<DeltaDay> days;
+    for (std::uint64_t committed = 0; committed < sequence; ++committed) {
+        log.next(days);
+    }
+
+    SQLite::Transaction transaction(*db);
+    std::size_t rows{ 0 };
+    std::bitset<KEY_CODE_COUNT> merged_keys;
+    stageDeltaRecords(log, rows, merged_keys);
+    const std::bitset<KEY_CODE_COUNT> new_key_names = mergeStagedRows(merged_keys);
+
+    update_delta_log_sequence_stmt->bind(1, static_cast<std::int64_t>(logged_sequence));
+    update_delta_log_sequence_stmt->exec();
+    update_delta_log_sequence_stmt->reset();
+
+    transaction.commit();
+    stored_key_names |= new_key_names;
+    committed_sequence = logged_sequence;
+}
+
+auto DatabaseManager::stageDeltaRecords(DeltaLogReader &log,
+                                        std::size_t &rows,
+                                        std::bitset<KEY_CODE_COUNT> &merged_keys) -> std::size_t
+{
+    db->exec(CREATE_IMPORT_TABLE_SQL);
+
+    SQLite::Statement row_stmt(*db, INSERT_IMPORT_ROW_SQL);
+    std::vector<DeltaDay> days;
+    std::size_t records{ 0 };
+    while (log.next(days)) {
+        for (const DeltaDay &day : days) {
+            for (const KeyCount &count : day.counts) {
+                row_stmt.bind(1, static_cast<std::int64_t>(day.day));
+                row_stmt.bind(2, static_cast<int>(count.key_code));
+                row_stmt.bind(3, static_cast<std::int64_t>(count.count));
+                row_stmt.exec();
+                row_stmt.reset();
+                merged_keys.set(count.key_code);
+            }
+            rows += day.counts.size();
+        }
+        ++records;
+    }
+
+    return records;
+}
+
+auto DatabaseManager::mergeStagedRows(const std::bitset<KEY_CODE_COUNT> &merged_keys)
+  -> std::bitset<KEY_CODE_COUNT>
+{
+    // Logs carry no names, every host names its keys from the same kernel headers
+    const std::bitset<KEY_CODE_COUNT> new_key_names = merged_keys & ~stored_key_names;
+    SQLite::Statement name_stmt(*db, INSERT_IMPORT_KEY_NAME_SQL);
+    for (std::size_t key_code = 0; key_code < new_key_names.size(); ++key_code) {
+        if (new_key_names.test(key_code)) {
+            name_stmt.bind(1, static_cast<int>(key_code));
+            name_stmt.bindNoCopy(2, getKeyName(key_code).data());
+            name_stmt.exec();
+            name_stmt.reset();
+        }
+    }
+
+    db->exec(MERGE_IMPORT_SQL);
+    db->exec(BUMP_HISTORY_EPOCH_SQL);
+    return new_key_names;
+}
+
+auto DatabaseManager::upsertCount(SQLite::Statement &stmt,
+                                  const std::int64_t period,
+                                  const std::size_t key_code,
+                                  const std::uint32_t count) -> void
+{
+    stmt.bind(1, period);
+    stmt.bind(2, static_cast<int>(key_code));
+    stmt.bind(3, count);
+    stmt.exec();
+    stmt.reset();
+}
+
+auto DatabaseManager::collectKeyCounts(SQLite::Statement &stmt) -> std::vector<KeyCount>
+{
+    std::vector<KeyCount> counts;
+    while (stmt.executeStep()) {
+        counts.push_back(KeyCount{
+          .key_code = static_cast<std::uint16_t>(stmt.getColumn(0).getUInt()),
+          .count = static_cast<std::uint64_t>(stmt.getColumn(1).getInt64()),
+        });
+    }
+
+    return counts;
+}
+
 } // namespace typetrace::backend
@@ -1,30 +1,211 @@
 #ifndef TYPETRACE_DATABASE_HPP
 #define TYPETRACE_DATABASE_HPP
 
+#include "calendar.hpp"
+#include "config.hpp"
+#include "constants.hpp"
+#include "day_clock.hpp"
+#include "delta_log.hpp"
+#include "dimension_matrix.hpp"
+#include "rhythm_stats.hpp"
 #include "types.hpp"
 
 #include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <istream>
 #include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
 #include <vector>
 
 namespace typetrace::backend {
 
+/// WAL checkpoint modes used by the backend
+enum class CheckpointMode : std::uint8_t
+{
+    passive,  ///< Checkpoint what is possible without blocking readers or writers
+    truncate, ///< Checkpoint everything and truncate the WAL file
+};
+
 class DatabaseManager
 {
   public:
     /// Constructs a database manager and initializes the database connection
-    explicit DatabaseManager(const std::filesystem::path &db_dir);
+    explicit DatabaseManager(const std::filesystem::path &db_dir,
+                             const DatabaseSettings &settings = {});
+
+    /// Truncates the WAL and closes the database connection
+    ~DatabaseManager();
+
+    DatabaseManager(const DatabaseManager &) = delete;
+    auto operator=(const DatabaseManager &) -> DatabaseManager & = delete;
+    DatabaseManager(DatabaseManager &&) = delete;
+    auto operator=(DatabaseManager &&) -> DatabaseManager & = delete;
+
+    /// Writes a buffer of keystroke events to the database. Throws `DatabaseError`, transient if
+    /// writing the same buffer again may succeed (busy or locked database, full disk, I/O error).
+    auto writeToDatabase(std::span<const KeystrokeEvent> buffer) -> void;
+
+    /// Adds the counts of a dimension matrix to the ones stored for its day
+    auto writeDayDimensions(const DimensionMatrix &matrix) -> void;
+
+    /// Returns the dimension matrix stored for `day`, if there is one
+    [[nodiscard]] auto getDayDimensions(DayNumber day) -> std::optional<DimensionMatrix>;
+
+    /// Adds the intervals and key pairs of rhythm stats to the ones stored for their day
+    auto writeDayRhythm(const RhythmStats &stats) -> void;
+
+    /// Returns the rhythm stats stored for `day`, if there are any
+    [[nodiscard]] auto getDayRhythm(DayNumber day) -> std::optional<RhythmStats>;
+
+    /// Writes the keystrokes table and the names of its keys as an archive, see `ArchiveWriter`.
+    /// Returns the number of rows written.
+    auto exportArchive(std::ostream &output) -> std::size_t;
+
+    /// Adds the counts of an archive to the database and its rollups in a single transaction,
+    /// returns the number of rows read. Keys the database has no name for get the archive's.
+    auto importArchive(std::istream &input) -> std::size_t;
+
+    /// Adds the records of a delta log that were not merged before to the database and its
+    /// rollups. The log's new offset is committed in the same transaction, so merging a log again
+    /// only adds what its host appended since. Returns the number of records merged.
+    auto mergeDeltaLog(DeltaLogReader &log) -> std::size_t;
+
+    /// Rewrites the whole database file with incremental vacuum enabled, so later prunes can
+    /// give their pages back. Locks the database for as long as it takes, only run it offline.
+    auto vacuum() -> void;
+
+    /// Appends every batch written from now on to `log`, `nullptr` stops it. The log must
+    /// outlive the database manager.
+    ///
+    /// Each batch gets a sequence number, committed with its counts and its record, and the
+    /// record is appended and synced to the log once the commit is done. A crash in between
+    /// leaves the log behind the database, a database that lost its last commits to a power cut
+    /// is behind the log. Attaching a log reconciles both sides by their sequence numbers: the
+    /// records the log lacks are appended from the database, the ones the database lacks are
+    /// merged into it. Throws `DatabaseError` if that fails.
+    auto setDeltaLog(DeltaLogWriter *log) -> void;
+
+    /// Copies the WAL back into the database file
+    auto checkpoint(CheckpointMode mode) -> void;
+
+    /// Deletes one batch of keystroke rows of days outside `DatabaseSettings::retention_days`,
+    /// their counts stay in the rollups. Each batch is a short transaction of its own, so
+    /// flushes are never held up. Returns true while such rows are left, after the last batch
+    /// the freed pages are given back to the file system. Once a day has been pruned, further
+    /// calls on the same day return false right away.
+    auto pruneExpiredDays() -> bool;
+
+    /// Returns the total number of presses of every key
+    [[nodiscard]] auto getTotalKeyCounts() -> std::vector<KeyCount>;
+
+    /// Returns the number of presses of every key on `day`
+    [[nodiscard]] auto getDayKeyCounts(DayNumber day) -> std::vector<KeyCount>;
 
-    /// Writes a buffer of keystroke events to the database
-    auto writeToDatabase(const std::vector<KeystrokeEvent> &buffer) -> void;
+    /// Returns the number of presses of every key in `week`
+    [[nodiscard]] auto getWeeklyKeyCounts(WeekNumber week) -> std::vector<KeyCount>;
+
+    /// Returns the number of presses of every key in `month`
+    [[nodiscard]] auto getMonthlyKeyCounts(MonthNumber month) -> std::vector<KeyCount>;
+
+    /// Returns the number of key presses per day from `first_day` on, newest first
+    [[nodiscard]] auto getDailyCounts(DayNumber first_day) -> std::vector<DailyCount>;
+
+    /// Returns the `limit` most pressed keys from `first_day` on
+    [[nodiscard]] auto getTopKeys(DayNumber first_day, std::size_t limit) -> std::vector<KeyCount>;
 
   private:
-    /// Creates necessary database tables if they don't exist
-    auto createTables() -> void;
+    /// Creates the tables of a new database or migrates an existing one to the current schema
+    auto migrateSchema() -> void;
+
+    /// Applies the configurable connection pragmas
+    auto applySettings(const DatabaseSettings &settings) -> void;
+
+    /// Prepares all statements once, they are reused for the lifetime of the connection
+    auto prepareStatements() -> void;
+
+    /// Truncates the free pages off the database file, a database without incremental vacuum
+    /// keeps them until `vacuum()` converts it
+    auto releaseFreePages() -> void;
+
+    /// Sums the events of a buffer into per-day key counts
+    auto aggregateBuffer(std::span<const KeystrokeEvent> buffer) -> void;
+
+    /// Keeps the delta log record of the batch being written with the next sequence number,
+    /// part of its transaction
+    auto storeDeltaRecord(std::span<const std::uint8_t> record) -> void;
+
+    /// Appends the committed `record` and any earlier ones the delta log lacks, failures are
+    /// logged and the records are appended with a later batch
+    auto appendToDeltaLog(std::span<const std::uint8_t> record) -> void;
+
+    /// Appends the records kept in the database that the delta log lacks, throws `SystemError`
+    /// if appending failed. Returns false if some of them are no longer kept.
+    auto appendUnlogged() -> bool;
+
+    /// Merges the records of the own delta log after `sequence` into the database, the ones its
+    /// last commits lost
+    auto replayDeltaLog(std::uint64_t sequence) -> void;
+
+    /// Adds the rows staged in the import table to the days and rollups, with the names of the
+    /// keys in `merged_keys` the database does not have yet. Part of the caller's transaction,
+    /// returns the keys it named so they count as stored once it is committed.
+    auto mergeStagedRows(const std::bitset<KEY_CODE_COUNT> &merged_keys)
+      -> std::bitset<KEY_CODE_COUNT>;
+
+    /// Stages the records of `log` from its read position on in the import table, returns the
+    /// number of records and adds their rows to `rows` and their keys to `merged_keys`
+    auto stageDeltaRecords(DeltaLogReader &log,
+                           std::size_t &rows,
+                           std::bitset<KEY_CODE_COUNT> &merged_keys) -> std::size_t;
+
+    /// Adds `count` presses of `key_code` in `period` through a `(period, scan_code, count)` upsert
+    static auto upsertCount(SQLite::Statement &stmt,
+                            std::int64_t period,
+                            std::size_t key_code,
+                            std::uint32_t count) -> void;
+
+    /// Steps through a reset and bound `(scan_code, count)` query and collects its rows
+    [[nodiscard]] static auto collectKeyCounts(SQLite::Statement &stmt) -> std::vector<KeyCount>;
 
     std::filesystem::path db_file;
     std::unique_ptr<SQLite::Database> db;
+
+    // Declared after the connection so they are finalized before it is closed
+    std::unique_ptr<SQLite::Statement> upsert_keystroke_stmt;
+    std::unique_ptr<SQLite::Statement> upsert_key_total_stmt;
+    std::unique_ptr<SQLite::Statement> upsert_weekly_count_stmt;
+    std::unique_ptr<SQLite::Statement> upsert_monthly_count_stmt;
+    std::unique_ptr<SQLite::Statement> upsert_key_name_stmt;
+    std::unique_ptr<SQLite::Statement> upsert_day_rhythm_stmt;
+    std::unique_ptr<SQLite::Statement> prune_keystrokes_stmt;
+    std::unique_ptr<SQLite::Statement> insert_delta_outbox_stmt;
+    std::unique_ptr<SQLite::Statement> delete_delta_outbox_stmt;
+    std::unique_ptr<SQLite::Statement> update_delta_log_sequence_stmt;
+    std::unique_ptr<SQLite::Statement> day_rhythm_stmt;
+    std::unique_ptr<SQLite::Statement> total_key_counts_stmt;
+    std::unique_ptr<SQLite::Statement> weekly_key_counts_stmt;
+    std::unique_ptr<SQLite::Statement> monthly_key_counts_stmt;
+    std::unique_ptr<SQLite::Statement> daily_counts_stmt;
+    std::unique_ptr<SQLite::Statement> top_keys_stmt;
+
+    std::vector<DailyKeyCounts> daily_counts;
+    std::array<std::uint64_t, KEY_CODE_COUNT> key_totals{};
+    std::bitset<KEY_CODE_COUNT> stored_key_names;
+    DeltaLogWriter *delta_log{ nullptr };
+    std::uint64_t committed_sequence{ 0 }; ///< Sequence number of the last committed batch
+    std::uint64_t logged_sequence{ 0 };    ///< Sequence number of the last batch in the log
+
+    DayClock day_clock;
+    std::size_t retention_days;
+    DayNumber pruned_until{ 0 }; ///< First kept day of the last completed pruning run
+    std::size_t pruned_rows{ 0 }; ///< Rows deleted by the pruning run in progress
 };
 
 } // namespace typetrace::backend
@@ -0,0 +1,33 @@
+#include "day_clock.hpp"
+
+#include "constants.hpp"
+#include "logger.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace typetrace::backend {
+
+auto DayClock::refresh(const TimePoint time_point) -> void
+{
+    // Time zone changes are only noticed here, so the cache is never trusted for longer than
+    // the check interval even if midnight is still far away
+    const std::chrono::time_zone *const current_zone = std::chrono::current_zone();
+    if (current_zone != zone && zone != nullptr) {
+        getLogger().info(
+          "System time zone changed from {} to {}", zone->name(), current_zone->name());
+    }
+    zone = current_zone;
+
+    const auto local_day = std::chrono::floor<std::chrono::days>(zone->to_local(time_point));
+
+    // A local midnight may not exist or exist twice around DST transitions, `earliest` picks
+    // the first instant belonging to the new day in both cases
+    day = static_cast<DayNumber>(local_day.time_since_epoch().count());
+    day_start = zone->to_sys(local_day, std::chrono::choose::earliest);
+    day_end = zone->to_sys(local_day + std::chrono::days{ 1 }, std::chrono::choose::earliest);
+    valid_until = std::min(day_end, time_point + TIME_ZONE_CHECK_INTERVAL);
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,62 @@
+#ifndef TYPETRACE_DAY_CLOCK_HPP
+#define TYPETRACE_DAY_CLOCK_HPP
+
+#include "types.hpp"
+
+#include <chrono>
+#include <cstddef>
+
+namespace typetrace::backend {
+
+/// Maps wall clock time to local days while keeping the time zone lookup off the hot path.
+///
+/// The current day, the instants of its local midnights and the active time zone are cached.
+/// As long as a time point falls between the cached midnights and before the next time zone
+/// check, resolving its day is a range comparison. Midnights are computed through the time
+/// zone database, so days that are shorter or longer because of DST are handled correctly.
+class DayClock
+{
+  public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    /// Constructs a day clock for the current system time zone
+    DayClock() { refresh(std::chrono::system_clock::now()); }
+
+    /// Returns the local day of the given time point
+    [[nodiscard]] auto dayOf(TimePoint time_point) -> DayNumber
+    {
+        if (time_point >= day_start && time_point < valid_until) [[likely]] {
+            return day;
+        }
+
+        refresh(time_point);
+        return day;
+    }
+
+    /// Returns the current local day
+    [[nodiscard]] auto today() -> DayNumber { return dayOf(std::chrono::system_clock::now()); }
+
+    /// Returns the hours elapsed since the local midnight of the given time point's day. After
+    /// a DST change this is one off from the wall clock hour for the rest of that day.
+    [[nodiscard]] auto hourOf(TimePoint time_point) -> std::size_t
+    {
+        [[maybe_unused]] const DayNumber current_day = dayOf(time_point);
+        return static_cast<std::size_t>(
+          std::chrono::floor<std::chrono::hours>(time_point - day_start).count());
+    }
+
+  private:
+    /// Re-reads the system time zone and recomputes the day containing the time point
+    auto refresh(TimePoint time_point) -> void;
+
+    DayNumber day{};
+    TimePoint day_start;
+    TimePoint day_end;
+    TimePoint valid_until;
+
+    const std::chrono::time_zone *zone{ nullptr };
+};
+
+} // namespace typetrace::backend
+
+#endif
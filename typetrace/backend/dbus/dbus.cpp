@@ -0,0 +1,355 @@
+#include "dbus.hpp"
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <systemd/sd-bus.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace typetrace::backend {
+
+namespace {
+
+using MessagePtr = std::unique_ptr<sd_bus_message, decltype(&sd_bus_message_unref)>;
+
+/// Throws a `SystemError` if an sd-bus call returned a negative errno
+auto check(const int result, const char *what) -> int
+{
+    if (result < 0) {
+        throw SystemError(std::format("{}: {}", what, std::strerror(-result)));
+    }
+    return result;
+}
+
+} // namespace
+
+DbusService::DbusService(std::filesystem::path database_path,
+                         const DayNumber today,
+                         const std::vector<KeyCount> &today_counts)
+  : database_file(std::move(database_path)), day(today)
+{
+    // Like the live segment, so a restart does not make today's snapshot start from zero. Scan
+    // codes without a counter are left out there as well.
+    for (const auto &[key_code, count] : today_counts) {
+        if (key_code < KEY_CODE_COUNT) {
+            day_counts.at(key_code) += count;
+        }
+    }
+
+    getLogger().info("Connecting to the session bus...");
+
+    sd_bus *connection = nullptr;
+    check(sd_bus_open_user(&connection), "Failed to connect to the session bus");
+    bus.reset(connection);
+
+    // Defined here so the method handler can stay a private member
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays, modernize-avoid-c-arrays)
+    static const sd_bus_vtable vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_METHOD("GetSnapshot",
+                      "",
+                      "uta(qt)",
+                      &DbusService::handleGetSnapshot,
+                      SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_SIGNAL("KeystrokeDeltas", "uta(qu)", 0),
+        SD_BUS_SIGNAL("Flushed", "t", 0),
+        SD_BUS_PROPERTY("EventsReceived", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("EventsIgnored", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("EventsDropped", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("DispatchTimeP50", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("DispatchTimeP99", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("DispatchTimeMax", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("Flushes", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("FlushSizeAverage", "d", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("FlushSizeMax", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("Transactions", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("TransactionsFailed", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("TransactionTimeP50", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("TransactionTimeP99", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("TransactionTimeMax", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("WalSize", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_PROPERTY("ResidentSetSize", "t", &DbusService::handleGetMetric, 0, 0),
+        SD_BUS_VTABLE_END,
+    };
+
+    sd_bus_slot *object_slot = nullptr;
+    check(sd_bus_add_object_vtable(
+            bus.get(), &object_slot, DBUS_OBJECT_PATH, DBUS_INTERFACE_NAME, vtable, this),
+          "Failed to register the D-Bus object");
+    slot.reset(object_slot);
+
+    check(sd_bus_request_name(bus.get(), DBUS_SERVICE_NAME, 0),
+          "Failed to acquire the D-Bus service name");
+    bus_watch.emplace(bus.get());
+
+    signal_timer_fd.reset(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (!signal_timer_fd) {
+        throw SystemError(std::format("Failed to create signal timer: {}", std::strerror(errno)));
+    }
+
+    flush_event_fd.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    if (!flush_event_fd) {
+        throw SystemError(std::format("Failed to create flush event: {}", std::strerror(errno)));
+    }
+
+    getLogger().info("Registered {} on the session bus", DBUS_SERVICE_NAME);
+}
+
+auto DbusService::addKeystrokes(const std::span<const KeystrokeEvent> keystrokes) -> void
+{
+    for (const auto &keystroke : keystrokes) {
+        if (keystroke.day != day) {
+            startDay(keystroke.day);
+        }
+
+        ++day_counts.at(keystroke.key_code);
+        if (pending_deltas.at(keystroke.key_code)++ == 0) {
+            pending_keys.push_back(keystroke.key_code);
+        }
+    }
+
+    // Deltas arriving while the timer runs are coalesced into the signal it triggers
+    if (!pending_keys.empty() && !signal_pending) {
+        const auto seconds = std::chrono::floor<std::chrono::seconds>(DBUS_SIGNAL_INTERVAL);
+        const auto nanoseconds
+          = std::chrono::duration_cast<std::chrono::nanoseconds>(DBUS_SIGNAL_INTERVAL - seconds);
+
+        struct itimerspec spec{};
+        spec.it_value.tv_sec = static_cast<time_t>(seconds.count());
+        spec.it_value.tv_nsec = static_cast<long>(nanoseconds.count());
+
+        if (timerfd_settime(signal_timer_fd.get(), 0, &spec, nullptr) < 0) {
+            getLogger().error("Failed to set signal timer: {}", std::strerror(errno));
+            return;
+        }
+        signal_pending = true;
+    }
+}
+
+auto DbusService::processBus() -> void
+{
+    bus_watch->process();
+}
+
+auto DbusService::onSignalTimer() -> void
+{
+    std::uint64_t expirations{ 0 };
+    [[maybe_unused]] const auto bytes_read
+      = ::read(signal_timer_fd.get(), &expirations, sizeof(expirations));
+
+    signal_pending = false;
+    emitDeltas();
+}
+
+auto DbusService::notifyFlushed() -> void
+{
+    flush_generation.fetch_add(1, std::memory_order_relaxed);
+
+    const std::uint64_t value{ 1 };
+    [[maybe_unused]] const auto written = ::write(flush_event_fd.get(), &value, sizeof(value));
+}
+
+auto DbusService::onFlushed() -> void
+{
+    std::uint64_t count{ 0 };
+    [[maybe_unused]] const auto bytes_read = ::read(flush_event_fd.get(), &count, sizeof(count));
+
+    const std::uint64_t generation = flush_generation.load(std::memory_order_relaxed);
+    const int result = sd_bus_emit_signal(
+      bus.get(), DBUS_OBJECT_PATH, DBUS_INTERFACE_NAME, "Flushed", "t", generation);
+
+    if (result < 0) {
+        getLogger().warn("Failed to emit flush signal: {}", std::strerror(-result));
+    }
+
+    // The signal is written once the socket takes it
+    bus_watch->update();
+}
+
+auto DbusService::busFd() const -> int
+{
+    return bus_watch->fd();
+}
+
+auto DbusService::signalTimerFd() const -> int
+{
+    return signal_timer_fd.get();
+}
+
+auto DbusService::flushEventFd() const -> int
+{
+    return flush_event_fd.get();
+}
+
+auto DbusService::handleGetSnapshot(sd_bus_message *const call,
+                                    void *const userdata,
+                                    sd_bus_error *const /*error*/) -> int
+{
+    auto &service = *static_cast<DbusService *>(userdata);
+
+    // Afterwards the counts are exactly the ones of all signals up to the current sequence
+    service.emitDeltas();
+
+    sd_bus_message *raw_reply = nullptr;
+    int result = sd_bus_message_new_method_return(call, &raw_reply);
+    if (result < 0) {
+        return result;
+    }
+    const MessagePtr reply{ raw_reply, &sd_bus_message_unref };
+
+    result = sd_bus_message_append(reply.get(), "ut", service.day, service.delta_sequence);
+    if (result < 0 || (result = sd_bus_message_open_container(reply.get(), 'a', "(qt)")) < 0) {
+        return result;
+    }
+
+    for (std::size_t key_code = 0; key_code < service.day_counts.size(); ++key_code) {
+        const std::uint64_t count = service.day_counts.at(key_code);
+        if (count == 0) {
+            continue;
+        }
+
+        result = sd_bus_message_append(
+          reply.get(), "(qt)", static_cast<std::uint16_t>(key_code), count);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    if ((result = sd_bus_message_close_container(reply.get())) < 0) {
+        return result;
+    }
+
+    return sd_bus_send(nullptr, reply.get(), nullptr);
+}
+
+auto DbusService::handleGetMetric(sd_bus *const /*bus*/,
+                                  const char *const /*path*/,
+                                  const char *const /*interface*/,
+                                  const char *const property,
+                                  sd_bus_message *const reply,
+                                  void *const userdata,
+                                  sd_bus_error *const /*error*/) -> int
+{
+    const auto &service = *static_cast<const DbusService *>(userdata);
+    const std::string_view name{ property };
+
+    // A `GetAll` asks for every property in turn, so each one only reads what it reports and
+    // the sizes are only sampled from the file system when they are asked for
+    if (name == "FlushSizeAverage") {
+        return sd_bus_message_append(reply, "d", averageFlushSize());
+    }
+
+    const Metrics &metrics = getMetrics();
+    const auto load = [](const std::atomic<std::uint64_t> &counter) -> std::uint64_t {
+        return counter.load(std::memory_order_relaxed);
+    };
+    const auto nanoseconds = [](const std::chrono::nanoseconds duration) -> std::uint64_t {
+        return static_cast<std::uint64_t>(duration.count());
+    };
+
+    std::uint64_t value{ 0 };
+    if (name == "EventsReceived") {
+        value = load(metrics.events_received);
+    } else if (name == "EventsIgnored") {
+        value = load(metrics.events_ignored);
+    } else if (name == "EventsDropped") {
+        value = load(metrics.events_dropped);
+    } else if (name == "DispatchTimeP50") {
+        value = nanoseconds(metrics.dispatch_time.percentile(0.5));
+    } else if (name == "DispatchTimeP99") {
+        value = nanoseconds(metrics.dispatch_time.percentile(0.99));
+    } else if (name == "DispatchTimeMax") {
+        value = nanoseconds(metrics.dispatch_time.max());
+    } else if (name == "Flushes") {
+        value = load(metrics.flushes);
+    } else if (name == "FlushSizeMax") {
+        value = load(metrics.max_flush_size);
+    } else if (name == "Transactions") {
+        value = metrics.transaction_time.count();
+    } else if (name == "TransactionsFailed") {
+        value = load(metrics.failed_transactions);
+    } else if (name == "TransactionTimeP50") {
+        value = nanoseconds(metrics.transaction_time.percentile(0.5));
+    } else if (name == "TransactionTimeP99") {
+        value = nanoseconds(metrics.transaction_time.percentile(0.99));
+    } else if (name == "TransactionTimeMax") {
+        value = nanoseconds(metrics.transaction_time.max());
+    } else if (name == "WalSize") {
+        value = readWalSize(service.database_file);
+    } else if (name == "ResidentSetSize") {
+        value = readResidentSetSize();
+    }
+
+    return sd_bus_message_append(reply, "t", value);
+}
+
+auto DbusService::emitDeltas() -> void
+{
+    if (pending_keys.empty()) {
+        return;
+    }
+
+    sd_bus_message *raw_signal = nullptr;
+    int result = sd_bus_message_new_signal(
+      bus.get(), &raw_signal, DBUS_OBJECT_PATH, DBUS_INTERFACE_NAME, "KeystrokeDeltas");
+    const MessagePtr signal{ raw_signal, &sd_bus_message_unref };
+
+    ++delta_sequence;
+    if (result >= 0) {
+        result = sd_bus_message_append(signal.get(), "ut", day, delta_sequence);
+    }
+    if (result >= 0) {
+        result = sd_bus_message_open_container(signal.get(), 'a', "(qu)");
+    }
+    for (const auto key_code : pending_keys) {
+        if (result >= 0) {
+            result = sd_bus_message_append(
+              signal.get(), "(qu)", key_code, pending_deltas.at(key_code));
+        }
+        pending_deltas.at(key_code) = 0;
+    }
+    if (result >= 0) {
+        result = sd_bus_message_close_container(signal.get());
+    }
+    if (result >= 0) {
+        result = sd_bus_send(bus.get(), signal.get(), nullptr);
+    }
+
+    // Dropped deltas are not retried, clients can resynchronize with `GetSnapshot`
+    if (result < 0) {
+        getLogger().warn("Failed to emit keystroke deltas: {}", std::strerror(-result));
+    }
+
+    pending_keys.clear();
+    bus_watch->update();
+}
+
+auto DbusService::startDay(const DayNumber new_day) -> void
+{
+    // Deltas always belong to a single day, so the old day's deltas go out first
+    emitDeltas();
+
+    day = new_day;
+    day_counts.fill(0);
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,125 @@
+#ifndef TYPETRACE_DBUS_HPP
+#define TYPETRACE_DBUS_HPP
+
+#include "bus_watch.hpp"
+#include "constants.hpp"
+#include "file_descriptor.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <systemd/sd-bus.h>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// Publishes keystrokes on the session bus.
+///
+/// Interface `DBUS_INTERFACE_NAME` at `DBUS_OBJECT_PATH`:
+/// - signal `KeystrokeDeltas(u day, t sequence, a(qu) deltas)`: presses per key since the
+///   previous signal, emitted at most once per `DBUS_SIGNAL_INTERVAL`. `sequence` grows by one
+///   with every signal and starts over when the backend restarts.
+/// - signal `Flushed(t generation)`: keystrokes were committed to the database, `generation`
+///   grows with every commit so clients can tell stale query results apart
+/// - method `GetSnapshot() -> (u day, t sequence, a(qt) counts)`: presses per key today, the
+///   ones committed before the backend started and every keystroke since, written to the
+///   database or not. Pending deltas are emitted first, so the counts contain the deltas of
+///   every signal up to `sequence` and of none after it.
+/// - read-only properties with the hot path metrics, e.g. `EventsReceived`, `FlushSize*`,
+///   `TransactionTime*` (nanoseconds), `WalSize` and `ResidentSetSize` (bytes). They change all
+///   the time, so no change signals are emitted.
+///
+/// The service does not run its own loop, its file descriptors are driven by the event handler.
+class DbusService
+{
+  public:
+    /// Connects to the session bus, registers the object and requests `DBUS_SERVICE_NAME`.
+    /// The WAL size property reports the WAL of `database_path`. The snapshot starts from the
+    /// counts the database already holds for `today`.
+    DbusService(std::filesystem::path database_path,
+                DayNumber today,
+                const std::vector<KeyCount> &today_counts);
+
+    DbusService(const DbusService &) = delete;
+    auto operator=(const DbusService &) -> DbusService & = delete;
+    DbusService(DbusService &&) = delete;
+    auto operator=(DbusService &&) -> DbusService & = delete;
+
+    ~DbusService() = default;
+
+    /// Adds keystrokes to the snapshot and to the deltas of the next signal
+    auto addKeystrokes(std::span<const KeystrokeEvent> keystrokes) -> void;
+
+    /// Handles all pending bus messages and writes queued ones, to be called when the bus fd is
+    /// readable
+    auto processBus() -> void;
+
+    /// Emits the coalesced deltas, to be called when the signal timer fd is readable
+    auto onSignalTimer() -> void;
+
+    /// Records a database commit, safe to call from any thread. The `Flushed` signal is emitted
+    /// once the flush event fd is handled, commits in between are coalesced into it.
+    auto notifyFlushed() -> void;
+
+    /// Emits the `Flushed` signal, to be called when the flush event fd is readable
+    auto onFlushed() -> void;
+
+    /// Returns the file descriptor that is readable whenever the bus connection has work to do
+    [[nodiscard]] auto busFd() const -> int;
+
+    /// Returns the timerfd that rate limits the delta signals
+    [[nodiscard]] auto signalTimerFd() const -> int;
+
+    /// Returns the eventfd that `notifyFlushed()` signals
+    [[nodiscard]] auto flushEventFd() const -> int;
+
+  private:
+    /// sd-bus handler of the `GetSnapshot` method
+    static auto handleGetSnapshot(sd_bus_message *call, void *userdata, sd_bus_error *error)
+      -> int;
+
+    /// sd-bus getter of all metric properties
+    static auto handleGetMetric(sd_bus *bus,
+                                const char *path,
+                                const char *interface,
+                                const char *property,
+                                sd_bus_message *reply,
+                                void *userdata,
+                                sd_bus_error *error) -> int;
+
+    /// Emits a `KeystrokeDeltas` signal with all pending deltas and resets them
+    auto emitDeltas() -> void;
+
+    /// Starts counting a new day, emitting the deltas of the previous one first
+    auto startDay(DayNumber new_day) -> void;
+
+    std::unique_ptr<sd_bus, decltype(&sd_bus_flush_close_unref)> bus{ nullptr,
+                                                                      &sd_bus_flush_close_unref };
+    std::unique_ptr<sd_bus_slot, decltype(&sd_bus_slot_unref)> slot{ nullptr, &sd_bus_slot_unref };
+    std::optional<BusWatch> bus_watch;
+
+    std::filesystem::path database_file;
+
+    FileDescriptor signal_timer_fd;
+    bool signal_pending{ false };
+
+    FileDescriptor flush_event_fd;
+    std::atomic<std::uint64_t> flush_generation{ 0 };
+
+    DayNumber day{ 0 };
+    std::uint64_t delta_sequence{ 0 }; ///< Sequence number of the last delta signal
+    std::array<std::uint64_t, KEY_CODE_COUNT> day_counts{};
+    std::array<std::uint32_t, KEY_CODE_COUNT> pending_deltas{};
+
+    /// Keys with a nonzero pending delta, so signals don't scan every key code
+    std::vector<std::uint16_t> pending_keys;
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,522 @@
+#include "delta_log.hpp"
+
+#include "blob_codec.hpp"
+#include "config.hpp"
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "logger.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// First bytes of every delta log
+constexpr std::string_view LOG_MAGIC = "TTDL";
+
+/// Format version, bumped whenever the layout changes
+constexpr std::uint8_t LOG_VERSION = 1;
+
+/// Size of the log ID in the header
+constexpr std::size_t LOG_ID_SIZE = 8;
+
+/// Largest possible header, the reader never needs more of the file to parse it
+constexpr std::size_t MAX_HEADER_SIZE = LOG_MAGIC.size() + 1 + LOG_ID_SIZE + 1 + UINT8_MAX;
+
+/// Size of the payload size and checksum in front of every record
+constexpr std::size_t FRAME_SIZE = 2 * BLOB_OFFSET_SIZE;
+
+/// Names the log in error messages
+constexpr std::string_view LOG_NAME = "Delta log";
+
+/// 32-bit FNV-1a hash, enough to tell a complete record from a torn or zero-filled one
+auto checksum(const std::span<const std::uint8_t> bytes) -> std::uint32_t
+{
+    constexpr std::uint32_t OFFSET_BASIS = 0x811c9dc5;
+    constexpr std::uint32_t PRIME = 0x01000193;
+
+    std::uint32_t hash = OFFSET_BASIS;
+    for (const std::uint8_t byte : bytes) {
+        hash = (hash ^ byte) * PRIME;
+    }
+    return hash;
+}
+
+/// Fields of a parsed header
+struct Header
+{
+    std::uint64_t log_id{ 0 };
+    std::string host;
+    std::size_t size{ 0 };
+};
+
+/// Parses the header at the start of `bytes`, throws `DatabaseError` if it is not one
+auto parseHeader(const std::span<const std::uint8_t> bytes) -> Header
+{
+    BlobReader reader{ bytes, 0, LOG_NAME };
+
+    if (reader.text(LOG_MAGIC.size()) != LOG_MAGIC) {
+        throw DatabaseError("Not a TypeTrace delta log");
+    }
+    if (const std::uint8_t version = reader.byte(); version != LOG_VERSION) {
+        throw DatabaseError(std::format("Unsupported delta log version {}", version));
+    }
+
+    Header header;
+    for (std::size_t i = 0; i < LOG_ID_SIZE; ++i) {
+        header.log_id |= static_cast<std::uint64_t>(reader.byte()) << (8 * i);
+    }
+    header.host = reader.text(reader.byte());
+    header.size = reader.tell();
+    return header;
+}
+
+/// How much of a record is present
+enum class FrameState : std::uint8_t
+{
+    complete,   ///< The whole record is present and intact
+    incomplete, ///< The record is still being written or copied
+    corrupt,    ///< The record is present but does not match its checksum
+};
+
+/// A record at the start of a byte range
+struct Frame
+{
+    FrameState state{ FrameState::incomplete };
+    std::span<const std::uint8_t> payload;
+};
+
+/// Looks at the record `bytes` start with
+auto readFrame(const std::span<const std::uint8_t> bytes) -> Frame
+{
+    if (bytes.size() < FRAME_SIZE) {
+        return {};
+    }
+
+    BlobReader reader{ bytes, 0, LOG_NAME };
+    const std::uint32_t payload_size = reader.offset();
+    const std::uint32_t expected_checksum = reader.offset();
+    if (bytes.size() - FRAME_SIZE < payload_size) {
+        return {};
+    }
+
+    const auto payload = bytes.subspan(FRAME_SIZE, payload_size);
+    return { .state = checksum(payload) == expected_checksum ? FrameState::complete
+                                                             : FrameState::corrupt,
+             .payload = payload };
+}
+
+/// Reads a file from `offset` to its end
+auto readFrom(const int fd, const std::uint64_t offset) -> std::vector<std::uint8_t>
+{
+    struct stat file_stat{};
+    if (::fstat(fd, &file_stat) < 0) {
+        throw SystemError(std::format("Failed to stat delta log: {}", std::strerror(errno)));
+    }
+
+    const auto file_size = static_cast<std::uint64_t>(file_stat.st_size);
+    std::vector<std::uint8_t> bytes(file_size > offset ? file_size - offset : 0);
+
+    std::size_t filled{ 0 };
+    while (filled < bytes.size()) {
+        const ssize_t result = ::pread(fd,
+                                       std::next(bytes.data(), static_cast<std::ptrdiff_t>(filled)),
+                                       bytes.size() - filled,
+                                       static_cast<off_t>(offset + filled));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            throw SystemError(std::format("Failed to read delta log: {}", std::strerror(errno)));
+        }
+        if (result == 0) {
+            // Another process shortened the file in the meantime
+            bytes.resize(filled);
+            break;
+        }
+        filled += static_cast<std::size_t>(result);
+    }
+
+    return bytes;
+}
+
+/// Writes all of `bytes` at the end of an `O_APPEND` file
+auto writeAll(const int fd, const std::span<const std::uint8_t> bytes) -> void
+{
+    // Regular files take a whole write, a short one only happens on a full disk
+    ssize_t result{ 0 };
+    do {
+        result = ::write(fd, bytes.data(), bytes.size());
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        throw SystemError(std::format("Failed to append to delta log: {}", std::strerror(errno)));
+    }
+    if (static_cast<std::size_t>(result) != bytes.size()) {
+        throw SystemError("Failed to append to delta log: disk full");
+    }
+}
+
+} // namespace
+
+auto getSyncHost(const SyncSettings &settings) -> std::string
+{
+    if (settings.host) {
+        return *settings.host;
+    }
+
+    std::array<char, MAX_SYNC_HOST_SIZE + 1> name{};
+    if (::gethostname(name.data(), name.size() - 1) < 0 || name.front() == '\0') {
+        throw SystemError(std::format("Failed to read the host name, set 'sync_host': {}",
+                                      std::strerror(errno)));
+    }
+
+    // Host names only consist of letters, digits, '-' and '.', anything else is replaced
+    std::string host{ name.data() };
+    std::ranges::replace_if(
+      host,
+      [](const char character) -> bool {
+          return std::isalnum(static_cast<unsigned char>(character)) == 0 && character != '-'
+                 && character != '.';
+      },
+      '_');
+    if (host.front() == '.') {
+        host.front() = '_';
+    }
+    return host;
+}
+
+auto getSyncDir(const SyncSettings &settings, const std::filesystem::path &database_dir)
+  -> std::filesystem::path
+{
+    return settings.dir.value_or(database_dir / SYNC_DIR_NAME);
+}
+
+DeltaLogWriter::DeltaLogWriter(const std::filesystem::path &path, const std::string_view host) :
+  file_path(path)
+{
+    getLogger().info("Opening delta log at: {}", file_path.string());
+
+    std::error_code error;
+    std::filesystem::create_directories(file_path.parent_path(), error);
+
+    fd.reset(::open(file_path.c_str(),
+                    O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC,
+                    S_IRUSR | S_IWUSR));
+    if (!fd) {
+        throw SystemError(std::format(
+          "Failed to open delta log '{}': {}", file_path.string(), std::strerror(errno)));
+    }
+
+    struct stat file_stat{};
+    if (::fstat(fd.get(), &file_stat) < 0) {
+        throw SystemError(std::format("Failed to stat delta log: {}", std::strerror(errno)));
+    }
+
+    if (file_stat.st_size == 0) {
+        writeHeader(host);
+    } else {
+        recover(host, static_cast<std::uint64_t>(file_stat.st_size));
+    }
+}
+
+auto DeltaLogWriter::encode(const std::span<const DailyKeyCounts> days)
+  -> std::span<const std::uint8_t>
+{
+    // The frame is filled in once the payload size is known
+    record.assign(FRAME_SIZE, 0);
+
+    const auto used_days = std::ranges::count_if(days, [](const DailyKeyCounts &day) -> bool {
+        return std::ranges::any_of(day.counts, [](const std::uint32_t count) -> bool {
+            return count != 0;
+        });
+    });
+    if (used_days == 0) {
+        return {};
+    }
+    writeVarint(record, static_cast<std::uint64_t>(used_days));
+
+    // Batches rarely span days, so they are not sorted and the first delta may wrap around
+    DayNumber previous_day{ 0 };
+    for (const DailyKeyCounts &day : days) {
+        const auto rows = std::ranges::count_if(
+          day.counts, [](const std::uint32_t count) -> bool { return count != 0; });
+        if (rows == 0) {
+            continue;
+        }
+
+        writeVarint(record, static_cast<DayNumber>(day.day - previous_day));
+        writeVarint(record, static_cast<std::uint64_t>(rows));
+        previous_day = day.day;
+
+        std::size_t previous_code{ 0 };
+        for (std::size_t key_code = 0; key_code < day.counts.size(); ++key_code) {
+            if (day.counts.at(key_code) != 0) {
+                writeVarint(record, key_code - previous_code);
+                previous_code = key_code;
+            }
+        }
+        for (const std::uint32_t count : day.counts) {
+            if (count != 0) {
+                writeVarint(record, count);
+            }
+        }
+    }
+
+    const auto payload = std::span{ record }.subspan(FRAME_SIZE);
+    writeOffset(record, 0, static_cast<std::uint32_t>(payload.size()));
+    writeOffset(record, BLOB_OFFSET_SIZE, checksum(payload));
+    return record;
+}
+
+auto DeltaLogWriter::append(const std::span<const std::uint8_t> encoded) -> void
+{
+    writeAll(fd.get(), encoded);
+
+    // The database counts the record as logged from here on, so it has to survive a power cut
+    if (::fdatasync(fd.get()) < 0) {
+        throw SystemError(std::format("Failed to sync delta log: {}", std::strerror(errno)));
+    }
+    ++record_count;
+}
+
+auto DeltaLogWriter::path() const -> const std::filesystem::path &
+{
+    return file_path;
+}
+
+auto DeltaLogWriter::logId() const -> std::uint64_t
+{
+    return log_id;
+}
+
+auto DeltaLogWriter::records() const -> std::uint64_t
+{
+    return record_count;
+}
+
+auto DeltaLogWriter::writeHeader(const std::string_view host) -> void
+{
+    std::random_device random;
+    log_id = (static_cast<std::uint64_t>(random()) << 32U) | static_cast<std::uint32_t>(random());
+
+    std::vector<std::uint8_t> header(LOG_MAGIC.begin(), LOG_MAGIC.end());
+    header.push_back(LOG_VERSION);
+    for (std::size_t i = 0; i < LOG_ID_SIZE; ++i) {
+        header.push_back(static_cast<std::uint8_t>(log_id >> (8 * i)));
+    }
+    header.push_back(static_cast<std::uint8_t>(host.size()));
+    header.insert(header.end(), host.begin(), host.end());
+
+    writeAll(fd.get(), header);
+    if (::fdatasync(fd.get()) < 0) {
+        throw SystemError(std::format("Failed to sync delta log: {}", std::strerror(errno)));
+    }
+}
+
+auto DeltaLogWriter::recover(const std::string_view host, const std::uint64_t file_size) -> void
+{
+    const std::vector<std::uint8_t> bytes = readFrom(fd.get(), 0);
+
+    Header header;
+    try {
+        header = parseHeader(bytes);
+    } catch (const DatabaseError &e) {
+        throw SystemError(
+          std::format("Failed to open delta log '{}': {}", file_path.string(), e.what()));
+    }
+    if (header.host != host) {
+        throw SystemError(std::format(
+          "Delta log '{}' belongs to host '{}', not '{}'", file_path.string(), header.host, host));
+    }
+    log_id = header.log_id;
+
+    std::size_t end = header.size;
+    Frame frame = readFrame(std::span{ bytes }.subspan(end));
+    while (frame.state == FrameState::complete) {
+        end += FRAME_SIZE + frame.payload.size();
+        ++record_count;
+        frame = readFrame(std::span{ bytes }.subspan(end));
+    }
+
+    // Only the last record can be torn, it was the one being written when the process died. A
+    // crash may also leave it zero-filled. A damaged record with others behind it is not torn,
+    // cutting it off would drop them too, so the log is left for the user to look at.
+    if (frame.state == FrameState::corrupt) {
+        const auto rest = std::span{ bytes }.subspan(end + FRAME_SIZE + frame.payload.size());
+        if (!std::ranges::all_of(rest, [](const std::uint8_t byte) -> bool { return byte == 0; })) {
+            throw SystemError(std::format("Delta log '{}' is corrupt at offset {}, move it away "
+                                          "to start a new one",
+                                          file_path.string(),
+                                          end));
+        }
+    }
+
+    if (end < file_size) {
+        getLogger().warn("Cutting off {} bytes of a torn record from delta log: {}",
+                         file_size - end,
+                         file_path.string());
+        if (::ftruncate(fd.get(), static_cast<off_t>(end)) < 0) {
+            throw SystemError(
+              std::format("Failed to truncate delta log: {}", std::strerror(errno)));
+        }
+    }
+}
+
+DeltaLogReader::DeltaLogReader(const std::filesystem::path &path) : file_path(path)
+{
+    fd.reset(::open(file_path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd) {
+        throw DatabaseError(std::format(
+          "Failed to open delta log '{}': {}", file_path.string(), std::strerror(errno)));
+    }
+
+    try {
+        std::vector<std::uint8_t> bytes = readFrom(fd.get(), 0);
+        bytes.resize(std::min(bytes.size(), MAX_HEADER_SIZE));
+
+        Header header = parseHeader(bytes);
+        log_host = std::move(header.host);
+        log_id = header.log_id;
+        header_size = header.size;
+    } catch (const std::runtime_error &e) {
+        throw DatabaseError(
+          std::format("Failed to read delta log '{}': {}", file_path.string(), e.what()));
+    }
+
+    data_offset = header_size;
+}
+
+auto DeltaLogReader::host() const -> const std::string &
+{
+    return log_host;
+}
+
+auto DeltaLogReader::logId() const -> std::uint64_t
+{
+    return log_id;
+}
+
+auto DeltaLogReader::seek(const std::uint64_t record_offset) -> void
+{
+    if (record_offset < header_size) {
+        throw DatabaseError(std::format(
+          "Delta log '{}' has no record at offset {}", file_path.string(), record_offset));
+    }
+
+    data_offset = record_offset;
+    data.clear();
+    position = 0;
+    loaded = false;
+}
+
+auto DeltaLogReader::next(std::vector<DeltaDay> &days) -> bool
+{
+    if (!loaded) {
+        load();
+    }
+
+    const Frame frame = readFrame(std::span{ data }.subspan(position));
+    if (frame.state == FrameState::incomplete) {
+        return false;
+    }
+    if (frame.state == FrameState::corrupt) {
+        throw DatabaseError(
+          std::format("Delta log '{}' is corrupt at offset {}", file_path.string(), offset()));
+    }
+
+    BlobReader reader{ frame.payload, 0, LOG_NAME };
+    const std::uint64_t day_count = reader.varint();
+    if (day_count > frame.payload.size()) {
+        throw DatabaseError("Delta log record holds too many days");
+    }
+    days.resize(day_count);
+
+    DayNumber day_number{ 0 };
+    for (DeltaDay &day : days) {
+        const std::uint64_t day_delta = reader.varint();
+        if (day_delta > UINT32_MAX) {
+            throw DatabaseError("Delta log record holds an invalid day");
+        }
+        day_number += static_cast<DayNumber>(day_delta);
+        day.day = day_number;
+
+        const std::uint64_t rows = reader.varint();
+        if (rows > KEY_CODE_COUNT) {
+            throw DatabaseError("Delta log record holds too many rows");
+        }
+        day.counts.resize(rows);
+
+        std::uint64_t key_code{ 0 };
+        for (KeyCount &count : day.counts) {
+            key_code += reader.varint();
+            if (key_code >= KEY_CODE_COUNT) {
+                throw DatabaseError("Delta log record refers to an unknown key");
+            }
+            count.key_code = static_cast<std::uint16_t>(key_code);
+        }
+        for (KeyCount &count : day.counts) {
+            count.count = reader.varint();
+            if (count.count > UINT32_MAX) {
+                throw DatabaseError("Delta log record holds an invalid count");
+            }
+        }
+    }
+
+    if (!reader.done()) {
+        throw DatabaseError("Delta log record has trailing bytes");
+    }
+
+    position += FRAME_SIZE + frame.payload.size();
+    return true;
+}
+
+auto DeltaLogReader::offset() const -> std::uint64_t
+{
+    return data_offset + position;
+}
+
+auto DeltaLogReader::load() -> void
+{
+    // Logs are only ever appended to, apart from an incomplete record no reader has used
+    struct stat file_stat{};
+    if (::fstat(fd.get(), &file_stat) == 0
+        && static_cast<std::uint64_t>(file_stat.st_size) < data_offset) {
+        throw DatabaseError(std::format("Delta log '{}' is shorter than the {} bytes read before",
+                                        file_path.string(),
+                                        data_offset));
+    }
+
+    // Only the records appended since the given offset are read
+    try {
+        data = readFrom(fd.get(), data_offset);
+    } catch (const SystemError &e) {
+        throw DatabaseError(std::format("{}: {}", file_path.string(), e.what()));
+    }
+    position = 0;
+    loaded = true;
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,126 @@
+#ifndef TYPETRACE_DELTA_LOG_HPP
+#define TYPETRACE_DELTA_LOG_HPP
+
+#include "config.hpp"
+#include "file_descriptor.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// The key count increments of one day in a delta log record, sorted by key code
+struct DeltaDay
+{
+    DayNumber day{ 0 };
+    std::vector<KeyCount> counts;
+};
+
+/// Returns the host ID of the sync settings, the sanitized host name if none is configured
+[[nodiscard]] auto getSyncHost(const SyncSettings &settings) -> std::string;
+
+/// Returns the directory of the delta logs, `SYNC_DIR_NAME` in `database_dir` by default
+[[nodiscard]] auto getSyncDir(const SyncSettings &settings,
+                              const std::filesystem::path &database_dir) -> std::filesystem::path;
+
+/// Appends every flushed batch of one host to its delta log.
+///
+/// Layout, all fixed-width integers are little-endian:
+/// - the magic bytes `TTDL`, a format version byte, a random 8 byte log ID and the host ID as
+///   length byte and bytes
+/// - one record per batch: the payload size and its FNV-1a checksum as 4 bytes each, then the
+///   payload. It holds LEB128 varints: the number of days, then per day the day as delta to the
+///   previous day, the number of rows, the key codes as deltas and the count increments.
+///
+/// A record is written with a single `write()` to a file opened with `O_APPEND`, so a copy of
+/// the log taken at any time ends with at most one incomplete record. Readers stop in front of
+/// it and pick it up once the rest has arrived. The number of the record in the log is the
+/// sequence number `DatabaseManager` stores with the batch, so the two are reconciled on open.
+class DeltaLogWriter
+{
+  public:
+    /// Opens or creates the log at `path`. A torn last record left by a crash is cut off,
+    /// throws `SystemError` if the file can't be opened, is the log of another host or has a
+    /// damaged record before its last one.
+    DeltaLogWriter(const std::filesystem::path &path, std::string_view host);
+
+    /// Encodes the non-zero counts of an aggregated batch as one record, empty if there are
+    /// none. The record stays valid until the next call.
+    [[nodiscard]] auto encode(std::span<const DailyKeyCounts> days)
+      -> std::span<const std::uint8_t>;
+
+    /// Appends a record `encode()` returned and syncs it to disk, throws `SystemError` if
+    /// writing failed
+    auto append(std::span<const std::uint8_t> encoded) -> void;
+
+    /// Returns the path of the log
+    [[nodiscard]] auto path() const -> const std::filesystem::path &;
+
+    /// Returns the ID the log got when it was created
+    [[nodiscard]] auto logId() const -> std::uint64_t;
+
+    /// Returns the number of complete records in the log
+    [[nodiscard]] auto records() const -> std::uint64_t;
+
+  private:
+    /// Writes the header of a new log
+    auto writeHeader(std::string_view host) -> void;
+
+    /// Checks the header of an existing log, cuts off a torn last record and counts the others
+    auto recover(std::string_view host, std::uint64_t file_size) -> void;
+
+    std::filesystem::path file_path;
+    FileDescriptor fd;
+    std::vector<std::uint8_t> record;
+    std::uint64_t log_id{ 0 };
+    std::uint64_t record_count{ 0 };
+};
+
+/// Reads the records of a delta log written by `DeltaLogWriter`.
+/// Throws `DatabaseError` if the file is not a valid delta log.
+class DeltaLogReader
+{
+  public:
+    /// Opens the log and reads its header, reading starts at the first record
+    explicit DeltaLogReader(const std::filesystem::path &path);
+
+    /// Returns the ID of the host that writes the log
+    [[nodiscard]] auto host() const -> const std::string &;
+
+    /// Returns the ID the log got when it was created, a recreated log has a new one
+    [[nodiscard]] auto logId() const -> std::uint64_t;
+
+    /// Continues reading at `record_offset`, which must be an offset `offset()` returned before
+    auto seek(std::uint64_t record_offset) -> void;
+
+    /// Reads the next complete record into `days`, returns false at the end of the log
+    auto next(std::vector<DeltaDay> &days) -> bool;
+
+    /// Returns the file offset behind the last record read
+    [[nodiscard]] auto offset() const -> std::uint64_t;
+
+  private:
+    /// Reads everything from the current offset to the end of the file
+    auto load() -> void;
+
+    std::filesystem::path file_path;
+    FileDescriptor fd;
+    std::string log_host;
+    std::uint64_t log_id{ 0 };
+    std::uint64_t header_size{ 0 };
+
+    std::uint64_t data_offset{ 0 }; ///< File offset of the first byte of `data`
+    std::vector<std::uint8_t> data;
+    std::size_t position{ 0 }; ///< Start of the next record in `data`
+    bool loaded{ false };
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,110 @@
+#include "device_registry.hpp"
+
+#include "constants.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <format>
+#include <map>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// Returns true if `needle` appears in `haystack`, ignoring ASCII case
+auto containsIgnoringCase(const std::string_view haystack, const std::string_view needle) -> bool
+{
+    const auto lower = [](const unsigned char character) -> int { return std::tolower(character); };
+    return !std::ranges::search(haystack, needle, {}, lower, lower).empty();
+}
+
+/// Returns true if `pattern` is the device's ID or part of its name
+auto matches(const std::string_view pattern, const std::string &id, const std::string &name)
+  -> bool
+{
+    return pattern == id || containsIgnoringCase(name, pattern);
+}
+
+} // namespace
+
+DeviceRegistry::DeviceRegistry(std::vector<std::string> allow_patterns,
+                               std::vector<std::string> deny_patterns)
+  : allowed(std::move(allow_patterns)), denied(std::move(deny_patterns))
+{
+}
+
+auto DeviceRegistry::attach(const DeviceInfo &info) -> Device *
+{
+    const std::string_view seat = info.seat.empty() ? DEFAULT_SEAT : std::string_view{ info.seat };
+
+    // Keyboards on the default seat keep the IDs they had before seats were told apart
+    std::string id = std::format("{}{:04x}:{:04x} {}",
+                                 seat == DEFAULT_SEAT ? "" : std::format("{}/", seat),
+                                 info.vendor,
+                                 info.product,
+                                 info.name);
+
+    if (!isAllowed(id, info.name)) {
+        getLogger().info("Ignoring excluded keyboard: {}", id);
+        return nullptr;
+    }
+
+    auto [entry, inserted] = entries.try_emplace(id);
+    Device &device = entry->second;
+
+    if (inserted) {
+        device.id = std::move(id);
+        device.name = info.name;
+        device.seat = seat;
+        device.index = entries.size() - 1;
+    }
+
+    // Identical keyboards share an ID, the second one just adds to the same counters
+    ++device.attached;
+    ++attached_count;
+
+    getLogger().info("Attached keyboard: {}", device.id);
+    return &device;
+}
+
+auto DeviceRegistry::detach(Device &device) -> void
+{
+    if (device.attached > 0) {
+        --device.attached;
+        --attached_count;
+    }
+
+    getLogger().info("Detached keyboard: {} ({} key presses)", device.id, device.key_presses);
+}
+
+auto DeviceRegistry::attachedCount() const -> std::size_t
+{
+    return attached_count;
+}
+
+auto DeviceRegistry::devices() const -> const std::map<std::string, Device> &
+{
+    return entries;
+}
+
+auto DeviceRegistry::isAllowed(const std::string &id, const std::string &name) const -> bool
+{
+    const auto match = [&](const std::string &pattern) -> bool {
+        return matches(pattern, id, name);
+    };
+
+    if (std::ranges::any_of(denied, match)) {
+        return false;
+    }
+
+    return allowed.empty() || std::ranges::any_of(allowed, match);
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,72 @@
+#ifndef TYPETRACE_DEVICE_REGISTRY_HPP
+#define TYPETRACE_DEVICE_REGISTRY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// Identity of a keyboard as reported by its input source
+struct DeviceInfo
+{
+    std::string name;
+    std::uint16_t vendor{ 0 };
+    std::uint16_t product{ 0 };
+    std::string seat; ///< Seat the keyboard is assigned to, empty for `DEFAULT_SEAT`
+};
+
+/// A keyboard the backend has read from, kept after removal so its counters survive replugging
+struct Device
+{
+    /// Stable identifier built from vendor, product and name, e.g. `046d:c31c USB Keyboard`.
+    /// Keyboards of other seats than `DEFAULT_SEAT` are prefixed, e.g. `seat1/046d:c31c ...`.
+    std::string id;
+    std::string name;
+    std::string seat;
+    std::size_t index{ 0 };         ///< Order in which the keyboard was first attached
+    std::size_t attached{ 0 };      ///< Attached devices with this ID, identical models share it
+    std::uint64_t events{ 0 };      ///< Input events read from the device
+    std::uint64_t key_presses{ 0 }; ///< Key presses among them
+};
+
+/// Keyboards seen since the backend started, updated incrementally from hotplug events.
+///
+/// Keyboards are matched against allow and deny patterns when they are attached, so input
+/// sources can skip excluded devices before reading a single event from them. A pattern matches
+/// the stable ID exactly or appears in the device name, ignoring case.
+class DeviceRegistry
+{
+  public:
+    DeviceRegistry(std::vector<std::string> allow_patterns,
+                   std::vector<std::string> deny_patterns);
+
+    /// Marks a keyboard as attached and returns its entry, or nullptr if it is excluded.
+    /// The entry stays valid for the lifetime of the registry.
+    auto attach(const DeviceInfo &info) -> Device *;
+
+    /// Marks a keyboard returned by `attach()` as removed, its counters are kept
+    auto detach(Device &device) -> void;
+
+    /// Returns the number of attached keyboards
+    [[nodiscard]] auto attachedCount() const -> std::size_t;
+
+    /// Returns all keyboards by stable ID, including removed ones
+    [[nodiscard]] auto devices() const -> const std::map<std::string, Device> &;
+
+  private:
+    /// Returns true if the filter lets the keyboard through
+    [[nodiscard]] auto isAllowed(const std::string &id, const std::string &name) const -> bool;
+
+    std::vector<std::string> allowed;
+    std::vector<std::string> denied;
+
+    std::map<std::string, Device> entries;
+    std::size_t attached_count{ 0 };
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,332 @@
+#include "evdev_source.hpp"
+
+#include "config.hpp"
+#include "constants.hpp"
+#include "device_registry.hpp"
+#include "exceptions.hpp"
+#include "input_source.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <format>
+#include <libudev.h>
+#include <linux/input.h>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// Converts the seconds of an event timestamp to microseconds
+constexpr std::uint64_t USEC_PER_SEC = 1'000'000;
+
+/// Returns true if udev tagged the device as a keyboard with an evdev node
+auto isKeyboard(struct udev_device *const device) -> bool
+{
+    const char *const keyboard = udev_device_get_property_value(device, "ID_INPUT_KEYBOARD");
+    const char *const node = udev_device_get_devnode(device);
+
+    return keyboard != nullptr && std::string_view{ keyboard } == "1" && node != nullptr
+           && std::string_view{ node }.starts_with("/dev/input/event");
+}
+
+/// Parses a hexadecimal sysfs ID attribute such as `id/vendor`, 0 if it is missing
+auto readIdAttribute(struct udev_device *const parent, const char *const attribute) -> std::uint16_t
+{
+    const char *const value = udev_device_get_sysattr_value(parent, attribute);
+    if (value == nullptr) {
+        return 0;
+    }
+
+    std::uint16_t id{ 0 };
+    std::from_chars(value, value + std::strlen(value), id, 16);
+    return id;
+}
+
+/// Returns the seat udev assigned the device to
+auto getSeat(struct udev_device *const device) -> std::string_view
+{
+    const char *const seat = udev_device_get_property_value(device, "ID_SEAT");
+    return seat != nullptr && *seat != '\0' ? std::string_view{ seat } : DEFAULT_SEAT;
+}
+
+/// Reads the name and IDs of an event node from its parent input device in sysfs
+auto getDeviceInfo(struct udev_device *const device) -> DeviceInfo
+{
+    struct udev_device *const parent = udev_device_get_parent(device);
+    if (parent == nullptr) {
+        return { .name = udev_device_get_sysname(device), .seat = std::string{ getSeat(device) } };
+    }
+
+    const char *const name = udev_device_get_sysattr_value(parent, "name");
+    return {
+        .name = name != nullptr ? name : udev_device_get_sysname(device),
+        .vendor = readIdAttribute(parent, "id/vendor"),
+        .product = readIdAttribute(parent, "id/product"),
+        .seat = std::string{ getSeat(device) },
+    };
+}
+
+} // namespace
+
+EvdevSource::EvdevSource(const InputSettings &settings)
+  : InputSource(settings), seats(settings.seats)
+{
+    getLogger().info("Initializing evdev input...");
+
+    udev.reset(udev_new());
+    if (udev == nullptr) {
+        throw SystemError("Failed to initialize udev");
+    }
+
+    epoll_fd.reset(epoll_create1(EPOLL_CLOEXEC));
+    if (!epoll_fd) {
+        throw SystemError(std::format("Failed to create epoll instance: {}", std::strerror(errno)));
+    }
+
+    // Start monitoring before enumerating, so no device can appear in between unnoticed
+    monitor.reset(udev_monitor_new_from_netlink(udev.get(), "udev"));
+    if (monitor == nullptr
+        || udev_monitor_filter_add_match_subsystem_devtype(monitor.get(), "input", nullptr) < 0
+        || udev_monitor_enable_receiving(monitor.get()) < 0) {
+        throw SystemError("Failed to create udev monitor");
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, udev_monitor_get_fd(monitor.get()), &event) < 0) {
+        throw SystemError(std::format("Failed to watch udev monitor: {}", std::strerror(errno)));
+    }
+
+    openKeyboards();
+
+    if (getDevices().attachedCount() == 0) {
+        throw SystemError("No input devices found or not accessible");
+    }
+
+    getLogger().info(
+      "Reading {} keyboards on {} seat(s) through evdev", devices.size(), seats.size());
+}
+
+auto EvdevSource::fd() const -> int
+{
+    return epoll_fd.get();
+}
+
+auto EvdevSource::read(const std::span<KeyPress> presses) -> InputRead
+{
+    std::array<struct epoll_event, READ_CHUNK_SIZE> ready_events{};
+    const int count = epoll_wait(
+      epoll_fd.get(), ready_events.data(), static_cast<int>(ready_events.size()), 0);
+
+    const auto ready_devices = std::span{ ready_events }.first(
+      static_cast<std::size_t>(std::max(count, 0)));
+
+    InputRead result;
+    bool hotplug_pending{ false };
+
+    for (const auto &ready : ready_devices) {
+        auto *const device = static_cast<OpenDevice *>(ready.data.ptr);
+
+        if (device == nullptr) {
+            hotplug_pending = true;
+        } else if (!readDevice(*device, presses, result)) {
+            // Removal is handled by the monitor, just stop watching the dead fd
+            epoll_ctl(epoll_fd.get(), EPOLL_CTL_DEL, device->fd.get(), nullptr);
+        }
+    }
+
+    // Removing a device frees its entry, so hotplug waits until no ready entry points to one
+    if (hotplug_pending) {
+        handleHotplug();
+    }
+
+    // Unread events stay in the kernel's device buffers and keep the epoll fd readable
+    result.backlog = false;
+    return result;
+}
+
+auto EvdevSource::openKeyboards() -> void
+{
+    std::unique_ptr<struct udev_enumerate, decltype(&udev_enumerate_unref)> enumerate{
+        udev_enumerate_new(udev.get()), &udev_enumerate_unref
+    };
+
+    if (enumerate == nullptr
+        || udev_enumerate_add_match_subsystem(enumerate.get(), "input") < 0
+        || udev_enumerate_add_match_property(enumerate.get(), "ID_INPUT_KEYBOARD", "1") < 0
+        || udev_enumerate_scan_devices(enumerate.get()) < 0) {
+        throw SystemError("Failed to enumerate input devices");
+    }
+
+    struct udev_list_entry *entry = nullptr;
+    udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate.get()))
+    {
+        std::unique_ptr<struct udev_device, decltype(&udev_device_unref)> device{
+            udev_device_new_from_syspath(udev.get(), udev_list_entry_get_name(entry)),
+            &udev_device_unref
+        };
+
+        if (device != nullptr) {
+            addDevice(device.get());
+        }
+    }
+}
+
+auto EvdevSource::addDevice(struct udev_device *const device) -> void
+{
+    if (!isKeyboard(device)) {
+        return;
+    }
+
+    const std::string node = udev_device_get_devnode(device);
+    if (devices.contains(node)) {
+        return;
+    }
+
+    // Keyboards of seats this backend does not serve belong to another session
+    if (std::ranges::find(seats, getSeat(device)) == seats.end()) {
+        getLogger().debug("Ignoring keyboard {} on seat {}", node, getSeat(device));
+        return;
+    }
+
+    // Excluded keyboards are rejected from their udev identity, before their node is opened
+    Device *const entry = deviceRegistry().attach(getDeviceInfo(device));
+    if (entry == nullptr) {
+        return;
+    }
+
+    FileDescriptor device_fd{ ::open(node.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC) };
+    if (!device_fd) {
+        getLogger().warn("Failed to open keyboard {}: {}", node, std::strerror(errno));
+        deviceRegistry().detach(*entry);
+        return;
+    }
+
+    // Monotonic timestamps like libinput's, so intervals between presses survive clock changes
+    int clock_id = CLOCK_MONOTONIC;
+    if (::ioctl(device_fd.get(), EVIOCSCLOCKID, &clock_id) < 0) {
+        getLogger().debug(
+          "Keyboard {} keeps wall clock timestamps: {}", node, std::strerror(errno));
+    }
+
+    auto &open_device = devices[node];
+    open_device = OpenDevice{ .fd = std::move(device_fd), .entry = entry };
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = &open_device;
+    if (epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, open_device.fd.get(), &event) < 0) {
+        getLogger().warn("Failed to watch keyboard {}: {}", node, std::strerror(errno));
+        removeDevice(node);
+        return;
+    }
+
+    getLogger().debug("Opened keyboard {} as {}", entry->id, node);
+}
+
+auto EvdevSource::removeDevice(const std::string &node) -> void
+{
+    const auto device = devices.find(node);
+    if (device == devices.end()) {
+        return;
+    }
+
+    // Closing the fd also removes it from the epoll instance
+    deviceRegistry().detach(*device->second.entry);
+    devices.erase(device);
+}
+
+auto EvdevSource::handleHotplug() -> void
+{
+    std::unique_ptr<struct udev_device, decltype(&udev_device_unref)> device{
+        udev_monitor_receive_device(monitor.get()), &udev_device_unref
+    };
+    if (device == nullptr) {
+        return;
+    }
+
+    const char *const action = udev_device_get_action(device.get());
+    const char *const node = udev_device_get_devnode(device.get());
+    if (action == nullptr || node == nullptr) {
+        return;
+    }
+
+    if (std::string_view{ action } == "add") {
+        addDevice(device.get());
+    } else if (std::string_view{ action } == "remove") {
+        removeDevice(node);
+    }
+}
+
+auto EvdevSource::readDevice(OpenDevice &device,
+                             const std::span<KeyPress> presses,
+                             InputRead &result) -> bool
+{
+    const std::size_t first_key_press = result.key_presses;
+    const std::size_t first_event = result.events;
+    const auto count_events = [&]() -> void {
+        device.entry->events += result.events - first_event;
+        device.entry->key_presses += result.key_presses - first_key_press;
+    };
+
+    std::array<struct input_event, READ_CHUNK_SIZE> events{};
+
+    // Every event may be a key press, so at most as many are read as there is room for. Bounding
+    // the events rather than the presses also bounds the time a drain takes, the rest waits in
+    // the kernel.
+    while (result.events < presses.size()) {
+        const std::size_t room = std::min(events.size(), presses.size() - result.events);
+        const ssize_t bytes
+          = ::read(device.fd.get(), events.data(), room * sizeof(struct input_event));
+
+        if (bytes <= 0) {
+            count_events();
+            return bytes < 0 && (errno == EAGAIN || errno == EINTR);
+        }
+
+        const auto count = static_cast<std::size_t>(bytes) / sizeof(struct input_event);
+        result.events += count;
+
+        // Value 1 is a press, 0 a release and 2 an autorepeat
+        for (const auto &event : std::span{ events }.first(count)) {
+            if (event.type == EV_SYN && event.code == SYN_DROPPED) {
+                // The device's buffer overflowed, presses among the lost events are gone
+                ++result.overruns;
+            } else if (event.type == EV_KEY && event.value == 1 && event.code < KEY_CODE_COUNT) {
+                presses[result.key_presses++] = {
+                    .key_code = event.code,
+                    .device = device.entry,
+                    .time_usec = (static_cast<std::uint64_t>(event.input_event_sec) * USEC_PER_SEC)
+                                 + static_cast<std::uint64_t>(event.input_event_usec),
+                };
+            }
+        }
+
+        if (count < room) {
+            break;
+        }
+    }
+
+    count_events();
+    return true;
+}
+
+} // namespace typetrace::backend
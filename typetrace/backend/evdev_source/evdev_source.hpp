@@ -0,0 +1,82 @@
+#ifndef TYPETRACE_EVDEV_SOURCE_HPP
+#define TYPETRACE_EVDEV_SOURCE_HPP
+
+#include "config.hpp"
+#include "device_registry.hpp"
+#include "file_descriptor.hpp"
+#include "input_source.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <libudev.h>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// Reads key presses straight from the keyboards' evdev nodes.
+///
+/// Keyboards are found through udev and followed through hotplug with a udev monitor. Their
+/// `input_event`s are read in bulk and everything but key presses is ignored, without any of
+/// libinput's device handling. Excluded keyboards and keyboards of seats that are not configured
+/// are identified from udev and never opened.
+class EvdevSource : public InputSource
+{
+  public:
+    /// Opens all keyboards, throws `SystemError` if none is accessible
+    explicit EvdevSource(const InputSettings &settings);
+
+    [[nodiscard]] auto fd() const -> int override;
+
+    auto read(std::span<KeyPress> presses) -> InputRead override;
+
+  private:
+    /// Number of `input_event`s read from a device per `read()` call
+    static constexpr std::size_t READ_CHUNK_SIZE = 64;
+
+    /// A keyboard that is open and watched
+    struct OpenDevice
+    {
+        FileDescriptor fd;
+        Device *entry{ nullptr };
+    };
+
+    /// Opens every keyboard udev currently knows about
+    auto openKeyboards() -> void;
+
+    /// Opens a keyboard device and watches it, other and excluded devices are ignored
+    auto addDevice(struct udev_device *device) -> void;
+
+    /// Closes a device and marks it as detached
+    auto removeDevice(const std::string &node) -> void;
+
+    /// Handles one pending add or remove event of the udev monitor
+    auto handleHotplug() -> void;
+
+    /// Reads the events of one device into `presses`, returns false once the device is gone
+    static auto readDevice(OpenDevice &device,
+                           std::span<KeyPress> presses,
+                           InputRead &result) -> bool;
+
+    std::unique_ptr<struct udev, decltype(&udev_unref)> udev{ nullptr, &udev_unref };
+    std::unique_ptr<struct udev_monitor, decltype(&udev_monitor_unref)> monitor{
+        nullptr, &udev_monitor_unref
+    };
+
+    /// Epoll instance over the monitor and all device fds, it is the fd the event loop watches.
+    /// Device entries point to their `OpenDevice`, the monitor's entry is nullptr.
+    FileDescriptor epoll_fd;
+
+    /// Open devices by device node, map nodes keep the addresses the epoll entries point to
+    std::map<std::string, OpenDevice> devices;
+
+    /// Seats whose keyboards are opened
+    std::vector<std::string> seats;
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -1,209 +1,668 @@
 #include "event_handler.hpp"
 
+#include "buffer_policy.hpp"
+#include "config.hpp"
 #include "constants.hpp"
+#include "device_registry.hpp"
+#include "dimension_matrix.hpp"
 #include "exceptions.hpp"
+#include "input_source.hpp"
+#include "key_table.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
+#include "rhythm_stats.hpp"
 #include "spdlog/common.h"
+#include "spill_file.hpp"
 #include "types.hpp"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cerrno>
 #include <chrono>
-#include <cstdlib>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
-#include <fcntl.h>
+#include <ctime>
 #include <format>
 #include <functional>
-#include <grp.h>
-#include <libevdev-1.0/libevdev/libevdev.h>
-#include <libinput.h>
-#include <libudev.h>
-#include <linux/input-event-codes.h>
+#include <iterator>
+#include <map>
 #include <optional>
 #include <poll.h>
-#include <print>
-#include <sys/poll.h>
-#include <sys/types.h>
+#include <pthread.h>
+#include <span>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <thread>
 #include <unistd.h>
 #include <utility>
 #include <vector>
 
 namespace typetrace::backend {
 
-auto EventHandler::setBufferCallback(
-  std::function<void(const std::vector<KeystrokeEvent> &)> callback) -> void
+auto EventHandler::blockLoopSignals() -> sigset_t
+{
+    // SIGUSR1 requests a stats dump and must not kill the process either
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+
+    if (pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0) {
+        throw SystemError("Failed to block termination signals");
+    }
+
+    return signals;
+}
+
+auto EventHandler::setBufferCallback(std::function<bool(std::span<const KeystrokeEvent>)> callback)
+  -> void
 {
     buffer_callback = std::move(callback);
 }
 
-auto EventHandler::trace() -> void
+auto EventHandler::setLiveCallback(std::function<void(std::span<const KeystrokeEvent>)> callback)
+  -> void
+{
+    live_callback = std::move(callback);
+}
+
+auto EventHandler::watchFileDescriptor(const int fd, std::function<void()> handler) -> void
 {
-    struct pollfd pfd = { .fd = libinput_get_fd(li.get()), .events = POLLIN, .revents = 0 };
+    addEventSource(fd, EventSource::external, static_cast<std::uint32_t>(external_handlers.size()));
+    external_handlers.push_back(std::move(handler));
+}
 
-    const int result = poll(&pfd, 1, POLL_TIMEOUT_MS);
+auto EventHandler::setDimensionsCallback(std::function<void(DimensionMatrix)> callback) -> void
+{
+    dimensions_callback = std::move(callback);
+    dimensions.emplace(day_clock.today());
+}
 
-    if (result < 0) {
-        getLogger()->error("Poll failed with error: {}", std::strerror(errno));
+auto EventHandler::setRhythmCallback(std::function<void(RhythmStats)> callback) -> void
+{
+    rhythm_callback = std::move(callback);
+    rhythm.emplace(day_clock.today());
+}
+
+auto EventHandler::setDeferred(const bool deferred) -> void
+{
+    policy.setDeferred(deferred);
+
+    if (buffer_size == 0) {
         return;
     }
 
-    if (result > 0 && POLLIN & pfd.revents) {
-        libinput_dispatch(li.get());
+    if (shouldFlush()) {
+        flushBuffer();
+        return;
+    }
 
-        // Process all available events
-        struct libinput_event *event = nullptr;
-        while ((event = libinput_get_event(li.get())) != nullptr) {
-            if (libinput_event_get_type(event) == LIBINPUT_EVENT_KEYBOARD_KEY) {
-                if (const auto keystroke = processKeyboardEvent(event)) {
-                    buffer.push_back(*keystroke);
-                }
+    // The flush timer was armed with the previous bound, it counts from the oldest keystroke
+    const auto remaining = std::chrono::ceil<std::chrono::seconds>(
+      policy.maxLatency() - (Clock::now() - first_event_time));
+    armTimer(flush_timer_fd.get(), std::max(remaining, std::chrono::seconds{ 1 }));
+}
+
+auto EventHandler::setDiskActivityProbe(std::function<bool(bool count_writes)> probe) -> void
+{
+    disk_probe = std::move(probe);
+}
+
+auto EventHandler::flush(const Clock::duration timeout) -> bool
+{
+    if (buffer_size > 0) {
+        getLogger().debug("Flushing buffer: requested ({} events)", buffer_size);
+    }
+
+    // A writer that is catching up frees a ring slot soon
+    const auto deadline = Clock::now() + timeout;
+    while (!flushBuffer()) {
+        if (Clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(WAITING_FLUSH_RETRY_DELAY);
+    }
+
+    // Flushes are confirmed in order, each one wakes the commit eventfd
+    while (confirmed_flushes.load(std::memory_order_acquire) < accepted_flushes) {
+        const auto remaining
+          = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+        if (remaining.count() <= 0) {
+            return false;
+        }
+
+        struct pollfd committed{ .fd = committed_fd.get(), .events = POLLIN, .revents = 0 };
+        if (::poll(&committed, 1, static_cast<int>(remaining.count())) > 0) {
+            drainFileDescriptor(committed_fd.get());
+        }
+    }
+
+    releaseSpill();
+    return true;
+}
+
+auto EventHandler::setStatsCallback(std::function<void()> callback) -> void
+{
+    stats_callback = std::move(callback);
+}
+
+auto EventHandler::setSpillFile(SpillFile *const file) -> void
+{
+    spill_file = file;
+}
+
+auto EventHandler::confirmFlush() -> void
+{
+    confirmed_flushes.fetch_add(1, std::memory_order_release);
+
+    // Wakes the loop, which owns the spill file
+    const std::uint64_t value{ 1 };
+    [[maybe_unused]] const auto written = ::write(committed_fd.get(), &value, sizeof(value));
+}
+
+auto EventHandler::releaseSpill() -> void
+{
+    if (spill_file == nullptr) {
+        return;
+    }
+
+    // Batches are committed in the order they were flushed
+    const std::uint64_t confirmed = confirmed_flushes.load(std::memory_order_acquire);
+    while (released_flushes < confirmed && !unconfirmed_spills.empty()) {
+        spill_file->release(unconfirmed_spills.front());
+        unconfirmed_spills.pop_front();
+        ++released_flushes;
+    }
+}
+
+auto EventHandler::setMaintenanceCallback(std::function<void()> callback,
+                                          const std::chrono::seconds delay) -> void
+{
+    maintenance_callback = std::move(callback);
+    maintenance_delay = delay;
+}
+
+auto EventHandler::scheduleMaintenance(const std::chrono::seconds delay) -> void
+{
+    armTimer(maintenance_timer_fd.get(), delay);
+    maintenance_pending = true;
+}
+
+auto EventHandler::run() -> void
+{
+    getLogger().info("Starting event loop");
+
+    std::array<struct epoll_event, MAX_EPOLL_EVENTS> ready_events{};
+    bool running{ true };
+    input_stats.started = Clock::now();
+
+    while (running) {
+        // Only polls without blocking while the source holds events a capped drain left behind,
+        // otherwise the loop sleeps until input, a due timer or a shutdown request
+        const int count = epoll_wait(epoll_fd.get(),
+                                     ready_events.data(),
+                                     static_cast<int>(ready_events.size()),
+                                     input_backlog ? 0 : -1);
+
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            throw SystemError(std::format("epoll_wait failed: {}", std::strerror(errno)));
+        }
+
+        bool input_dispatched{ false };
+
+        for (const auto &ready : std::span{ ready_events }.first(static_cast<std::size_t>(count))) {
+            // The lower half identifies the source, the upper half indexes external handlers
+            const auto source = static_cast<EventSource>(ready.data.u64 & UINT32_MAX);
+            const auto index = static_cast<std::size_t>(ready.data.u64 >> 32U);
+
+            switch (source) {
+                case EventSource::input:
+                    drainInputEvents();
+                    input_dispatched = true;
+                    break;
+                case EventSource::flush_timer:
+                    drainFileDescriptor(flush_timer_fd.get());
+                    getLogger().debug("Flushing buffer: time threshold reached ({}s elapsed)",
+                                      policy.maxLatency().count());
+                    flushBuffer();
+                    break;
+                case EventSource::maintenance_timer:
+                    drainFileDescriptor(maintenance_timer_fd.get());
+                    maintenance_pending = false;
+                    if (maintenance_callback) {
+                        maintenance_callback();
+                    }
+                    break;
+                case EventSource::shutdown:
+                    drainFileDescriptor(shutdown_fd.get());
+                    getLogger().info("Shutdown requested, leaving event loop");
+                    running = false;
+                    break;
+                case EventSource::committed:
+                    drainFileDescriptor(committed_fd.get());
+                    releaseSpill();
+                    break;
+                case EventSource::signal:
+                    if (handleSignal()) {
+                        running = false;
+                    }
+                    break;
+                case EventSource::external:
+                    external_handlers.at(index)();
+                    break;
+            }
+        }
+
+        // The other sources had their turn, continue with the events left from the last drain
+        if (input_backlog && !input_dispatched && running) {
+            drainInputEvents();
+        }
 
-            libinput_event_destroy(event);
+        if (input_finished && running) {
+            getLogger().info("Input source finished, leaving event loop");
+            running = false;
         }
     }
 
-    if (shouldFlush()) {
-        flushBuffer();
+    getLogger().info("Flushing {} buffered keystrokes before shutdown", buffer_size);
+
+    // Input no longer waits on the loop, so a writer that is catching up gets some time
+    const auto deadline = Clock::now() + SHUTDOWN_FLUSH_TIMEOUT;
+    while (!flushBuffer() && Clock::now() < deadline) {
+        std::this_thread::sleep_for(WAITING_FLUSH_RETRY_DELAY);
+    }
+    if (buffer_size > 0) {
+        getLogger().error("Failed to hand over {} buffered keystrokes before shutdown",
+                          buffer_size);
     }
+    closeDimensions(std::nullopt);
+    input_stats.stopped = Clock::now();
+    logInputStats();
+}
+
+auto EventHandler::stop() const -> void
+{
+    // Writing to an eventfd is async-signal-safe, so this may be called from anywhere
+    const std::uint64_t value{ 1 };
+    [[maybe_unused]] const auto written = ::write(shutdown_fd.get(), &value, sizeof(value));
+}
+
+auto EventHandler::getInputStats() const -> const InputStats &
+{
+    return input_stats;
 }
 
-auto EventHandler::checkInputGroupMembership() -> void
+auto EventHandler::getDevices() const -> const DeviceRegistry &
 {
-    getLogger()->info("Checking for 'input' group membership...");
+    return input_source->getDevices();
+}
+
+auto EventHandler::drainInputEvents() -> void
+{
+    const auto dispatch_start = Clock::now();
+
+    // Checked once per drain, so the keystroke log costs nothing when it is disabled. With it
+    // enabled the keys are collected on the stack and logged as a single message per drain.
+    spdlog::logger &logger = getLogger();
+    const bool log_keystrokes = logger.should_log(spdlog::level::debug);
+    std::array<char, KEYSTROKE_LOG_SIZE> logged_keys{};
+    std::size_t logged_size{ 0 };
+    bool logged_all{ true };
+
+    std::array<KeyPress, MAX_EVENTS_PER_DISPATCH> presses{};
+    const InputRead result = input_source->read(presses);
+    const std::size_t spilled_before = spilled_size;
+
+    const auto now = std::chrono::system_clock::now();
+    const DayNumber today = day_clock.dayOf(now);
+    const std::size_t hour = day_clock.hourOf(now);
+
+    if (dimensions && dimensions->day() != today) {
+        closeDimensions(today);
+    }
+
+    for (const auto &press : std::span{ presses }.first(result.key_presses)) {
+        // Replayed key presses carry the day they belong to
+        const DayNumber day = press.day != 0 ? press.day : today;
+        pushKeystroke({ .key_code = press.key_code, .day = day });
+
+        if (dimensions && press.device != nullptr) {
+            if (dimensions->day() != day) {
+                closeDimensions(day);
+            }
+            recordDimensions(press, hour);
+        }
+
+        if (rhythm && press.device != nullptr && press.time_usec != 0) {
+            if (rhythm->day() != day) {
+                flushRhythm(day);
+            }
+            recordRhythm(press, hour);
+        }
 
-    struct group const *const input_group = getgrnam("input");
-    if (input_group == nullptr) {
-        throw SystemError("Input group does not exist. Please create it");
+        if (log_keystrokes && logged_all) {
+            const auto room = logged_keys.size() - logged_size;
+            const auto offset = static_cast<std::ptrdiff_t>(logged_size);
+            const auto written = std::format_to_n(std::next(logged_keys.begin(), offset),
+                                                  static_cast<std::ptrdiff_t>(room),
+                                                  " {} ({})",
+                                                  getKeyName(press.key_code),
+                                                  press.key_code);
+            logged_all = static_cast<std::size_t>(written.size) <= room;
+            logged_size += std::min(static_cast<std::size_t>(written.size), room);
+        }
+    }
+
+    if (log_keystrokes && result.key_presses > 0) {
+        logger.debug("Added {} keystrokes [{}/{}] to buffer:{}{}",
+                     result.key_presses,
+                     buffer_size,
+                     policy.flushThreshold(),
+                     std::string_view{ logged_keys.data(), logged_size },
+                     logged_all ? "" : " ...");
     }
 
-    const gid_t input_gid = input_group->gr_gid;
+    input_backlog = result.backlog;
+    input_finished = result.finished;
 
-    const int ngroups = getgroups(0, nullptr);
-    std::vector<gid_t> groups(static_cast<std::size_t>(ngroups));
-    getgroups(ngroups, groups.data());
+    if (spilled_size != spilled_before) {
+        last_spill_append = dispatch_start;
+    }
+
+    publishKeystrokes();
 
-    if (!(std::ranges::find(groups, input_gid) != groups.end())) {
-        printInputGroupPermissionHelp();
-        throw PermissionError("User not in 'input' group. See instructions above");
+    if (shouldFlush() || diskWokenUp()) {
+        flushBuffer();
     }
 
-    getLogger()->info("User is a member of the 'input' group");
+    const auto dispatch_time = Clock::now() - dispatch_start;
+
+    Metrics &metrics = getMetrics();
+    addTo(metrics.events_received, result.events);
+    addTo(metrics.events_ignored, result.events - result.key_presses);
+    addTo(metrics.events_dropped, result.overruns);
+    metrics.dispatch_time.record(dispatch_time);
+
+    input_stats.events += result.events;
+    input_stats.keystrokes += result.key_presses;
+    ++input_stats.dispatches;
+    input_stats.capped_dispatches += result.events == presses.size() ? 1 : 0;
+    input_stats.total_dispatch_time += dispatch_time;
+    input_stats.max_dispatch_time = std::max(input_stats.max_dispatch_time,
+                                             std::chrono::nanoseconds{ dispatch_time });
 }
 
-auto EventHandler::printInputGroupPermissionHelp() -> void
+auto EventHandler::recordDimensions(const KeyPress &press, const std::size_t hour) -> void
 {
-    std::println(stderr, R"(
-===================== Permission Error =====================
-TypeTrace requires access to input devices to function.
+    // Registry indices map to matrix indices through a flat table, so no ID is compared here
+    const std::size_t index = press.device->index;
+    if (index >= dimension_slots.size()) {
+        dimension_slots.resize(index + 1, NO_DIMENSION_SLOT);
+    }
 
-To grant access, add your user to the 'input' group:
-    sudo usermod -a -G input $USER
+    std::size_t &slot = dimension_slots.at(index);
+    if (slot == NO_DIMENSION_SLOT) {
+        slot = dimensions->addDevice(press.device->id);
+    }
 
-Then log out and log back in for the changes to take effect.
-============================================================
-)");
+    dimensions->add(slot, hour, press.key_code);
 }
 
-auto EventHandler::checkDeviceAccessibility() const -> void
+auto EventHandler::closeDimensions(const std::optional<DayNumber> next_day) -> void
 {
-    getLogger()->info("Checking for device accessibility...");
+    if (dimensions && !dimensions->empty() && dimensions_callback) {
+        getLogger().debug("Closing dimensions of day {}", dimensions->day());
+        dimensions_callback(std::move(*dimensions));
+    }
 
-    if (li == nullptr) {
-        throw SystemError("Libinput is not initialized. Cannot check device accessibility");
+    dimensions.reset();
+    dimension_slots.clear();
+
+    if (next_day) {
+        dimensions.emplace(*next_day);
     }
+}
 
-    if (libinput_dispatch(li.get()) < 0) {
-        throw SystemError("Failed to dispatch libinput events");
+auto EventHandler::recordRhythm(const KeyPress &press, const std::size_t hour) -> void
+{
+    const std::size_t index = press.device->index;
+    if (index >= last_presses.size()) {
+        last_presses.resize(index + 1);
     }
 
-    struct libinput_event *event = libinput_get_event(li.get());
-    if ((event == nullptr) || libinput_event_get_type(event) != LIBINPUT_EVENT_DEVICE_ADDED) {
-        throw SystemError("No input devices found or not accessible");
+    // A timestamp before the previous one, e.g. after the keyboard was reopened, starts over
+    LastPress &last = last_presses.at(index);
+    if (last.time_usec != 0 && press.time_usec >= last.time_usec) {
+        rhythm->add(hour, last.key_code, press.key_code, press.time_usec - last.time_usec);
     }
 
-    getLogger()->info("Input devices are accessible");
-    libinput_event_destroy(event);
+    last = { .time_usec = press.time_usec, .key_code = press.key_code };
 }
 
-auto EventHandler::initializeLibinput() -> void
+auto EventHandler::flushRhythm(const DayNumber day) -> void
 {
-    getLogger()->info("Initializing libinput context...");
+    if (rhythm->empty() && rhythm->day() == day) {
+        return;
+    }
 
-    static const struct libinput_interface interface = {
-        .open_restricted = [](const char *const path, const int flags, void *) -> int {
-            return ::open(path, flags);
-        },
-        .close_restricted = [](const int fd, void *) -> void { ::close(fd); }
-    };
+    if (!rhythm->empty()) {
+        rhythm_callback(std::move(*rhythm));
+    }
+    rhythm.emplace(day);
+}
 
-    // Initialize udev
-    udev.reset(udev_new());
-    if (udev == nullptr) {
-        throw SystemError("Failed to initialize udev");
+auto EventHandler::logInputStats() const -> void
+{
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    using Seconds = std::chrono::duration<double>;
+
+    const auto &stats = input_stats;
+    const double elapsed
+      = std::chrono::duration_cast<Seconds>(Clock::now() - stats.started).count();
+    const auto dispatches = std::max<std::uint64_t>(stats.dispatches, 1);
+
+    getLogger().info("Input stats: {} events ({:.1f}/s), {} keystrokes, {} dispatches "
+                     "(avg {:.1f}us, max {:.1f}us), {} capped",
+                     stats.events,
+                     elapsed > 0 ? static_cast<double>(stats.events) / elapsed : 0.0,
+                     stats.keystrokes,
+                     stats.dispatches,
+                     std::chrono::duration_cast<Microseconds>(stats.total_dispatch_time).count()
+                       / static_cast<double>(dispatches),
+                     std::chrono::duration_cast<Microseconds>(stats.max_dispatch_time).count(),
+                     stats.capped_dispatches);
+
+    if (stats.flush_latency.count() > 0) {
+        getLogger().info(
+          "Flush stats: {} flushes, p50 {:.1f}us, p99 {:.1f}us, max {:.1f}us",
+          stats.flush_latency.count(),
+          std::chrono::duration_cast<Microseconds>(stats.flush_latency.percentile(0.5)).count(),
+          std::chrono::duration_cast<Microseconds>(stats.flush_latency.percentile(0.99)).count(),
+          std::chrono::duration_cast<Microseconds>(stats.flush_latency.max()).count());
     }
 
-    // Initialize libinput
-    li.reset(libinput_udev_create_context(&interface, nullptr, udev.get()));
-    if (li == nullptr) {
-        throw SystemError("Failed to initialize libinput from udev");
+    std::map<std::string_view, std::uint64_t> seat_key_presses;
+
+    for (const auto &[id, device] : getDevices().devices()) {
+        getLogger().info("Keyboard {}: {} events, {} key presses{}",
+                         id,
+                         device.events,
+                         device.key_presses,
+                         device.attached > 0 ? "" : " (detached)");
+        seat_key_presses[device.seat] += device.key_presses;
     }
 
-    // Assign seat0
-    if (libinput_udev_assign_seat(li.get(), "seat0") < 0) {
-        throw SystemError("Failed to assign seat to libinput");
+    if (seat_key_presses.size() > 1) {
+        for (const auto &[seat, key_presses] : seat_key_presses) {
+            getLogger().info("Seat {}: {} key presses", seat, key_presses);
+        }
     }
+}
 
-    getLogger()->info("Libinput initialized successfully");
+auto EventHandler::initializeEventLoop() -> void
+{
+    getLogger().info("Initializing event loop...");
+
+    epoll_fd.reset(epoll_create1(EPOLL_CLOEXEC));
+    if (!epoll_fd) {
+        throw SystemError(std::format("Failed to create epoll instance: {}", std::strerror(errno)));
+    }
+
+    flush_timer_fd.reset(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (!flush_timer_fd) {
+        throw SystemError(std::format("Failed to create flush timer: {}", std::strerror(errno)));
+    }
+
+    maintenance_timer_fd.reset(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (!maintenance_timer_fd) {
+        throw SystemError(
+          std::format("Failed to create maintenance timer: {}", std::strerror(errno)));
+    }
+
+    shutdown_fd.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    if (!shutdown_fd) {
+        throw SystemError(std::format("Failed to create shutdown event: {}", std::strerror(errno)));
+    }
+
+    committed_fd.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    if (!committed_fd) {
+        throw SystemError(std::format("Failed to create commit event: {}", std::strerror(errno)));
+    }
+
+    // Deliver termination signals through the loop instead of interrupting it, so the buffer
+    // can still be flushed. A no-op if the signals were blocked before threads were started.
+    const sigset_t signals = blockLoopSignals();
+
+    signal_fd.reset(signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC));
+    if (!signal_fd) {
+        throw SystemError(std::format("Failed to create signalfd: {}", std::strerror(errno)));
+    }
+
+    addEventSource(input_source->fd(), EventSource::input);
+    addEventSource(flush_timer_fd.get(), EventSource::flush_timer);
+    addEventSource(maintenance_timer_fd.get(), EventSource::maintenance_timer);
+    addEventSource(shutdown_fd.get(), EventSource::shutdown);
+    addEventSource(committed_fd.get(), EventSource::committed);
+    addEventSource(signal_fd.get(), EventSource::signal);
+
+    getLogger().info("Event loop initialized successfully");
 }
 
-auto EventHandler::processKeyboardEvent(struct libinput_event *const event)
-  -> std::optional<KeystrokeEvent>
+auto EventHandler::addEventSource(const int fd,
+                                  const EventSource source,
+                                  const std::uint32_t index) const -> void
 {
-    auto *keyboard_event = libinput_event_get_keyboard_event(event);
-    if (keyboard_event == nullptr) {
-        getLogger()->warn("Failed to get keyboard event from libinput event");
-        return std::nullopt;
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64
+      = (static_cast<std::uint64_t>(index) << 32U) | static_cast<std::uint64_t>(source);
+
+    if (epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, fd, &event) < 0) {
+        throw SystemError(
+          std::format("Failed to add file descriptor to epoll: {}", std::strerror(errno)));
     }
+}
+
+auto EventHandler::armFlushTimer(const bool armed) const -> void
+{
+    armTimer(flush_timer_fd.get(), armed ? policy.maxLatency() : std::chrono::seconds{ 0 });
+}
 
-    // Ignore releases, only process key presses
-    if (libinput_event_keyboard_get_key_state(keyboard_event) != LIBINPUT_KEY_STATE_PRESSED) {
-        return std::nullopt;
+auto EventHandler::armTimer(const int fd, const std::chrono::seconds delay) -> void
+{
+    // A zero expiration disarms the timer
+    struct itimerspec spec{};
+    spec.it_value.tv_sec = static_cast<time_t>(delay.count());
+
+    if (timerfd_settime(fd, 0, &spec, nullptr) < 0) {
+        getLogger().error("Failed to set timer: {}", std::strerror(errno));
     }
+}
 
-    const auto key_code = libinput_event_keyboard_get_key(keyboard_event);
-    const char *const raw_name = libevdev_event_code_get_name(EV_KEY, key_code);
-    const auto time_now = std::chrono::system_clock::now();
+auto EventHandler::drainFileDescriptor(const int fd) -> void
+{
+    // Both timerfd and eventfd hand out a single 8 byte counter
+    std::uint64_t value{ 0 };
+    [[maybe_unused]] const auto bytes_read = ::read(fd, &value, sizeof(value));
+}
 
-    KeystrokeEvent keystroke{
-        .key_code = key_code,
-        .key_name = (raw_name != nullptr) ? raw_name : "UNKNOWN",
-        .date = std::format("{:%Y-%m-%d}",
-                            std::chrono::zoned_time{ std::chrono::current_zone(), time_now }),
-    };
+auto EventHandler::handleSignal() const -> bool
+{
+    struct signalfd_siginfo info{};
+    if (::read(signal_fd.get(), &info, sizeof(info)) != sizeof(info)) {
+        getLogger().warn("Failed to read signal: {}", std::strerror(errno));
+        return true;
+    }
+
+    if (info.ssi_signo == SIGUSR1) {
+        if (stats_callback) {
+            stats_callback();
+        } else {
+            logInputStats();
+        }
+        return false;
+    }
+
+    getLogger().info("Received signal {} ({}), leaving event loop",
+                     info.ssi_signo,
+                     strsignal(static_cast<int>(info.ssi_signo)));
+    return true;
+}
+
+auto EventHandler::pushKeystroke(const KeystrokeEvent &keystroke) -> void
+{
+    if (buffer_size == buffer.size()) {
+        getLogger().debug("Flushing buffer: buffer is full ({} events)", buffer_size);
+        if (!flushBuffer()) {
+            // The writer has fallen behind by a whole ring and this buffer, nothing can hold it
+            addTo(getMetrics().events_dropped, 1);
+            return;
+        }
+    }
+
+    // The time threshold counts from the oldest buffered keystroke
+    if (buffer_size == 0) {
+        first_event_time = Clock::now();
+        armFlushTimer(true);
+    }
 
-    getLogger()->debug("Added keystroke [{}/{}] to buffer: {} (code: {})",
-                       buffer.size() + 1,
-                       BUFFER_SIZE,
-                       keystroke.key_name.data(),
-                       key_code);
+    buffer.at(buffer_size) = keystroke;
+    ++buffer_size;
 
-    return keystroke;
+    if (spill_file != nullptr) {
+        if (spill_file->append(keystroke)) {
+            ++spilled_size;
+        } else {
+            addTo(getMetrics().events_dropped, 1);
+            getLogger().warn("Spill file is full, keystroke is only kept in memory");
+        }
+    }
 }
 
 auto EventHandler::shouldFlush() const -> bool
 {
-    if (buffer.size() >= BUFFER_SIZE) {
-        getLogger()->debug("Flushing buffer: size threshold reached ({} events)", buffer.size());
+    if (buffer_size >= policy.flushThreshold()) {
+        getLogger().debug("Flushing buffer: size threshold reached ({} events)", buffer_size);
         return true;
     }
 
-    if (!buffer.empty()) {
-        const auto elapsed_duration = Clock::now() - last_flush_time;
+    if (buffer_size > 0) {
+        const auto elapsed_duration = Clock::now() - first_event_time;
 
-        if (elapsed_duration >= std::chrono::seconds(BUFFER_TIMEOUT)) {
-            getLogger()->debug("Flushing buffer: time threshold reached ({}s elapsed)",
-                               BUFFER_TIMEOUT);
+        if (elapsed_duration >= policy.maxLatency()) {
+            getLogger().debug("Flushing buffer: time threshold reached ({}s elapsed)",
+                              policy.maxLatency().count());
             return true;
         }
     }
@@ -211,24 +670,105 @@ auto EventHandler::shouldFlush() const -> bool
     return false;
 }
 
-auto EventHandler::flushBuffer() -> void
+auto EventHandler::diskWokenUp() -> bool
 {
-    if (buffer.empty()) {
-        return;
+    if (!disk_probe || !policy.isDeferred() || buffer_size == 0) {
+        return false;
+    }
+
+    const auto now = Clock::now();
+    if (now < next_disk_probe) {
+        return false;
+    }
+    next_disk_probe = now + DISK_PROBE_INTERVAL;
+
+    // The kernel writes back the spill file's dirty pages on its own schedule, those writes
+    // can't be told apart from others on the device counters
+    const bool spill_dirty = spill_file != nullptr && now < last_spill_append + DISK_SETTLE_TIME;
+    const bool active = disk_probe(!spill_dirty);
+    if (!disk_baseline) {
+        disk_baseline = true;
+        return false;
+    }
+
+    if (active) {
+        getLogger().debug("Flushing buffer: the disk is awake ({} events)", buffer_size);
     }
+    return active;
+}
+
+auto EventHandler::publishKeystrokes() -> void
+{
+    if (live_callback && published_size < buffer_size) {
+        live_callback(std::span{ buffer }.subspan(published_size, buffer_size - published_size));
+    }
+
+    published_size = buffer_size;
+}
+
+auto EventHandler::flushBuffer() -> bool
+{
+    if (buffer_size == 0) {
+        return true;
+    }
+
+    // Keystrokes flushed mid-dispatch must not be skipped by the live callback
+    publishKeystrokes();
+
+    const auto fill_duration = Clock::now() - first_event_time;
 
     if (buffer_callback) {
-        const auto elapsed_seconds = std::chrono::duration_cast<std::chrono::duration<double>>(
-                                       Clock::now() - last_flush_time)
-                                       .count();
-        getLogger()->debug(
-          "Flushing buffer with {} events in {:.2f}s to database", buffer.size(), elapsed_seconds);
+        const auto elapsed_seconds
+          = std::chrono::duration_cast<std::chrono::duration<double>>(fill_duration).count();
+        getLogger().debug(
+          "Flushing buffer with {} events in {:.2f}s to database", buffer_size, elapsed_seconds);
+
+        const auto callback_start = Clock::now();
+        const bool accepted = buffer_callback(std::span{ buffer }.first(buffer_size));
+        input_stats.flush_latency.record(Clock::now() - callback_start);
+
+        // Keep buffering, new input or the timer tries again
+        if (!accepted) {
+            armTimer(flush_timer_fd.get(), FLUSH_RETRY_DELAY);
+            return false;
+        }
+        ++accepted_flushes;
+    }
+
+    // The intervals travel with the keystrokes they were measured on
+    if (rhythm) {
+        flushRhythm(rhythm->day());
+    }
+
+    Metrics &metrics = getMetrics();
+    addTo(metrics.flushes, 1);
+    addTo(metrics.flushed_keystrokes, buffer_size);
+    raiseTo(metrics.max_flush_size, buffer_size);
+
+    policy.onFlush(buffer_size, fill_duration);
+
+    // The spilled keystrokes are only forgotten once the database has committed them
+    if (spill_file != nullptr) {
+        unconfirmed_spills.push_back(spilled_size);
+        spilled_size = 0;
+        releaseSpill();
+    }
+
+    buffer_size = 0;
+    published_size = 0;
+    armFlushTimer(false);
+
+    // The pages this flush and its maintenance dirty are written back later by the kernel
+    next_disk_probe = Clock::now() + maintenance_delay + DISK_SETTLE_TIME;
+    disk_baseline = false;
 
-        buffer_callback(buffer);
+    // Schedule maintenance once per write burst, it never fires while nothing is written
+    if (maintenance_callback && !maintenance_pending) {
+        armTimer(maintenance_timer_fd.get(), maintenance_delay);
+        maintenance_pending = true;
     }
 
-    buffer.clear();
-    last_flush_time = Clock::now();
+    return true;
 }
 
 } // namespace typetrace::backend
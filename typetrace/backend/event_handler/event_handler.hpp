@@ -1,70 +1,299 @@
 #ifndef TYPETRACE_EVENTHANDLER_HPP
 #define TYPETRACE_EVENTHANDLER_HPP
 
+#include "buffer_policy.hpp"
+#include "config.hpp"
+#include "constants.hpp"
+#include "day_clock.hpp"
+#include "device_registry.hpp"
+#include "dimension_matrix.hpp"
+#include "file_descriptor.hpp"
+#include "input_source.hpp"
+#include "latency_histogram.hpp"
+#include "rhythm_stats.hpp"
+#include "spill_file.hpp"
 #include "types.hpp"
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <libinput.h>
-#include <libudev.h>
 #include <memory>
 #include <optional>
+#include <span>
+#include <utility>
 #include <vector>
 
 namespace typetrace::backend {
 
 using Clock = std::chrono::steady_clock;
 
+/// Counters of the input path, for checking its cost
+struct InputStats
+{
+    std::uint64_t events{ 0 };            ///< Events read from the input source
+    std::uint64_t keystrokes{ 0 };        ///< Key presses added to the buffer
+    std::uint64_t dispatches{ 0 };        ///< Runs of the drain loop
+    std::uint64_t capped_dispatches{ 0 }; ///< Drains that stopped at the per-dispatch cap
+    std::chrono::nanoseconds total_dispatch_time{ 0 }; ///< Time spent draining events
+    std::chrono::nanoseconds max_dispatch_time{ 0 };   ///< Longest single drain
+    LatencyHistogram flush_latency; ///< Time the buffer callback took per flush
+    Clock::time_point started;      ///< Start of the event loop
+    Clock::time_point stopped;      ///< Return of the event loop, after the final flush
+};
+
 class EventHandler
 {
   public:
-    /// Constructs an event handler and initializes libinput and device access
-    EventHandler()
+    /// Constructs an event handler that buffers the key presses of `source`
+    EventHandler(const BufferSettings &buffer_settings, std::unique_ptr<InputSource> source)
+      : policy(buffer_settings), input_source(std::move(source))
     {
-        initializeLibinput();
-        checkInputGroupMembership();
-        checkDeviceAccessibility();
-
-        last_flush_time = Clock::now();
+        initializeEventLoop();
     };
 
-    /// Sets the callback function to be called when the buffer needs to be flushed
-    auto setBufferCallback(std::function<void(const std::vector<KeystrokeEvent> &)> callback)
+    /// Blocks the signals the event loop handles for the calling thread and returns them.
+    /// Threads only inherit the mask if they are started afterwards, so this must run before
+    /// the first thread of the process (e.g. the async logger's) is created.
+    static auto blockLoopSignals() -> sigset_t;
+
+    /// Sets the callback function to be called when the buffer needs to be flushed. The span
+    /// points into the buffer and is only valid during the call, the buffer is reused after it.
+    /// If the callback returns false the keystrokes stay buffered and are handed over again with
+    /// the next flush, key presses that find the buffer full in the meantime are dropped.
+    auto setBufferCallback(std::function<bool(std::span<const KeystrokeEvent>)> callback) -> void;
+
+    /// Sets a callback that sees new keystrokes as soon as they are buffered, at least once per
+    /// input dispatch. The span points into the buffer and is only valid during the call.
+    auto setLiveCallback(std::function<void(std::span<const KeystrokeEvent>)> callback) -> void;
+
+    /// Calls `handler` on the event loop whenever `fd` becomes readable.
+    /// The file descriptor must stay open while the event loop runs.
+    auto watchFileDescriptor(int fd, std::function<void()> handler) -> void;
+
+    /// Counts keystrokes per keyboard and hour and hands each day's counts to `callback` when
+    /// the day closes, and the counts so far when the event loop returns
+    auto setDimensionsCallback(std::function<void(DimensionMatrix)> callback) -> void;
+
+    /// Measures the interval before every key press of a known keyboard and counts the pairs
+    /// of keys typed in a row. What was gathered is handed to `callback` with every flush and
+    /// when the day changes. Key presses without a timestamp, like replayed ones, are skipped.
+    auto setRhythmCallback(std::function<void(RhythmStats)> callback) -> void;
+
+    /// Mirrors buffered keystrokes to a spill file until `confirmFlush()` reports them committed.
+    /// The spill file must outlive the event handler.
+    auto setSpillFile(SpillFile *file) -> void;
+
+    /// Reports that the oldest flush the buffer callback accepted and that was not confirmed yet
+    /// is committed to the database, or was given up for good, so its keystrokes can leave the
+    /// spill file. Safe to call from other threads and from within the buffer callback.
+    auto confirmFlush() -> void;
+
+    /// Releases the spilled keystrokes of confirmed flushes. The event loop does this by itself,
+    /// once it returned call this after the last flushes are committed (event loop thread only).
+    auto releaseSpill() -> void;
+
+    /// Sets a callback that runs on the event loop `delay` after the first flush following the
+    /// previous run, so maintenance like WAL checkpoints happens off the flush path
+    auto setMaintenanceCallback(std::function<void()> callback, std::chrono::seconds delay)
       -> void;
 
-    /// Traces keyboard events and processes them into keystroke events
-    auto trace() -> void;
+    /// Runs the maintenance callback again after `delay`, e.g. from within the callback to go on
+    /// with work it left for later (event loop thread only)
+    auto scheduleMaintenance(std::chrono::seconds delay) -> void;
+
+    /// Starts or stops deferring writes, see `BufferPolicy`. A keystroke buffered before the
+    /// switch is written within the latency bound of the new policy.
+    auto setDeferred(bool deferred) -> void;
+
+    /// Sets a probe that returns true if the disk did I/O since its previous call, writes only
+    /// count if its argument is true. While writes are deferred it is asked during input at most
+    /// every `DISK_PROBE_INTERVAL`, and the buffer is flushed along with I/O that is not the
+    /// backend's own.
+    auto setDiskActivityProbe(std::function<bool(bool count_writes)> probe) -> void;
+
+    /// Flushes the buffer right away and waits at most `timeout` until this flush and all earlier
+    /// ones are confirmed, e.g. before a suspend. A flush the buffer callback rejects is tried
+    /// again meanwhile. Returns false if the time ran out (event loop thread only).
+    auto flush(Clock::duration timeout) -> bool;
+
+    /// Calls `callback` on the event loop whenever SIGUSR1 arrives, without it the input stats
+    /// are logged instead
+    auto setStatsCallback(std::function<void()> callback) -> void;
+
+    /// Traces keyboard events and processes them into keystroke events until `stop()` is called,
+    /// a termination signal arrives or the input source is finished. The buffer is flushed
+    /// before returning.
+    auto run() -> void;
+
+    /// Requests the event loop to return, safe to call from other threads and signal handlers
+    auto stop() const -> void;
+
+    /// Returns the counters of the input path, only meaningful on the event loop's thread
+    [[nodiscard]] auto getInputStats() const -> const InputStats &;
+
+    /// Returns the keyboards seen so far with their counters, same caveat as `getInputStats()`
+    [[nodiscard]] auto getDevices() const -> const DeviceRegistry &;
 
   private:
-    /// Checks if the current user is a member of the 'input' group
-    static auto checkInputGroupMembership() -> void;
+    /// Identifies the file descriptor that woke up the event loop
+    enum class EventSource : std::uint8_t
+    {
+        input,
+        flush_timer,
+        maintenance_timer,
+        shutdown,
+        committed,
+        signal,
+        external, ///< Registered through `watchFileDescriptor()`
+    };
+
+    /// Maximum number of ready file descriptors handled per wakeup
+    static constexpr std::size_t MAX_EPOLL_EVENTS = 8;
+
+    /// Maximum number of input events handled per wakeup, so a flood of events can't delay
+    /// timers and shutdown. The rest stays queued in the source for the next iteration.
+    static constexpr std::size_t MAX_EVENTS_PER_DISPATCH = 256;
+
+    /// Bytes of key names the debug log collects per drain, the rest is cut off
+    static constexpr std::size_t KEYSTROKE_LOG_SIZE = 512;
+
+    /// Delay before a flush the buffer callback rejected is tried again without new input
+    static constexpr std::chrono::seconds FLUSH_RETRY_DELAY{ 1 };
 
-    /// Prints help information for input group permission issues
-    static auto printInputGroupPermissionHelp() -> void;
+    /// Longest time the final flush waits for a buffer callback that keeps rejecting it
+    static constexpr std::chrono::seconds SHUTDOWN_FLUSH_TIMEOUT{ 10 };
 
-    /// Checks if input devices are accessible and functional
-    auto checkDeviceAccessibility() const -> void;
+    /// Pause between two attempts of a flush that waits for the buffer callback to accept it
+    static constexpr std::chrono::milliseconds WAITING_FLUSH_RETRY_DELAY{ 50 };
 
-    /// Initializes libinput context and assigns seat
-    auto initializeLibinput() -> void;
+    /// Shortest time between two disk activity probes
+    static constexpr std::chrono::seconds DISK_PROBE_INTERVAL{ 15 };
 
-    /// Processes a libinput keyboard event into a keystroke event
-    [[nodiscard]] auto processKeyboardEvent(struct libinput_event *event)
-      -> std::optional<KeystrokeEvent>;
+    /// Time after the maintenance following a flush until the kernel has written back the pages
+    /// the backend dirtied, disk activity until then may be the backend's own. The kernel
+    /// writes dirty pages back after 30 seconds by default.
+    static constexpr std::chrono::seconds DISK_SETTLE_TIME{ 60 };
 
-    /// Determines if the buffer should be flushed based on size and time
+    /// Creates the epoll instance with the input, flush timer, shutdown and signal sources.
+    /// Termination signals are blocked for the calling thread, see `blockLoopSignals()`.
+    auto initializeEventLoop() -> void;
+
+    /// Registers a file descriptor with the epoll instance, `index` identifies external sources
+    auto addEventSource(int fd, EventSource source, std::uint32_t index = 0) const -> void;
+
+    /// Arms the flush timer to fire after the policy's maximum latency, or disarms it
+    auto armFlushTimer(bool armed) const -> void;
+
+    /// Arms a one-shot timerfd to fire after `delay`, a zero delay disarms it
+    static auto armTimer(int fd, std::chrono::seconds delay) -> void;
+
+    /// Reads the pending counter of a timerfd or eventfd so it stops being readable
+    static auto drainFileDescriptor(int fd) -> void;
+
+    /// Reads a pending signal from the signalfd, returns true if it asks the loop to return
+    [[nodiscard]] auto handleSignal() const -> bool;
+
+    /// Buffers the key presses among up to `MAX_EVENTS_PER_DISPATCH` input events
+    auto drainInputEvents() -> void;
+
+    /// Counts a key press of a known keyboard in the current dimension matrix
+    auto recordDimensions(const KeyPress &press, std::size_t hour) -> void;
+
+    /// Hands the current dimension matrix to the callback and starts one for `next_day`
+    auto closeDimensions(std::optional<DayNumber> next_day) -> void;
+
+    /// Counts the interval since the previous key press on the same keyboard
+    auto recordRhythm(const KeyPress &press, std::size_t hour) -> void;
+
+    /// Hands the rhythm stats gathered so far to the callback and starts new ones for `day`
+    auto flushRhythm(DayNumber day) -> void;
+
+    /// Logs the input counters, in total and per keyboard
+    auto logInputStats() const -> void;
+
+    /// Determines if the buffer should be flushed based on the buffering policy
     [[nodiscard]] auto shouldFlush() const -> bool;
 
-    /// Flushes the current buffer by calling the buffer callback
-    auto flushBuffer() -> void;
+    /// Returns true if writes are deferred and the probe saw disk activity of someone else
+    [[nodiscard]] auto diskWokenUp() -> bool;
+
+    /// Appends a keystroke to the buffer, flushing first if the buffer is full
+    auto pushKeystroke(const KeystrokeEvent &keystroke) -> void;
+
+    /// Hands the keystrokes buffered since the previous call to the live callback
+    auto publishKeystrokes() -> void;
+
+    /// Flushes the current buffer by calling the buffer callback, returns false if the callback
+    /// rejected it and the keystrokes are still buffered
+    auto flushBuffer() -> bool;
+
+    std::array<KeystrokeEvent, MAX_BUFFER_SIZE> buffer{};
+    std::size_t buffer_size{ 0 };
+    std::size_t published_size{ 0 };
+    Clock::time_point first_event_time;
+
+    /// Set while the input source still has events queued that the last drain left for later
+    bool input_backlog{ false };
+    /// Set once the input source reported that it will not deliver another event
+    bool input_finished{ false };
+    InputStats input_stats;
+
+    BufferPolicy policy;
+
+    DayClock day_clock;
+
+    std::function<bool(std::span<const KeystrokeEvent>)> buffer_callback;
+    std::function<void(std::span<const KeystrokeEvent>)> live_callback;
+    SpillFile *spill_file{ nullptr };
+    std::size_t spilled_size{ 0 };              ///< Keystrokes of the buffer in the spill file
+    std::deque<std::size_t> unconfirmed_spills; ///< Spilled keystrokes per accepted flush
+    std::uint64_t accepted_flushes{ 0 };               ///< Flushes the buffer callback accepted
+    std::atomic<std::uint64_t> confirmed_flushes{ 0 }; ///< Written by `confirmFlush()`
+    std::uint64_t released_flushes{ 0 };
+    std::vector<std::function<void()>> external_handlers;
+    std::function<void()> stats_callback;
+
+    std::function<bool(bool)> disk_probe;
+    Clock::time_point next_disk_probe;
+    Clock::time_point last_spill_append; ///< Start of the last drain that appended to the spill
+    /// Cleared by a flush, the first probe after it only resets the probe's counters
+    bool disk_baseline{ false };
+
+    /// Marks registry indices that have no row in the current dimension matrix yet
+    static constexpr std::size_t NO_DIMENSION_SLOT = SIZE_MAX;
+
+    std::function<void(DimensionMatrix)> dimensions_callback;
+    std::optional<DimensionMatrix> dimensions;
+    std::vector<std::size_t> dimension_slots;
+
+    /// Previous key press of a keyboard, where its next interval starts
+    struct LastPress
+    {
+        std::uint64_t time_usec{ 0 };
+        std::uint16_t key_code{ 0 };
+    };
+
+    std::function<void(RhythmStats)> rhythm_callback;
+    std::optional<RhythmStats> rhythm;
+    std::vector<LastPress> last_presses; ///< Indexed by registry index
 
-    std::vector<KeystrokeEvent> buffer;
-    Clock::time_point last_flush_time;
+    std::function<void()> maintenance_callback;
+    std::chrono::seconds maintenance_delay{ 0 };
+    bool maintenance_pending{ false };
 
-    std::function<void(const std::vector<KeystrokeEvent> &)> buffer_callback;
+    FileDescriptor epoll_fd;
+    FileDescriptor flush_timer_fd;
+    FileDescriptor maintenance_timer_fd;
+    FileDescriptor shutdown_fd;
+    FileDescriptor committed_fd;
+    FileDescriptor signal_fd;
 
-    std::unique_ptr<struct libinput, decltype(&libinput_unref)> li{ nullptr, &libinput_unref };
-    std::unique_ptr<struct udev, decltype(&udev_unref)> udev{ nullptr, &udev_unref };
+    std::unique_ptr<InputSource> input_source;
 };
 
 } // namespace typetrace::backend
@@ -0,0 +1,54 @@
+#ifndef TYPETRACE_FILE_DESCRIPTOR_HPP
+#define TYPETRACE_FILE_DESCRIPTOR_HPP
+
+#include <unistd.h>
+#include <utility>
+
+namespace typetrace::backend {
+
+/// Owning wrapper around a POSIX file descriptor that closes it on destruction
+class FileDescriptor
+{
+  public:
+    FileDescriptor() = default;
+
+    /// Takes ownership of an open file descriptor (or -1 for none)
+    explicit FileDescriptor(const int descriptor) : fd(descriptor) {}
+
+    ~FileDescriptor() { reset(); }
+
+    FileDescriptor(const FileDescriptor &) = delete;
+    auto operator=(const FileDescriptor &) -> FileDescriptor & = delete;
+
+    FileDescriptor(FileDescriptor &&other) noexcept : fd(std::exchange(other.fd, -1)) {}
+
+    auto operator=(FileDescriptor &&other) noexcept -> FileDescriptor &
+    {
+        if (this != &other) {
+            reset(std::exchange(other.fd, -1));
+        }
+        return *this;
+    }
+
+    /// Returns the raw file descriptor without giving up ownership
+    [[nodiscard]] auto get() const -> int { return fd; }
+
+    /// Returns true if a file descriptor is owned
+    [[nodiscard]] explicit operator bool() const { return fd >= 0; }
+
+    /// Closes the owned file descriptor and takes ownership of a new one
+    auto reset(const int descriptor = -1) -> void
+    {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = descriptor;
+    }
+
+  private:
+    int fd{ -1 };
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,85 @@
+#include "input_source.hpp"
+
+#include "config.hpp"
+#include "evdev_source.hpp"
+#include "exceptions.hpp"
+#include "libinput_source.hpp"
+#include "logger.hpp"
+#include "replay_source.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <grp.h>
+#include <memory>
+#include <print>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// Prints help information for input group permission issues
+auto printInputGroupPermissionHelp() -> void
+{
+    std::println(stderr, R"(
+===================== Permission Error =====================
+TypeTrace requires access to input devices to function.
+
+To grant access, add your user to the 'input' group:
+    sudo usermod -a -G input $USER
+
+Then log out and log back in for the changes to take effect.
+============================================================
+)");
+}
+
+/// Checks if the current user is a member of the 'input' group
+auto checkInputGroupMembership() -> void
+{
+    getLogger().info("Checking for 'input' group membership...");
+
+    struct group const *const input_group = getgrnam("input");
+    if (input_group == nullptr) {
+        throw SystemError("Input group does not exist. Please create it");
+    }
+
+    const gid_t input_gid = input_group->gr_gid;
+
+    const int ngroups = getgroups(0, nullptr);
+    std::vector<gid_t> groups(static_cast<std::size_t>(ngroups));
+    getgroups(ngroups, groups.data());
+
+    if (!(std::ranges::find(groups, input_gid) != groups.end())) {
+        printInputGroupPermissionHelp();
+        throw PermissionError("User not in 'input' group. See instructions above");
+    }
+
+    getLogger().info("User is a member of the 'input' group");
+}
+
+} // namespace
+
+auto createInputSource(const InputSettings &settings) -> std::unique_ptr<InputSource>
+{
+    // A replay touches no device, both other backends open the device nodes directly
+    if (settings.backend == InputBackend::replay) {
+        return std::make_unique<ReplaySource>(settings);
+    }
+
+    checkInputGroupMembership();
+
+    switch (settings.backend) {
+        case InputBackend::evdev:
+            return std::make_unique<EvdevSource>(settings);
+        case InputBackend::libinput:
+        case InputBackend::replay:
+            break;
+    }
+
+    return std::make_unique<LibinputSource>(settings);
+}
+
+} // namespace typetrace::backend
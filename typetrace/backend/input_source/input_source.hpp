@@ -0,0 +1,78 @@
+#ifndef TYPETRACE_INPUT_SOURCE_HPP
+#define TYPETRACE_INPUT_SOURCE_HPP
+
+#include "config.hpp"
+#include "device_registry.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace typetrace::backend {
+
+/// A key press and the keyboard it came from
+struct KeyPress
+{
+    std::uint16_t key_code{ 0 };
+    const Device *device{ nullptr }; ///< Registry entry of the keyboard, nullptr if unknown
+    DayNumber day{ 0 }; ///< Day the key was pressed on, 0 for today. Only replays set it.
+    std::uint64_t time_usec{ 0 }; ///< Timestamp of the press from the kernel, 0 if unknown
+};
+
+/// Outcome of one read from an input source
+struct InputRead
+{
+    std::size_t events{ 0 };      ///< Raw events consumed, including the ones that were ignored
+    std::size_t key_presses{ 0 }; ///< Key presses written to the output span
+    std::size_t overruns{ 0 }; ///< Times the kernel reported lost events (`SYN_DROPPED`)
+    bool backlog{ false }; ///< Events are left that were already taken from the fd, so it may not
+                           ///< become readable again before they are read
+    bool finished{ false }; ///< The source will never deliver another event
+};
+
+/// Delivers the key presses of all keyboards to the event handler.
+///
+/// Sources register the keyboards they find in a device registry and leave the excluded ones
+/// alone, they count the events of every attached keyboard there.
+class InputSource
+{
+  public:
+    /// Creates the device registry with the allow and deny lists of the settings
+    explicit InputSource(const InputSettings &settings)
+      : registry(settings.allowed_devices, settings.denied_devices)
+    {
+    }
+
+    virtual ~InputSource() = default;
+
+    InputSource(const InputSource &) = delete;
+    auto operator=(const InputSource &) -> InputSource & = delete;
+    InputSource(InputSource &&) = delete;
+    auto operator=(InputSource &&) -> InputSource & = delete;
+
+    /// Returns the file descriptor that becomes readable when events are pending
+    [[nodiscard]] virtual auto fd() const -> int = 0;
+
+    /// Consumes at most `presses.size()` events and stores the key presses among them, every
+    /// stored key code is below `KEY_CODE_COUNT`
+    virtual auto read(std::span<KeyPress> presses) -> InputRead = 0;
+
+    /// Returns the keyboards seen so far
+    [[nodiscard]] auto getDevices() const -> const DeviceRegistry & { return registry; }
+
+  protected:
+    /// Returns the registry for sources to update
+    [[nodiscard]] auto deviceRegistry() -> DeviceRegistry & { return registry; }
+
+  private:
+    DeviceRegistry registry;
+};
+
+/// Creates the input source selected by the settings
+[[nodiscard]] auto createInputSource(const InputSettings &settings) -> std::unique_ptr<InputSource>;
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,54 @@
+#include "instance_lock.hpp"
+
+#include "exceptions.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <string>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace typetrace::backend {
+
+InstanceLock::InstanceLock(const std::filesystem::path &path)
+{
+    fd.reset(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR));
+    if (!fd) {
+        throw SystemError(std::format(
+          "Failed to open lock file '{}': {}", path.string(), std::strerror(errno)));
+    }
+
+    if (::flock(fd.get(), LOCK_EX | LOCK_NB) < 0) {
+        if (errno != EWOULDBLOCK) {
+            throw SystemError(
+              std::format("Failed to lock '{}': {}", path.string(), std::strerror(errno)));
+        }
+
+        std::string owner(32, '\0');
+        const ssize_t length = ::pread(fd.get(), owner.data(), owner.size(), 0);
+        owner.resize(static_cast<std::size_t>(std::max<ssize_t>(length, 0)));
+
+        throw SystemError(std::format(
+          "Another backend (PID {}) is already writing to this database. Serve several seats from "
+          "one backend with the 'seats' setting instead",
+          owner.empty() ? "unknown" : owner));
+    }
+
+    const std::string pid = std::to_string(::getpid());
+    if (::ftruncate(fd.get(), 0) < 0
+        || ::pwrite(fd.get(), pid.data(), pid.size(), 0) != static_cast<ssize_t>(pid.size())) {
+        getLogger().debug("Failed to write PID to lock file: {}", std::strerror(errno));
+    }
+
+    getLogger().info("Acquired instance lock: {}", path.string());
+}
+
+} // namespace typetrace::backend
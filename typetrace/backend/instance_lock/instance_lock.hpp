@@ -0,0 +1,27 @@
+#ifndef TYPETRACE_INSTANCE_LOCK_HPP
+#define TYPETRACE_INSTANCE_LOCK_HPP
+
+#include "file_descriptor.hpp"
+
+#include <filesystem>
+
+namespace typetrace::backend {
+
+/// Exclusive lock that makes the backend the only writer of a database.
+///
+/// The lock is an `flock()` on a file next to the database, held as long as the object lives.
+/// The kernel drops it when the process exits for any reason, so a crashed backend never leaves
+/// a stale lock behind. The file holds the PID of the owner for diagnostics.
+class InstanceLock
+{
+  public:
+    /// Takes the lock, throws `SystemError` if another backend already holds it
+    explicit InstanceLock(const std::filesystem::path &path);
+
+  private:
+    FileDescriptor fd;
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef TYPETRACE_LATENCY_HISTOGRAM_HPP
+#define TYPETRACE_LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace typetrace::backend {
+
+/// Fixed-size histogram of durations for percentile estimates.
+///
+/// Buckets split every power of two of nanoseconds into `SUB_BUCKETS` equal parts, so a
+/// percentile is reported with at most 1/`SUB_BUCKETS` relative error. Recording is a few
+/// integer operations and never allocates.
+///
+/// Only one thread may record at a time, but any thread may read while it does. Counters are
+/// relaxed atomics that are loaded and stored without read-modify-write instructions, so
+/// readers may see a sample in the count before it reaches its bucket.
+class LatencyHistogram
+{
+  public:
+    using Duration = std::chrono::nanoseconds;
+
+    /// Counts one sample
+    auto record(const Duration duration) -> void
+    {
+        const auto nanoseconds
+          = static_cast<std::uint64_t>(std::max<Duration::rep>(duration.count(), 0));
+        increment(buckets.at(bucketOf(nanoseconds)));
+        increment(sample_count);
+
+        if (nanoseconds > max_sample.load(std::memory_order_relaxed)) {
+            max_sample.store(nanoseconds, std::memory_order_relaxed);
+        }
+    }
+
+    /// Returns the number of recorded samples
+    [[nodiscard]] auto count() const -> std::uint64_t
+    {
+        return sample_count.load(std::memory_order_relaxed);
+    }
+
+    /// Returns the longest recorded sample
+    [[nodiscard]] auto max() const -> Duration
+    {
+        return Duration{ static_cast<Duration::rep>(max_sample.load(std::memory_order_relaxed)) };
+    }
+
+    /// Returns the upper bound of the bucket holding the `fraction` percentile, e.g. 0.99
+    [[nodiscard]] auto percentile(const double fraction) const -> Duration
+    {
+        const std::uint64_t samples = count();
+        if (samples == 0) {
+            return Duration{ 0 };
+        }
+
+        const auto rank = static_cast<std::uint64_t>(static_cast<double>(samples - 1) * fraction);
+        std::uint64_t seen{ 0 };
+
+        for (std::size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+            seen += buckets.at(bucket).load(std::memory_order_relaxed);
+            if (seen > rank) {
+                const Duration bound{ static_cast<Duration::rep>(upperBound(bucket)) };
+                return std::min(bound, max());
+            }
+        }
+        return max();
+    }
+
+  private:
+    /// Number of buckets per power of two
+    static constexpr std::size_t SUB_BUCKETS = 8;
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+
+    /// Powers of two covered, durations of 2^`POWERS` ns (about 18 minutes) and more share the
+    /// last bucket
+    static constexpr std::size_t POWERS = 40;
+
+    static constexpr std::size_t BUCKET_COUNT = (POWERS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    /// Adds one to a counter only this thread writes
+    static auto increment(std::atomic<std::uint64_t> &counter) -> void
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /// Returns the bucket of a duration in nanoseconds
+    static auto bucketOf(const std::uint64_t nanoseconds) -> std::size_t
+    {
+        // Values below `SUB_BUCKETS` get a bucket each, larger ones are split by their top bits
+        if (nanoseconds < SUB_BUCKETS) {
+            return static_cast<std::size_t>(nanoseconds);
+        }
+
+        const auto power = static_cast<unsigned>(std::bit_width(nanoseconds)) - 1;
+        const auto sub_bucket = (nanoseconds >> (power - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        const std::size_t bucket = ((power - SUB_BUCKET_BITS + 1) * SUB_BUCKETS) + sub_bucket;
+
+        return std::min(bucket, BUCKET_COUNT - 1);
+    }
+
+    /// Returns the largest duration in nanoseconds that falls into `bucket`
+    static auto upperBound(const std::size_t bucket) -> std::uint64_t
+    {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+
+        const std::size_t power = (bucket / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+        const std::size_t sub_bucket = bucket % SUB_BUCKETS;
+        const std::uint64_t width = std::uint64_t{ 1 } << (power - SUB_BUCKET_BITS);
+
+        return (std::uint64_t{ 1 } << power) + ((sub_bucket + 1) * width) - 1;
+    }
+
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<std::uint64_t> sample_count{ 0 };
+    std::atomic<std::uint64_t> max_sample{ 0 }; ///< In nanoseconds
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,270 @@
+#include "libinput_source.hpp"
+
+#include "config.hpp"
+#include "constants.hpp"
+#include "device_registry.hpp"
+#include "exceptions.hpp"
+#include "input_source.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <libinput.h>
+#include <libudev.h>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace typetrace::backend {
+
+LibinputSource::LibinputSource(const InputSettings &settings) : InputSource(settings)
+{
+    initializeLibinput(settings.seats);
+    checkDeviceAccessibility();
+}
+
+auto LibinputSource::fd() const -> int
+{
+    return epoll_fd.get();
+}
+
+auto LibinputSource::read(const std::span<KeyPress> presses) -> InputRead
+{
+    std::array<struct epoll_event, MAX_READY_SEATS> ready_events{};
+    const int count = epoll_wait(
+      epoll_fd.get(), ready_events.data(), static_cast<int>(ready_events.size()), 0);
+
+    for (const auto &ready : std::span{ ready_events }.first(
+           static_cast<std::size_t>(std::max(count, 0)))) {
+        static_cast<Seat *>(ready.data.ptr)->pending = true;
+    }
+
+    InputRead result;
+
+    for (std::size_t offset = 0; offset < seats.size() && result.events < presses.size();
+         ++offset) {
+        Seat &seat = *seats.at((next_seat + offset) % seats.size());
+        if (seat.pending) {
+            readSeat(seat, presses, result);
+        }
+    }
+    next_seat = (next_seat + 1) % seats.size();
+
+    // libinput has already read the fds, the rest of their queues would otherwise wait for input
+    result.backlog = std::ranges::any_of(
+      seats, [](const std::unique_ptr<Seat> &seat) -> bool { return seat->pending; });
+    return result;
+}
+
+auto LibinputSource::readSeat(Seat &seat, const std::span<KeyPress> presses, InputRead &result)
+  -> void
+{
+    libinput_dispatch(seat.li.get());
+
+    struct libinput_event *event = nullptr;
+
+    while (result.events < presses.size()
+           && (event = libinput_get_event(seat.li.get())) != nullptr) {
+        ++result.events;
+
+        const auto type = libinput_event_get_type(event);
+
+        // Only keyboards that passed the filter are enabled, so all key events belong to one
+        if (type == LIBINPUT_EVENT_KEYBOARD_KEY) {
+            auto *const keyboard_event = libinput_event_get_keyboard_event(event);
+            const auto key_code = libinput_event_keyboard_get_key(keyboard_event);
+            auto *const device = static_cast<Device *>(
+              libinput_device_get_user_data(libinput_event_get_device(event)));
+
+            if (device != nullptr) {
+                ++device->events;
+            }
+
+            // Ignore releases, only process key presses
+            if (libinput_event_keyboard_get_key_state(keyboard_event) == LIBINPUT_KEY_STATE_PRESSED
+                && key_code < KEY_CODE_COUNT) {
+                presses[result.key_presses++] = {
+                    .key_code = static_cast<std::uint16_t>(key_code),
+                    .device = device,
+                    .time_usec = libinput_event_keyboard_get_time_usec(keyboard_event),
+                };
+
+                if (device != nullptr) {
+                    ++device->key_presses;
+                }
+            }
+        } else if (type == LIBINPUT_EVENT_DEVICE_ADDED || type == LIBINPUT_EVENT_DEVICE_REMOVED) {
+            handleDeviceEvent(event);
+        }
+
+        libinput_event_destroy(event);
+    }
+
+    // A full span may have left events in the queue, they are read before waiting again
+    seat.pending = result.events == presses.size();
+
+    result.overruns += seat.overruns;
+    seat.overruns = 0;
+}
+
+auto LibinputSource::handleLog(struct libinput *const li,
+                               const enum libinput_log_priority priority,
+                               const char *const format,
+                               va_list args) -> void
+{
+    std::array<char, MAX_LOG_MESSAGE_SIZE> buffer{};
+    // NOLINTNEXTLINE(clang-diagnostic-format-nonliteral)
+    const int size = std::vsnprintf(buffer.data(), buffer.size(), format, args);
+    if (size < 0) {
+        return;
+    }
+
+    std::string_view message{ buffer.data(),
+                              std::min(static_cast<std::size_t>(size), buffer.size() - 1) };
+    if (message.ends_with('\n')) {
+        message.remove_suffix(1);
+    }
+
+    if (message.contains("SYN_DROPPED")) {
+        ++static_cast<Seat *>(libinput_get_user_data(li))->overruns;
+    }
+
+    if (priority == LIBINPUT_LOG_PRIORITY_ERROR) {
+        getLogger().warn("libinput: {}", message);
+    } else {
+        getLogger().debug("libinput: {}", message);
+    }
+}
+
+auto LibinputSource::initializeLibinput(const std::vector<std::string> &seat_names) -> void
+{
+    getLogger().info("Initializing libinput context...");
+
+    static const struct libinput_interface interface = {
+        .open_restricted = [](const char *const path, const int flags, void *) -> int {
+            return ::open(path, flags);
+        },
+        .close_restricted = [](const int fd, void *) -> void { ::close(fd); }
+    };
+
+    // Initialize udev
+    udev.reset(udev_new());
+    if (udev == nullptr) {
+        throw SystemError("Failed to initialize udev");
+    }
+
+    epoll_fd.reset(epoll_create1(EPOLL_CLOEXEC));
+    if (!epoll_fd) {
+        throw SystemError(std::format("Failed to create epoll instance: {}", std::strerror(errno)));
+    }
+
+    // One context per seat, they share the udev handle
+    for (const std::string &name : seat_names) {
+        auto seat = std::make_unique<Seat>();
+        seat->name = name;
+
+        seat->li.reset(libinput_udev_create_context(&interface, seat.get(), udev.get()));
+        if (seat->li == nullptr) {
+            throw SystemError("Failed to initialize libinput from udev");
+        }
+
+        // Lost events are reported at info priority, the default only passes errors
+        libinput_log_set_handler(seat->li.get(), &LibinputSource::handleLog);
+        libinput_log_set_priority(seat->li.get(), LIBINPUT_LOG_PRIORITY_INFO);
+
+        if (libinput_udev_assign_seat(seat->li.get(), name.c_str()) < 0) {
+            throw SystemError(std::format("Failed to assign seat {} to libinput", name));
+        }
+
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = seat.get();
+        if (epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, libinput_get_fd(seat->li.get()), &event) < 0) {
+            throw SystemError(
+              std::format("Failed to watch libinput on {}: {}", name, std::strerror(errno)));
+        }
+
+        seats.push_back(std::move(seat));
+    }
+
+    getLogger().info("Libinput initialized successfully on {} seat(s)", seats.size());
+}
+
+auto LibinputSource::checkDeviceAccessibility() -> void
+{
+    getLogger().info("Checking for device accessibility...");
+
+    if (seats.empty()) {
+        throw SystemError("Libinput is not initialized. Cannot check device accessibility");
+    }
+
+    for (const auto &seat : seats) {
+        if (libinput_dispatch(seat->li.get()) < 0) {
+            throw SystemError(std::format("Failed to dispatch libinput events of {}", seat->name));
+        }
+
+        // Assigning the seat queues an added event per device before any input can arrive
+        struct libinput_event *event = nullptr;
+        while ((event = libinput_get_event(seat->li.get())) != nullptr) {
+            if (libinput_event_get_type(event) == LIBINPUT_EVENT_DEVICE_ADDED) {
+                handleDeviceEvent(event);
+            }
+            libinput_event_destroy(event);
+        }
+    }
+
+    if (getDevices().attachedCount() == 0) {
+        throw SystemError("No input devices found or not accessible");
+    }
+
+    getLogger().info("Input devices are accessible");
+}
+
+auto LibinputSource::handleDeviceEvent(struct libinput_event *const event) -> void
+{
+    struct libinput_device *const handle = libinput_event_get_device(event);
+
+    if (libinput_event_get_type(event) == LIBINPUT_EVENT_DEVICE_REMOVED) {
+        if (auto *const device = static_cast<Device *>(libinput_device_get_user_data(handle))) {
+            deviceRegistry().detach(*device);
+            libinput_device_set_user_data(handle, nullptr);
+        }
+        return;
+    }
+
+    Device *device = nullptr;
+    if (libinput_device_has_capability(handle, LIBINPUT_DEVICE_CAP_KEYBOARD) != 0) {
+        device = deviceRegistry().attach({
+          .name = libinput_device_get_name(handle),
+          .vendor = static_cast<std::uint16_t>(libinput_device_get_id_vendor(handle)),
+          .product = static_cast<std::uint16_t>(libinput_device_get_id_product(handle)),
+          .seat = libinput_seat_get_physical_name(libinput_device_get_seat(handle)),
+        });
+    }
+
+    if (device != nullptr) {
+        libinput_device_set_user_data(handle, device);
+        return;
+    }
+
+    // Disabled devices are closed by libinput, none of their events reach the queue
+    if (libinput_device_config_send_events_set_mode(handle, LIBINPUT_CONFIG_SEND_EVENTS_DISABLED)
+        != LIBINPUT_CONFIG_STATUS_SUCCESS) {
+        getLogger().debug("Failed to disable input device: {}", libinput_device_get_name(handle));
+    }
+}
+
+} // namespace typetrace::backend
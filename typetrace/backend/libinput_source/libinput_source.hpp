@@ -0,0 +1,88 @@
+#ifndef TYPETRACE_LIBINPUT_SOURCE_HPP
+#define TYPETRACE_LIBINPUT_SOURCE_HPP
+
+#include "config.hpp"
+#include "file_descriptor.hpp"
+#include "input_source.hpp"
+
+#include <cstdarg>
+#include <cstddef>
+#include <libinput.h>
+#include <libudev.h>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// Reads key presses through one libinput context per configured seat.
+///
+/// Devices that are not keyboards and excluded keyboards are disabled in the context as soon as
+/// they are added, so libinput stops reading them instead of queueing events that get dropped.
+/// The contexts share an epoll instance, so a single daemon reads every seat of the machine on
+/// one event loop and all of them feed the same database.
+class LibinputSource : public InputSource
+{
+  public:
+    /// Initializes libinput and checks that input devices are accessible
+    explicit LibinputSource(const InputSettings &settings);
+
+    [[nodiscard]] auto fd() const -> int override;
+
+    auto read(std::span<KeyPress> presses) -> InputRead override;
+
+  private:
+    /// Number of seats whose readiness is collected per `read()` call
+    static constexpr std::size_t MAX_READY_SEATS = 16;
+
+    /// A libinput context and the seat it is assigned to
+    struct Seat
+    {
+        std::string name;
+        std::unique_ptr<struct libinput, decltype(&libinput_unref)> li{ nullptr, &libinput_unref };
+
+        /// Events were left in the context's queue, its fd may not become readable again
+        bool pending{ false };
+
+        /// Lost events libinput reported since the last read, see `handleLog()`
+        std::size_t overruns{ 0 };
+    };
+
+    /// Longest libinput log message that is forwarded, longer ones are cut off
+    static constexpr std::size_t MAX_LOG_MESSAGE_SIZE = 256;
+
+    /// Forwards libinput's messages to the log. libinput reports the `SYN_DROPPED` of a device
+    /// only here, rate-limited, so these messages are counted as overruns of the context's seat.
+    static auto handleLog(struct libinput *li,
+                          enum libinput_log_priority priority,
+                          const char *format,
+                          va_list args) -> void;
+
+    /// Initializes a libinput context for every seat and watches their fds
+    auto initializeLibinput(const std::vector<std::string> &seat_names) -> void;
+
+    /// Registers the devices libinput added at startup, throws if no keyboard can be read
+    auto checkDeviceAccessibility() -> void;
+
+    /// Reads queued events of one seat into `presses`
+    auto readSeat(Seat &seat, std::span<KeyPress> presses, InputRead &result) -> void;
+
+    /// Updates the registry for a device added or removed event
+    auto handleDeviceEvent(struct libinput_event *event) -> void;
+
+    std::unique_ptr<struct udev, decltype(&udev_unref)> udev{ nullptr, &udev_unref };
+
+    /// Seats in configuration order, the epoll entries point to them
+    std::vector<std::unique_ptr<Seat>> seats;
+
+    /// Epoll instance over the contexts' fds, it is the fd the event loop watches
+    FileDescriptor epoll_fd;
+
+    /// Seat the next read starts at, so a busy seat can't keep the others waiting
+    std::size_t next_seat{ 0 };
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,133 @@
+#include "live_segment.hpp"
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "live_counters.hpp"
+#include "logger.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <span>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// Adds to a counter that only this thread writes, so no read-modify-write is needed
+auto increment(std::uint64_t &counter, const std::uint64_t amount) -> void
+{
+    std::atomic_ref value{ counter };
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+} // namespace
+
+LiveSegment::LiveSegment(const std::filesystem::path &path,
+                         const DayNumber today,
+                         const std::vector<KeyCount> &today_counts,
+                         const std::vector<KeyCount> &all_time_counts) :
+  file_path(path)
+{
+    getLogger().info("Publishing live counters at: {}", file_path.string());
+
+    // Readers of a previous run keep their mapping of the old file, so start from a fresh one
+    ::unlink(file_path.c_str());
+
+    fd.reset(::open(file_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR));
+    if (!fd) {
+        throw SystemError(std::format(
+          "Failed to create live counters '{}': {}", file_path.string(), std::strerror(errno)));
+    }
+
+    if (::ftruncate(fd.get(), sizeof(LiveCounters)) < 0) {
+        throw SystemError(std::format("Failed to resize live counters: {}", std::strerror(errno)));
+    }
+
+    void *const mapping
+      = ::mmap(nullptr, sizeof(LiveCounters), PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (mapping == MAP_FAILED) {
+        throw SystemError(std::format("Failed to map live counters: {}", std::strerror(errno)));
+    }
+    counters = static_cast<LiveCounters *>(mapping);
+
+    // The file starts zeroed, a zero sequence marks a segment that was never published
+    counters->version = LIVE_COUNTERS_VERSION;
+
+    // Imported or older rows may hold scan codes the segment has no counter for, they are left out
+    beginUpdate();
+    startDay(today);
+    for (const auto &[key_code, count] : today_counts) {
+        if (key_code < KEY_CODE_COUNT) {
+            increment(counters->today.at(key_code), count);
+        }
+    }
+    for (const auto &[key_code, count] : all_time_counts) {
+        if (key_code < KEY_CODE_COUNT) {
+            increment(counters->all_time.at(key_code), count);
+        }
+    }
+    endUpdate();
+
+    std::atomic_ref{ counters->magic }.store(LIVE_COUNTERS_MAGIC, std::memory_order_release);
+}
+
+LiveSegment::~LiveSegment()
+{
+    ::munmap(counters, sizeof(LiveCounters));
+    ::unlink(file_path.c_str());
+}
+
+auto LiveSegment::publish(const std::span<const KeystrokeEvent> keystrokes) -> void
+{
+    if (keystrokes.empty()) {
+        return;
+    }
+
+    beginUpdate();
+
+    for (const auto &keystroke : keystrokes) {
+        if (keystroke.day != counters->day) {
+            startDay(keystroke.day);
+        }
+
+        increment(counters->today.at(keystroke.key_code), 1);
+        increment(counters->all_time.at(keystroke.key_code), 1);
+    }
+
+    endUpdate();
+}
+
+auto LiveSegment::beginUpdate() -> void
+{
+    std::atomic_ref sequence{ counters->sequence };
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    // Keeps the counter stores below from becoming visible before the odd sequence
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+auto LiveSegment::endUpdate() -> void
+{
+    std::atomic_ref sequence{ counters->sequence };
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+auto LiveSegment::startDay(const DayNumber day) -> void
+{
+    std::atomic_ref{ counters->day }.store(day, std::memory_order_relaxed);
+    for (auto &count : counters->today) {
+        std::atomic_ref{ count }.store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,55 @@
+#ifndef TYPETRACE_LIVE_SEGMENT_HPP
+#define TYPETRACE_LIVE_SEGMENT_HPP
+
+#include "file_descriptor.hpp"
+#include "live_counters.hpp"
+#include "types.hpp"
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// Writer side of the shared-memory live counters (see `LiveCounters`).
+///
+/// Readers map the segment read-only and never call into the backend, so publishing a batch only
+/// costs a few relaxed stores plus two stores of the sequence number.
+class LiveSegment
+{
+  public:
+    /// Creates the segment at `path` and fills it with the counts already in the database
+    LiveSegment(const std::filesystem::path &path,
+                DayNumber today,
+                const std::vector<KeyCount> &today_counts,
+                const std::vector<KeyCount> &all_time_counts);
+
+    /// Unmaps and removes the segment, readers keep their mapping of the last state
+    ~LiveSegment();
+
+    LiveSegment(const LiveSegment &) = delete;
+    auto operator=(const LiveSegment &) -> LiveSegment & = delete;
+    LiveSegment(LiveSegment &&) = delete;
+    auto operator=(LiveSegment &&) -> LiveSegment & = delete;
+
+    /// Adds a flushed batch of keystrokes to the counters
+    auto publish(std::span<const KeystrokeEvent> keystrokes) -> void;
+
+  private:
+    /// Makes the counters inconsistent for readers until `endUpdate()` is called
+    auto beginUpdate() -> void;
+
+    /// Publishes all stores since `beginUpdate()` to readers
+    auto endUpdate() -> void;
+
+    /// Starts counting a new day, must be called between `beginUpdate()` and `endUpdate()`
+    auto startDay(DayNumber day) -> void;
+
+    std::filesystem::path file_path;
+    FileDescriptor fd;
+    LiveCounters *counters{ nullptr };
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -1,4 +1,5 @@
 #include "cli.hpp"
+#include "logger.hpp"
 
 #include <cstdlib>
 #include <exception>
@@ -14,4 +15,7 @@ auto main(int argc, char *argv[]) -> int
     } catch (const std::exception &e) {
         std::cerr << "Error: " << e.what() << "\n";
     }
+
+    // Queued log messages are written out before the process exits
+    typetrace::shutdownLogger();
 }
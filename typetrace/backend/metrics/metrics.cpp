@@ -0,0 +1,120 @@
+#include "metrics.hpp"
+
+#include "latency_histogram.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// Returns a duration in microseconds
+auto toMicroseconds(const std::chrono::nanoseconds duration) -> double
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+} // namespace
+
+auto getMetrics() -> Metrics &
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+auto readResidentSetSize() -> std::uint64_t
+{
+    std::ifstream statm{ "/proc/self/statm" };
+    std::uint64_t total_pages{ 0 };
+    std::uint64_t resident_pages{ 0 };
+
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+    return page_size > 0 ? resident_pages * static_cast<std::uint64_t>(page_size) : 0;
+}
+
+auto readWalSize(const std::filesystem::path &database_file) -> std::uint64_t
+{
+    std::error_code error;
+    const auto wal_size
+      = std::filesystem::file_size(std::filesystem::path{ database_file.string() + "-wal" }, error);
+    return error ? 0 : static_cast<std::uint64_t>(wal_size);
+}
+
+auto averageFlushSize() -> double
+{
+    const Metrics &metrics = getMetrics();
+    const std::uint64_t flushes = metrics.flushes.load(std::memory_order_relaxed);
+    if (flushes == 0) {
+        return 0;
+    }
+
+    return static_cast<double>(metrics.flushed_keystrokes.load(std::memory_order_relaxed))
+           / static_cast<double>(flushes);
+}
+
+auto snapshotMetrics(const std::filesystem::path &database_file) -> MetricsSnapshot
+{
+    const Metrics &metrics = getMetrics();
+    const auto load = [](const std::atomic<std::uint64_t> &counter) -> std::uint64_t {
+        return counter.load(std::memory_order_relaxed);
+    };
+
+    return MetricsSnapshot{
+        .events_received = load(metrics.events_received),
+        .events_ignored = load(metrics.events_ignored),
+        .events_dropped = load(metrics.events_dropped),
+        .dispatch_p50 = metrics.dispatch_time.percentile(0.5),
+        .dispatch_p99 = metrics.dispatch_time.percentile(0.99),
+        .dispatch_max = metrics.dispatch_time.max(),
+        .flushes = load(metrics.flushes),
+        .average_flush_size = averageFlushSize(),
+        .max_flush_size = load(metrics.max_flush_size),
+        .transactions = metrics.transaction_time.count(),
+        .failed_transactions = load(metrics.failed_transactions),
+        .transaction_p50 = metrics.transaction_time.percentile(0.5),
+        .transaction_p99 = metrics.transaction_time.percentile(0.99),
+        .transaction_max = metrics.transaction_time.max(),
+        .wal_size = readWalSize(database_file),
+        .rss = readResidentSetSize(),
+    };
+}
+
+auto formatMetrics(const MetricsSnapshot &snapshot) -> std::string
+{
+    std::string text;
+    auto out = std::back_inserter(text);
+
+    std::format_to(out, "events_received {}\n", snapshot.events_received);
+    std::format_to(out, "events_ignored {}\n", snapshot.events_ignored);
+    std::format_to(out, "events_dropped {}\n", snapshot.events_dropped);
+    std::format_to(out, "dispatch_p50_us {:.1f}\n", toMicroseconds(snapshot.dispatch_p50));
+    std::format_to(out, "dispatch_p99_us {:.1f}\n", toMicroseconds(snapshot.dispatch_p99));
+    std::format_to(out, "dispatch_max_us {:.1f}\n", toMicroseconds(snapshot.dispatch_max));
+    std::format_to(out, "flushes {}\n", snapshot.flushes);
+    std::format_to(out, "flush_size_avg {:.1f}\n", snapshot.average_flush_size);
+    std::format_to(out, "flush_size_max {}\n", snapshot.max_flush_size);
+    std::format_to(out, "transactions {}\n", snapshot.transactions);
+    std::format_to(out, "transactions_failed {}\n", snapshot.failed_transactions);
+    std::format_to(out, "transaction_p50_us {:.1f}\n", toMicroseconds(snapshot.transaction_p50));
+    std::format_to(out, "transaction_p99_us {:.1f}\n", toMicroseconds(snapshot.transaction_p99));
+    std::format_to(out, "transaction_max_us {:.1f}\n", toMicroseconds(snapshot.transaction_max));
+    std::format_to(out, "wal_bytes {}\n", snapshot.wal_size);
+    std::format_to(out, "rss_bytes {}\n", snapshot.rss);
+
+    return text;
+}
+
+} // namespace typetrace::backend
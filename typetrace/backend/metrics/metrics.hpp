@@ -0,0 +1,95 @@
+#ifndef TYPETRACE_METRICS_HPP
+#define TYPETRACE_METRICS_HPP
+
+#include "latency_histogram.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace typetrace::backend {
+
+/// Counters of the backend's hot paths, from the input source to the database commit.
+///
+/// Every counter has exactly one writing thread, the event loop or whichever thread owns the
+/// database connection, and is updated with relaxed loads and stores. Recording costs about as
+/// much as a plain increment, while the stats dump and the D-Bus properties read the counters
+/// from any thread.
+struct Metrics
+{
+    std::atomic<std::uint64_t> events_received{ 0 }; ///< Raw events read from the input source
+    std::atomic<std::uint64_t> events_ignored{ 0 };  ///< Events among them that were no key press
+    /// Kernel buffer overflows reported by the input source, and key presses that could not be
+    /// buffered or not be mirrored to the spill file. Any of them may mean lost keystrokes.
+    std::atomic<std::uint64_t> events_dropped{ 0 };
+    LatencyHistogram dispatch_time;                 ///< Time per drain of the input source
+
+    std::atomic<std::uint64_t> flushes{ 0 };            ///< Buffers handed to the write path
+    std::atomic<std::uint64_t> flushed_keystrokes{ 0 }; ///< Buffer occupancy summed over flushes
+    std::atomic<std::uint64_t> max_flush_size{ 0 };     ///< Fullest buffer at a flush
+
+    LatencyHistogram transaction_time;                   ///< Committed `writeToDatabase` calls
+    std::atomic<std::uint64_t> failed_transactions{ 0 }; ///< Rolled back `writeToDatabase` calls
+};
+
+/// Returns the metrics of the process
+[[nodiscard]] auto getMetrics() -> Metrics &;
+
+/// Adds `amount` to a counter that only the calling thread writes
+inline auto addTo(std::atomic<std::uint64_t> &counter, const std::uint64_t amount) -> void
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+/// Raises a counter that only the calling thread writes to `value` if it is below
+inline auto raiseTo(std::atomic<std::uint64_t> &counter, const std::uint64_t value) -> void
+{
+    if (value > counter.load(std::memory_order_relaxed)) {
+        counter.store(value, std::memory_order_relaxed);
+    }
+}
+
+/// Values of the metrics at one point in time, plus the sizes sampled from the system
+struct MetricsSnapshot
+{
+    std::uint64_t events_received{ 0 };
+    std::uint64_t events_ignored{ 0 };
+    std::uint64_t events_dropped{ 0 };
+    std::chrono::nanoseconds dispatch_p50{ 0 };
+    std::chrono::nanoseconds dispatch_p99{ 0 };
+    std::chrono::nanoseconds dispatch_max{ 0 };
+
+    std::uint64_t flushes{ 0 };
+    double average_flush_size{ 0 };
+    std::uint64_t max_flush_size{ 0 };
+
+    std::uint64_t transactions{ 0 };
+    std::uint64_t failed_transactions{ 0 };
+    std::chrono::nanoseconds transaction_p50{ 0 };
+    std::chrono::nanoseconds transaction_p99{ 0 };
+    std::chrono::nanoseconds transaction_max{ 0 };
+
+    std::uint64_t wal_size{ 0 }; ///< Bytes in the database's WAL file, 0 if there is none
+    std::uint64_t rss{ 0 };      ///< Resident set size of the process in bytes
+};
+
+/// Returns the resident set size from `/proc/self/statm`, 0 if it can't be read
+[[nodiscard]] auto readResidentSetSize() -> std::uint64_t;
+
+/// Returns the size of the WAL file of `database_file`, 0 if there is none
+[[nodiscard]] auto readWalSize(const std::filesystem::path &database_file) -> std::uint64_t;
+
+/// Returns the average number of keystrokes per flush, 0 before the first one
+[[nodiscard]] auto averageFlushSize() -> double;
+
+/// Reads the metrics, the WAL size of `database_file` and the resident set size
+[[nodiscard]] auto snapshotMetrics(const std::filesystem::path &database_file) -> MetricsSnapshot;
+
+/// Formats a snapshot as one `name value` line per metric, durations in microseconds
+[[nodiscard]] auto formatMetrics(const MetricsSnapshot &snapshot) -> std::string;
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,369 @@
+#include "power_monitor.hpp"
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "logger.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <system_error>
+#include <systemd/sd-bus.h>
+#include <utility>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// Throws a `SystemError` if an sd-bus call returned a negative errno
+auto check(const int result, const char *what) -> int
+{
+    if (result < 0) {
+        throw SystemError(std::format("{}: {}", what, std::strerror(-result)));
+    }
+    return result;
+}
+
+/// Returns the first word of a sysfs attribute, or an empty string if it can't be read
+auto readAttribute(const std::filesystem::path &path) -> std::string
+{
+    std::ifstream file{ path };
+    std::string value;
+    file >> value;
+    return value;
+}
+
+/// Returns true if the machine has a battery and no external power supply is online
+auto readPowerSupplies() -> bool
+{
+    bool has_battery{ false };
+    std::error_code error;
+
+    for (const auto &entry :
+         std::filesystem::directory_iterator{ "/sys/class/power_supply", error }) {
+        const std::string type = readAttribute(entry.path() / "type");
+        const bool external = type == "Mains" || type == "USB";
+
+        if (type == "Battery") {
+            has_battery = true;
+        } else if (external && readAttribute(entry.path() / "online") == "1") {
+            return false;
+        }
+    }
+
+    return has_battery;
+}
+
+} // namespace
+
+PowerMonitor::PowerMonitor(const std::filesystem::path &database_dir)
+{
+    getLogger().info("Connecting to the system bus...");
+
+    sd_bus *connection = nullptr;
+    check(sd_bus_open_system(&connection), "Failed to connect to the system bus");
+    bus.reset(connection);
+
+    sd_bus_slot *slot = nullptr;
+    check(sd_bus_match_signal(bus.get(),
+                              &slot,
+                              UPOWER_SERVICE_NAME,
+                              UPOWER_OBJECT_PATH,
+                              "org.freedesktop.DBus.Properties",
+                              "PropertiesChanged",
+                              &PowerMonitor::handlePropertiesChanged,
+                              this),
+          "Failed to subscribe to power source changes");
+    power_slot.reset(slot);
+
+    check(sd_bus_match_signal(bus.get(),
+                              &slot,
+                              LOGIND_SERVICE_NAME,
+                              LOGIND_OBJECT_PATH,
+                              LOGIND_INTERFACE_NAME,
+                              "PrepareForSleep",
+                              &PowerMonitor::handlePrepareForSleep,
+                              this),
+          "Failed to subscribe to suspends");
+    sleep_slot.reset(slot);
+
+    on_battery = readOnBattery();
+    takeSleepInhibitor();
+    bus_watch.emplace(bus.get());
+
+    // Partitions have their own counters under the device number of the file system
+    struct stat dir_stat{};
+    if (::stat(database_dir.c_str(), &dir_stat) == 0) {
+        const std::filesystem::path stat_file = std::format(
+          "/sys/dev/block/{}:{}/stat", major(dir_stat.st_dev), minor(dir_stat.st_dev));
+        std::error_code error;
+        if (std::filesystem::exists(stat_file, error)) {
+            disk_stat_file = stat_file;
+        }
+    }
+    if (disk_stat_file.empty()) {
+        getLogger().info("No I/O counters for the database's disk, flushes while on battery "
+                         "only follow the latency bound and suspends");
+    }
+
+    getLogger().info("Power monitor started, running on {}", on_battery ? "battery" : "AC power");
+}
+
+auto PowerMonitor::setPowerCallback(std::function<void(bool on_battery)> callback) -> void
+{
+    power_callback = std::move(callback);
+}
+
+auto PowerMonitor::setSleepCallback(std::function<void()> callback) -> void
+{
+    sleep_callback = std::move(callback);
+}
+
+auto PowerMonitor::onBattery() const -> bool
+{
+    return on_battery;
+}
+
+auto PowerMonitor::diskActive(const bool count_writes) -> bool
+{
+    if (disk_stat_file.empty()) {
+        return false;
+    }
+
+    // Completed reads come first and completed writes fifth, see the kernel's iostats docs
+    std::ifstream file{ disk_stat_file };
+    std::uint64_t reads{ 0 };
+    std::uint64_t writes{ 0 };
+    std::uint64_t skipped{ 0 };
+    file >> reads >> skipped >> skipped >> skipped >> writes;
+    if (!file) {
+        return false;
+    }
+
+    const bool read = std::exchange(disk_reads, reads) != reads;
+    const bool written = std::exchange(disk_writes, writes) != writes;
+    return read || (count_writes && written);
+}
+
+auto PowerMonitor::processBus() -> void
+{
+    bus_watch->process();
+}
+
+auto PowerMonitor::busFd() const -> int
+{
+    return bus_watch->fd();
+}
+
+auto PowerMonitor::handlePropertiesChanged(sd_bus_message *const message,
+                                           void *const userdata,
+                                           sd_bus_error *const /*error*/) -> int
+{
+    auto &monitor = *static_cast<PowerMonitor *>(userdata);
+
+    // Malformed signals are ignored, returning an error would only be logged by sd-bus
+    const char *interface = nullptr;
+    if (sd_bus_message_read(message, "s", &interface) < 0
+        || std::string_view{ interface } != UPOWER_INTERFACE_NAME
+        || sd_bus_message_enter_container(message, 'a', "{sv}") < 0) {
+        return 0;
+    }
+
+    while (sd_bus_message_enter_container(message, 'e', "sv") > 0) {
+        const char *name = nullptr;
+        if (sd_bus_message_read(message, "s", &name) < 0) {
+            return 0;
+        }
+
+        if (std::string_view{ name } == "OnBattery") {
+            int value{ 0 };
+            if (sd_bus_message_read(message, "v", "b", &value) < 0) {
+                return 0;
+            }
+            monitor.updateOnBattery(value != 0);
+        } else if (sd_bus_message_skip(message, "v") < 0) {
+            return 0;
+        }
+
+        if (sd_bus_message_exit_container(message) < 0) {
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+auto PowerMonitor::handlePrepareForSleep(sd_bus_message *const message,
+                                         void *const userdata,
+                                         sd_bus_error *const /*error*/) -> int
+{
+    auto &monitor = *static_cast<PowerMonitor *>(userdata);
+
+    int starting{ 0 };
+    if (sd_bus_message_read(message, "b", &starting) < 0) {
+        return 0;
+    }
+
+    if (starting == 0) {
+        // Resumed, the power source may have changed while the machine was asleep
+        getLogger().info("Resumed from suspend");
+        monitor.requestOnBattery();
+        monitor.takeSleepInhibitor();
+        return 0;
+    }
+
+    getLogger().info("Preparing for suspend");
+    if (monitor.sleep_callback) {
+        monitor.sleep_callback();
+    }
+
+    // Lets logind go ahead with the suspend
+    monitor.sleep_inhibitor.reset();
+    return 0;
+}
+
+auto PowerMonitor::readOnBattery() -> bool
+{
+    int value{ 0 };
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    const int result = sd_bus_get_property_trivial(bus.get(),
+                                                   UPOWER_SERVICE_NAME,
+                                                   UPOWER_OBJECT_PATH,
+                                                   UPOWER_INTERFACE_NAME,
+                                                   "OnBattery",
+                                                   &error,
+                                                   'b',
+                                                   &value);
+
+    if (result < 0) {
+        getLogger().warn("Failed to read the power source from UPower, reading the power "
+                         "supplies instead: {}",
+                         error.message != nullptr ? error.message : std::strerror(-result));
+        sd_bus_error_free(&error);
+        return readPowerSupplies();
+    }
+
+    return value != 0;
+}
+
+auto PowerMonitor::requestOnBattery() -> void
+{
+    const int result = sd_bus_call_method_async(bus.get(),
+                                                nullptr,
+                                                UPOWER_SERVICE_NAME,
+                                                UPOWER_OBJECT_PATH,
+                                                "org.freedesktop.DBus.Properties",
+                                                "Get",
+                                                &PowerMonitor::handleOnBatteryReply,
+                                                this,
+                                                "ss",
+                                                UPOWER_INTERFACE_NAME,
+                                                "OnBattery");
+
+    if (result < 0) {
+        getLogger().warn("Failed to ask UPower for the power source, reading the power supplies "
+                         "instead: {}",
+                         std::strerror(-result));
+        updateOnBattery(readPowerSupplies());
+    }
+}
+
+auto PowerMonitor::handleOnBatteryReply(sd_bus_message *const reply,
+                                        void *const userdata,
+                                        sd_bus_error *const /*error*/) -> int
+{
+    auto &monitor = *static_cast<PowerMonitor *>(userdata);
+
+    int value{ 0 };
+    const sd_bus_error *const reply_error = sd_bus_message_get_error(reply);
+    const int result = reply_error == nullptr ? sd_bus_message_read(reply, "v", "b", &value)
+                                              : -sd_bus_message_get_errno(reply);
+
+    if (result < 0) {
+        getLogger().warn("Failed to read the power source from UPower, reading the power "
+                         "supplies instead: {}",
+                         reply_error != nullptr && reply_error->message != nullptr
+                           ? reply_error->message
+                           : std::strerror(-result));
+        monitor.updateOnBattery(readPowerSupplies());
+        return 0;
+    }
+
+    monitor.updateOnBattery(value != 0);
+    return 0;
+}
+
+auto PowerMonitor::updateOnBattery(const bool battery) -> void
+{
+    if (battery == on_battery) {
+        return;
+    }
+
+    on_battery = battery;
+    getLogger().info("Power source changed to {}", on_battery ? "battery" : "AC power");
+
+    if (power_callback) {
+        power_callback(on_battery);
+    }
+}
+
+auto PowerMonitor::takeSleepInhibitor() -> void
+{
+    const int result = sd_bus_call_method_async(bus.get(),
+                                                nullptr,
+                                                LOGIND_SERVICE_NAME,
+                                                LOGIND_OBJECT_PATH,
+                                                LOGIND_INTERFACE_NAME,
+                                                "Inhibit",
+                                                &PowerMonitor::handleInhibitReply,
+                                                this,
+                                                "ssss",
+                                                "sleep",
+                                                "TypeTrace",
+                                                "Writing buffered keystrokes",
+                                                "delay");
+
+    if (result < 0) {
+        getLogger().warn("Failed to delay suspends, keystrokes buffered before a suspend are "
+                         "written after it: {}",
+                         std::strerror(-result));
+    }
+}
+
+auto PowerMonitor::handleInhibitReply(sd_bus_message *const reply,
+                                      void *const userdata,
+                                      sd_bus_error *const /*error*/) -> int
+{
+    auto &monitor = *static_cast<PowerMonitor *>(userdata);
+
+    // The descriptor belongs to the reply, so a duplicate is kept
+    int fd{ -1 };
+    const sd_bus_error *const reply_error = sd_bus_message_get_error(reply);
+    int result = reply_error == nullptr ? sd_bus_message_read(reply, "h", &fd)
+                                        : -sd_bus_message_get_errno(reply);
+    if (result >= 0) {
+        monitor.sleep_inhibitor.reset(::fcntl(fd, F_DUPFD_CLOEXEC, 3));
+        result = monitor.sleep_inhibitor ? result : -errno;
+    }
+
+    if (result < 0) {
+        getLogger().warn("Failed to delay suspends, keystrokes buffered before a suspend are "
+                         "written after it: {}",
+                         reply_error != nullptr && reply_error->message != nullptr
+                           ? reply_error->message
+                           : std::strerror(-result));
+    }
+    return 0;
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,114 @@
+#ifndef TYPETRACE_POWER_MONITOR_HPP
+#define TYPETRACE_POWER_MONITOR_HPP
+
+#include "bus_watch.hpp"
+#include "file_descriptor.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <systemd/sd-bus.h>
+
+namespace typetrace::backend {
+
+/// Follows the power source and suspends of the machine on the system bus.
+///
+/// The power source comes from the `OnBattery` property of UPower. Without UPower the power
+/// supplies in `/sys/class/power_supply` are read once at startup. Suspends are announced by
+/// logind's `PrepareForSleep` signal, a delay inhibitor keeps logind waiting until the sleep
+/// callback has returned, so the callback can wait for buffered keystrokes to be committed.
+/// Disk activity is read from the I/O counters of the block device holding the database.
+///
+/// The monitor does not run its own loop, its bus file descriptor is driven by the event handler.
+/// Only the power source at startup is read with a blocking call, the calls after a resume are
+/// asynchronous so they never hold up the event loop.
+class PowerMonitor
+{
+  public:
+    /// Connects to the system bus and subscribes to UPower and logind, throws `SystemError` if
+    /// the bus is not reachable. `database_dir` selects the disk `diskActive()` watches.
+    explicit PowerMonitor(const std::filesystem::path &database_dir);
+
+    PowerMonitor(const PowerMonitor &) = delete;
+    auto operator=(const PowerMonitor &) -> PowerMonitor & = delete;
+    PowerMonitor(PowerMonitor &&) = delete;
+    auto operator=(PowerMonitor &&) -> PowerMonitor & = delete;
+
+    ~PowerMonitor() = default;
+
+    /// Sets the callback that is called with the new state whenever the power source changes
+    auto setPowerCallback(std::function<void(bool on_battery)> callback) -> void;
+
+    /// Sets the callback that is called right before the machine suspends, the suspend waits
+    /// until it returns
+    auto setSleepCallback(std::function<void()> callback) -> void;
+
+    /// Returns true while the machine runs on battery
+    [[nodiscard]] auto onBattery() const -> bool;
+
+    /// Returns true if the disk holding the database did I/O since the previous call, only
+    /// reads count unless `count_writes` is set. Always false if its counters are not available
+    /// (e.g. on device mapper or btrfs volumes).
+    [[nodiscard]] auto diskActive(bool count_writes) -> bool;
+
+    /// Handles all pending bus messages and writes queued ones, to be called when the bus fd is
+    /// readable
+    auto processBus() -> void;
+
+    /// Returns the file descriptor that is readable whenever the bus connection has work to do
+    [[nodiscard]] auto busFd() const -> int;
+
+  private:
+    /// sd-bus handler of UPower's `PropertiesChanged` signal
+    static auto handlePropertiesChanged(sd_bus_message *message,
+                                        void *userdata,
+                                        sd_bus_error *error) -> int;
+
+    /// sd-bus handler of logind's `PrepareForSleep` signal
+    static auto handlePrepareForSleep(sd_bus_message *message, void *userdata, sd_bus_error *error)
+      -> int;
+
+    /// sd-bus handler of the reply to the `OnBattery` request of `requestOnBattery()`
+    static auto handleOnBatteryReply(sd_bus_message *reply, void *userdata, sd_bus_error *error)
+      -> int;
+
+    /// sd-bus handler of the reply to the `Inhibit` call of `takeSleepInhibitor()`
+    static auto handleInhibitReply(sd_bus_message *reply, void *userdata, sd_bus_error *error)
+      -> int;
+
+    /// Reads the power source from UPower, or from sysfs if UPower does not answer. Blocks until
+    /// UPower replies, so only used at startup.
+    [[nodiscard]] auto readOnBattery() -> bool;
+
+    /// Asks UPower for the power source, the reply updates it
+    auto requestOnBattery() -> void;
+
+    /// Records a new power source and calls the power callback if it changed
+    auto updateOnBattery(bool battery) -> void;
+
+    /// Asks logind for an inhibitor lock that delays the next suspend, the reply stores it
+    auto takeSleepInhibitor() -> void;
+
+    std::unique_ptr<sd_bus, decltype(&sd_bus_flush_close_unref)> bus{ nullptr,
+                                                                      &sd_bus_flush_close_unref };
+    std::unique_ptr<sd_bus_slot, decltype(&sd_bus_slot_unref)> power_slot{ nullptr,
+                                                                           &sd_bus_slot_unref };
+    std::unique_ptr<sd_bus_slot, decltype(&sd_bus_slot_unref)> sleep_slot{ nullptr,
+                                                                           &sd_bus_slot_unref };
+    std::optional<BusWatch> bus_watch;
+
+    std::function<void(bool)> power_callback;
+    std::function<void()> sleep_callback;
+    FileDescriptor sleep_inhibitor;
+    bool on_battery{ false };
+
+    std::filesystem::path disk_stat_file; ///< Empty if the disk has no I/O counters
+    std::uint64_t disk_reads{ 0 };
+    std::uint64_t disk_writes{ 0 };
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,227 @@
+#include "replay_source.hpp"
+
+#include "config.hpp"
+#include "constants.hpp"
+#include "day_clock.hpp"
+#include "device_registry.hpp"
+#include "exceptions.hpp"
+#include "input_source.hpp"
+#include "logger.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <linux/input-event-codes.h>
+#include <span>
+#include <sstream>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <vector>
+
+namespace typetrace::backend {
+
+namespace {
+
+/// Keys of the typing pattern from most to least frequent, roughly the letter frequencies of
+/// English prose. The pattern presses the key of rank `r` with a weight of 1/`r`.
+constexpr std::array<std::uint16_t, 32> TYPING_KEYS = {
+    KEY_SPACE, KEY_E, KEY_T, KEY_A, KEY_O, KEY_I, KEY_N, KEY_S, KEY_H, KEY_R, KEY_D,
+    KEY_L, KEY_C, KEY_U, KEY_M, KEY_W, KEY_F, KEY_G, KEY_Y, KEY_P, KEY_B, KEY_BACKSPACE,
+    KEY_V, KEY_K, KEY_COMMA, KEY_DOT, KEY_ENTER, KEY_LEFTSHIFT, KEY_J, KEY_X, KEY_Q, KEY_Z,
+};
+
+/// Key sequence the flood pattern repeats, a copy and paste macro
+constexpr std::array<std::uint16_t, 5> FLOOD_KEYS = {
+    KEY_LEFTCTRL, KEY_C, KEY_LEFTCTRL, KEY_V, KEY_ENTER,
+};
+
+/// Returns the Zipf weights of the typing keys
+auto zipfWeights() -> std::vector<double>
+{
+    std::vector<double> weights(TYPING_KEYS.size());
+    for (std::size_t rank = 0; rank < weights.size(); ++rank) {
+        weights.at(rank) = 1.0 / static_cast<double>(rank + 1);
+    }
+    return weights;
+}
+
+} // namespace
+
+ReplaySource::ReplaySource(const InputSettings &settings)
+  : InputSource(settings), pattern(settings.replay.pattern), days(settings.replay.days)
+{
+    getLogger().info("Initializing keystroke replay...");
+
+    const ReplaySettings &replay = settings.replay;
+
+    if (replay.trace) {
+        trace = loadTrace(*replay.trace);
+        total = trace.size();
+    } else {
+        total = replay.keystrokes;
+        const auto weights = zipfWeights();
+        zipf = std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+    }
+
+    rate = replay.rate.value_or(pattern == ReplayPattern::flood ? REPLAY_FLOOD_RATE
+                                                                : REPLAY_TYPING_RATE);
+
+    // Generated keystrokes end today, so the last day is the one the frontend shows as current
+    const DayNumber today = DayClock{}.today();
+    first_day = today - static_cast<DayNumber>(std::min<std::size_t>(days - 1, today));
+
+    device = deviceRegistry().attach({ .name = "TypeTrace replay" });
+
+    if (rate > 0) {
+        event_fd.reset(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+        if (!event_fd) {
+            throw SystemError(
+              std::format("Failed to create replay timer: {}", std::strerror(errno)));
+        }
+
+        const auto tick = std::chrono::duration_cast<std::chrono::nanoseconds>(REPLAY_TICK);
+        struct itimerspec spec{};
+        spec.it_value.tv_nsec = static_cast<long>(tick.count());
+        spec.it_interval = spec.it_value;
+
+        if (timerfd_settime(event_fd.get(), 0, &spec, nullptr) < 0) {
+            throw SystemError(std::format("Failed to set replay timer: {}", std::strerror(errno)));
+        }
+    } else {
+        // Never read, so the event loop keeps draining until the replay is finished
+        event_fd.reset(eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC));
+        if (!event_fd) {
+            throw SystemError(
+              std::format("Failed to create replay event: {}", std::strerror(errno)));
+        }
+    }
+
+    started = Clock::now();
+
+    getLogger().info("Replaying {} keystrokes over {} day(s) at {}",
+                     total,
+                     days,
+                     rate > 0 ? std::format("{}/s", rate) : std::string{ "full speed" });
+}
+
+auto ReplaySource::fd() const -> int
+{
+    return event_fd.get();
+}
+
+auto ReplaySource::read(const std::span<KeyPress> presses) -> InputRead
+{
+    if (rate > 0) {
+        std::uint64_t expirations{ 0 };
+        [[maybe_unused]] const auto bytes_read
+          = ::read(event_fd.get(), &expirations, sizeof(expirations));
+    }
+
+    const std::size_t due = dueCount();
+    const std::size_t count = std::min(due - delivered, presses.size());
+
+    for (auto &press : presses.first(count)) {
+        press = keyPressAt(delivered++);
+    }
+
+    if (device != nullptr) {
+        device->events += count;
+        device->key_presses += count;
+    }
+
+    return {
+        .events = count,
+        .key_presses = count,
+        // The timer only fires again at the next tick, the keystrokes due until then are left
+        .backlog = rate > 0 && delivered < due,
+        .finished = delivered == total,
+    };
+}
+
+auto ReplaySource::loadTrace(const std::filesystem::path &path) -> std::vector<TraceEntry>
+{
+    std::ifstream file{ path };
+    if (!file) {
+        throw ConfigurationError(std::format("Failed to open replay trace: {}", path.string()));
+    }
+
+    std::vector<TraceEntry> entries;
+    std::string line;
+    std::size_t line_number{ 0 };
+
+    while (std::getline(file, line)) {
+        ++line_number;
+
+        std::istringstream fields{ line.substr(0, line.find('#')) };
+        std::uint64_t first{ 0 };
+        if (!(fields >> first)) {
+            continue;
+        }
+
+        std::uint64_t second{ 0 };
+        const bool has_day = static_cast<bool>(fields >> second);
+        const std::uint64_t key_code = has_day ? second : first;
+        const std::uint64_t day = has_day ? first : 0;
+
+        std::string rest;
+        if (key_code >= KEY_CODE_COUNT || day > UINT32_MAX || fields >> rest) {
+            throw ConfigurationError(std::format(
+              "{}:{}: expected 'key_code' or 'day key_code'", path.string(), line_number));
+        }
+
+        entries.push_back({ .key_code = static_cast<std::uint16_t>(key_code),
+                            .day = static_cast<DayNumber>(day) });
+    }
+
+    if (entries.empty()) {
+        throw ConfigurationError(std::format("Replay trace has no keystrokes: {}", path.string()));
+    }
+
+    getLogger().info("Loaded {} keystrokes from {}", entries.size(), path.string());
+    return entries;
+}
+
+auto ReplaySource::keyPressAt(const std::size_t position) -> KeyPress
+{
+    // Days advance evenly over the replay, so it crosses midnight `days - 1` times
+    const auto spread_day = static_cast<DayNumber>(first_day + (position * days / total));
+
+    if (!trace.empty()) {
+        const TraceEntry &entry = trace.at(position);
+        return { .key_code = entry.key_code,
+                 .device = device,
+                 .day = entry.day != 0 ? entry.day : spread_day };
+    }
+
+    const std::uint16_t key_code = pattern == ReplayPattern::flood
+                                     ? FLOOD_KEYS.at(position % FLOOD_KEYS.size())
+                                     : TYPING_KEYS.at(zipf(random));
+
+    return { .key_code = key_code, .device = device, .day = spread_day };
+}
+
+auto ReplaySource::dueCount() const -> std::size_t
+{
+    if (rate == 0) {
+        return total;
+    }
+
+    const std::chrono::duration<double> elapsed = Clock::now() - started;
+    const double due = std::floor(elapsed.count() * static_cast<double>(rate));
+
+    return due >= static_cast<double>(total) ? total : static_cast<std::size_t>(due);
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,79 @@
+#ifndef TYPETRACE_REPLAY_SOURCE_HPP
+#define TYPETRACE_REPLAY_SOURCE_HPP
+
+#include "config.hpp"
+#include "device_registry.hpp"
+#include "file_descriptor.hpp"
+#include "input_source.hpp"
+#include "types.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// Feeds generated or recorded keystrokes to the event handler, for load tests.
+///
+/// The keystrokes take the same buffer, flush and write path as real ones. A rate limited
+/// replay releases the keystrokes that became due every `REPLAY_TICK` through a timerfd, an
+/// unthrottled one keeps an eventfd readable until everything is delivered. The replay shows up
+/// as a single keyboard in the device registry and reports itself finished after the last
+/// keystroke.
+class ReplaySource : public InputSource
+{
+  public:
+    /// Loads the trace or sets up the pattern, throws `ConfigurationError` for an unusable trace
+    explicit ReplaySource(const InputSettings &settings);
+
+    [[nodiscard]] auto fd() const -> int override;
+
+    auto read(std::span<KeyPress> presses) -> InputRead override;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    /// A keystroke of a trace file, day 0 if the line had none
+    struct TraceEntry
+    {
+        std::uint16_t key_code{ 0 };
+        DayNumber day{ 0 };
+    };
+
+    /// Reads `key_code` or `day key_code` lines, `#` starts a comment
+    [[nodiscard]] static auto loadTrace(const std::filesystem::path &path)
+      -> std::vector<TraceEntry>;
+
+    /// Returns the keystroke at `position` of the replay
+    [[nodiscard]] auto keyPressAt(std::size_t position) -> KeyPress;
+
+    /// Returns the number of keystrokes that are due by now
+    [[nodiscard]] auto dueCount() const -> std::size_t;
+
+    ReplayPattern pattern;
+    std::vector<TraceEntry> trace;
+
+    std::size_t total{ 0 };
+    std::size_t rate{ 0 }; ///< Keystrokes per second, 0 if unthrottled
+    std::size_t days{ 1 };
+    DayNumber first_day{ 0 };
+
+    std::size_t delivered{ 0 };
+    Clock::time_point started;
+
+    std::mt19937 random;
+    std::discrete_distribution<std::size_t> zipf;
+
+    Device *device{ nullptr };
+
+    /// Timerfd of a rate limited replay, eventfd otherwise
+    FileDescriptor event_fd;
+};
+
+} // namespace typetrace::backend
+
+#endif
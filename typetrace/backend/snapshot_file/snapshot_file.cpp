@@ -0,0 +1,131 @@
+#include "snapshot_file.hpp"
+
+#include "constants.hpp"
+#include "database_manager.hpp"
+#include "exceptions.hpp"
+#include "file_descriptor.hpp"
+#include "logger.hpp"
+#include "stats_snapshot.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace typetrace::backend {
+
+SnapshotFile::SnapshotFile(std::filesystem::path path) :
+  file_path(std::move(path)),
+  temporary_path(std::filesystem::path{ file_path }.concat(".tmp")),
+  snapshot(std::make_unique<StatsSnapshot>())
+{
+}
+
+auto SnapshotFile::update(DatabaseManager &db_manager) -> void
+{
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    const auto start = std::chrono::steady_clock::now();
+
+    collect(db_manager);
+    replaceFile();
+
+    const Microseconds elapsed = std::chrono::steady_clock::now() - start;
+    getLogger().debug(
+      "Wrote statistics snapshot in {:.1f}us: {}", elapsed.count(), file_path.string());
+}
+
+auto SnapshotFile::collect(DatabaseManager &db_manager) -> void
+{
+    const DayNumber today = day_clock.today();
+
+    *snapshot = StatsSnapshot{};
+    snapshot->magic = STATS_SNAPSHOT_MAGIC;
+    snapshot->version = STATS_SNAPSHOT_VERSION;
+    snapshot->written_at = std::chrono::duration_cast<std::chrono::seconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+    snapshot->day = today;
+
+    // Imported or older rows may hold scan codes the snapshot has no counter for
+    for (const auto &[key_code, count] : db_manager.getDayKeyCounts(today)) {
+        if (key_code < KEY_CODE_COUNT) {
+            snapshot->today.at(key_code) = count;
+        }
+    }
+
+    // The all-time totals come from their rollup, the top keys are ranked from them instead of
+    // summing the whole keystrokes table
+    std::vector<KeyCount> totals = db_manager.getTotalKeyCounts();
+    for (const auto &[key_code, count] : totals) {
+        if (key_code < KEY_CODE_COUNT) {
+            snapshot->all_time.at(key_code) = count;
+        }
+    }
+
+    const std::size_t top_keys = std::min(totals.size(), StatsSnapshot::TOP_KEYS);
+    std::ranges::partial_sort(totals,
+                              std::next(totals.begin(), static_cast<std::ptrdiff_t>(top_keys)),
+                              std::ranges::greater{},
+                              &KeyCount::count);
+    std::ranges::copy(std::span{ totals }.first(top_keys), snapshot->top_keys.begin());
+    snapshot->top_keys_size = top_keys;
+
+    const auto first_day = static_cast<DayNumber>(today - (StatsSnapshot::DAYS - 1));
+    const std::vector<DailyCount> daily = db_manager.getDailyCounts(first_day);
+    const std::size_t days = std::min(daily.size(), StatsSnapshot::DAYS);
+    std::ranges::copy(std::span{ daily }.first(days), snapshot->daily.begin());
+    snapshot->daily_size = days;
+}
+
+auto SnapshotFile::replaceFile() const -> void
+{
+    FileDescriptor fd{ ::open(temporary_path.c_str(),
+                              O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                              S_IRUSR | S_IWUSR) };
+    if (!fd) {
+        throw SystemError(std::format("Failed to create statistics snapshot '{}': {}",
+                                      temporary_path.string(),
+                                      std::strerror(errno)));
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const std::span bytes{ reinterpret_cast<const char *>(snapshot.get()),
+                           sizeof(StatsSnapshot) };
+    std::size_t written{ 0 };
+
+    while (written < bytes.size()) {
+        const auto rest = bytes.subspan(written);
+        const ssize_t result = ::write(fd.get(), rest.data(), rest.size());
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw SystemError(
+              std::format("Failed to write statistics snapshot: {}", std::strerror(errno)));
+        }
+        written += static_cast<std::size_t>(result);
+    }
+
+    // Not synced: after a crash the file may be cut short, which readers reject by its size
+    if (::rename(temporary_path.c_str(), file_path.c_str()) < 0) {
+        throw SystemError(std::format("Failed to replace statistics snapshot '{}': {}",
+                                      file_path.string(),
+                                      std::strerror(errno)));
+    }
+}
+
+} // namespace typetrace::backend
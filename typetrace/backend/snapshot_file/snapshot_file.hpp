@@ -0,0 +1,45 @@
+#ifndef TYPETRACE_SNAPSHOT_FILE_HPP
+#define TYPETRACE_SNAPSHOT_FILE_HPP
+
+#include "database_manager.hpp"
+#include "day_clock.hpp"
+#include "stats_snapshot.hpp"
+
+#include <filesystem>
+#include <memory>
+
+namespace typetrace::backend {
+
+/// Writer side of the statistics snapshot (see `StatsSnapshot`).
+///
+/// Every update queries the statistics once and replaces the file through a write to a
+/// temporary file and a rename, so readers never see a partial snapshot. It is meant to run
+/// off the flush path, like the WAL checkpoints.
+class SnapshotFile
+{
+  public:
+    /// Writes snapshots to `path`, nothing is written before the first `update()`
+    explicit SnapshotFile(std::filesystem::path path);
+
+    /// Replaces the snapshot with the current statistics of the database, throws
+    /// `DatabaseError` or `SystemError` and keeps the previous snapshot if that fails
+    auto update(DatabaseManager &db_manager) -> void;
+
+  private:
+    /// Fills the snapshot buffer from the database
+    auto collect(DatabaseManager &db_manager) -> void;
+
+    /// Writes the snapshot buffer to the temporary file and renames it over the snapshot
+    auto replaceFile() const -> void;
+
+    std::filesystem::path file_path;
+    std::filesystem::path temporary_path;
+    DayClock day_clock;
+
+    /// Kept on the heap and reused by every update, it is about 18 KiB
+    std::unique_ptr<StatsSnapshot> snapshot;
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,195 @@
+#include "spill_file.hpp"
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "logger.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace typetrace::backend {
+
+SpillFile::SpillFile(const std::filesystem::path &path) : file_path(path)
+{
+    getLogger().info("Opening spill file at: {}", file_path.string());
+
+    fd.reset(::open(file_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR));
+    if (!fd) {
+        throw SystemError(std::format(
+          "Failed to open spill file '{}': {}", file_path.string(), std::strerror(errno)));
+    }
+
+    struct stat file_stat{};
+    if (::fstat(fd.get(), &file_stat) < 0) {
+        throw SystemError(std::format("Failed to stat spill file: {}", std::strerror(errno)));
+    }
+
+    // A file of another size was written with an older layout or capacity, its keystrokes have
+    // to be read before resizing cuts them off
+    const auto file_size = static_cast<std::size_t>(file_stat.st_size);
+    const bool has_expected_size = file_size == sizeof(Layout);
+    std::vector<KeystrokeEvent> recovered;
+    if (!has_expected_size && file_size > 0) {
+        recovered = readOlderLayout(file_size);
+    }
+
+    if (!has_expected_size && ::ftruncate(fd.get(), sizeof(Layout)) < 0) {
+        throw SystemError(std::format("Failed to resize spill file: {}", std::strerror(errno)));
+    }
+
+    void *const mapping
+      = ::mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (mapping == MAP_FAILED) {
+        throw SystemError(std::format("Failed to map spill file: {}", std::strerror(errno)));
+    }
+    layout = static_cast<Layout *>(mapping);
+
+    if (has_expected_size && isValid()) {
+        return;
+    }
+    if (has_expected_size) {
+        recovered = readOlderLayout(file_size);
+    }
+
+    layout->magic = MAGIC;
+    layout->version = VERSION;
+    layout->capacity = SPILL_FILE_CAPACITY;
+    layout->reserved = 0;
+    layout->begin = 0;
+    layout->end = 0;
+
+    // Carried over keystrokes are replayed on this start like any others
+    std::size_t restored{ 0 };
+    while (restored < recovered.size() && append(recovered.at(restored))) {
+        ++restored;
+    }
+    if (restored > 0) {
+        getLogger().info("Carried {} keystrokes over from an older spill file", restored);
+    }
+    if (restored < recovered.size()) {
+        getLogger().warn("Dropping {} keystrokes that do not fit into the spill file",
+                         recovered.size() - restored);
+    }
+}
+
+SpillFile::~SpillFile()
+{
+    if (layout != nullptr) {
+        ::munmap(layout, sizeof(Layout));
+    }
+}
+
+auto SpillFile::append(const KeystrokeEvent &keystroke) -> bool
+{
+    const std::uint64_t end = layout->end;
+    if (end - layout->begin >= SPILL_FILE_CAPACITY) {
+        return false;
+    }
+
+    layout->events.at(end % SPILL_FILE_CAPACITY) = keystroke;
+
+    // Publish the event before the counter so a crash never exposes a half-written slot
+    std::atomic_ref{ layout->end }.store(end + 1, std::memory_order_release);
+    return true;
+}
+
+auto SpillFile::pending() const -> std::vector<KeystrokeEvent>
+{
+    std::vector<KeystrokeEvent> keystrokes;
+    keystrokes.reserve(layout->end - layout->begin);
+
+    for (std::uint64_t index = layout->begin; index < layout->end; ++index) {
+        keystrokes.push_back(layout->events.at(index % SPILL_FILE_CAPACITY));
+    }
+    return keystrokes;
+}
+
+auto SpillFile::release(const std::size_t count) -> void
+{
+    const std::uint64_t begin = layout->begin;
+    const std::uint64_t stored = layout->end - begin;
+    std::atomic_ref{ layout->begin }.store(begin + std::min<std::uint64_t>(count, stored),
+                                           std::memory_order_release);
+}
+
+auto SpillFile::clear() -> void
+{
+    std::atomic_ref{ layout->begin }.store(layout->end, std::memory_order_release);
+}
+
+auto SpillFile::readOlderLayout(const std::size_t file_size) const -> std::vector<KeystrokeEvent>
+{
+    // Version 1 stored a plain count in place of `reserved` and its events right after the
+    // header, version 2 added the running counters in front of the events
+    constexpr std::size_t HEADER_SIZE = 4 * sizeof(std::uint32_t);
+    constexpr std::size_t COUNTERS_SIZE = 2 * sizeof(std::uint64_t);
+
+    std::vector<char> bytes(file_size);
+    if (::pread(fd.get(), bytes.data(), file_size, 0) != static_cast<ssize_t>(file_size)) {
+        getLogger().warn("Discarding unreadable spill file: {}", file_path.string());
+        return {};
+    }
+
+    std::array<std::uint32_t, 4> header{};
+    if (file_size >= HEADER_SIZE) {
+        std::memcpy(header.data(), bytes.data(), HEADER_SIZE);
+    }
+    const auto [magic, version, capacity, count] = header;
+    if (magic != MAGIC || version == 0 || version > VERSION) {
+        getLogger().warn("Discarding spill file with unknown format: {}", file_path.string());
+        return {};
+    }
+
+    const auto discard = [this, version] {
+        getLogger().warn("Discarding corrupt spill file of version {}: {}",
+                         version,
+                         file_path.string());
+        return std::vector<KeystrokeEvent>{};
+    };
+
+    const std::size_t events_offset = version >= 2 ? HEADER_SIZE + COUNTERS_SIZE : HEADER_SIZE;
+    if (capacity == 0 || file_size < events_offset + (capacity * sizeof(KeystrokeEvent))) {
+        return discard();
+    }
+
+    std::uint64_t begin{ 0 };
+    std::uint64_t end{ count };
+    if (version >= 2) {
+        std::memcpy(&begin, bytes.data() + HEADER_SIZE, sizeof(begin));
+        std::memcpy(&end, bytes.data() + HEADER_SIZE + sizeof(begin), sizeof(end));
+    }
+    if (begin > end || end - begin > capacity) {
+        return discard();
+    }
+
+    std::vector<KeystrokeEvent> keystrokes(end - begin);
+    for (std::uint64_t index = begin; index < end; ++index) {
+        std::memcpy(&keystrokes.at(index - begin),
+                    bytes.data() + events_offset + ((index % capacity) * sizeof(KeystrokeEvent)),
+                    sizeof(KeystrokeEvent));
+    }
+
+    return keystrokes;
+}
+
+auto SpillFile::isValid() const -> bool
+{
+    return layout->magic == MAGIC && layout->version == VERSION
+           && layout->capacity == SPILL_FILE_CAPACITY && layout->begin <= layout->end
+           && layout->end - layout->begin <= SPILL_FILE_CAPACITY;
+}
+
+} // namespace typetrace::backend
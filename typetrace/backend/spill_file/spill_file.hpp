@@ -0,0 +1,82 @@
+#ifndef TYPETRACE_SPILL_FILE_HPP
+#define TYPETRACE_SPILL_FILE_HPP
+
+#include "constants.hpp"
+#include "file_descriptor.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// Memory-mapped mirror of the keystrokes that are not yet in the database.
+///
+/// Appending is a plain store into a shared mapping, so it costs no syscall on the input path.
+/// The kernel keeps the pages even if the process is killed, and keystrokes left in the file are
+/// replayed into the database on the next start. The events form a ring between two running
+/// counters, keystrokes are appended at the end and released from the beginning once they are
+/// committed. Each update stores a single counter, so a crash never exposes a torn state.
+class SpillFile
+{
+  public:
+    /// Opens or creates the spill file. Keystrokes of a file with an older layout or capacity are
+    /// carried over, contents that can't be read are discarded with a warning.
+    explicit SpillFile(const std::filesystem::path &path);
+
+    /// Unmaps the spill file
+    ~SpillFile();
+
+    SpillFile(const SpillFile &) = delete;
+    auto operator=(const SpillFile &) -> SpillFile & = delete;
+    SpillFile(SpillFile &&) = delete;
+    auto operator=(SpillFile &&) -> SpillFile & = delete;
+
+    /// Appends a keystroke, returns false if the file is full
+    auto append(const KeystrokeEvent &keystroke) -> bool;
+
+    /// Returns a copy of the keystrokes currently stored in the file, oldest first
+    [[nodiscard]] auto pending() const -> std::vector<KeystrokeEvent>;
+
+    /// Forgets the `count` oldest keystrokes once they have been written to the database
+    auto release(std::size_t count) -> void;
+
+    /// Forgets all stored keystrokes once they have been written to the database
+    auto clear() -> void;
+
+  private:
+    /// Identifies a spill file written by a compatible version ("TTSP")
+    static constexpr std::uint32_t MAGIC = 0x50535454;
+    static constexpr std::uint32_t VERSION = 2;
+
+    /// On-disk layout of the spill file
+    struct Layout
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t capacity;
+        std::uint32_t reserved;
+        std::uint64_t begin; ///< Running count of released keystrokes
+        std::uint64_t end;   ///< Running count of appended keystrokes
+        std::array<KeystrokeEvent, SPILL_FILE_CAPACITY> events;
+    };
+
+    /// Reads the stored keystrokes of a file that doesn't match the current layout, returns
+    /// none if the file is not a readable spill file
+    [[nodiscard]] auto readOlderLayout(std::size_t file_size) const
+      -> std::vector<KeystrokeEvent>;
+
+    /// Returns true if the mapped file has a matching header and plausible counters
+    [[nodiscard]] auto isValid() const -> bool;
+
+    std::filesystem::path file_path;
+    FileDescriptor fd;
+    Layout *layout{ nullptr };
+};
+
+} // namespace typetrace::backend
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef TYPETRACE_SPSC_RING_HPP
+#define TYPETRACE_SPSC_RING_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <type_traits>
+
+namespace typetrace::backend {
+
+/// Bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+///
+/// Values are written and read in place: the producer fills a claimed slot and publishes it,
+/// the consumer reads the front slot and pops it once done, so nothing is copied in between.
+///
+/// Each side caches the other side's index and only reloads it when the ring looks full or
+/// empty, so in the common case a claim or pop touches no shared cache line besides its own.
+template<typename T, std::size_t Capacity>
+class SpscRing
+{
+    static_assert(std::has_single_bit(Capacity), "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "Slots are reused without destruction");
+
+  public:
+    /// Returns the next free slot to be filled in place, or nullptr if the ring is full. The
+    /// slot still holds an older value and is only queued by `publish()` (producer only).
+    [[nodiscard]] auto tryClaim() -> T *
+    {
+        const std::size_t head = write_index.load(std::memory_order_relaxed);
+
+        if (head - cached_read_index == Capacity) {
+            cached_read_index = read_index.load(std::memory_order_acquire);
+            if (head - cached_read_index == Capacity) {
+                return nullptr;
+            }
+        }
+
+        return &slots.at(head & MASK);
+    }
+
+    /// Queues the slot returned by `tryClaim()` for the consumer (producer only)
+    auto publish() -> void
+    {
+        write_index.store(write_index.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_release);
+    }
+
+    /// Returns the oldest value without removing it, or nullptr if empty (consumer only)
+    [[nodiscard]] auto front() -> const T *
+    {
+        const std::size_t tail = read_index.load(std::memory_order_relaxed);
+
+        if (tail == cached_write_index) {
+            cached_write_index = write_index.load(std::memory_order_acquire);
+            if (tail == cached_write_index) {
+                return nullptr;
+            }
+        }
+
+        return &slots.at(tail & MASK);
+    }
+
+    /// Removes the value returned by `front()`, releasing its slot (consumer only)
+    auto pop() -> void
+    {
+        read_index.store(read_index.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_release);
+    }
+
+    /// Returns the number of queued values, exact only when both sides are idle
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        return write_index.load(std::memory_order_acquire)
+               - read_index.load(std::memory_order_acquire);
+    }
+
+  private:
+    static constexpr std::size_t MASK = Capacity - 1;
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    // Producer side
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> write_index{ 0 };
+    std::size_t cached_read_index{ 0 };
+
+    // Consumer side
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> read_index{ 0 };
+    std::size_t cached_write_index{ 0 };
+
+    alignas(CACHE_LINE_SIZE) std::array<T, Capacity> slots{};
+};
+
+} // namespace typetrace::backend
+
+#endif
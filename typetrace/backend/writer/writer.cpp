@@ -0,0 +1,319 @@
+#include "writer.hpp"
+
+#include "constants.hpp"
+#include "database_manager.hpp"
+#include "dimension_matrix.hpp"
+#include "exceptions.hpp"
+#include "logger.hpp"
+#include "rhythm_stats.hpp"
+#include "snapshot_file.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+namespace typetrace::backend {
+
+Writer::Writer(std::unique_ptr<DatabaseManager> manager,
+               std::function<void(bool)> on_written,
+               SnapshotFile *const snapshot) :
+  db_manager(std::move(manager)),
+  written_callback(std::move(on_written)),
+  snapshot_file(snapshot),
+  thread([this](const std::stop_token &stop_token) -> void { run(stop_token); })
+{
+    getLogger().info("Database writer thread started");
+}
+
+Writer::~Writer()
+{
+    thread.request_stop();
+    notify();
+    thread.join();
+
+    const auto stats = getStats();
+    getLogger().info(
+      "Database writer thread stopped: {} batches written, {} failed, {} dropped, {} full-ring "
+      "waits",
+      stats.batches_written,
+      stats.batches_failed,
+      stats.batches_dropped,
+      stats.ring_full_waits);
+}
+
+auto Writer::submit(const std::span<const KeystrokeEvent> events) -> bool
+{
+    // The disk has stalled for a whole ring worth of batches. Waiting here would make input
+    // latency depend on the disk, so the caller keeps buffering and the writer does the logging.
+    EventBatch *const batch = ring.tryClaim();
+    if (batch == nullptr) {
+        ring_full_waits.fetch_add(1, std::memory_order_relaxed);
+        notify();
+        return false;
+    }
+
+    // The events are copied once, straight into the slot the writer reads them from, and
+    // only as many as the batch holds instead of the whole array
+    const auto chunk = events.first(std::min(events.size(), batch->events.size()));
+    std::ranges::copy(chunk, batch->events.begin());
+    batch->size = chunk.size();
+    ring.publish();
+
+    batches_submitted.fetch_add(1, std::memory_order_relaxed);
+    notify();
+    return true;
+}
+
+auto Writer::submitDimensions(DimensionMatrix matrix) -> void
+{
+    {
+        const std::scoped_lock lock{ dimensions_mutex };
+        pending_dimensions.push_back(std::move(matrix));
+    }
+    notify();
+}
+
+auto Writer::submitRhythm(RhythmStats stats) -> void
+{
+    {
+        const std::scoped_lock lock{ rhythm_mutex };
+        pending_rhythm.push_back(std::move(stats));
+    }
+    notify();
+}
+
+auto Writer::requestCheckpoint() -> void
+{
+    checkpoint_requested.store(true, std::memory_order_release);
+    notify();
+}
+
+auto Writer::requestRetention() -> void
+{
+    retention_requested.store(true, std::memory_order_release);
+    notify();
+}
+
+auto Writer::requestSnapshot() -> void
+{
+    snapshot_requested.store(true, std::memory_order_release);
+    notify();
+}
+
+auto Writer::getStats() const -> WriterStats
+{
+    return WriterStats{
+        .batches_submitted = batches_submitted.load(std::memory_order_relaxed),
+        .batches_written = batches_written.load(std::memory_order_relaxed),
+        .batches_failed = batches_failed.load(std::memory_order_relaxed),
+        .batches_dropped = batches_dropped.load(std::memory_order_relaxed),
+        .ring_full_waits = ring_full_waits.load(std::memory_order_relaxed),
+        .max_queued_batches = max_queued_batches.load(std::memory_order_relaxed),
+    };
+}
+
+auto Writer::run(const std::stop_token &stop_token) -> void
+{
+    while (true) {
+        // Read the generation before draining so a submit racing with the drain is not missed
+        const auto generation = wake_generation.load(std::memory_order_acquire);
+
+        drain(stop_token);
+        reportRingFull();
+        writeDimensions();
+        writeRhythm();
+
+        // Checked before stopping, so the snapshot taken at shutdown includes the final flush
+        if (snapshot_requested.exchange(false, std::memory_order_acq_rel)) {
+            writeSnapshot();
+        }
+
+        if (stop_token.stop_requested()) {
+            break;
+        }
+
+        if (checkpoint_requested.exchange(false, std::memory_order_acq_rel)) {
+            try {
+                db_manager->checkpoint(CheckpointMode::passive);
+            } catch (const std::exception &e) {
+                getLogger().warn("Database writer failed to checkpoint: {}", e.what());
+            }
+        }
+
+        // Pruning goes on without waiting, but drains the ring again after every batch
+        if (retention_requested.exchange(false, std::memory_order_acq_rel)) {
+            pruning = true;
+        }
+        if (pruning) {
+            pruning = pruneBatch();
+            if (pruning) {
+                continue;
+            }
+        }
+
+        wake_generation.wait(generation, std::memory_order_acquire);
+    }
+}
+
+auto Writer::drain(const std::stop_token &stop_token) -> void
+{
+    const std::size_t queued = ring.size();
+    if (queued > max_queued_batches.load(std::memory_order_relaxed)) {
+        max_queued_batches.store(queued, std::memory_order_relaxed);
+    }
+
+    while (const EventBatch *const batch = ring.front()) {
+        try {
+            db_manager->writeToDatabase(std::span{ batch->events }.first(batch->size));
+            batches_written.fetch_add(1, std::memory_order_relaxed);
+            retry_delay = std::chrono::milliseconds{ 0 };
+
+            if (written_callback) {
+                written_callback(true);
+            }
+        } catch (const std::exception &e) {
+            batches_failed.fetch_add(1, std::memory_order_relaxed);
+
+            // Retrying a constraint error or a corrupt database would hold up every later batch
+            if (!isTransient(e)) {
+                getLogger().error("Database writer failed to write batch, dropping its {} "
+                                  "keystrokes: {}",
+                                  batch->size,
+                                  e.what());
+                batches_dropped.fetch_add(1, std::memory_order_relaxed);
+                retry_delay = std::chrono::milliseconds{ 0 };
+
+                if (written_callback) {
+                    written_callback(false);
+                }
+                ring.pop();
+                continue;
+            }
+
+            // A busy database or a full disk usually passes, so the batch stays queued
+            if (!stop_token.stop_requested()) {
+                retry_delay = std::clamp(retry_delay * 2, MIN_RETRY_DELAY, MAX_RETRY_DELAY);
+                getLogger().error("Database writer failed to write batch, retrying in {}ms: {}",
+                                  retry_delay.count(),
+                                  e.what());
+                waitBeforeRetry(stop_token);
+                continue;
+            }
+
+            // Later batches are dropped too, so no commit is confirmed in place of this one
+            std::size_t dropped{ 0 };
+            while (const EventBatch *const queued_batch = ring.front()) {
+                dropped += queued_batch->size;
+                ring.pop();
+            }
+            getLogger().error("Database writer failed to write batch, dropping {} keystrokes: {}",
+                              dropped,
+                              e.what());
+            return;
+        }
+
+        ring.pop();
+    }
+}
+
+auto Writer::isTransient(const std::exception &error) -> bool
+{
+    const auto *const database_error = dynamic_cast<const DatabaseError *>(&error);
+    return database_error != nullptr && database_error->isTransient();
+}
+
+auto Writer::waitBeforeRetry(const std::stop_token &stop_token) -> void
+{
+    std::unique_lock lock{ retry_mutex };
+    retry_condition.wait_for(lock, stop_token, retry_delay, []() -> bool { return false; });
+}
+
+auto Writer::reportRingFull() -> void
+{
+    const std::uint64_t waits = ring_full_waits.load(std::memory_order_relaxed);
+    const auto now = std::chrono::steady_clock::now();
+    if (waits == reported_ring_full_waits || now < next_ring_full_report) {
+        return;
+    }
+
+    getLogger().warn("Database writer is falling behind, {} submits found the ring full",
+                     waits - reported_ring_full_waits);
+    reported_ring_full_waits = waits;
+    next_ring_full_report = now + RING_FULL_LOG_INTERVAL;
+}
+
+auto Writer::writeDimensions() -> void
+{
+    std::vector<DimensionMatrix> matrices;
+    {
+        const std::scoped_lock lock{ dimensions_mutex };
+        matrices.swap(pending_dimensions);
+    }
+
+    for (const auto &matrix : matrices) {
+        try {
+            db_manager->writeDayDimensions(matrix);
+        } catch (const std::exception &e) {
+            getLogger().error("Database writer failed to write dimensions: {}", e.what());
+        }
+    }
+}
+
+auto Writer::writeRhythm() -> void
+{
+    std::vector<RhythmStats> queued;
+    {
+        const std::scoped_lock lock{ rhythm_mutex };
+        queued.swap(pending_rhythm);
+    }
+
+    for (const auto &stats : queued) {
+        try {
+            db_manager->writeDayRhythm(stats);
+        } catch (const std::exception &e) {
+            getLogger().error("Database writer failed to write rhythm: {}", e.what());
+        }
+    }
+}
+
+auto Writer::writeSnapshot() -> void
+{
+    if (snapshot_file == nullptr) {
+        return;
+    }
+
+    try {
+        snapshot_file->update(*db_manager);
+    } catch (const std::exception &e) {
+        getLogger().warn("Database writer failed to write the statistics snapshot: {}", e.what());
+    }
+}
+
+auto Writer::pruneBatch() -> bool
+{
+    try {
+        return db_manager->pruneExpiredDays();
+    } catch (const std::exception &e) {
+        getLogger().warn("Database writer failed to prune expired days: {}", e.what());
+        return false;
+    }
+}
+
+auto Writer::notify() -> void
+{
+    wake_generation.fetch_add(1, std::memory_order_release);
+    wake_generation.notify_one();
+}
+
+} // namespace typetrace::backend
@@ -0,0 +1,179 @@
+#ifndef TYPETRACE_WRITER_HPP
+#define TYPETRACE_WRITER_HPP
+
+#include "constants.hpp"
+#include "database_manager.hpp"
+#include "dimension_matrix.hpp"
+#include "rhythm_stats.hpp"
+#include "snapshot_file.hpp"
+#include "spsc_ring.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace typetrace::backend {
+
+/// Fixed-size batch of keystroke events handed from the input thread to the writer thread
+struct EventBatch
+{
+    std::array<KeystrokeEvent, MAX_BUFFER_SIZE> events{}; ///< Buffered events
+    std::size_t size{ 0 };                                ///< Number of valid events
+};
+
+/// Snapshot of the writer's back-pressure counters
+struct WriterStats
+{
+    std::uint64_t batches_submitted{ 0 }; ///< Batches pushed by the input thread
+    std::uint64_t batches_written{ 0 };   ///< Batches committed to the database
+    std::uint64_t batches_failed{ 0 };    ///< Failed database writes, transient ones are retried
+    std::uint64_t batches_dropped{ 0 };   ///< Batches given up after a write that can't succeed
+    std::uint64_t ring_full_waits{ 0 };   ///< Submits rejected because the ring was full
+    std::size_t max_queued_batches{ 0 };  ///< Highest ring occupancy seen by the writer
+};
+
+/// Writes keystroke batches to the database on a dedicated thread.
+///
+/// The input thread submits batches through a bounded single-producer/single-consumer ring, so
+/// SQLite commits and fsyncs never block input dispatch. A batch whose write fails transiently
+/// stays at the head of the ring and is retried with backoff, any other failure drops it so
+/// the later batches are not held up. The writer owns the database connection for its whole
+/// lifetime and drains all queued batches before it is destroyed.
+class Writer
+{
+  public:
+    /// Takes ownership of the database manager and starts the writer thread.
+    /// `on_written` is called on the writer thread for every batch that leaves the ring, in
+    /// order, with false for a dropped batch. `snapshot` is updated on the writer thread after
+    /// `requestSnapshot()`, it must outlive the writer.
+    explicit Writer(std::unique_ptr<DatabaseManager> manager,
+                    std::function<void(bool written)> on_written = {},
+                    SnapshotFile *snapshot = nullptr);
+
+    /// Stops the writer thread after all queued batches have been written
+    ~Writer();
+
+    Writer(const Writer &) = delete;
+    auto operator=(const Writer &) -> Writer & = delete;
+    Writer(Writer &&) = delete;
+    auto operator=(Writer &&) -> Writer & = delete;
+
+    /// Queues at most `MAX_BUFFER_SIZE` events for writing by copying them into a ring slot.
+    /// Never waits, returns false if the ring is full and the caller has to keep the events
+    /// (input thread only).
+    [[nodiscard]] auto submit(std::span<const KeystrokeEvent> events) -> bool;
+
+    /// Queues the dimension matrix of a closed day for writing, safe to call from any thread
+    auto submitDimensions(DimensionMatrix matrix) -> void;
+
+    /// Queues the rhythm stats handed over with a flush for writing, safe to call from any thread
+    auto submitRhythm(RhythmStats stats) -> void;
+
+    /// Asks the writer thread to run a passive WAL checkpoint once the queue is drained
+    auto requestCheckpoint() -> void;
+
+    /// Asks the writer thread to prune keystroke rows outside the retention period. The batches
+    /// are deleted one per loop, so queued keystrokes are written in between.
+    auto requestRetention() -> void;
+
+    /// Asks the writer thread to update the statistics snapshot once the queue is drained, a
+    /// request right before the writer is destroyed is still carried out
+    auto requestSnapshot() -> void;
+
+    /// Returns the current back-pressure counters
+    [[nodiscard]] auto getStats() const -> WriterStats;
+
+  private:
+    /// Delay before the first retry of a failed batch, it doubles with every further failure
+    static constexpr std::chrono::milliseconds MIN_RETRY_DELAY{ 100 };
+
+    /// Longest delay between two retries of a failed batch
+    static constexpr std::chrono::milliseconds MAX_RETRY_DELAY{ 10000 };
+
+    /// Shortest time between two warnings about submits that found the ring full
+    static constexpr std::chrono::seconds RING_FULL_LOG_INTERVAL{ 10 };
+
+    /// Main loop of the writer thread
+    auto run(const std::stop_token &stop_token) -> void;
+
+    /// Writes all batches currently queued in the ring. A transiently failed batch is retried
+    /// until it is written, once stopping is requested it is given up with all later batches
+    /// after one more failure. Those are not reported to `on_written`.
+    auto drain(const std::stop_token &stop_token) -> void;
+
+    /// Returns true if a failed write may succeed when it is retried
+    [[nodiscard]] static auto isTransient(const std::exception &error) -> bool;
+
+    /// Waits before the next retry of a failed batch, returns early if stopping is requested
+    auto waitBeforeRetry(const std::stop_token &stop_token) -> void;
+
+    /// Warns about submits that found the ring full, at most every `RING_FULL_LOG_INTERVAL`
+    auto reportRingFull() -> void;
+
+    /// Writes all queued dimension matrices
+    auto writeDimensions() -> void;
+
+    /// Writes all queued rhythm stats
+    auto writeRhythm() -> void;
+
+    /// Updates the statistics snapshot, failures are only logged
+    auto writeSnapshot() -> void;
+
+    /// Deletes one batch of expired keystroke rows, returns true while rows are left
+    auto pruneBatch() -> bool;
+
+    /// Wakes the writer thread
+    auto notify() -> void;
+
+    std::unique_ptr<DatabaseManager> db_manager;
+    std::function<void(bool)> written_callback;
+    SnapshotFile *snapshot_file;
+    SpscRing<EventBatch, WRITER_RING_CAPACITY> ring;
+
+    // Days close rarely, so a mutex is cheap enough here
+    std::mutex dimensions_mutex;
+    std::vector<DimensionMatrix> pending_dimensions;
+
+    // Rhythm stats come once per flush, far less often than keystrokes
+    std::mutex rhythm_mutex;
+    std::vector<RhythmStats> pending_rhythm;
+
+    std::atomic<std::uint32_t> wake_generation{ 0 };
+    std::atomic<bool> checkpoint_requested{ false };
+    std::atomic<bool> snapshot_requested{ false };
+    std::atomic<bool> retention_requested{ false };
+    bool pruning{ false }; // Writer thread only
+
+    // Writer thread only
+    std::chrono::milliseconds retry_delay{ 0 };
+    std::uint64_t reported_ring_full_waits{ 0 };
+    std::chrono::steady_clock::time_point next_ring_full_report;
+
+    std::mutex retry_mutex;
+    std::condition_variable_any retry_condition; ///< Only notified by stop requests
+
+    std::atomic<std::uint64_t> batches_submitted{ 0 };
+    std::atomic<std::uint64_t> batches_written{ 0 };
+    std::atomic<std::uint64_t> batches_failed{ 0 };
+    std::atomic<std::uint64_t> batches_dropped{ 0 };
+    std::atomic<std::uint64_t> ring_full_waits{ 0 };
+    std::atomic<std::size_t> max_queued_batches{ 0 };
+
+    std::jthread thread; // Declared last so it starts after all other members are initialized
+};
+
+} // namespace typetrace::backend
+
+#endif
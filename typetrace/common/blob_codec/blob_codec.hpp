@@ -0,0 +1,113 @@
+#ifndef TYPETRACE_BLOB_CODEC_HPP
+#define TYPETRACE_BLOB_CODEC_HPP
+
+#include "exceptions.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace typetrace {
+
+/// Size of a fixed-width offset as written by `writeOffset()`
+constexpr std::size_t BLOB_OFFSET_SIZE = 4;
+
+/// Appends an unsigned LEB128 varint
+inline auto writeVarint(std::vector<std::uint8_t> &out, std::uint64_t value) -> void
+{
+    constexpr std::uint8_t CONTINUE = 0x80;
+    constexpr std::uint8_t PAYLOAD = 0x7f;
+
+    while (value >= CONTINUE) {
+        out.push_back(static_cast<std::uint8_t>(value & PAYLOAD) | CONTINUE);
+        value >>= 7U;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+/// Stores a little-endian fixed-width offset at `position`, which must already be allocated
+inline auto writeOffset(std::vector<std::uint8_t> &out,
+                        const std::size_t position,
+                        const std::uint32_t value) -> void
+{
+    for (std::size_t i = 0; i < BLOB_OFFSET_SIZE; ++i) {
+        out.at(position + i) = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+}
+
+/// Sequential reader over a stored blob that throws `DatabaseError` on truncated or oversized
+/// values. `blob_name` describes the blob in the error messages, e.g. "Dimension blob".
+class BlobReader
+{
+  public:
+    explicit BlobReader(const std::span<const std::uint8_t> blob,
+                        const std::size_t offset = 0,
+                        const std::string_view blob_name = "Blob")
+      : data(blob), position(offset), name(blob_name)
+    {
+    }
+
+    auto byte() -> std::uint8_t
+    {
+        if (position >= data.size()) {
+            throw DatabaseError(std::format("{} is truncated", name));
+        }
+        return data[position++];
+    }
+
+    auto varint() -> std::uint64_t
+    {
+        constexpr unsigned MAX_SHIFT = 63;
+
+        std::uint64_t value{ 0 };
+        for (unsigned shift = 0;; shift += 7) {
+            const std::uint8_t next = byte();
+            value |= static_cast<std::uint64_t>(next & 0x7fU) << shift;
+
+            if ((next & 0x80U) == 0) {
+                return value;
+            }
+            if (shift >= MAX_SHIFT) {
+                throw DatabaseError(std::format("{} holds an oversized varint", name));
+            }
+        }
+    }
+
+    auto offset() -> std::uint32_t
+    {
+        std::uint32_t value{ 0 };
+        for (std::size_t i = 0; i < BLOB_OFFSET_SIZE; ++i) {
+            value |= static_cast<std::uint32_t>(byte()) << (8 * i);
+        }
+        return value;
+    }
+
+    auto text(const std::size_t length) -> std::string_view
+    {
+        if (position > data.size() || length > data.size() - position) {
+            throw DatabaseError(std::format("{} is truncated", name));
+        }
+
+        const auto bytes = data.subspan(position, length);
+        position += length;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return { reinterpret_cast<const char *>(bytes.data()), bytes.size() };
+    }
+
+    [[nodiscard]] auto tell() const -> std::size_t { return position; }
+
+    /// Returns true once every byte has been read
+    [[nodiscard]] auto done() const -> bool { return position >= data.size(); }
+
+  private:
+    std::span<const std::uint8_t> data;
+    std::size_t position;
+    std::string_view name;
+};
+
+} // namespace typetrace
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef TYPETRACE_CALENDAR_HPP
+#define TYPETRACE_CALENDAR_HPP
+
+#include "types.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+namespace typetrace {
+
+// ============================================================================
+// Period Numbers
+// ============================================================================
+
+/// Week starting on Monday, expressed as the number of weeks since Monday 1969-12-29
+using WeekNumber = std::uint32_t;
+
+/// Calendar month, expressed as `year * 12 + (month - 1)`
+using MonthNumber = std::uint32_t;
+
+/// Returns the Monday-based week a day belongs to (1970-01-01 was a Thursday)
+[[nodiscard]] constexpr auto weekOf(const DayNumber day) -> WeekNumber
+{
+    return (day + 3) / 7;
+}
+
+/// Returns the calendar month a day belongs to
+[[nodiscard]] constexpr auto monthOf(const DayNumber day) -> MonthNumber
+{
+    const std::chrono::year_month_day date{ std::chrono::sys_days{ std::chrono::days{ day } } };
+    return (static_cast<MonthNumber>(static_cast<int>(date.year())) * 12)
+           + static_cast<MonthNumber>(static_cast<unsigned int>(date.month()) - 1);
+}
+
+/// Returns the day number of a calendar date
+[[nodiscard]] constexpr auto dayOf(const std::chrono::year_month_day date) -> DayNumber
+{
+    return static_cast<DayNumber>(std::chrono::sys_days{ date }.time_since_epoch().count());
+}
+
+/// Returns the current day in the system time zone
+[[nodiscard]] inline auto localToday() -> DayNumber
+{
+    const auto now = std::chrono::current_zone()->to_local(std::chrono::system_clock::now());
+    return static_cast<DayNumber>(
+      std::chrono::floor<std::chrono::days>(now).time_since_epoch().count());
+}
+
+static_assert(weekOf(0) == 0 && weekOf(3) == 0 && weekOf(4) == 1);
+static_assert(monthOf(0) == 1970 * 12 && monthOf(31) == (1970 * 12) + 1);
+
+} // namespace typetrace
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef TYPETRACE_CONSTANTS_HPP
 #define TYPETRACE_CONSTANTS_HPP
 
+#include <chrono>
 #include <cstddef>
+#include <linux/input-event-codes.h>
 #include <string_view>
 
 namespace typetrace {
@@ -10,14 +12,151 @@ namespace typetrace {
 // Buffering Constants
 // ============================================================================
 
-/// Maximum number of keystrokes to buffer before writing to the database
+/// Default number of keystrokes to buffer before writing to the database
 constexpr std::size_t BUFFER_SIZE = 50;
 
-/// Maximum time (in seconds) to buffer keystrokes before writing to the database
+/// Default maximum time (in seconds) to buffer keystrokes before writing to the database
 constexpr std::size_t BUFFER_TIMEOUT = 100;
 
-/// Polling timeout in milliseconds for libinput events
-constexpr std::size_t POLL_TIMEOUT_MS = 100;
+/// Default maximum time (in seconds) to buffer keystrokes while writes are deferred on battery
+constexpr std::size_t DEFAULT_BATTERY_MAX_LATENCY = 1800;
+
+/// Capacity of the keystroke buffer, the upper bound for the configurable flush size
+constexpr std::size_t MAX_BUFFER_SIZE = 2048;
+
+/// Default commit rate the adaptive buffering policy aims to stay below
+constexpr std::size_t DEFAULT_MAX_COMMITS_PER_MINUTE = 4;
+
+/// Number of batches the writer ring can queue, then the input thread keeps buffering
+constexpr std::size_t WRITER_RING_CAPACITY = 16;
+
+/// Number of keystrokes the spill file can hold. It mirrors the buffer and every batch queued
+/// for the writer until that batch is committed, so this always suffices.
+constexpr std::size_t SPILL_FILE_CAPACITY = (WRITER_RING_CAPACITY + 1) * MAX_BUFFER_SIZE;
+
+// ============================================================================
+// Database Constants
+// ============================================================================
+
+/// Version of the database schema, stored in `PRAGMA user_version`
+constexpr int DB_SCHEMA_VERSION = 9;
+
+/// Default size of the memory-mapped I/O window in bytes (`PRAGMA mmap_size`)
+constexpr std::size_t DEFAULT_DB_MMAP_SIZE = 32 * 1024 * 1024;
+
+/// Default number of pages kept in the page cache (`PRAGMA cache_size`)
+constexpr std::size_t DEFAULT_DB_CACHE_SIZE = 10000;
+
+/// Default WAL size in pages that triggers an automatic checkpoint (`PRAGMA wal_autocheckpoint`).
+/// Disabled because the backend schedules checkpoints itself, off the commit path.
+constexpr std::size_t DEFAULT_DB_WAL_AUTOCHECKPOINT = 0;
+
+/// Default delay in seconds between a write and the passive WAL checkpoint that follows it
+constexpr std::size_t DEFAULT_DB_CHECKPOINT_INTERVAL = 30;
+
+/// Default time in milliseconds to wait for a lock held by another connection
+constexpr std::size_t DEFAULT_DB_BUSY_TIMEOUT_MS = 5000;
+
+/// Default number of days whose keystroke rows are kept, 0 keeps them forever
+constexpr std::size_t DEFAULT_DB_RETENTION_DAYS = 0;
+
+/// Keystroke rows deleted per retention transaction, small enough to never hold up a flush
+constexpr std::size_t RETENTION_BATCH_ROWS = 1000;
+
+/// Pause between two retention batches pruned on the input thread, so it keeps handling input
+constexpr std::chrono::seconds RETENTION_BATCH_INTERVAL{ 1 };
+
+// ============================================================================
+// Sync Constants
+// ============================================================================
+
+/// Longest host ID a delta log can be written under
+constexpr std::size_t MAX_SYNC_HOST_SIZE = 64;
+
+/// Directory of the delta logs inside the database directory, unless configured otherwise
+constexpr std::string_view SYNC_DIR_NAME = "sync";
+
+/// File name extension of a delta log, the host ID is its stem
+constexpr std::string_view DELTA_LOG_EXTENSION = ".ttdl";
+
+// ============================================================================
+// Time Constants
+// ============================================================================
+
+/// Maximum time the cached local day is trusted before the system time zone is checked again
+constexpr std::chrono::minutes TIME_ZONE_CHECK_INTERVAL{ 1 };
+
+// ============================================================================
+// D-Bus Constants
+// ============================================================================
+
+/// Well-known name the backend owns on the session bus
+constexpr const char *DBUS_SERVICE_NAME = "org.typetrace.Backend";
+
+/// Object path of the backend's keystroke interface
+constexpr const char *DBUS_OBJECT_PATH = "/org/typetrace/Backend";
+
+/// Interface exposing live keystroke deltas and the in-memory snapshot
+constexpr const char *DBUS_INTERFACE_NAME = "org.typetrace.Backend1";
+
+/// Minimum time between two keystroke delta signals, deltas are coalesced in between
+constexpr std::chrono::milliseconds DBUS_SIGNAL_INTERVAL{ 100 };
+
+/// Service, object and interface of UPower on the system bus, it reports the power source
+constexpr const char *UPOWER_SERVICE_NAME = "org.freedesktop.UPower";
+constexpr const char *UPOWER_OBJECT_PATH = "/org/freedesktop/UPower";
+constexpr const char *UPOWER_INTERFACE_NAME = "org.freedesktop.UPower";
+
+/// Service, object and interface of the logind manager on the system bus, it announces suspends
+constexpr const char *LOGIND_SERVICE_NAME = "org.freedesktop.login1";
+constexpr const char *LOGIND_OBJECT_PATH = "/org/freedesktop/login1";
+constexpr const char *LOGIND_INTERFACE_NAME = "org.freedesktop.login1.Manager";
+
+/// Longest time a suspend waits for the buffered keystrokes to be committed, below logind's
+/// default `InhibitDelayMaxSec` of 5 seconds
+constexpr std::chrono::milliseconds SLEEP_FLUSH_TIMEOUT{ 4000 };
+
+// ============================================================================
+// Key Constants
+// ============================================================================
+
+/// Number of distinct key codes defined by the kernel (`KEY_MAX + 1`)
+constexpr std::size_t KEY_CODE_COUNT = KEY_CNT;
+
+/// Seat udev assigns to devices without an `ID_SEAT` property
+constexpr std::string_view DEFAULT_SEAT = "seat0";
+
+// ============================================================================
+// Replay Constants
+// ============================================================================
+
+/// Default keystrokes per second of the typing pattern, a fast typist
+constexpr std::size_t REPLAY_TYPING_RATE = 10;
+
+/// Default keystrokes per second of the flood pattern, a macro firing at 1 kHz
+constexpr std::size_t REPLAY_FLOOD_RATE = 1000;
+
+/// Default number of keystrokes a generated replay consists of
+constexpr std::size_t REPLAY_KEYSTROKES = 100'000;
+
+/// Interval at which a rate limited replay releases the keystrokes that became due
+constexpr std::chrono::milliseconds REPLAY_TICK{ 10 };
+
+/// Directory in the system's temporary directory that holds the database of a replay
+constexpr std::string_view REPLAY_DIR_NAME = "typetrace-replay";
+
+// ============================================================================
+// Logging Constants
+// ============================================================================
+
+/// Messages the async logger can queue before it drops the oldest ones
+constexpr std::size_t LOG_QUEUE_SIZE = 8192;
+
+/// Size in bytes at which the log file is rotated
+constexpr std::size_t LOG_FILE_MAX_SIZE = 5 * 1024 * 1024;
+
+/// Number of rotated log files kept besides the current one
+constexpr std::size_t LOG_FILE_COUNT = 3;
 
 // ============================================================================
 // File and Directory Constants
@@ -31,6 +170,21 @@ constexpr std::string_view PROJECT_DIR_NAME = "typetrace";
 /// SQLite database file name
 constexpr std::string_view DB_FILE_NAME = "TypeTrace.db";
 
+/// Backend configuration file name, looked up in the XDG config directory
+constexpr std::string_view CONFIG_FILE_NAME = "backend.conf";
+
+/// Shared-memory segment with the live counters, created in the XDG runtime directory
+constexpr std::string_view LIVE_COUNTERS_FILE_NAME = "typetrace.live";
+
+/// Spill file name for keystrokes that are buffered but not yet written to the database
+constexpr std::string_view SPILL_FILE_NAME = "TypeTrace.spill";
+
+/// Statistics snapshot the backend keeps next to the database for a fast frontend start
+constexpr std::string_view STATS_SNAPSHOT_FILE_NAME = "TypeTrace.snapshot";
+
+/// Lock file that keeps a second backend from writing to the same database
+constexpr std::string_view LOCK_FILE_NAME = "TypeTrace.lock";
+
 } // namespace typetrace
 
 #endif
@@ -0,0 +1,231 @@
+#include "dimension_matrix.hpp"
+
+#include "blob_codec.hpp"
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace typetrace {
+
+namespace {
+
+/// Format version stored in the first byte of a blob
+constexpr std::uint8_t BLOB_VERSION = 1;
+
+/// Names the blob in error messages
+constexpr std::string_view BLOB_NAME = "Dimension blob";
+
+/// Layout of a blob as read from its header
+struct BlobHeader
+{
+    std::vector<std::string> device_ids;
+    std::size_t offsets_start{ 0 }; ///< Position of the offset table
+    std::size_t rows_start{ 0 };    ///< Position the row offsets are relative to
+};
+
+/// Reads the header of a blob and checks that it matches this build's key codes
+auto readHeader(const std::span<const std::uint8_t> blob) -> BlobHeader
+{
+    BlobReader reader{ blob, 0, BLOB_NAME };
+
+    if (reader.byte() != BLOB_VERSION) {
+        throw DatabaseError("Dimension blob has an unsupported version");
+    }
+    if (reader.varint() != KEY_CODE_COUNT || reader.varint() != DimensionMatrix::HOURS_PER_DAY) {
+        throw DatabaseError("Dimension blob has an unexpected shape");
+    }
+
+    BlobHeader header;
+    const std::uint64_t device_count = reader.varint();
+    for (std::uint64_t device = 0; device < device_count; ++device) {
+        header.device_ids.emplace_back(reader.text(reader.varint()));
+    }
+
+    header.offsets_start = reader.tell();
+    header.rows_start
+      = header.offsets_start
+        + (header.device_ids.size() * DimensionMatrix::HOURS_PER_DAY * BLOB_OFFSET_SIZE);
+    return header;
+}
+
+/// Reads a row at the reader's position and hands every pressed key to `on_count`
+template<typename Callback>
+auto readRow(BlobReader &reader, Callback &&on_count) -> void
+{
+    const std::uint64_t entries = reader.varint();
+    std::uint64_t key_code{ 0 };
+
+    for (std::uint64_t entry = 0; entry < entries; ++entry) {
+        key_code += reader.varint() + (entry > 0 ? 1 : 0);
+        const std::uint64_t count = reader.varint();
+
+        if (key_code >= KEY_CODE_COUNT || count > UINT32_MAX) {
+            throw DatabaseError("Dimension blob holds an invalid count");
+        }
+        on_count(static_cast<std::uint16_t>(key_code), static_cast<std::uint32_t>(count));
+    }
+}
+
+} // namespace
+
+DimensionMatrix::DimensionMatrix(const DayNumber day) : matrix_day(day) {}
+
+auto DimensionMatrix::day() const -> DayNumber
+{
+    return matrix_day;
+}
+
+auto DimensionMatrix::empty() const -> bool
+{
+    const auto is_zero = [](const std::uint32_t value) -> bool { return value == 0; };
+    return std::ranges::all_of(counts, [&](const auto &device_counts) -> bool {
+        return std::ranges::all_of(device_counts, is_zero);
+    });
+}
+
+auto DimensionMatrix::devices() const -> const std::vector<std::string> &
+{
+    return device_ids;
+}
+
+auto DimensionMatrix::addDevice(const std::string_view device_id) -> std::size_t
+{
+    const auto existing = std::ranges::find(device_ids, device_id);
+    if (existing != device_ids.end()) {
+        return static_cast<std::size_t>(existing - device_ids.begin());
+    }
+
+    device_ids.emplace_back(device_id);
+    counts.emplace_back(HOURS_PER_DAY * KEY_CODE_COUNT, 0);
+    return device_ids.size() - 1;
+}
+
+auto DimensionMatrix::add(const std::size_t device,
+                          const std::size_t hour,
+                          const std::uint16_t key_code,
+                          const std::uint32_t count) -> void
+{
+    counts.at(device).at(cell(std::min(hour, HOURS_PER_DAY - 1), key_code)) += count;
+}
+
+auto DimensionMatrix::count(const std::size_t device,
+                            const std::size_t hour,
+                            const std::uint16_t key_code) const -> std::uint32_t
+{
+    return device < counts.size() ? counts.at(device).at(cell(hour, key_code)) : 0;
+}
+
+auto DimensionMatrix::merge(const DimensionMatrix &other) -> void
+{
+    for (std::size_t other_device = 0; other_device < other.device_ids.size(); ++other_device) {
+        auto &target = counts.at(addDevice(other.device_ids.at(other_device)));
+        const auto &source = other.counts.at(other_device);
+
+        std::ranges::transform(target, source, target.begin(), std::plus{});
+    }
+}
+
+auto DimensionMatrix::encode() const -> std::vector<std::uint8_t>
+{
+    std::vector<std::uint8_t> blob;
+    blob.push_back(BLOB_VERSION);
+    writeVarint(blob, KEY_CODE_COUNT);
+    writeVarint(blob, HOURS_PER_DAY);
+    writeVarint(blob, device_ids.size());
+
+    for (const auto &device_id : device_ids) {
+        writeVarint(blob, device_id.size());
+        blob.insert(blob.end(), device_id.begin(), device_id.end());
+    }
+
+    // The offset table is filled in once the rows are written behind it
+    const std::size_t offsets_start = blob.size();
+    blob.resize(offsets_start + (device_ids.size() * HOURS_PER_DAY * BLOB_OFFSET_SIZE));
+    const std::size_t rows_start = blob.size();
+
+    for (std::size_t device = 0; device < counts.size(); ++device) {
+        for (std::size_t hour = 0; hour < HOURS_PER_DAY; ++hour) {
+            const auto offset = static_cast<std::uint32_t>(blob.size() - rows_start);
+            const std::size_t entry
+              = offsets_start + (((device * HOURS_PER_DAY) + hour) * BLOB_OFFSET_SIZE);
+            writeOffset(blob, entry, offset);
+
+            const auto row = std::span{ counts.at(device) }.subspan(hour * KEY_CODE_COUNT,
+                                                                    KEY_CODE_COUNT);
+            writeVarint(blob, static_cast<std::size_t>(std::ranges::count_if(
+                                row, [](const auto value) -> bool { return value != 0; })));
+
+            // The first key is stored as is, later ones as the gap to the previous pressed key
+            std::size_t next_key{ 0 };
+            for (std::size_t key_code = 0; key_code < row.size(); ++key_code) {
+                if (row[key_code] != 0) {
+                    writeVarint(blob, key_code - next_key);
+                    writeVarint(blob, row[key_code]);
+                    next_key = key_code + 1;
+                }
+            }
+        }
+    }
+
+    return blob;
+}
+
+auto DimensionMatrix::decode(const DayNumber day, const std::span<const std::uint8_t> blob)
+  -> DimensionMatrix
+{
+    const BlobHeader header = readHeader(blob);
+
+    DimensionMatrix matrix{ day };
+    for (const auto &device_id : header.device_ids) {
+        matrix.addDevice(device_id);
+    }
+
+    // Rows are stored in order, so they can be read without going through the offset table
+    BlobReader reader{ blob, header.rows_start, BLOB_NAME };
+    for (std::size_t device = 0; device < header.device_ids.size(); ++device) {
+        for (std::size_t hour = 0; hour < HOURS_PER_DAY; ++hour) {
+            readRow(reader, [&](const std::uint16_t key_code, const std::uint32_t count) -> void {
+                matrix.add(device, hour, key_code, count);
+            });
+        }
+    }
+
+    return matrix;
+}
+
+auto DimensionMatrix::decodeRow(const std::span<const std::uint8_t> blob,
+                                const std::size_t device,
+                                const std::size_t hour) -> Row
+{
+    const BlobHeader header = readHeader(blob);
+    if (device >= header.device_ids.size() || hour >= HOURS_PER_DAY) {
+        throw DatabaseError("Dimension blob has no such row");
+    }
+
+    const std::size_t entry
+      = header.offsets_start + (((device * HOURS_PER_DAY) + hour) * BLOB_OFFSET_SIZE);
+    BlobReader offsets{ blob, entry, BLOB_NAME };
+    BlobReader reader{ blob, header.rows_start + offsets.offset(), BLOB_NAME };
+
+    Row row(KEY_CODE_COUNT, 0);
+    readRow(reader, [&](const std::uint16_t key_code, const std::uint32_t count) -> void {
+        row.at(key_code) = count;
+    });
+    return row;
+}
+
+auto DimensionMatrix::cell(const std::size_t hour, const std::uint16_t key_code) -> std::size_t
+{
+    return (hour * KEY_CODE_COUNT) + key_code;
+}
+
+} // namespace typetrace
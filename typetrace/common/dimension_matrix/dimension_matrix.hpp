@@ -0,0 +1,84 @@
+#ifndef TYPETRACE_DIMENSION_MATRIX_HPP
+#define TYPETRACE_DIMENSION_MATRIX_HPP
+
+#include "constants.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace typetrace {
+
+/// Key presses of one day broken down by keyboard and local hour.
+///
+/// In memory the counts are dense, so counting a press is a single increment. Stored, the day is
+/// one blob that holds the keyboard IDs, a table with the byte offset of every keyboard-hour row
+/// and the rows themselves. A row lists only its pressed keys, each as the distance to the
+/// previous pressed key and its count, all as varints. A single row can be decoded without the
+/// rest of the blob through the offset table.
+class DimensionMatrix
+{
+  public:
+    /// Hours of a day, presses after the 24th hour of a long DST day count towards the last one
+    static constexpr std::size_t HOURS_PER_DAY = 24;
+
+    /// Counts of one keyboard in one hour, indexed by key code
+    using Row = std::vector<std::uint32_t>;
+
+    /// Creates an empty matrix for `day`
+    explicit DimensionMatrix(DayNumber day = 0);
+
+    /// Returns the day the counts belong to
+    [[nodiscard]] auto day() const -> DayNumber;
+
+    /// Returns true if no key press was counted
+    [[nodiscard]] auto empty() const -> bool;
+
+    /// Returns the IDs of the keyboards, in the order of their indices
+    [[nodiscard]] auto devices() const -> const std::vector<std::string> &;
+
+    /// Returns the index of the keyboard with `device_id`, adding it if it is new
+    auto addDevice(std::string_view device_id) -> std::size_t;
+
+    /// Counts presses of a key on the keyboard at `device` in `hour`
+    auto add(std::size_t device, std::size_t hour, std::uint16_t key_code, std::uint32_t count = 1)
+      -> void;
+
+    /// Returns the count of a key, 0 for keyboards that have no index
+    [[nodiscard]] auto count(std::size_t device, std::size_t hour, std::uint16_t key_code) const
+      -> std::uint32_t;
+
+    /// Adds all counts of another matrix, keyboards are matched by ID
+    auto merge(const DimensionMatrix &other) -> void;
+
+    /// Serializes the matrix into its blob format
+    [[nodiscard]] auto encode() const -> std::vector<std::uint8_t>;
+
+    /// Parses a blob written by `encode()`, throws `DatabaseError` if it is malformed
+    [[nodiscard]] static auto decode(DayNumber day, std::span<const std::uint8_t> blob)
+      -> DimensionMatrix;
+
+    /// Parses only the row of one keyboard and hour of a blob, throws `DatabaseError` if the
+    /// blob is malformed or has no such row
+    [[nodiscard]] static auto decodeRow(std::span<const std::uint8_t> blob,
+                                        std::size_t device,
+                                        std::size_t hour) -> Row;
+
+  private:
+    /// Returns the flat index of a count in a keyboard's counts
+    [[nodiscard]] static auto cell(std::size_t hour, std::uint16_t key_code) -> std::size_t;
+
+    DayNumber matrix_day;
+    std::vector<std::string> device_ids;
+
+    /// Counts per keyboard, `HOURS_PER_DAY` rows of `KEY_CODE_COUNT` entries each
+    std::vector<std::vector<std::uint32_t>> counts;
+};
+
+} // namespace typetrace
+
+#endif
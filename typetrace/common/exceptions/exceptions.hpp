@@ -19,7 +19,16 @@ class ConfigurationError : public std::runtime_error
 class DatabaseError : public std::runtime_error
 {
   public:
-    explicit DatabaseError(const std::string &msg) : std::runtime_error("Database error: " + msg) {}
+    explicit DatabaseError(const std::string &msg, const bool transient = false) :
+      std::runtime_error("Database error: " + msg), transient_error(transient)
+    {
+    }
+
+    /// Returns true if the failure may pass by itself, like a busy database or a full disk
+    [[nodiscard]] auto isTransient() const -> bool { return transient_error; }
+
+  private:
+    bool transient_error;
 };
 
 class PermissionError : public std::runtime_error
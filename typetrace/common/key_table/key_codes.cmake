@@ -0,0 +1,57 @@
+# Generates the key code table of `key_codes.hpp.in` from the kernel's input event codes
+
+# Range markers that take the code of an actual key or none, skipped like libevdev does
+set(KEY_CODE_ALIASES
+    KEY_MAX
+    KEY_CNT
+    BTN_MISC
+    BTN_MOUSE
+    BTN_JOYSTICK
+    BTN_GAMEPAD
+    BTN_DIGI
+    BTN_WHEEL
+    BTN_TRIGGER_HAPPY
+)
+
+set(KEY_CODE_DEFINE_REGEX "^#define[ \t]+((KEY|BTN)_[A-Za-z0-9_]+)[ \t]+(0x[0-9a-fA-F]+|[0-9]+)")
+
+# Writes `output` with every `KEY_*` and `BTN_*` definition with a numeric value in `header`.
+# Aliases defined as another macro are left out, of two numeric definitions the first wins.
+function(generate_key_codes header template output)
+    file(STRINGS ${header} defines REGEX "${KEY_CODE_DEFINE_REGEX}")
+
+    # Kernel header updates regenerate the table on the next build
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${header})
+
+    set(pairs "")
+    set(seen_codes "")
+    set(count 0)
+
+    foreach(define IN LISTS defines)
+        string(REGEX MATCH "${KEY_CODE_DEFINE_REGEX}" match "${define}")
+        set(name ${CMAKE_MATCH_1})
+        math(EXPR code "${CMAKE_MATCH_3}" OUTPUT_FORMAT DECIMAL)
+
+        if(name IN_LIST KEY_CODE_ALIASES OR code IN_LIST seen_codes)
+            continue()
+        endif()
+
+        list(APPEND seen_codes ${code})
+        list(APPEND pairs "${code}:${name}")
+        math(EXPR count "${count} + 1")
+    endforeach()
+
+    # The header is ordered by code with few exceptions, sorting keeps the table ascending
+    list(SORT pairs COMPARE NATURAL)
+    set(entries "")
+    foreach(pair IN LISTS pairs)
+        string(REPLACE ":" ";" fields ${pair})
+        list(GET fields 0 code)
+        list(GET fields 1 name)
+        string(APPEND entries "    { ${code}, \"${name}\" },\n")
+    endforeach()
+
+    set(KEY_CODE_NAME_COUNT ${count})
+    set(KEY_CODE_NAME_ENTRIES "${entries}")
+    configure_file(${template} ${output} @ONLY)
+endfunction()
@@ -0,0 +1,160 @@
+#ifndef TYPETRACE_KEY_TABLE_HPP
+#define TYPETRACE_KEY_TABLE_HPP
+
+#include "constants.hpp"
+#include "key_codes.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <linux/input-event-codes.h>
+#include <span>
+#include <string_view>
+
+namespace typetrace {
+
+/// Name of key codes the kernel headers do not define
+constexpr std::string_view UNKNOWN_KEY_NAME = "UNKNOWN";
+
+/// Kernel name of every key code (e.g. `KEY_A`), indexed by the code
+constexpr auto KEY_NAMES = []() -> std::array<std::string_view, KEY_CODE_COUNT> {
+    std::array<std::string_view, KEY_CODE_COUNT> names{};
+    names.fill(UNKNOWN_KEY_NAME);
+    for (const auto &[key_code, name] : KEY_CODE_NAMES) {
+        if (key_code < names.size()) {
+            names.at(key_code) = name;
+        }
+    }
+    return names;
+}();
+
+/// Returns the kernel name of a key code, or `UNKNOWN` if it has none.
+/// The view always refers to a null-terminated string literal.
+[[nodiscard]] constexpr auto getKeyName(const std::size_t key_code) -> std::string_view
+{
+    return key_code < KEY_NAMES.size() ? KEY_NAMES.at(key_code) : UNKNOWN_KEY_NAME;
+}
+
+/// A key of the keyboard layout, lengths are in key units
+struct KeyPosition
+{
+    std::uint16_t key_code{ 0 };
+    const char *label{ nullptr };
+    float width{ 1.0F };
+    std::size_t row{ 0 };
+    float column{ 0.0F }; ///< Left edge of the key
+};
+
+/// Number of rows of the keyboard layout
+constexpr std::size_t KEYBOARD_ROWS = 6;
+
+/// Width of every row of the keyboard layout in key units
+constexpr float KEYBOARD_UNITS = 15.0F;
+
+namespace detail {
+
+/// Rows of an ANSI layout, `row` and `column` are filled in by `placeKeys()`
+constexpr std::array<KeyPosition, 14> FUNCTION_ROW{ {
+  { KEY_ESC, "Esc", 1.0F }, { KEY_F1, "F1" }, { KEY_F2, "F2" }, { KEY_F3, "F3" },
+  { KEY_F4, "F4" }, { KEY_F5, "F5" }, { KEY_F6, "F6" }, { KEY_F7, "F7" }, { KEY_F8, "F8" },
+  { KEY_F9, "F9" }, { KEY_F10, "F10" }, { KEY_F11, "F11" }, { KEY_F12, "F12" },
+  { KEY_DELETE, "Del", 2.0F },
+} };
+
+constexpr std::array<KeyPosition, 14> NUMBER_ROW{ {
+  { KEY_GRAVE, "`" }, { KEY_1, "1" }, { KEY_2, "2" }, { KEY_3, "3" }, { KEY_4, "4" },
+  { KEY_5, "5" }, { KEY_6, "6" }, { KEY_7, "7" }, { KEY_8, "8" }, { KEY_9, "9" }, { KEY_0, "0" },
+  { KEY_MINUS, "-" }, { KEY_EQUAL, "=" }, { KEY_BACKSPACE, "Backspace", 2.0F },
+} };
+
+constexpr std::array<KeyPosition, 14> TOP_ROW{ {
+  { KEY_TAB, "Tab", 1.5F }, { KEY_Q, "Q" }, { KEY_W, "W" }, { KEY_E, "E" }, { KEY_R, "R" },
+  { KEY_T, "T" }, { KEY_Y, "Y" }, { KEY_U, "U" }, { KEY_I, "I" }, { KEY_O, "O" }, { KEY_P, "P" },
+  { KEY_LEFTBRACE, "[" }, { KEY_RIGHTBRACE, "]" }, { KEY_BACKSLASH, "\\", 1.5F },
+} };
+
+constexpr std::array<KeyPosition, 13> HOME_ROW{ {
+  { KEY_CAPSLOCK, "Caps", 1.75F }, { KEY_A, "A" }, { KEY_S, "S" }, { KEY_D, "D" }, { KEY_F, "F" },
+  { KEY_G, "G" }, { KEY_H, "H" }, { KEY_J, "J" }, { KEY_K, "K" }, { KEY_L, "L" },
+  { KEY_SEMICOLON, ";" }, { KEY_APOSTROPHE, "'" }, { KEY_ENTER, "Enter", 2.25F },
+} };
+
+constexpr std::array<KeyPosition, 12> BOTTOM_ROW{ {
+  { KEY_LEFTSHIFT, "Shift", 2.25F }, { KEY_Z, "Z" }, { KEY_X, "X" }, { KEY_C, "C" },
+  { KEY_V, "V" }, { KEY_B, "B" }, { KEY_N, "N" }, { KEY_M, "M" }, { KEY_COMMA, "," },
+  { KEY_DOT, "." }, { KEY_SLASH, "/" }, { KEY_RIGHTSHIFT, "Shift", 2.75F },
+} };
+
+constexpr std::array<KeyPosition, 8> SPACE_ROW{ {
+  { KEY_LEFTCTRL, "Ctrl", 1.25F }, { KEY_LEFTMETA, "Super", 1.25F },
+  { KEY_LEFTALT, "Alt", 1.25F }, { KEY_SPACE, "Space", 6.25F }, { KEY_RIGHTALT, "AltGr", 1.25F },
+  { KEY_RIGHTMETA, "Super", 1.25F }, { KEY_COMPOSE, "Menu", 1.25F },
+  { KEY_RIGHTCTRL, "Ctrl", 1.25F },
+} };
+
+constexpr std::array<std::span<const KeyPosition>, KEYBOARD_ROWS> ROWS{
+    FUNCTION_ROW, NUMBER_ROW, TOP_ROW, HOME_ROW, BOTTOM_ROW, SPACE_ROW,
+};
+
+/// Number of keys in all rows
+constexpr std::size_t KEY_COUNT = []() -> std::size_t {
+    std::size_t count{ 0 };
+    for (const auto &row : ROWS) {
+        count += row.size();
+    }
+    return count;
+}();
+
+/// Concatenates the rows and gives every key its row and the column where it starts
+consteval auto placeKeys() -> std::array<KeyPosition, KEY_COUNT>
+{
+    std::array<KeyPosition, KEY_COUNT> keys{};
+    std::size_t index{ 0 };
+
+    for (std::size_t row = 0; row < ROWS.size(); ++row) {
+        float column{ 0.0F };
+        for (KeyPosition key : ROWS.at(row)) {
+            key.row = row;
+            key.column = column;
+            column += key.width;
+            keys.at(index++) = key;
+        }
+    }
+
+    return keys;
+}
+
+} // namespace detail
+
+/// Every key of the layout row by row, from left to right
+constexpr std::array<KeyPosition, detail::KEY_COUNT> KEYBOARD_LAYOUT = detail::placeKeys();
+
+/// Index into `KEYBOARD_LAYOUT` by key code, -1 for keys the layout does not show
+constexpr auto KEYBOARD_LAYOUT_INDEX = []() -> std::array<std::int16_t, KEY_CODE_COUNT> {
+    std::array<std::int16_t, KEY_CODE_COUNT> index{};
+    index.fill(-1);
+    for (std::size_t key = 0; key < KEYBOARD_LAYOUT.size(); ++key) {
+        index.at(KEYBOARD_LAYOUT.at(key).key_code) = static_cast<std::int16_t>(key);
+    }
+    return index;
+}();
+
+// Widths are multiples of a quarter unit, so the sums are exact
+static_assert(
+  []() -> bool {
+      for (const auto &row : detail::ROWS) {
+          float width{ 0.0F };
+          for (const KeyPosition &key : row) {
+              width += key.width;
+          }
+          if (width != KEYBOARD_UNITS) {
+              return false;
+          }
+      }
+      return true;
+  }(),
+  "Every row of the keyboard layout must be KEYBOARD_UNITS wide");
+
+} // namespace typetrace
+
+#endif
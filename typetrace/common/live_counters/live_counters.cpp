@@ -0,0 +1,104 @@
+#include "live_counters.hpp"
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace typetrace {
+
+auto getLiveCountersPath() -> std::filesystem::path
+{
+    const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir == nullptr) {
+        throw SystemError("XDG_RUNTIME_DIR environment variable is not set");
+    }
+
+    return std::filesystem::path{ runtime_dir } / LIVE_COUNTERS_FILE_NAME;
+}
+
+LiveCountersReader::LiveCountersReader(const std::filesystem::path &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw SystemError(std::format(
+          "Failed to open live counters '{}': {}", path.string(), std::strerror(errno)));
+    }
+
+    struct stat file_stat{};
+    const bool has_expected_size = ::fstat(fd, &file_stat) == 0
+                                   && static_cast<std::size_t>(file_stat.st_size)
+                                        == sizeof(LiveCounters);
+
+    void *const mapping = has_expected_size
+                            ? ::mmap(nullptr, sizeof(LiveCounters), PROT_READ, MAP_SHARED, fd, 0)
+                            : MAP_FAILED;
+
+    // The mapping stays valid without the file descriptor
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        throw SystemError(std::format("Failed to map live counters '{}'", path.string()));
+    }
+    counters = static_cast<LiveCounters *>(mapping);
+
+    const auto magic = std::atomic_ref{ counters->magic }.load(std::memory_order_acquire);
+    if (magic != LIVE_COUNTERS_MAGIC || counters->version != LIVE_COUNTERS_VERSION) {
+        ::munmap(counters, sizeof(LiveCounters));
+        throw SystemError(std::format("Live counters '{}' have an unknown format", path.string()));
+    }
+}
+
+LiveCountersReader::~LiveCountersReader()
+{
+    ::munmap(counters, sizeof(LiveCounters));
+}
+
+auto LiveCountersReader::read(LiveCountersSnapshot &snapshot) const -> bool
+{
+    auto &shared = *counters;
+
+    while (true) {
+        const std::uint64_t before
+          = std::atomic_ref{ shared.sequence }.load(std::memory_order_acquire);
+
+        if (before == snapshot.sequence) {
+            return false;
+        }
+
+        // The writer is in the middle of an update
+        if ((before & 1U) != 0) {
+            continue;
+        }
+
+        snapshot.day = std::atomic_ref{ shared.day }.load(std::memory_order_relaxed);
+        for (std::size_t key_code = 0; key_code < KEY_CODE_COUNT; ++key_code) {
+            snapshot.today.at(key_code)
+              = std::atomic_ref{ shared.today.at(key_code) }.load(std::memory_order_relaxed);
+            snapshot.all_time.at(key_code)
+              = std::atomic_ref{ shared.all_time.at(key_code) }.load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::uint64_t after
+          = std::atomic_ref{ shared.sequence }.load(std::memory_order_relaxed);
+
+        if (before == after) {
+            snapshot.sequence = before;
+            return true;
+        }
+    }
+}
+
+} // namespace typetrace
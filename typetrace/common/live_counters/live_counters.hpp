@@ -0,0 +1,72 @@
+#ifndef TYPETRACE_LIVE_COUNTERS_HPP
+#define TYPETRACE_LIVE_COUNTERS_HPP
+
+#include "constants.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace typetrace {
+
+/// Identifies a live counter segment written by a compatible version ("TTLC")
+constexpr std::uint32_t LIVE_COUNTERS_MAGIC = 0x434c5454;
+
+/// Version of the `LiveCounters` layout
+constexpr std::uint32_t LIVE_COUNTERS_VERSION = 1;
+
+/// Layout of the shared-memory segment the backend publishes its counters in.
+///
+/// There is a single writer, readers use a seqlock: `sequence` is odd while the counters are
+/// being updated and every field is only accessed through `std::atomic_ref`.
+struct LiveCounters
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    alignas(64) std::uint64_t sequence;
+    DayNumber day;
+    std::array<std::uint64_t, KEY_CODE_COUNT> today;
+    std::array<std::uint64_t, KEY_CODE_COUNT> all_time;
+};
+
+/// Consistent copy of the live counters
+struct LiveCountersSnapshot
+{
+    std::uint64_t sequence{ 0 };
+    DayNumber day{ 0 };
+    std::array<std::uint64_t, KEY_CODE_COUNT> today{};
+    std::array<std::uint64_t, KEY_CODE_COUNT> all_time{};
+};
+
+/// Returns the path of the live counter segment in the user's runtime directory
+[[nodiscard]] auto getLiveCountersPath() -> std::filesystem::path;
+
+/// Read-only mapping of the live counter segment
+class LiveCountersReader
+{
+  public:
+    /// Maps the segment at `path`, throws `SystemError` if it is missing or incompatible
+    explicit LiveCountersReader(const std::filesystem::path &path = getLiveCountersPath());
+
+    /// Unmaps the segment
+    ~LiveCountersReader();
+
+    LiveCountersReader(const LiveCountersReader &) = delete;
+    auto operator=(const LiveCountersReader &) -> LiveCountersReader & = delete;
+    LiveCountersReader(LiveCountersReader &&) = delete;
+    auto operator=(LiveCountersReader &&) -> LiveCountersReader & = delete;
+
+    /// Copies the counters into `snapshot` unless they have not changed since it was taken.
+    /// Returns true if the snapshot was updated. Costs no syscall.
+    auto read(LiveCountersSnapshot &snapshot) const -> bool;
+
+  private:
+    /// Mapped read-only, non-const only because `std::atomic_ref` requires it
+    LiveCounters *counters{ nullptr };
+};
+
+} // namespace typetrace
+
+#endif
@@ -1,30 +1,88 @@
 #include "logger.hpp"
 
+#include "constants.hpp"
+
+#include "spdlog/async.h"
+#include "spdlog/async_logger.h"
 #include "spdlog/common.h"
 #include "spdlog/logger.h"
+#include "spdlog/sinks/rotating_file_sink.h"  // NOLINT
 #include "spdlog/sinks/stdout_color_sinks.h" // NOLINT
+#include "spdlog/spdlog.h"
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace typetrace {
 
-// Sets the log level of the global logger based on the debug mode
-auto initLogger(bool debug_mode) -> void
+namespace {
+
+constexpr const char *LOGGER_NAME = "typetrace";
+
+/// Owns every logger that was ever installed, so references handed out earlier stay valid
+auto installedLoggers() -> std::vector<std::shared_ptr<spdlog::logger>> &
+{
+    static std::vector<std::shared_ptr<spdlog::logger>> loggers{ std::make_shared<spdlog::logger>(
+      LOGGER_NAME,
+      std::make_shared<spdlog::sinks::stdout_color_sink_mt>(spdlog::color_mode::automatic)) };
+
+    return loggers;
+}
+
+/// The logger `getLogger()` returns, cached as a plain pointer
+auto currentLogger() -> spdlog::logger *&
+{
+    static spdlog::logger *current = installedLoggers().back().get();
+    return current;
+}
+
+} // namespace
+
+auto initLogger(const LoggerSettings &settings) -> void
 {
-    if (debug_mode) {
-        getLogger()->set_level(spdlog::level::debug);
+    std::vector<spdlog::sink_ptr> sinks{ std::make_shared<spdlog::sinks::stdout_color_sink_mt>(
+      spdlog::color_mode::automatic) };
+
+    if (settings.file) {
+        sinks.push_back(std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
+          settings.file->string(), LOG_FILE_MAX_SIZE, LOG_FILE_COUNT));
+    }
+
+    std::shared_ptr<spdlog::logger> logger;
+    if (settings.async) {
+        // A single worker keeps the messages in order
+        spdlog::init_thread_pool(LOG_QUEUE_SIZE, 1);
+        logger
+          = std::make_shared<spdlog::async_logger>(LOGGER_NAME,
+                                                   sinks.begin(),
+                                                   sinks.end(),
+                                                   spdlog::thread_pool(),
+                                                   spdlog::async_overflow_policy::overrun_oldest);
     } else {
-        getLogger()->set_level(spdlog::level::info);
+        logger = std::make_shared<spdlog::logger>(LOGGER_NAME, sinks.begin(), sinks.end());
     }
+
+    logger->set_level(settings.debug_mode ? spdlog::level::debug : spdlog::level::info);
+
+    // Warnings and errors are written out right away, they may precede a crash
+    logger->flush_on(spdlog::level::warn);
+
+    currentLogger() = logger.get();
+    installedLoggers().push_back(std::move(logger));
+}
+
+auto getLogger() -> spdlog::logger &
+{
+    return *currentLogger();
 }
 
-// Create a console logger with color output
-auto getLogger() -> std::shared_ptr<spdlog::logger>
+auto shutdownLogger() -> void
 {
-    static const std::shared_ptr<spdlog::logger> logger
-      = spdlog::stdout_color_mt("typetrace", spdlog::color_mode::automatic);
+    getLogger().flush();
 
-    return logger;
+    // Destroys the thread pool, its worker writes out the queue before it exits
+    spdlog::shutdown();
 }
 
 } // namespace typetrace
@@ -3,16 +3,36 @@
 
 #include "spdlog/logger.h"
 
-#include <memory>
+#include <filesystem>
+#include <optional>
 
 namespace typetrace {
 
-/// Initializes the global logger with a console sink.
-/// If `debug_mode` is true, sets the log level to `debug`, otherwise `info`.
-auto initLogger(bool debug_mode) -> void;
+/// Where and how log messages are written
+struct LoggerSettings
+{
+    bool debug_mode{ false }; ///< Log at `debug` instead of `info` level
 
-/// Get the global logger instance.
-auto getLogger() -> std::shared_ptr<spdlog::logger>;
+    /// Hand messages to a background thread through a bounded queue instead of writing them
+    /// on the calling thread. When the queue is full the oldest message is dropped, so logging
+    /// never waits for the terminal or the disk.
+    bool async{ false };
+
+    /// Rotating log file written in addition to the console, see `LOG_FILE_MAX_SIZE`
+    std::optional<std::filesystem::path> file;
+};
+
+/// Replaces the global logger with one built from `settings`.
+/// Must be called before other threads log, references to the previous logger stay valid.
+auto initLogger(const LoggerSettings &settings) -> void;
+
+/// Get the global logger instance, a synchronous console logger until `initLogger()` is called.
+/// The reference is cached, so calling this costs no reference counting.
+[[nodiscard]] auto getLogger() -> spdlog::logger &;
+
+/// Writes out queued messages and stops the async logger's thread, messages logged afterwards
+/// are lost
+auto shutdownLogger() -> void;
 
 } // namespace typetrace
 
@@ -0,0 +1,28 @@
+#include "paths.hpp"
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "logger.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+
+namespace typetrace {
+
+auto getDatabaseDir() -> std::filesystem::path
+{
+    if (const char *xdg_path = std::getenv("XDG_DATA_HOME")) {
+        getLogger().debug("Found XDG data directory: {}", xdg_path);
+        return std::filesystem::path{ xdg_path } / PROJECT_DIR_NAME;
+    }
+
+    const char *home = std::getenv("HOME");
+    if (home == nullptr) {
+        throw SystemError("HOME environment variable is not set");
+    }
+
+    getLogger().debug("Using default home directory: {}", home);
+    return std::filesystem::path{ home } / ".local" / "share" / PROJECT_DIR_NAME;
+}
+
+} // namespace typetrace
@@ -0,0 +1,13 @@
+#ifndef TYPETRACE_PATHS_HPP
+#define TYPETRACE_PATHS_HPP
+
+#include <filesystem>
+
+namespace typetrace {
+
+/// Gets the database directory path using XDG or fallback locations
+[[nodiscard]] auto getDatabaseDir() -> std::filesystem::path;
+
+} // namespace typetrace
+
+#endif
@@ -0,0 +1,251 @@
+#include "rhythm_stats.hpp"
+
+#include "blob_codec.hpp"
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace typetrace {
+
+namespace {
+
+/// Format version stored in the first byte of a blob
+constexpr std::uint8_t BLOB_VERSION = 1;
+
+/// Names the blob in error messages
+constexpr std::string_view BLOB_NAME = "Rhythm blob";
+
+/// Packs a key pair into a table key
+constexpr auto packPair(const std::uint16_t first, const std::uint16_t second) -> std::uint32_t
+{
+    return (static_cast<std::uint32_t>(first) << 16U) | second;
+}
+
+} // namespace
+
+RhythmStats::RhythmStats(const DayNumber day) :
+  stats_day(day), hours(HOURS_PER_DAY), slots(BIGRAM_SLOTS)
+{
+}
+
+auto RhythmStats::day() const -> DayNumber
+{
+    return stats_day;
+}
+
+auto RhythmStats::empty() const -> bool
+{
+    return std::ranges::all_of(hours, [](const Hour &entry) -> bool {
+        return std::ranges::all_of(entry.intervals,
+                                   [](const std::uint32_t count) -> bool { return count == 0; });
+    });
+}
+
+auto RhythmStats::add(const std::size_t hour_of_day,
+                      const std::uint16_t first,
+                      const std::uint16_t second,
+                      const std::uint64_t interval_usec) -> void
+{
+    const std::size_t bucket = bucketOf(interval_usec);
+    Hour &entry = hours.at(std::min(hour_of_day, HOURS_PER_DAY - 1));
+    ++entry.intervals.at(bucket);
+
+    if (bucket < PAUSE_BUCKET) {
+        entry.typing_usec += interval_usec;
+        addBigram(packPair(first, second), 1);
+    }
+}
+
+auto RhythmStats::hour(const std::size_t hour_of_day) const -> const Hour &
+{
+    return hours.at(hour_of_day);
+}
+
+auto RhythmStats::wordsPerMinute() const -> double
+{
+    constexpr double KEY_PRESSES_PER_WORD = 5;
+    constexpr double USEC_PER_MINUTE = 60'000'000;
+
+    std::uint64_t typed{ 0 };
+    std::uint64_t typing_usec{ 0 };
+    for (const Hour &entry : hours) {
+        for (std::size_t bucket = 0; bucket < PAUSE_BUCKET; ++bucket) {
+            typed += entry.intervals.at(bucket);
+        }
+        typing_usec += entry.typing_usec;
+    }
+
+    if (typing_usec == 0) {
+        return 0;
+    }
+    return (static_cast<double>(typed) / KEY_PRESSES_PER_WORD)
+           / (static_cast<double>(typing_usec) / USEC_PER_MINUTE);
+}
+
+auto RhythmStats::bigramCount(const std::uint16_t first, const std::uint16_t second) const
+  -> std::uint32_t
+{
+    return slots.at(findSlot(packPair(first, second))).count;
+}
+
+auto RhythmStats::bigrams() const -> std::vector<Bigram>
+{
+    std::vector<Bigram> result;
+    result.reserve(bigram_count);
+
+    for (const Slot &slot : slots) {
+        if (slot.pair != EMPTY_SLOT) {
+            result.push_back({ .first = static_cast<std::uint16_t>(slot.pair >> 16U),
+                               .second = static_cast<std::uint16_t>(slot.pair),
+                               .count = slot.count });
+        }
+    }
+
+    std::ranges::sort(result, std::ranges::greater{}, &Bigram::count);
+    return result;
+}
+
+auto RhythmStats::droppedBigrams() const -> std::uint64_t
+{
+    return dropped_bigrams;
+}
+
+auto RhythmStats::merge(const RhythmStats &other) -> void
+{
+    for (std::size_t index = 0; index < HOURS_PER_DAY; ++index) {
+        Hour &target = hours.at(index);
+        const Hour &source = other.hours.at(index);
+
+        std::ranges::transform(
+          target.intervals, source.intervals, target.intervals.begin(), std::plus{});
+        target.typing_usec += source.typing_usec;
+    }
+
+    for (const Slot &slot : other.slots) {
+        if (slot.pair != EMPTY_SLOT) {
+            addBigram(slot.pair, slot.count);
+        }
+    }
+    dropped_bigrams += other.dropped_bigrams;
+}
+
+auto RhythmStats::encode() const -> std::vector<std::uint8_t>
+{
+    std::vector<std::uint8_t> blob;
+    blob.push_back(BLOB_VERSION);
+    writeVarint(blob, HOURS_PER_DAY);
+    writeVarint(blob, INTERVAL_BUCKETS);
+
+    for (const Hour &entry : hours) {
+        writeVarint(blob, entry.typing_usec);
+        for (const std::uint32_t count : entry.intervals) {
+            writeVarint(blob, count);
+        }
+    }
+
+    writeVarint(blob, dropped_bigrams);
+    writeVarint(blob, bigram_count);
+
+    // Pairs are stored in order, each as the gap to the previous one
+    std::vector<Slot> used;
+    used.reserve(bigram_count);
+    std::ranges::copy_if(slots, std::back_inserter(used), [](const Slot &slot) -> bool {
+        return slot.pair != EMPTY_SLOT;
+    });
+    std::ranges::sort(used, {}, &Slot::pair);
+
+    std::uint32_t previous{ 0 };
+    for (const Slot &slot : used) {
+        writeVarint(blob, slot.pair - previous);
+        writeVarint(blob, slot.count);
+        previous = slot.pair;
+    }
+
+    return blob;
+}
+
+auto RhythmStats::decode(const DayNumber day, const std::span<const std::uint8_t> blob)
+  -> RhythmStats
+{
+    BlobReader reader{ blob, 0, BLOB_NAME };
+
+    if (reader.byte() != BLOB_VERSION) {
+        throw DatabaseError("Rhythm blob has an unsupported version");
+    }
+    if (reader.varint() != HOURS_PER_DAY || reader.varint() != INTERVAL_BUCKETS) {
+        throw DatabaseError("Rhythm blob has an unexpected shape");
+    }
+
+    const auto count32 = [&reader]() -> std::uint32_t {
+        const std::uint64_t value = reader.varint();
+        if (value > UINT32_MAX) {
+            throw DatabaseError("Rhythm blob holds an invalid count");
+        }
+        return static_cast<std::uint32_t>(value);
+    };
+
+    RhythmStats stats{ day };
+    for (Hour &entry : stats.hours) {
+        entry.typing_usec = reader.varint();
+        for (std::uint32_t &count : entry.intervals) {
+            count = count32();
+        }
+    }
+
+    stats.dropped_bigrams = reader.varint();
+
+    const std::uint64_t pairs = reader.varint();
+    std::uint64_t pair{ 0 };
+    for (std::uint64_t entry = 0; entry < pairs; ++entry) {
+        pair += reader.varint();
+        if ((pair >> 16U) >= KEY_CODE_COUNT || (pair & UINT16_MAX) >= KEY_CODE_COUNT) {
+            throw DatabaseError("Rhythm blob holds an invalid key pair");
+        }
+        stats.addBigram(static_cast<std::uint32_t>(pair), count32());
+    }
+
+    return stats;
+}
+
+auto RhythmStats::addBigram(const std::uint32_t pair, const std::uint32_t count) -> void
+{
+    Slot &slot = slots.at(findSlot(pair));
+
+    if (slot.pair == EMPTY_SLOT) {
+        if (bigram_count == MAX_BIGRAMS) {
+            dropped_bigrams += count;
+            return;
+        }
+        slot.pair = pair;
+        ++bigram_count;
+    }
+
+    slot.count += count;
+}
+
+auto RhythmStats::findSlot(const std::uint32_t pair) const -> std::size_t
+{
+    // Fibonacci hashing, the top bits of the product index the table
+    constexpr std::uint32_t GOLDEN_RATIO = 0x9e3779b1;
+    constexpr auto SHIFT = static_cast<unsigned>(32 - std::countr_zero(BIGRAM_SLOTS));
+    constexpr std::size_t MASK = BIGRAM_SLOTS - 1;
+
+    // The table is never full, so the probe always ends at the pair or a free slot
+    std::size_t index = static_cast<std::uint32_t>(pair * GOLDEN_RATIO) >> SHIFT;
+    while (slots.at(index).pair != pair && slots.at(index).pair != EMPTY_SLOT) {
+        index = (index + 1) & MASK;
+    }
+    return index;
+}
+
+} // namespace typetrace
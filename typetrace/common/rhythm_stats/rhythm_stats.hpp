@@ -0,0 +1,132 @@
+#ifndef TYPETRACE_RHYTHM_STATS_HPP
+#define TYPETRACE_RHYTHM_STATS_HPP
+
+#include "types.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace typetrace {
+
+/// Typing rhythm of one day: intervals between key presses per local hour and key pairs.
+///
+/// Intervals are counted in a fixed set of log2 buckets of milliseconds together with the time
+/// spent typing, so words per minute and latency percentiles can be derived without storing a
+/// single event. An interval that reaches `PAUSE_BUCKET` is a pause, it is counted but adds
+/// neither typing time nor a key pair. Key pairs (bigrams) live in an open-addressing table
+/// with linear probing and a fixed capacity, pairs that no longer fit are only counted as
+/// dropped. Both parts have a fixed size, so a day costs the same memory however much is typed.
+class RhythmStats
+{
+  public:
+    /// Hours of a day, intervals after the 24th hour of a long DST day count towards the last one
+    static constexpr std::size_t HOURS_PER_DAY = 24;
+
+    /// Interval buckets, bucket `b > 0` holds intervals of `2^(b-1)` to `2^b - 1` milliseconds
+    /// and the last one everything above
+    static constexpr std::size_t INTERVAL_BUCKETS = 16;
+
+    /// First bucket that counts as a pause, intervals of 2048 milliseconds and more
+    static constexpr std::size_t PAUSE_BUCKET = 12;
+
+    /// Slots of the key pair table, a power of two
+    static constexpr std::size_t BIGRAM_SLOTS = 4096;
+
+    /// Key pairs the table holds at most, so probe sequences stay short
+    static constexpr std::size_t MAX_BIGRAMS = BIGRAM_SLOTS / 4 * 3;
+
+    /// Intervals of one hour
+    struct Hour
+    {
+        std::array<std::uint32_t, INTERVAL_BUCKETS> intervals{}; ///< Counts per bucket
+        std::uint64_t typing_usec{ 0 }; ///< Sum of the intervals below `PAUSE_BUCKET`
+    };
+
+    /// A key followed by another one, without a pause in between
+    struct Bigram
+    {
+        std::uint16_t first{ 0 };
+        std::uint16_t second{ 0 };
+        std::uint32_t count{ 0 };
+    };
+
+    /// Creates empty stats for `day`
+    explicit RhythmStats(DayNumber day = 0);
+
+    /// Returns the bucket of an interval given in microseconds
+    [[nodiscard]] static constexpr auto bucketOf(const std::uint64_t interval_usec) -> std::size_t
+    {
+        constexpr std::uint64_t USEC_PER_MSEC = 1000;
+        const auto bits = static_cast<std::size_t>(std::bit_width(interval_usec / USEC_PER_MSEC));
+        return bits < INTERVAL_BUCKETS ? bits : INTERVAL_BUCKETS - 1;
+    }
+
+    /// Returns the day the stats belong to
+    [[nodiscard]] auto day() const -> DayNumber;
+
+    /// Returns true if no interval was counted
+    [[nodiscard]] auto empty() const -> bool;
+
+    /// Counts the interval between a press of `first` and the following press of `second`
+    auto add(std::size_t hour_of_day,
+             std::uint16_t first,
+             std::uint16_t second,
+             std::uint64_t interval_usec) -> void;
+
+    /// Returns the intervals of the hour `hour_of_day`
+    [[nodiscard]] auto hour(std::size_t hour_of_day) const -> const Hour &;
+
+    /// Returns the typing speed over the whole day, counting five key presses as a word
+    [[nodiscard]] auto wordsPerMinute() const -> double;
+
+    /// Returns how often `second` followed `first`
+    [[nodiscard]] auto bigramCount(std::uint16_t first, std::uint16_t second) const
+      -> std::uint32_t;
+
+    /// Returns all key pairs, most frequent first
+    [[nodiscard]] auto bigrams() const -> std::vector<Bigram>;
+
+    /// Returns the number of key pairs that were not counted because the table was full
+    [[nodiscard]] auto droppedBigrams() const -> std::uint64_t;
+
+    /// Adds all counts of another day's stats
+    auto merge(const RhythmStats &other) -> void;
+
+    /// Serializes the stats into their blob format
+    [[nodiscard]] auto encode() const -> std::vector<std::uint8_t>;
+
+    /// Parses a blob written by `encode()`, throws `DatabaseError` if it is malformed
+    [[nodiscard]] static auto decode(DayNumber day, std::span<const std::uint8_t> blob)
+      -> RhythmStats;
+
+  private:
+    /// Marks a free slot, no pair of key codes packs to it
+    static constexpr std::uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    /// A slot of the key pair table, the pair is packed as `first << 16 | second`
+    struct Slot
+    {
+        std::uint32_t pair{ EMPTY_SLOT };
+        std::uint32_t count{ 0 };
+    };
+
+    /// Adds `count` to a packed pair, counting it as dropped if the table is full
+    auto addBigram(std::uint32_t pair, std::uint32_t count) -> void;
+
+    /// Returns the slot of a packed pair, or the free slot it would go into
+    [[nodiscard]] auto findSlot(std::uint32_t pair) const -> std::size_t;
+
+    DayNumber stats_day;
+    std::vector<Hour> hours;
+    std::vector<Slot> slots;
+    std::size_t bigram_count{ 0 };
+    std::uint64_t dropped_bigrams{ 0 };
+};
+
+} // namespace typetrace
+
+#endif
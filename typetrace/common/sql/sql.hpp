@@ -1,6 +1,11 @@
 #ifndef TYPETRACE_SQL_HPP
 #define TYPETRACE_SQL_HPP
 
+#include "constants.hpp"
+
+#include <array>
+#include <cstddef>
+
 namespace typetrace {
 
 // ============================================================================
@@ -8,35 +13,526 @@ namespace typetrace {
 // ============================================================================
 
 /// SQL query to create the keystrokes table if it doesn't exist
+///
+/// `day` is the local day as days since 1970-01-01. The table is clustered on `(day, scan_code)`,
+/// so upserts maintain a single B-tree and day range queries read it in order.
 constexpr const char *CREATE_KEYSTROKES_TABLE_SQL = {
     R"(CREATE TABLE IF NOT EXISTS keystrokes (
-           id INTEGER PRIMARY KEY AUTOINCREMENT,
+           day INTEGER NOT NULL,
+           scan_code INTEGER NOT NULL,
+           count INTEGER NOT NULL DEFAULT 0,
+           PRIMARY KEY (day, scan_code)
+       ) WITHOUT ROWID;)"
+};
+
+/// SQL query to create the key name lookup table if it doesn't exist
+constexpr const char *CREATE_KEY_NAMES_TABLE_SQL = {
+    R"(CREATE TABLE IF NOT EXISTS key_names (
+           scan_code INTEGER PRIMARY KEY,
+           key_name TEXT NOT NULL
+       );)"
+};
+
+/// SQL query to create the all-time per-key totals table if it doesn't exist
+constexpr const char *CREATE_KEY_TOTALS_TABLE_SQL = {
+    R"(CREATE TABLE IF NOT EXISTS key_totals (
+           scan_code INTEGER PRIMARY KEY,
+           count INTEGER NOT NULL DEFAULT 0
+       );)"
+};
+
+/// SQL query to create the weekly rollup table if it doesn't exist
+///
+/// `week` counts Monday-based weeks since 1969-12-29, see `weekOf()`.
+constexpr const char *CREATE_WEEKLY_COUNTS_TABLE_SQL = {
+    R"(CREATE TABLE IF NOT EXISTS weekly_counts (
+           week INTEGER NOT NULL,
+           scan_code INTEGER NOT NULL,
+           count INTEGER NOT NULL DEFAULT 0,
+           PRIMARY KEY (week, scan_code)
+       ) WITHOUT ROWID;)"
+};
+
+/// SQL query to create the monthly rollup table if it doesn't exist
+///
+/// `month` is `year * 12 + (month - 1)`, see `monthOf()`.
+constexpr const char *CREATE_MONTHLY_COUNTS_TABLE_SQL = {
+    R"(CREATE TABLE IF NOT EXISTS monthly_counts (
+           month INTEGER NOT NULL,
            scan_code INTEGER NOT NULL,
-           key_name TEXT NOT NULL,
-           date DATE NOT NULL,
-           count INTEGER DEFAULT 0,
-           UNIQUE(scan_code, date)
+           count INTEGER NOT NULL DEFAULT 0,
+           PRIMARY KEY (month, scan_code)
+       ) WITHOUT ROWID;)"
+};
+
+/// SQL query to create the per-day dimension table if it doesn't exist
+///
+/// Each row holds the key presses of one day by keyboard, hour and key as a single blob, see
+/// `DimensionMatrix`. It is written when a day closes, never on the upsert path.
+constexpr const char *CREATE_DAY_DIMENSIONS_TABLE_SQL = {
+    R"(CREATE TABLE IF NOT EXISTS day_dimensions (
+           day INTEGER PRIMARY KEY,
+           matrix BLOB NOT NULL
+       );)"
+};
+
+/// SQL query to create the per-day typing rhythm table if it doesn't exist
+///
+/// Each row holds the inter-key intervals and key pairs of one day as a single blob, see
+/// `RhythmStats`. Every flush merges the intervals measured since the previous one into it.
+constexpr const char *CREATE_DAY_RHYTHM_TABLE_SQL = {
+    R"(CREATE TABLE IF NOT EXISTS day_rhythm (
+           day INTEGER PRIMARY KEY,
+           stats BLOB NOT NULL
+       );)"
+};
+
+/// SQL query to create the table of merged delta logs if it doesn't exist
+///
+/// Each row holds the file offset up to which the records of one log of a host are in the
+/// database, so merging again only reads what was appended since. A host that recreated its log
+/// has a row per log ID, a stale copy of the old log next to the new one is not merged again.
+constexpr const char *CREATE_SYNC_OFFSETS_TABLE_SQL = {
+    R"(CREATE TABLE IF NOT EXISTS sync_offsets (
+           host TEXT NOT NULL,
+           log_id INTEGER NOT NULL,
+           merged_bytes INTEGER NOT NULL,
+           PRIMARY KEY (host, log_id)
+       ) WITHOUT ROWID;)"
+};
+
+/// SQL query to create the history epoch table if it doesn't exist
+///
+/// Its single row counts the imports and merges, which change days the backend no longer writes
+/// to. Readers that keep results of those days compare it to notice that they are outdated.
+constexpr const char *CREATE_HISTORY_EPOCH_TABLE_SQL = {
+    R"(CREATE TABLE IF NOT EXISTS history_epoch (
+           id INTEGER PRIMARY KEY CHECK (id = 0),
+           epoch INTEGER NOT NULL
+       );
+       INSERT OR IGNORE INTO history_epoch (id, epoch) VALUES (0, 0);)"
+};
+
+/// SQL query to create the tables that tie the own delta log to the database if they don't exist
+///
+/// The single row of `delta_log_state` holds the ID of the log and the sequence number of the
+/// last batch committed for it, which is the number of records the log should hold.
+/// `delta_outbox` keeps the records of committed batches until they are synced to the log, so a
+/// crash between the commit and the append loses none of them.
+constexpr const char *CREATE_DELTA_LOG_TABLES_SQL = {
+    R"(CREATE TABLE IF NOT EXISTS delta_log_state (
+           id INTEGER PRIMARY KEY CHECK (id = 0),
+           log_id INTEGER NOT NULL,
+           sequence INTEGER NOT NULL
+       );
+       CREATE TABLE IF NOT EXISTS delta_outbox (
+           sequence INTEGER PRIMARY KEY,
+           record BLOB NOT NULL
        );)"
 };
 
 /// Database optimization pragmas
+///
+/// `auto_vacuum` only takes effect on a new database, so it comes before the switch to WAL mode
+/// creates the file. An existing database is converted offline by `ENABLE_INCREMENTAL_VACUUM_SQL`.
+///
+/// Connection specific sizes (`mmap_size`, `cache_size`, `wal_autocheckpoint`) are configurable
+/// and applied separately by the backend.
 constexpr const char *OPTIMIZE_DATABASE_SQL =
-  R"(PRAGMA journal_mode=WAL;
+  R"(PRAGMA auto_vacuum=INCREMENTAL;
+       PRAGMA journal_mode=WAL;
        PRAGMA synchronous=NORMAL;
-       PRAGMA cache_size=10000;
        PRAGMA temp_store=memory;)";
 
 /// SQL query for inserting or updating keystroke data (UPSERT)
+///
+/// The last parameter is the number of presses to add, so a whole aggregated
+/// batch of one key on one day is written as a single row.
 constexpr const char *UPSERT_KEYSTROKE_SQL = {
-    R"(INSERT INTO keystrokes (scan_code, key_name, date, count)
-       VALUES (?, ?, ?, 1)
-       ON CONFLICT(scan_code, date) DO UPDATE SET
-           count = count + 1,
+    R"(INSERT INTO keystrokes (day, scan_code, count)
+       VALUES (?, ?, ?)
+       ON CONFLICT(day, scan_code) DO UPDATE SET
+           count = count + excluded.count;)"
+};
+
+/// SQL query for inserting or updating the name of a key
+constexpr const char *UPSERT_KEY_NAME_SQL = {
+    R"(INSERT INTO key_names (scan_code, key_name)
+       VALUES (?, ?)
+       ON CONFLICT(scan_code) DO UPDATE SET
            key_name = excluded.key_name;)"
 };
 
-/// SQL query to clear all entries from the keystrokes table
-constexpr const char *CLEAR_KEYSTROKES_TABLE_SQL = "DELETE FROM keystrokes;";
+/// SQL query for adding presses to the all-time total of a key
+constexpr const char *UPSERT_KEY_TOTAL_SQL = {
+    R"(INSERT INTO key_totals (scan_code, count)
+       VALUES (?, ?)
+       ON CONFLICT(scan_code) DO UPDATE SET
+           count = count + excluded.count;)"
+};
+
+/// SQL query for adding presses to the weekly rollup of a key
+constexpr const char *UPSERT_WEEKLY_COUNT_SQL = {
+    R"(INSERT INTO weekly_counts (week, scan_code, count)
+       VALUES (?, ?, ?)
+       ON CONFLICT(week, scan_code) DO UPDATE SET
+           count = count + excluded.count;)"
+};
+
+/// SQL query for adding presses to the monthly rollup of a key
+constexpr const char *UPSERT_MONTHLY_COUNT_SQL = {
+    R"(INSERT INTO monthly_counts (month, scan_code, count)
+       VALUES (?, ?, ?)
+       ON CONFLICT(month, scan_code) DO UPDATE SET
+           count = count + excluded.count;)"
+};
+
+/// SQL query for storing the dimension blob of a day, replacing the one stored before
+constexpr const char *UPSERT_DAY_DIMENSIONS_SQL = {
+    R"(INSERT INTO day_dimensions (day, matrix)
+       VALUES (?, ?)
+       ON CONFLICT(day) DO UPDATE SET
+           matrix = excluded.matrix;)"
+};
+
+/// SQL query for storing the rhythm blob of a day, replacing the one stored before
+constexpr const char *UPSERT_DAY_RHYTHM_SQL = {
+    R"(INSERT INTO day_rhythm (day, stats)
+       VALUES (?, ?)
+       ON CONFLICT(day) DO UPDATE SET
+           stats = excluded.stats;)"
+};
+
+/// SQL query to clear all entries from the keystrokes table and its rollups
+constexpr const char *CLEAR_KEYSTROKES_TABLE_SQL = {
+    R"(DELETE FROM keystrokes;
+       DELETE FROM key_totals;
+       DELETE FROM weekly_counts;
+       DELETE FROM monthly_counts;
+       DELETE FROM day_dimensions;
+       DELETE FROM day_rhythm;)"
+};
+
+// ============================================================================
+// Retention Queries
+// ============================================================================
+
+/// SQL query to delete a batch of keystroke rows of days before the first parameter, at most
+/// as many as the second parameter. Their counts stay in the weekly and monthly rollups and the
+/// all-time totals, which every write updates in the same transaction as the day.
+constexpr const char *PRUNE_KEYSTROKES_SQL = {
+    R"(DELETE FROM keystrokes
+       WHERE (day, scan_code) IN (
+           SELECT day, scan_code FROM keystrokes
+           WHERE day < ?
+           ORDER BY day ASC, scan_code ASC
+           LIMIT ?
+       );)"
+};
+
+/// SQL query to read the auto-vacuum mode, 2 is incremental
+constexpr const char *GET_AUTO_VACUUM_SQL = "PRAGMA auto_vacuum;";
+
+/// Converts a database created without incremental vacuum, rewriting the whole file. Holds the
+/// database locked until it is done, so it is only run by the `--vacuum` command.
+constexpr const char *ENABLE_INCREMENTAL_VACUUM_SQL = {
+    R"(PRAGMA auto_vacuum=INCREMENTAL;
+       VACUUM;)"
+};
+
+/// Returns all free pages to the file system by truncating the database file
+constexpr const char *INCREMENTAL_VACUUM_SQL = "PRAGMA incremental_vacuum;";
+
+// ============================================================================
+// Archive Queries
+// ============================================================================
+
+/// SQL query to read every keystroke row in archive order
+constexpr const char *EXPORT_KEYSTROKES_SQL = {
+    R"(SELECT day, scan_code, count
+       FROM keystrokes
+       ORDER BY day ASC, scan_code ASC;)"
+};
+
+/// SQL query to read the keys an archive needs, with their names if they are known
+constexpr const char *EXPORT_KEY_TABLE_SQL = {
+    R"(SELECT s.scan_code, COALESCE(n.key_name, '')
+       FROM (SELECT DISTINCT scan_code FROM keystrokes) AS s
+       LEFT JOIN key_names AS n ON n.scan_code = s.scan_code
+       ORDER BY s.scan_code ASC;)"
+};
+
+/// SQL query to create the staging table of an import, it only lives for the connection
+constexpr const char *CREATE_IMPORT_TABLE_SQL = {
+    R"(CREATE TEMP TABLE IF NOT EXISTS import_keystrokes (
+           day INTEGER NOT NULL,
+           scan_code INTEGER NOT NULL,
+           count INTEGER NOT NULL
+       );
+       DELETE FROM import_keystrokes;)"
+};
+
+/// SQL query to stage one archive row, a plain append without conflict handling
+constexpr const char *INSERT_IMPORT_ROW_SQL = {
+    R"(INSERT INTO import_keystrokes (day, scan_code, count)
+       VALUES (?, ?, ?);)"
+};
+
+/// SQL query to add the name of an imported key unless the database already knows it
+constexpr const char *INSERT_IMPORT_KEY_NAME_SQL = {
+    R"(INSERT INTO key_names (scan_code, key_name)
+       VALUES (?, ?)
+       ON CONFLICT(scan_code) DO NOTHING;)"
+};
+
+/// Merges the staged rows into the keystrokes table and its rollups, one set-based upsert per
+/// table instead of one per row. The `WHERE true` keeps `ON CONFLICT` from being parsed as a
+/// join constraint. Weeks and months are computed like in `MIGRATE_V2_TO_V3_SQL`.
+constexpr const char *MERGE_IMPORT_SQL = {
+    R"(INSERT INTO keystrokes (day, scan_code, count)
+           SELECT day, scan_code, count FROM import_keystrokes WHERE true
+           ON CONFLICT(day, scan_code) DO UPDATE SET count = count + excluded.count;
+
+       INSERT INTO key_totals (scan_code, count)
+           SELECT scan_code, SUM(count) FROM import_keystrokes WHERE true GROUP BY scan_code
+           ON CONFLICT(scan_code) DO UPDATE SET count = count + excluded.count;
+
+       INSERT INTO weekly_counts (week, scan_code, count)
+           SELECT (day + 3) / 7, scan_code, SUM(count)
+           FROM import_keystrokes WHERE true
+           GROUP BY 1, 2
+           ON CONFLICT(week, scan_code) DO UPDATE SET count = count + excluded.count;
+
+       INSERT INTO monthly_counts (month, scan_code, count)
+           SELECT CAST(strftime('%Y', day * 86400, 'unixepoch') AS INTEGER) * 12
+                    + CAST(strftime('%m', day * 86400, 'unixepoch') AS INTEGER) - 1,
+                  scan_code,
+                  SUM(count)
+           FROM import_keystrokes WHERE true
+           GROUP BY 1, 2
+           ON CONFLICT(month, scan_code) DO UPDATE SET count = count + excluded.count;
+
+       DELETE FROM import_keystrokes;)"
+};
+
+/// SQL query to count an import or merge, committed in the same transaction as its rows
+constexpr const char *BUMP_HISTORY_EPOCH_SQL = "UPDATE history_epoch SET epoch = epoch + 1;";
+
+/// Pragma for the duration of an import, its commit is not synced. In WAL mode a crash can only
+/// lose the import as a whole, never corrupt the database.
+constexpr const char *BEGIN_BULK_IMPORT_SQL = "PRAGMA synchronous=OFF;";
+
+/// Restores the synchronous setting of `OPTIMIZE_DATABASE_SQL` after an import
+constexpr const char *END_BULK_IMPORT_SQL = "PRAGMA synchronous=NORMAL;";
+
+// ============================================================================
+// Sync Queries
+// ============================================================================
+
+/// SQL query to read the merged offset stored for a log of a host
+constexpr const char *GET_SYNC_OFFSET_SQL = {
+    R"(SELECT merged_bytes
+       FROM sync_offsets
+       WHERE host = ? AND log_id = ?;)"
+};
+
+/// SQL query to store the merged offset of a log of a host
+constexpr const char *UPSERT_SYNC_OFFSET_SQL = {
+    R"(INSERT INTO sync_offsets (host, log_id, merged_bytes)
+       VALUES (?, ?, ?)
+       ON CONFLICT(host, log_id) DO UPDATE SET
+           merged_bytes = excluded.merged_bytes;)"
+};
+
+/// SQL query to read the ID and sequence number of the own delta log
+constexpr const char *GET_DELTA_LOG_STATE_SQL = "SELECT log_id, sequence FROM delta_log_state;";
+
+/// SQL query to store the ID and sequence number of the own delta log
+constexpr const char *UPSERT_DELTA_LOG_STATE_SQL = {
+    R"(INSERT INTO delta_log_state (id, log_id, sequence)
+       VALUES (0, ?, ?)
+       ON CONFLICT(id) DO UPDATE SET
+           log_id = excluded.log_id,
+           sequence = excluded.sequence;)"
+};
+
+/// SQL query to advance the sequence number of the own delta log, committed with the batch
+constexpr const char *UPDATE_DELTA_LOG_SEQUENCE_SQL = "UPDATE delta_log_state SET sequence = ?;";
+
+/// SQL query to keep the delta log record of a batch until it is synced to the log
+constexpr const char *INSERT_DELTA_OUTBOX_SQL = {
+    R"(INSERT INTO delta_outbox (sequence, record)
+       VALUES (?, ?);)"
+};
+
+/// SQL query to drop the kept records up to a sequence number the log is known to hold
+constexpr const char *DELETE_DELTA_OUTBOX_SQL = "DELETE FROM delta_outbox WHERE sequence <= ?;";
+
+/// SQL query to drop all kept records, when the log they were meant for is gone
+constexpr const char *CLEAR_DELTA_OUTBOX_SQL = "DELETE FROM delta_outbox;";
+
+/// SQL query to read the kept records after a sequence number, in log order
+constexpr const char *GET_DELTA_OUTBOX_SQL = {
+    R"(SELECT sequence, record
+       FROM delta_outbox
+       WHERE sequence > ?
+       ORDER BY sequence;)"
+};
+
+// ============================================================================
+// Schema Migrations
+// ============================================================================
+
+/// SQL query to read the schema version of the database
+constexpr const char *GET_SCHEMA_VERSION_SQL = "PRAGMA user_version;";
+
+/// Migrates the original schema (`id`, `scan_code`, `key_name`, `date` TEXT, `count` with
+/// `UNIQUE(scan_code, date)`) to schema version 2
+constexpr const char *MIGRATE_V1_TO_V2_SQL = {
+    R"(CREATE TABLE key_names (
+           scan_code INTEGER PRIMARY KEY,
+           key_name TEXT NOT NULL
+       );
+       INSERT INTO key_names (scan_code, key_name)
+           SELECT scan_code, MAX(key_name) FROM keystrokes GROUP BY scan_code;
+
+       CREATE TABLE keystrokes_v2 (
+           day INTEGER NOT NULL,
+           scan_code INTEGER NOT NULL,
+           count INTEGER NOT NULL DEFAULT 0,
+           PRIMARY KEY (day, scan_code)
+       ) WITHOUT ROWID;
+       INSERT INTO keystrokes_v2 (day, scan_code, count)
+           SELECT CAST(julianday(date) - 2440587.5 AS INTEGER), scan_code, SUM(count)
+           FROM keystrokes
+           GROUP BY 1, 2;
+
+       DROP TABLE keystrokes;
+       ALTER TABLE keystrokes_v2 RENAME TO keystrokes;)"
+};
+
+/// Migrates schema version 2 to version 3 by adding the rollup tables
+constexpr const char *MIGRATE_V2_TO_V3_SQL = {
+    R"(CREATE TABLE key_totals (
+           scan_code INTEGER PRIMARY KEY,
+           count INTEGER NOT NULL DEFAULT 0
+       );
+       INSERT INTO key_totals (scan_code, count)
+           SELECT scan_code, SUM(count) FROM keystrokes GROUP BY scan_code;
+
+       CREATE TABLE weekly_counts (
+           week INTEGER NOT NULL,
+           scan_code INTEGER NOT NULL,
+           count INTEGER NOT NULL DEFAULT 0,
+           PRIMARY KEY (week, scan_code)
+       ) WITHOUT ROWID;
+       INSERT INTO weekly_counts (week, scan_code, count)
+           SELECT (day + 3) / 7, scan_code, SUM(count) FROM keystrokes GROUP BY 1, 2;
+
+       CREATE TABLE monthly_counts (
+           month INTEGER NOT NULL,
+           scan_code INTEGER NOT NULL,
+           count INTEGER NOT NULL DEFAULT 0,
+           PRIMARY KEY (month, scan_code)
+       ) WITHOUT ROWID;
+       INSERT INTO monthly_counts (month, scan_code, count)
+           SELECT CAST(strftime('%Y', day * 86400, 'unixepoch') AS INTEGER) * 12
+                    + CAST(strftime('%m', day * 86400, 'unixepoch') AS INTEGER) - 1,
+                  scan_code,
+                  SUM(count)
+           FROM keystrokes
+           GROUP BY 1, 2;)"
+};
+
+/// SQL query to migrate schema version 3 to 4, adding the per-day dimension table
+constexpr const char *MIGRATE_V3_TO_V4_SQL = {
+    R"(CREATE TABLE day_dimensions (
+           day INTEGER PRIMARY KEY,
+           matrix BLOB NOT NULL
+       );)"
+};
+
+/// SQL query to migrate schema version 4 to 5, adding the per-day typing rhythm table
+constexpr const char *MIGRATE_V4_TO_V5_SQL = {
+    R"(CREATE TABLE day_rhythm (
+           day INTEGER PRIMARY KEY,
+           stats BLOB NOT NULL
+       );)"
+};
+
+/// SQL query to migrate schema version 5 to 6, adding the table of merged delta logs
+constexpr const char *MIGRATE_V5_TO_V6_SQL = {
+    R"(CREATE TABLE sync_offsets (
+           host TEXT PRIMARY KEY,
+           log_id INTEGER NOT NULL,
+           merged_bytes INTEGER NOT NULL
+       );)"
+};
+
+/// SQL query to migrate schema version 6 to 7, adding the history epoch table
+constexpr const char *MIGRATE_V6_TO_V7_SQL = {
+    R"(CREATE TABLE history_epoch (
+           id INTEGER PRIMARY KEY CHECK (id = 0),
+           epoch INTEGER NOT NULL
+       );
+       INSERT INTO history_epoch (id, epoch) VALUES (0, 0);)"
+};
+
+/// SQL query to migrate schema version 7 to 8, adding the tables of the own delta log
+constexpr const char *MIGRATE_V7_TO_V8_SQL = {
+    R"(CREATE TABLE delta_log_state (
+           id INTEGER PRIMARY KEY CHECK (id = 0),
+           log_id INTEGER NOT NULL,
+           sequence INTEGER NOT NULL
+       );
+       CREATE TABLE delta_outbox (
+           sequence INTEGER PRIMARY KEY,
+           record BLOB NOT NULL
+       );)"
+};
+
+/// SQL query to migrate schema version 8 to 9, keying the merged delta logs on host and log ID
+constexpr const char *MIGRATE_V8_TO_V9_SQL = {
+    R"(CREATE TABLE sync_offsets_v9 (
+           host TEXT NOT NULL,
+           log_id INTEGER NOT NULL,
+           merged_bytes INTEGER NOT NULL,
+           PRIMARY KEY (host, log_id)
+       ) WITHOUT ROWID;
+       INSERT INTO sync_offsets_v9 (host, log_id, merged_bytes)
+           SELECT host, log_id, merged_bytes FROM sync_offsets;
+
+       DROP TABLE sync_offsets;
+       ALTER TABLE sync_offsets_v9 RENAME TO sync_offsets;)"
+};
+
+/// Migration steps, the entry at index `i` migrates schema version `i + 1` to `i + 2`
+constexpr std::array<const char *, DB_SCHEMA_VERSION - 1> SCHEMA_MIGRATIONS_SQL = {
+    MIGRATE_V1_TO_V2_SQL,
+    MIGRATE_V2_TO_V3_SQL,
+    MIGRATE_V3_TO_V4_SQL,
+    MIGRATE_V4_TO_V5_SQL,
+    MIGRATE_V5_TO_V6_SQL,
+    MIGRATE_V6_TO_V7_SQL,
+    MIGRATE_V7_TO_V8_SQL,
+    MIGRATE_V8_TO_V9_SQL,
+};
+
+// ============================================================================
+// Maintenance Queries
+// ============================================================================
+
+/// Copies as much of the WAL into the database as possible without waiting for readers
+///
+/// Example output:
+///
+/// busy  log  checkpointed
+/// ----  ---  ------------
+/// 0     42   42
+constexpr const char *WAL_CHECKPOINT_PASSIVE_SQL = "PRAGMA wal_checkpoint(PASSIVE);";
+
+/// Checkpoints the whole WAL and truncates the WAL file to zero bytes
+constexpr const char *WAL_CHECKPOINT_TRUNCATE_SQL = "PRAGMA wal_checkpoint(TRUNCATE);";
 
 // ============================================================================
 // READ Queries
@@ -52,30 +548,123 @@ constexpr const char *CLEAR_KEYSTROKES_TABLE_SQL = "DELETE FROM keystrokes;";
 /// 3          19
 /// 11         12
 constexpr const char *GET_TOTAL_KEY_COUNTS_SQL = {
-    R"(SELECT scan_code, SUM(count) AS total_presses
+    R"(SELECT scan_code, count AS total_presses
+       FROM key_totals
+       ORDER BY scan_code ASC;)"
+};
+
+/// SQL query to get one page of the per-day key counts, newest first.
+///
+/// Keyset paging: `?1, ?2` is the `(day, scan_code)` of the last row of the previous page (or a
+/// position past all rows for the first page) and `?3` the page size. This walks the primary
+/// key, so a page costs the same no matter how deep into the history it is.
+///
+/// Filters: only days from `?4` to `?5` are included, and only keys whose name matches the LIKE
+/// pattern `?6` (`%` matches every key, `\` escapes wildcards).
+///
+/// Example output:
+///
+/// day    scan_code  key_name  count
+/// -----  ---------  --------  -----
+/// 20351  31         KEY_S     7
+/// 20351  30         KEY_A     5
+/// 20350  30         KEY_A     2
+constexpr const char *GET_KEYSTROKES_PAGE_SQL = {
+    R"(SELECT k.day, k.scan_code, COALESCE(n.key_name, 'UNKNOWN'), k.count
+       FROM keystrokes AS k
+       LEFT JOIN key_names AS n ON n.scan_code = k.scan_code
+       WHERE (k.day, k.scan_code) < (?1, ?2)
+         AND k.day BETWEEN ?4 AND ?5
+         AND COALESCE(n.key_name, 'UNKNOWN') LIKE ?6 ESCAPE '\'
+       ORDER BY k.day DESC, k.scan_code DESC
+       LIMIT ?3;)"
+};
+
+/// SQL query to get one page of the per-day key counts, oldest first.
+///
+/// Same parameters as `GET_KEYSTROKES_PAGE_SQL`, except that `?1, ?2` is a position before all
+/// rows for the first page. Walks the primary key in the other direction.
+constexpr const char *GET_KEYSTROKES_PAGE_ASCENDING_SQL = {
+    R"(SELECT k.day, k.scan_code, COALESCE(n.key_name, 'UNKNOWN'), k.count
+       FROM keystrokes AS k
+       LEFT JOIN key_names AS n ON n.scan_code = k.scan_code
+       WHERE (k.day, k.scan_code) > (?1, ?2)
+         AND k.day BETWEEN ?4 AND ?5
+         AND COALESCE(n.key_name, 'UNKNOWN') LIKE ?6 ESCAPE '\'
+       ORDER BY k.day ASC, k.scan_code ASC
+       LIMIT ?3;)"
+};
+
+/// SQL query to get the count of each key on a given day
+///
+/// Example output:
+///
+/// scan_code  total_presses
+/// ---------  -------------
+/// 1          3
+/// 3          8
+/// 11         2
+constexpr const char *GET_DAY_KEY_COUNTS_SQL = {
+    R"(SELECT scan_code, count AS total_presses
        FROM keystrokes
-       GROUP BY scan_code
+       WHERE day = ?
        ORDER BY scan_code ASC;)"
 };
 
-/// SQL query to get the daily amount of key presses over the last X days
+/// SQL query to get the count of each key in a given week (see `weekOf()`)
 ///
 /// Example output:
 ///
-/// date        daily_total
-/// ----------  -----------
-/// 2025-09-20  28
-/// 2025-09-19  43
-/// 2025-09-18  58
+/// scan_code  total_presses
+/// ---------  -------------
+/// 1          10
+/// 3          19
+/// 11         12
+constexpr const char *GET_WEEKLY_KEY_COUNTS_SQL = {
+    R"(SELECT scan_code, count AS total_presses
+       FROM weekly_counts
+       WHERE week = ?
+       ORDER BY scan_code ASC;)"
+};
+
+/// SQL query to get the count of each key in a given month (see `monthOf()`)
+///
+/// Example output:
+///
+/// scan_code  total_presses
+/// ---------  -------------
+/// 1          42
+/// 3          77
+/// 11         51
+constexpr const char *GET_MONTHLY_KEY_COUNTS_SQL = {
+    R"(SELECT scan_code, count AS total_presses
+       FROM monthly_counts
+       WHERE month = ?
+       ORDER BY scan_code ASC;)"
+};
+
+/// SQL query to get the daily amount of key presses from a given day on
+///
+/// The parameter is the first day to include (days since 1970-01-01).
+///
+/// Example output:
+///
+/// day    daily_total
+/// -----  -----------
+/// 20351  28
+/// 20350  43
+/// 20349  58
 constexpr const char *GET_DAILY_COUNTS_SQL = {
-    R"(SELECT date, SUM(count) AS daily_total
+    R"(SELECT day, SUM(count) AS daily_total
        FROM keystrokes
-       WHERE date BETWEEN date('now', '-' || ? || ' days') AND date('now', 'localtime')
-       GROUP BY date
-       ORDER BY date DESC;)"
+       WHERE day >= ?
+       GROUP BY day
+       ORDER BY day DESC;)"
 };
 
-/// SQL query to get the top N most pressed keys in last X days
+/// SQL query to get the top N most pressed keys from a given day on
+///
+/// The parameters are the first day to include (days since 1970-01-01) and N.
 ///
 /// Example output:
 ///
@@ -87,12 +676,32 @@ constexpr const char *GET_DAILY_COUNTS_SQL = {
 constexpr const char *GET_TOP_KEYS_SQL = {
     R"(SELECT scan_code, SUM(count) AS total_presses
        FROM keystrokes
-       WHERE date >= date('now', 'localtime', '-' || ? || ' days')
+       WHERE day >= ?
        GROUP BY scan_code
        ORDER BY total_presses DESC
        LIMIT ?;)"
 };
 
+/// SQL query to get the number of imports and merges, see `CREATE_HISTORY_EPOCH_TABLE_SQL`
+constexpr const char *GET_HISTORY_EPOCH_SQL = "SELECT epoch FROM history_epoch;";
+
+/// SQL query to get a number that changes whenever another connection commits
+constexpr const char *GET_DATA_VERSION_SQL = "PRAGMA data_version;";
+
+/// SQL query to get the dimension blob of a day
+constexpr const char *GET_DAY_DIMENSIONS_SQL = {
+    R"(SELECT matrix
+       FROM day_dimensions
+       WHERE day = ?;)"
+};
+
+/// SQL query to get the rhythm blob of a day
+constexpr const char *GET_DAY_RHYTHM_SQL = {
+    R"(SELECT stats
+       FROM day_rhythm
+       WHERE day = ?;)"
+};
+
 } // namespace typetrace
 
 #endif // SQL_H
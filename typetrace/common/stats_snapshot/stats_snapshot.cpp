@@ -0,0 +1,64 @@
+#include "stats_snapshot.hpp"
+
+#include "exceptions.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace typetrace {
+
+StatsSnapshotReader::StatsSnapshotReader(const std::filesystem::path &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw SystemError(std::format(
+          "Failed to open statistics snapshot '{}': {}", path.string(), std::strerror(errno)));
+    }
+
+    // A file cut short by a crash before it was renamed into place has the wrong size
+    struct stat file_stat{};
+    const bool has_expected_size = ::fstat(fd, &file_stat) == 0
+                                   && static_cast<std::size_t>(file_stat.st_size)
+                                        == sizeof(StatsSnapshot);
+
+    void *const mapping = has_expected_size
+                            ? ::mmap(nullptr, sizeof(StatsSnapshot), PROT_READ, MAP_SHARED, fd, 0)
+                            : MAP_FAILED;
+
+    // The mapping stays valid without the file descriptor
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        throw SystemError(std::format("Failed to map statistics snapshot '{}'", path.string()));
+    }
+    snapshot = static_cast<const StatsSnapshot *>(mapping);
+
+    if (snapshot->magic != STATS_SNAPSHOT_MAGIC || snapshot->version != STATS_SNAPSHOT_VERSION
+        || snapshot->daily_size > StatsSnapshot::DAYS
+        || snapshot->top_keys_size > StatsSnapshot::TOP_KEYS) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+        ::munmap(const_cast<StatsSnapshot *>(snapshot), sizeof(StatsSnapshot));
+        throw SystemError(
+          std::format("Statistics snapshot '{}' has an unknown format", path.string()));
+    }
+}
+
+StatsSnapshotReader::~StatsSnapshotReader()
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    ::munmap(const_cast<StatsSnapshot *>(snapshot), sizeof(StatsSnapshot));
+}
+
+auto StatsSnapshotReader::get() const -> const StatsSnapshot &
+{
+    return *snapshot;
+}
+
+} // namespace typetrace
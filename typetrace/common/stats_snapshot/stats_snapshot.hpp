@@ -0,0 +1,70 @@
+#ifndef TYPETRACE_STATS_SNAPSHOT_HPP
+#define TYPETRACE_STATS_SNAPSHOT_HPP
+
+#include "constants.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace typetrace {
+
+/// Identifies a statistics snapshot written by a compatible version ("TTSS")
+constexpr std::uint32_t STATS_SNAPSHOT_MAGIC = 0x53535454;
+
+/// Version of the `StatsSnapshot` layout
+constexpr std::uint32_t STATS_SNAPSHOT_VERSION = 1;
+
+/// Layout of the statistics snapshot file the backend keeps next to the database.
+///
+/// It holds the results of the aggregate queries a frontend needs for its first paint, so
+/// mapping it costs the same however large the database is. The backend writes a new file and
+/// renames it over the old one, so a mapping always shows one complete snapshot and is never
+/// changed under its reader. Lists hold their valid entries first, `*_size` counts them.
+struct StatsSnapshot
+{
+    /// Days of daily totals, today included
+    static constexpr std::size_t DAYS = 365;
+
+    /// Number of most pressed keys
+    static constexpr std::size_t TOP_KEYS = 20;
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::int64_t written_at; ///< Unix time the snapshot was taken
+    DayNumber day;           ///< Day `today` counts, the last day of `daily`
+    std::array<std::uint64_t, KEY_CODE_COUNT> today;
+    std::array<std::uint64_t, KEY_CODE_COUNT> all_time;
+    std::uint64_t daily_size;
+    std::array<DailyCount, DAYS> daily; ///< Days with presses, newest first
+    std::uint64_t top_keys_size;
+    std::array<KeyCount, TOP_KEYS> top_keys; ///< Most pressed keys of all time, most first
+};
+
+/// Read-only mapping of a statistics snapshot file
+class StatsSnapshotReader
+{
+  public:
+    /// Maps the snapshot at `path`, throws `SystemError` if it is missing or incompatible
+    explicit StatsSnapshotReader(const std::filesystem::path &path);
+
+    /// Unmaps the snapshot
+    ~StatsSnapshotReader();
+
+    StatsSnapshotReader(const StatsSnapshotReader &) = delete;
+    auto operator=(const StatsSnapshotReader &) -> StatsSnapshotReader & = delete;
+    StatsSnapshotReader(StatsSnapshotReader &&) = delete;
+    auto operator=(StatsSnapshotReader &&) -> StatsSnapshotReader & = delete;
+
+    /// Returns the mapped snapshot, it stays the same while the reader exists
+    [[nodiscard]] auto get() const -> const StatsSnapshot &;
+
+  private:
+    const StatsSnapshot *snapshot{ nullptr };
+};
+
+} // namespace typetrace
+
+#endif
@@ -1,11 +1,21 @@
 #ifndef TYPETRACE_TYPES_HPP
 #define TYPETRACE_TYPES_HPP
 
-#include <cstddef>
-#include <string>
+#include "constants.hpp"
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
 
 namespace typetrace {
 
+// ============================================================================
+// Aliases
+// ============================================================================
+
+/// Local calendar day expressed as the number of days since 1970-01-01
+using DayNumber = std::uint32_t;
+
 // ============================================================================
 // Structures
 // ============================================================================
@@ -13,9 +23,32 @@ namespace typetrace {
 /// Structure representing a keystroke event
 struct KeystrokeEvent
 {
-    std::size_t key_code{}; ///< Code of the pressed key
-    std::string key_name;   ///< Human-readable name of the key
-    std::string date;       ///< Date in YYYY-MM-DD format
+    std::uint16_t key_code{}; ///< Code of the pressed key
+    DayNumber day{};          ///< Local day the key was pressed on
+};
+
+static_assert(std::is_trivially_copyable_v<KeystrokeEvent>);
+static_assert(sizeof(KeystrokeEvent) == 8);
+
+/// Structure holding the summed key presses of a single day, indexed by key code
+struct DailyKeyCounts
+{
+    DayNumber day{};                                    ///< Local day of the counts
+    std::array<std::uint32_t, KEY_CODE_COUNT> counts{}; ///< Presses per key code
+};
+
+/// Structure holding the number of presses of a single key
+struct KeyCount
+{
+    std::uint16_t key_code{}; ///< Code of the key
+    std::uint64_t count{};    ///< Number of presses
+};
+
+/// Structure holding the number of key presses of a single day
+struct DailyCount
+{
+    DayNumber day{};       ///< Local day of the count
+    std::uint64_t count{}; ///< Number of presses on that day
 };
 
 } // namespace typetrace
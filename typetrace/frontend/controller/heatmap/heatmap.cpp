@@ -0,0 +1,318 @@
+#include "heatmap.hpp"
+
+#include "constants.hpp"
+#include "dbus.hpp"
+#include "key_table.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glibmm/refptr.h>
+#include <gtk/gtk.h>
+#include <gtkmm/snapshot.h>
+#include <optional>
+#include <sigc++/functors/mem_fun.h>
+#include <span>
+#include <vector>
+
+namespace typetrace::frontend {
+
+namespace {
+
+/// Size of a key unit in pixels the widget asks for, and the least it can be shrunk to
+constexpr int NATURAL_UNIT_SIZE = 40;
+constexpr int MINIMUM_UNIT_SIZE = 20;
+
+/// Space between two cells in pixels
+constexpr float CELL_GAP = 4.0F;
+
+/// Linear blend of two colors, `weight` 0 is `from` and 1 is `to`
+constexpr auto blend(const GdkRGBA &from, const GdkRGBA &to, const float weight) -> GdkRGBA
+{
+    return {
+        .red = from.red + ((to.red - from.red) * weight),
+        .green = from.green + ((to.green - from.green) * weight),
+        .blue = from.blue + ((to.blue - from.blue) * weight),
+        .alpha = from.alpha + ((to.alpha - from.alpha) * weight),
+    };
+}
+
+/// Cell colors by bucket, unused keys are gray and pressed ones go from yellow to red
+constexpr auto BUCKET_COLORS = []() -> std::array<GdkRGBA, HeatmapBuckets::BUCKET_COUNT> {
+    constexpr GdkRGBA UNUSED{ .red = 0.85F, .green = 0.85F, .blue = 0.85F, .alpha = 1.0F };
+    constexpr GdkRGBA COLD{ .red = 1.0F, .green = 0.93F, .blue = 0.63F, .alpha = 1.0F };
+    constexpr GdkRGBA HOT{ .red = 0.74F, .green = 0.0F, .blue = 0.15F, .alpha = 1.0F };
+
+    std::array<GdkRGBA, HeatmapBuckets::BUCKET_COUNT> colors{};
+    colors.at(0) = UNUSED;
+    for (std::size_t bucket = 1; bucket < colors.size(); ++bucket) {
+        colors.at(bucket) = blend(COLD,
+                                  HOT,
+                                  static_cast<float>(bucket - 1)
+                                    / static_cast<float>(colors.size() - 2));
+    }
+    return colors;
+}();
+
+/// Color of the key labels
+constexpr GdkRGBA LABEL_COLOR{ .red = 0.1F, .green = 0.1F, .blue = 0.1F, .alpha = 1.0F };
+
+} // namespace
+
+auto HeatmapBuckets::reset(const std::span<const KeyCount> new_counts) -> void
+{
+    counts.fill(0);
+    for (const auto &[key_code, count] : new_counts) {
+        if (key_code < counts.size()) {
+            counts.at(key_code) = count;
+        }
+    }
+
+    const std::uint64_t highest = std::ranges::max(counts);
+    scale = std::bit_ceil(std::max<std::uint64_t>(highest, 1));
+    rebucket();
+}
+
+auto HeatmapBuckets::add(const std::span<const KeyCount> deltas) -> bool
+{
+    std::uint64_t highest{ 0 };
+    for (const auto &[key_code, count] : deltas) {
+        if (key_code < counts.size()) {
+            counts.at(key_code) += count;
+            highest = std::max(highest, counts.at(key_code));
+        }
+    }
+
+    // Crossing the scale moves every key, so all of them are re-bucketed at once
+    if (highest > scale) {
+        scale = std::bit_ceil(highest);
+        rebucket();
+        return true;
+    }
+
+    const std::size_t previously_changed = changed_keys.size();
+    for (const auto &delta : deltas) {
+        if (delta.key_code >= counts.size()) {
+            continue;
+        }
+
+        const std::uint8_t new_bucket = bucketOf(counts.at(delta.key_code));
+        if (new_bucket != buckets.at(delta.key_code)) {
+            buckets.at(delta.key_code) = new_bucket;
+            changed_keys.push_back(delta.key_code);
+        }
+    }
+
+    return changed_keys.size() > previously_changed;
+}
+
+auto HeatmapBuckets::bucket(const std::uint16_t key_code) const -> std::uint8_t
+{
+    return key_code < buckets.size() ? buckets.at(key_code) : 0;
+}
+
+auto HeatmapBuckets::changed() const -> std::span<const std::uint16_t>
+{
+    return changed_keys;
+}
+
+auto HeatmapBuckets::rescaled() const -> bool
+{
+    return scale_changed;
+}
+
+auto HeatmapBuckets::clearChanged() -> void
+{
+    changed_keys.clear();
+    scale_changed = false;
+}
+
+auto HeatmapBuckets::bucketOf(const std::uint64_t count) const -> std::uint8_t
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    // Pressed keys use buckets 1 to `BUCKET_COUNT - 1`, the highest count is at most `scale`
+    const double share = static_cast<double>(count) / static_cast<double>(scale);
+    constexpr auto PRESSED_BUCKETS = static_cast<double>(BUCKET_COUNT - 1);
+    const auto level = static_cast<std::size_t>(std::ceil(share * PRESSED_BUCKETS));
+    return static_cast<std::uint8_t>(std::clamp<std::size_t>(level, 1, BUCKET_COUNT - 1));
+}
+
+auto HeatmapBuckets::rebucket() -> void
+{
+    for (std::size_t key_code = 0; key_code < counts.size(); ++key_code) {
+        buckets.at(key_code) = bucketOf(counts.at(key_code));
+    }
+
+    changed_keys.clear();
+    scale_changed = true;
+}
+
+Heatmap::Heatmap(DbusClient &dbus_client) : client(dbus_client)
+{
+    // Cells are in layout order, so `KEYBOARD_LAYOUT_INDEX` indexes them as well
+    cells.reserve(KEYBOARD_LAYOUT.size());
+    for (const KeyPosition &key : KEYBOARD_LAYOUT) {
+        cells.push_back({ .key_code = key.key_code, .label = key.label });
+    }
+    buckets.reset({});
+
+    dbus_client.signalKeystrokeDeltas().connect(sigc::mem_fun(*this, &Heatmap::onKeystrokeDeltas));
+    dbus_client.signalBackendStarted().connect(sigc::mem_fun(*this, &Heatmap::requestSnapshot));
+    requestSnapshot();
+}
+
+auto Heatmap::measure_vfunc(const Gtk::Orientation orientation,
+                            const int /*for_size*/,
+                            int &minimum,
+                            int &natural,
+                            int &minimum_baseline,
+                            int &natural_baseline) const -> void
+{
+    const float units = orientation == Gtk::Orientation::HORIZONTAL
+                          ? KEYBOARD_UNITS
+                          : static_cast<float>(KEYBOARD_ROWS);
+
+    minimum = static_cast<int>(units * MINIMUM_UNIT_SIZE);
+    natural = static_cast<int>(units * NATURAL_UNIT_SIZE);
+    minimum_baseline = -1;
+    natural_baseline = -1;
+}
+
+auto Heatmap::size_allocate_vfunc(const int width, const int height, const int /*baseline*/)
+  -> void
+{
+    layoutCells(width, height);
+}
+
+auto Heatmap::snapshot_vfunc(const Glib::RefPtr<Gtk::Snapshot> &snapshot) -> void
+{
+    for (const Cell &cell : cells) {
+        if (cell.node != nullptr) {
+            gtk_snapshot_append_node(snapshot->gobj(), cell.node.get());
+        }
+    }
+}
+
+auto Heatmap::requestSnapshot() -> void
+{
+    snapshot_pending = true;
+    client.requestSnapshot(sigc::mem_fun(*this, &Heatmap::onSnapshot));
+}
+
+auto Heatmap::onSnapshot(const std::optional<DayKeyCounts> &snapshot) -> void
+{
+    snapshot_pending = false;
+    if (!snapshot) {
+        // A backend that starts later begins its sequence at one
+        sequence = 0;
+        return;
+    }
+
+    day = snapshot->day;
+    sequence = snapshot->sequence;
+    buckets.reset(snapshot->counts);
+    renderChangedCells();
+}
+
+auto Heatmap::onKeystrokeDeltas(const DayKeyCounts &deltas) -> void
+{
+    // The bus delivers the backend's messages in order, so every delta that arrives before the
+    // reply is already counted in the snapshot
+    if (snapshot_pending || deltas.sequence <= sequence) {
+        return;
+    }
+    sequence = deltas.sequence;
+
+    if (deltas.day != day) {
+        day = deltas.day;
+        buckets.reset(deltas.counts);
+    } else if (!buckets.add(deltas.counts)) {
+        return;
+    }
+
+    renderChangedCells();
+}
+
+auto Heatmap::layoutCells(const int width, const int height) -> void
+{
+    constexpr auto ROW_COUNT = static_cast<float>(KEYBOARD_ROWS);
+    const float unit = std::min(static_cast<float>(width) / KEYBOARD_UNITS,
+                                static_cast<float>(height) / ROW_COUNT);
+    const float left = (static_cast<float>(width) - (unit * KEYBOARD_UNITS)) / 2.0F;
+    const float top = (static_cast<float>(height) - (unit * ROW_COUNT)) / 2.0F;
+
+    for (std::size_t index = 0; index < cells.size(); ++index) {
+        const KeyPosition &key = KEYBOARD_LAYOUT.at(index);
+        Cell &cell = cells.at(index);
+
+        graphene_rect_init(&cell.bounds,
+                           left + (key.column * unit) + (CELL_GAP / 2.0F),
+                           top + (static_cast<float>(key.row) * unit) + (CELL_GAP / 2.0F),
+                           std::max((key.width * unit) - CELL_GAP, 0.0F),
+                           std::max(unit - CELL_GAP, 0.0F));
+        renderCell(cell);
+    }
+
+    buckets.clearChanged();
+}
+
+auto Heatmap::renderCell(Cell &cell) -> void
+{
+    GtkSnapshot *const cell_snapshot = gtk_snapshot_new();
+
+    const GdkRGBA &color = BUCKET_COLORS.at(buckets.bucket(cell.key_code));
+    gtk_snapshot_append_color(cell_snapshot, &color, &cell.bounds);
+
+    const auto layout = create_pango_layout(cell.label);
+    int label_width{ 0 };
+    int label_height{ 0 };
+    layout->get_pixel_size(label_width, label_height);
+
+    // Labels that don't fit are left out instead of spilling into the neighbouring cells
+    if (static_cast<float>(label_width) <= cell.bounds.size.width) {
+        const graphene_point_t origin = GRAPHENE_POINT_INIT(
+          cell.bounds.origin.x + ((cell.bounds.size.width - static_cast<float>(label_width)) / 2),
+          cell.bounds.origin.y
+            + ((cell.bounds.size.height - static_cast<float>(label_height)) / 2));
+
+        gtk_snapshot_save(cell_snapshot);
+        gtk_snapshot_translate(cell_snapshot, &origin);
+        gtk_snapshot_append_layout(cell_snapshot, layout->gobj(), &LABEL_COLOR);
+        gtk_snapshot_restore(cell_snapshot);
+    }
+
+    cell.node.reset(gtk_snapshot_free_to_node(cell_snapshot));
+}
+
+auto Heatmap::renderChangedCells() -> void
+{
+    // Nothing is rendered before the first allocation, it lays out and renders every cell
+    if (get_width() == 0) {
+        buckets.clearChanged();
+        return;
+    }
+
+    if (buckets.rescaled()) {
+        for (Cell &cell : cells) {
+            renderCell(cell);
+        }
+    } else {
+        for (const std::uint16_t key_code : buckets.changed()) {
+            if (const std::int16_t index = KEYBOARD_LAYOUT_INDEX.at(key_code); index >= 0) {
+                renderCell(cells.at(static_cast<std::size_t>(index)));
+            }
+        }
+    }
+
+    buckets.clearChanged();
+    queue_draw();
+}
+
+} // namespace typetrace::frontend
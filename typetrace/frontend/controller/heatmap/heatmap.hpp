@@ -0,0 +1,133 @@
+#ifndef TYPETRACE_FRONTEND_HEATMAP_HPP
+#define TYPETRACE_FRONTEND_HEATMAP_HPP
+
+#include "constants.hpp"
+#include "dbus.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glibmm/refptr.h>
+#include <gtk/gtk.h>
+#include <gtkmm/snapshot.h>
+#include <gtkmm/widget.h>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace typetrace::frontend {
+
+/// Intensity bucket of every key, derived from its share of the highest count.
+///
+/// Buckets are relative to a scale, the smallest power of two that is at least the highest
+/// count. The scale only moves when the highest count crosses it, so an update usually changes
+/// the buckets of a few pressed keys, and only a new scale re-buckets every key.
+class HeatmapBuckets
+{
+  public:
+    /// Number of intensity levels, bucket 0 is reserved for keys that were never pressed
+    static constexpr std::size_t BUCKET_COUNT = 8;
+
+    /// Replaces all counts, every key is reported as changed
+    auto reset(std::span<const KeyCount> counts) -> void;
+
+    /// Adds the presses of a delta to the counts, returns true if any bucket changed
+    auto add(std::span<const KeyCount> deltas) -> bool;
+
+    /// Returns the bucket of a key, between 0 and `BUCKET_COUNT - 1`
+    [[nodiscard]] auto bucket(std::uint16_t key_code) const -> std::uint8_t;
+
+    /// Returns the keys whose bucket changed since `clearChanged()`
+    [[nodiscard]] auto changed() const -> std::span<const std::uint16_t>;
+
+    /// Returns true if the scale changed since `clearChanged()`, so every key may have moved
+    [[nodiscard]] auto rescaled() const -> bool;
+
+    /// Forgets the changes once they have been rendered
+    auto clearChanged() -> void;
+
+  private:
+    /// Returns the bucket `count` falls into at the current scale
+    [[nodiscard]] auto bucketOf(std::uint64_t count) const -> std::uint8_t;
+
+    /// Recomputes every bucket after the scale changed
+    auto rebucket() -> void;
+
+    std::array<std::uint64_t, KEY_CODE_COUNT> counts{};
+    std::array<std::uint8_t, KEY_CODE_COUNT> buckets{};
+    std::uint64_t scale{ 1 };
+
+    std::vector<std::uint16_t> changed_keys;
+    bool scale_changed{ false };
+};
+
+/// Keyboard heatmap of today's key presses, following the backend's live deltas.
+///
+/// Every key cell is rendered into its own render node, which is kept until the key moves to
+/// another bucket or the widget is resized. A frame only appends the cached nodes, so an update
+/// costs a render node for each key that changed color and neither a full repaint nor a
+/// database query.
+class Heatmap : public Gtk::Widget
+{
+  public:
+    /// Shows an empty keyboard until the backend's snapshot of today arrives, it is requested
+    /// again whenever the backend starts
+    explicit Heatmap(DbusClient &dbus_client);
+
+  protected:
+    auto measure_vfunc(Gtk::Orientation orientation,
+                       int for_size,
+                       int &minimum,
+                       int &natural,
+                       int &minimum_baseline,
+                       int &natural_baseline) const -> void override;
+
+    auto size_allocate_vfunc(int width, int height, int baseline) -> void override;
+
+    auto snapshot_vfunc(const Glib::RefPtr<Gtk::Snapshot> &snapshot) -> void override;
+
+  private:
+    using RenderNode = std::unique_ptr<GskRenderNode, decltype(&gsk_render_node_unref)>;
+
+    /// A key of the layout and its cached rendering
+    struct Cell
+    {
+        std::uint16_t key_code{ 0 };
+        const char *label{ nullptr };
+        graphene_rect_t bounds{};
+        RenderNode node{ nullptr, &gsk_render_node_unref };
+    };
+
+    /// Asks the backend for a snapshot, deltas are ignored until it arrives
+    auto requestSnapshot() -> void;
+
+    /// Replaces all counts with the snapshot, or keeps them if the backend was not reachable
+    auto onSnapshot(const std::optional<DayKeyCounts> &snapshot) -> void;
+
+    /// Adds live deltas the snapshot does not contain yet, a delta of a new day starts from an
+    /// empty keyboard
+    auto onKeystrokeDeltas(const DayKeyCounts &deltas) -> void;
+
+    /// Positions the cells for the allocated size and renders all of them
+    auto layoutCells(int width, int height) -> void;
+
+    /// Renders a cell into its cached node
+    auto renderCell(Cell &cell) -> void;
+
+    /// Renders the cells the buckets report as changed and schedules a frame if there were any
+    auto renderChangedCells() -> void;
+
+    DbusClient &client;
+    HeatmapBuckets buckets;
+    DayNumber day{ 0 };
+    std::uint64_t sequence{ 0 };   ///< Sequence of the last delta contained in the counts
+    bool snapshot_pending{ false }; ///< Deltas that arrive meanwhile are part of the snapshot
+
+    std::vector<Cell> cells; ///< One for every key of `KEYBOARD_LAYOUT`, in its order
+};
+
+} // namespace typetrace::frontend
+
+#endif
@@ -0,0 +1,109 @@
+#include "verbose.hpp"
+
+#include "database.hpp"
+#include "keystroke_list.hpp"
+
+#include <chrono>
+#include <format>
+#include <glibmm/refptr.h>
+#include <gtkmm/columnviewcolumn.h>
+#include <gtkmm/enums.h>
+#include <gtkmm/label.h>
+#include <gtkmm/listitem.h>
+#include <gtkmm/noselection.h>
+#include <gtkmm/object.h>
+#include <gtkmm/signallistitemfactory.h>
+#include <memory>
+#include <sigc++/functors/mem_fun.h>
+#include <string>
+
+namespace typetrace::frontend {
+
+namespace {
+
+/// Formats a row's day as an ISO date
+auto formatDay(const KeystrokeRow &row) -> std::string
+{
+    return std::format("{:%Y-%m-%d}", std::chrono::sys_days{ std::chrono::days{ row.day } });
+}
+
+/// Returns a row's key name
+auto formatKeyName(const KeystrokeRow &row) -> std::string
+{
+    return row.key_name;
+}
+
+/// Formats a row's number of presses
+auto formatCount(const KeystrokeRow &row) -> std::string
+{
+    return std::to_string(row.count);
+}
+
+} // namespace
+
+Verbose::Verbose(Database &database) :
+  Gtk::Box(Gtk::Orientation::VERTICAL),
+  toolbar(Gtk::Orientation::HORIZONTAL),
+  oldest_first_button("Oldest first"),
+  keystrokes(KeystrokeList::create(database))
+{
+    search_entry.set_placeholder_text("Filter by key name");
+    search_entry.set_hexpand(true);
+    search_entry.signal_search_changed().connect(sigc::mem_fun(*this, &Verbose::updateQuery));
+    oldest_first_button.signal_toggled().connect(sigc::mem_fun(*this, &Verbose::updateQuery));
+
+    toolbar.append(search_entry);
+    toolbar.append(oldest_first_button);
+    append(toolbar);
+
+    // The view only binds the rows it shows, the list fetches their pages on demand
+    column_view.set_model(Gtk::NoSelection::create(keystrokes));
+    appendColumn("Date", &formatDay);
+    appendColumn("Key", &formatKeyName);
+    appendColumn("Count", &formatCount);
+
+    scrolled_window.set_child(column_view);
+    scrolled_window.set_vexpand(true);
+    append(scrolled_window);
+}
+
+auto Verbose::refresh() -> void
+{
+    keystrokes->refresh();
+}
+
+auto Verbose::appendColumn(const char *const title, std::string (*const text)(const KeystrokeRow &))
+  -> void
+{
+    auto factory = Gtk::SignalListItemFactory::create();
+
+    factory->signal_setup().connect([](const Glib::RefPtr<Gtk::ListItem> &list_item) -> void {
+        list_item->set_child(*Gtk::make_managed<Gtk::Label>("", Gtk::Align::START));
+    });
+
+    factory->signal_bind().connect([text](const Glib::RefPtr<Gtk::ListItem> &list_item) -> void {
+        const auto item = std::dynamic_pointer_cast<KeystrokeItem>(list_item->get_item());
+        auto *const label = dynamic_cast<Gtk::Label *>(list_item->get_child());
+        if (label == nullptr) {
+            return;
+        }
+
+        // Placeholders stay empty until their page arrives and the item is replaced
+        label->set_text(item && item->row() ? text(*item->row()) : std::string{});
+    });
+
+    auto column = Gtk::ColumnViewColumn::create(title, factory);
+    column->set_expand(true);
+    column_view.append_column(column);
+}
+
+auto Verbose::updateQuery() -> void
+{
+    keystrokes->setQuery(KeystrokeQuery{
+      .order = oldest_first_button.get_active() ? KeystrokeOrder::oldest_first
+                                                : KeystrokeOrder::newest_first,
+      .key_name = search_entry.get_text().raw(),
+    });
+}
+
+} // namespace typetrace::frontend
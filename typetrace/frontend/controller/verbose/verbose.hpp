@@ -0,0 +1,48 @@
+#ifndef TYPETRACE_FRONTEND_VERBOSE_HPP
+#define TYPETRACE_FRONTEND_VERBOSE_HPP
+
+#include "database.hpp"
+#include "keystroke_list.hpp"
+
+#include <glibmm/refptr.h>
+#include <gtkmm/box.h>
+#include <gtkmm/columnview.h>
+#include <gtkmm/scrolledwindow.h>
+#include <gtkmm/searchentry.h>
+#include <gtkmm/togglebutton.h>
+#include <string>
+
+namespace typetrace::frontend {
+
+/// Table of the presses of every key on every day.
+///
+/// The table is backed by a `KeystrokeList`, so opening it loads a single page and memory stays
+/// flat however long the history is. Searching by key name and the order are applied by SQL,
+/// changing them reloads the list from its first page.
+class Verbose : public Gtk::Box
+{
+  public:
+    explicit Verbose(Database &database);
+
+    /// Reloads the table, to be called when the backend has flushed
+    auto refresh() -> void;
+
+  private:
+    /// Adds a label column whose text is taken from a loaded row
+    auto appendColumn(const char *title, std::string (*text)(const KeystrokeRow &)) -> void;
+
+    /// Applies the search text and order to the list
+    auto updateQuery() -> void;
+
+    Gtk::Box toolbar;
+    Gtk::SearchEntry search_entry;
+    Gtk::ToggleButton oldest_first_button;
+    Gtk::ScrolledWindow scrolled_window;
+    Gtk::ColumnView column_view;
+
+    Glib::RefPtr<KeystrokeList> keystrokes;
+};
+
+} // namespace typetrace::frontend
+
+#endif
@@ -0,0 +1,452 @@
+#include "database.hpp"
+
+#include "calendar.hpp"
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "query_cache.hpp"
+#include "sql.hpp"
+#include "stats_snapshot.hpp"
+#include "types.hpp"
+
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Statement.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sigc++/functors/mem_fun.h>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace typetrace::frontend {
+
+struct Database::Connection
+{
+    explicit Connection(const std::filesystem::path &db_file) :
+      db(db_file.string(), SQLite::OPEN_READONLY),
+      total_key_counts(db, GET_TOTAL_KEY_COUNTS_SQL),
+      daily_counts(db, GET_DAILY_COUNTS_SQL),
+      top_keys(db, GET_TOP_KEYS_SQL),
+      keystrokes_page(db, GET_KEYSTROKES_PAGE_SQL),
+      keystrokes_page_ascending(db, GET_KEYSTROKES_PAGE_ASCENDING_SQL),
+      data_version(db, GET_DATA_VERSION_SQL),
+      history_epoch(db, GET_HISTORY_EPOCH_SQL)
+    {
+        db.setBusyTimeout(static_cast<int>(DEFAULT_DB_BUSY_TIMEOUT_MS));
+    }
+
+    SQLite::Database db;
+    SQLite::Statement total_key_counts;
+    SQLite::Statement daily_counts;
+    SQLite::Statement top_keys;
+    SQLite::Statement keystrokes_page;
+    SQLite::Statement keystrokes_page_ascending;
+    SQLite::Statement data_version;
+    SQLite::Statement history_epoch;
+    std::int64_t last_data_version{ -1 }; ///< Data version the history epoch was read at
+};
+
+namespace {
+
+/// Steps through a bound `(scan_code, count)` query and resets it afterwards
+auto collectKeyCounts(SQLite::Statement &stmt) -> std::vector<KeyCount>
+{
+    std::vector<KeyCount> counts;
+    while (stmt.executeStep()) {
+        counts.push_back(KeyCount{
+          .key_code = static_cast<std::uint16_t>(stmt.getColumn(0).getUInt()),
+          .count = static_cast<std::uint64_t>(stmt.getColumn(1).getInt64()),
+        });
+    }
+
+    stmt.reset();
+    return counts;
+}
+
+/// Steps through the daily counts query from `first_day` on and resets it afterwards
+auto collectDailyCounts(SQLite::Statement &stmt, const DayNumber first_day)
+  -> std::vector<DailyCount>
+{
+    stmt.bind(1, static_cast<std::int64_t>(first_day));
+
+    std::vector<DailyCount> counts;
+    while (stmt.executeStep()) {
+        counts.push_back(DailyCount{
+          .day = static_cast<DayNumber>(stmt.getColumn(0).getInt64()),
+          .count = static_cast<std::uint64_t>(stmt.getColumn(1).getInt64()),
+        });
+    }
+
+    stmt.reset();
+    return counts;
+}
+
+/// Returns a LIKE pattern matching key names that contain `text`, wildcards in it are escaped
+auto containsPattern(const std::string &text) -> std::string
+{
+    std::string pattern{ "%" };
+    for (const char character : text) {
+        if (character == '%' || character == '_' || character == '\\') {
+            pattern += '\\';
+        }
+        pattern += character;
+    }
+    return pattern + "%";
+}
+
+} // namespace
+
+Database::Database(std::filesystem::path database_file) :
+  db_file(std::move(database_file)),
+  worker([this](const std::stop_token &stop_token) -> void { run(stop_token); })
+{
+    dispatcher.connect(sigc::mem_fun(*this, &Database::deliverResults));
+    seedFromSnapshot();
+}
+
+Database::~Database()
+{
+    // The jthread requests the stop and joins, the condition variable wakes up on the stop
+    worker.request_stop();
+}
+
+template<typename Result>
+auto Database::submit(std::function<Result(Connection &)> query, Callback<Result> on_result)
+  -> void
+{
+    Job job = [query = std::move(query),
+               on_result = std::move(on_result)](Connection &connection) -> std::function<void()> {
+        return [result = query(connection), on_result]() mutable -> void {
+            on_result(std::move(result));
+        };
+    };
+
+    {
+        const std::scoped_lock lock{ jobs_mutex };
+        jobs.push_back(std::move(job));
+    }
+    jobs_available.notify_one();
+}
+
+template<typename Result>
+auto Database::submitCached(const QueryCache::Key &key,
+                            const bool immutable,
+                            std::function<Result(Connection &)> query,
+                            Callback<Result> on_result) -> void
+{
+    // A hit still takes the worker's queue, so its callback runs after the ones of earlier
+    // queries and never from within the caller
+    if (const Result *const cached = cache.find<Result>(key)) {
+        submit<Result>([result = *cached](Connection & /*connection*/) -> Result { return result; },
+                       std::move(on_result));
+        return;
+    }
+
+    submit<Result>(std::move(query),
+                   [this, key, immutable, generation = cache.generation(), on_result](
+                     Result result) -> void {
+                       cache.store(key, result, generation, immutable);
+                       on_result(std::move(result));
+                   });
+}
+
+auto Database::seedFromSnapshot() -> void
+{
+    std::optional<StatsSnapshotReader> reader;
+    try {
+        reader.emplace(db_file.parent_path() / STATS_SNAPSHOT_FILE_NAME);
+    } catch (const SystemError &) {
+        // Without a snapshot the first queries simply run against the database
+        return;
+    }
+
+    // A snapshot of another day covers other days than today's queries ask for
+    const StatsSnapshot &snapshot = reader->get();
+    if (snapshot.day != localToday()) {
+        return;
+    }
+
+    std::vector<KeyCount> totals;
+    for (std::size_t key_code = 0; key_code < snapshot.all_time.size(); ++key_code) {
+        if (snapshot.all_time.at(key_code) != 0) {
+            totals.push_back({ .key_code = static_cast<std::uint16_t>(key_code),
+                               .count = snapshot.all_time.at(key_code) });
+        }
+    }
+
+    const auto daily = std::span{ snapshot.daily }.first(snapshot.daily_size);
+    const auto top_keys = std::span{ snapshot.top_keys }.first(snapshot.top_keys_size);
+    const auto first_day = static_cast<std::int64_t>(snapshot.day - (StatsSnapshot::DAYS - 1));
+
+    cache.store({ GET_TOTAL_KEY_COUNTS_SQL, 0, 0 }, std::move(totals), cache.generation());
+    cache.store({ GET_DAILY_COUNTS_SQL, first_day, 0 },
+                std::vector<DailyCount>(daily.begin(), daily.end()),
+                cache.generation());
+    cache.store({ GET_TOP_KEYS_SQL, 0, static_cast<std::int64_t>(StatsSnapshot::TOP_KEYS) },
+                std::vector<KeyCount>(top_keys.begin(), top_keys.end()),
+                cache.generation());
+}
+
+auto Database::firstUnsettledDay() -> DayNumber
+{
+    return localToday() - 1;
+}
+
+auto Database::getTotalKeyCounts(Callback<std::vector<KeyCount>> on_result) -> void
+{
+    submitCached<std::vector<KeyCount>>(
+      { GET_TOTAL_KEY_COUNTS_SQL, 0, 0 },
+      false,
+      [](Connection &connection) -> std::vector<KeyCount> {
+          return collectKeyCounts(connection.total_key_counts);
+      },
+      std::move(on_result));
+}
+
+auto Database::getDailyCounts(const DayNumber first_day,
+                              Callback<std::vector<DailyCount>> on_result) -> void
+{
+    const DayNumber unsettled_day = firstUnsettledDay();
+
+    // Settled days were cached by an earlier query, only the days after them can have changed
+    const bool settled_cached = first_day < unsettled_day && settled_end_day == unsettled_day
+                                && settled_first_day <= first_day;
+    const DayNumber query_first_day = settled_cached ? unsettled_day : first_day;
+
+    submitCached<std::vector<DailyCount>>(
+      { GET_DAILY_COUNTS_SQL, query_first_day, 0 },
+      false,
+      [query_first_day](Connection &connection) -> std::vector<DailyCount> {
+          return collectDailyCounts(connection.daily_counts, query_first_day);
+      },
+      [this, first_day, unsettled_day, settled_cached, on_result = std::move(on_result)](
+        std::vector<DailyCount> counts) -> void {
+          if (settled_cached) {
+              std::ranges::copy_if(settled_daily_counts,
+                                   std::back_inserter(counts),
+                                   [first_day](const DailyCount &count) -> bool {
+                                       return count.day >= first_day;
+                                   });
+          } else if (first_day < unsettled_day) {
+              settled_daily_counts.clear();
+              std::ranges::copy_if(counts,
+                                   std::back_inserter(settled_daily_counts),
+                                   [unsettled_day](const DailyCount &count) -> bool {
+                                       return count.day < unsettled_day;
+                                   });
+              settled_first_day = first_day;
+              settled_end_day = unsettled_day;
+          }
+
+          on_result(std::move(counts));
+      });
+}
+
+auto Database::getTopKeys(const DayNumber first_day,
+                          const std::size_t limit,
+                          Callback<std::vector<KeyCount>> on_result) -> void
+{
+    submitCached<std::vector<KeyCount>>(
+      { GET_TOP_KEYS_SQL, first_day, static_cast<std::int64_t>(limit) },
+      false,
+      [first_day, limit](Connection &connection) -> std::vector<KeyCount> {
+          connection.top_keys.bind(1, static_cast<std::int64_t>(first_day));
+          connection.top_keys.bind(2, static_cast<std::int64_t>(limit));
+          return collectKeyCounts(connection.top_keys);
+      },
+      std::move(on_result));
+}
+
+auto Database::getKeystrokesPage(const KeystrokeQuery &query,
+                                 const std::optional<PageCursor> after,
+                                 const std::size_t page_size,
+                                 Callback<KeystrokePage> on_result) -> void
+{
+    const bool ascending = query.order == KeystrokeOrder::oldest_first;
+
+    auto run_query = [query, after, page_size, ascending](Connection &connection) -> KeystrokePage {
+        SQLite::Statement &stmt
+          = ascending ? connection.keystrokes_page_ascending : connection.keystrokes_page;
+
+        // The first page starts behind or before every stored day
+        const std::int64_t first_position = ascending ? std::numeric_limits<std::int64_t>::min()
+                                                      : std::numeric_limits<std::int64_t>::max();
+        stmt.bind(1, after ? static_cast<std::int64_t>(after->day) : first_position);
+        stmt.bind(2, after ? static_cast<int>(after->key_code) : 0);
+        stmt.bind(3, static_cast<std::int64_t>(page_size));
+        stmt.bind(4, static_cast<std::int64_t>(query.first_day));
+        stmt.bind(5, static_cast<std::int64_t>(query.last_day));
+        stmt.bind(6, containsPattern(query.key_name));
+
+        KeystrokePage page;
+        page.rows.reserve(page_size);
+
+        while (stmt.executeStep()) {
+            page.rows.push_back(KeystrokeRow{
+              .day = static_cast<DayNumber>(stmt.getColumn(0).getInt64()),
+              .key_code = static_cast<std::uint16_t>(stmt.getColumn(1).getUInt()),
+              .key_name = stmt.getColumn(2).getString(),
+              .count = static_cast<std::uint64_t>(stmt.getColumn(3).getInt64()),
+            });
+        }
+        stmt.reset();
+
+        // A short page is the last one
+        if (page.rows.size() == page_size && !page.rows.empty()) {
+            page.next = PageCursor{ .day = page.rows.back().day,
+                                    .key_code = page.rows.back().key_code };
+        }
+
+        return page;
+    };
+
+    // The cache key has no room for filters, a filtered view is cached by the list model
+    const bool filtered = query.first_day != 0
+                          || query.last_day != std::numeric_limits<DayNumber>::max()
+                          || !query.key_name.empty();
+    if (filtered) {
+        submit<KeystrokePage>(std::move(run_query), std::move(on_result));
+        return;
+    }
+
+    // Newest first, rows after a settled day are settled too, so deeper pages never change.
+    // Oldest first, every page may reach into the days that still change.
+    const bool immutable = !ascending && after && after->day < firstUnsettledDay();
+    const std::int64_t position
+      = after ? (static_cast<std::int64_t>(after->day) << 16U) | after->key_code : -1;
+
+    submitCached<KeystrokePage>(
+      { ascending ? GET_KEYSTROKES_PAGE_ASCENDING_SQL : GET_KEYSTROKES_PAGE_SQL,
+        position,
+        static_cast<std::int64_t>(page_size) },
+      immutable,
+      std::move(run_query),
+      std::move(on_result));
+}
+
+auto Database::invalidate(const std::uint64_t generation) -> void
+{
+    if (generation == cache.generation()) {
+        return;
+    }
+
+    cache.invalidate(generation);
+
+    // The worker looks for an import before every job, even while every view is cached
+    {
+        const std::scoped_lock lock{ jobs_mutex };
+        jobs.emplace_back([](Connection &) -> std::function<void()> { return []() -> void {}; });
+    }
+    jobs_available.notify_one();
+}
+
+auto Database::checkHistory(Connection &connection) -> bool
+{
+    // Reading the data version costs no I/O, the epoch is only read after another commit
+    connection.data_version.executeStep();
+    const std::int64_t data_version = connection.data_version.getColumn(0).getInt64();
+    connection.data_version.reset();
+
+    if (data_version == connection.last_data_version) {
+        return false;
+    }
+    connection.last_data_version = data_version;
+
+    connection.history_epoch.executeStep();
+    const std::int64_t epoch = connection.history_epoch.getColumn(0).getInt64();
+    connection.history_epoch.reset();
+
+    const bool changed = history_epoch && *history_epoch != epoch;
+    history_epoch = epoch;
+    return changed;
+}
+
+auto Database::dropHistory() -> void
+{
+    cache.clear();
+    settled_daily_counts.clear();
+    settled_first_day = 0;
+    settled_end_day = 0;
+}
+
+auto Database::signalError() -> sigc::signal<void(const std::string &)> &
+{
+    return error_signal;
+}
+
+auto Database::run(const std::stop_token &stop_token) -> void
+{
+    std::unique_ptr<Connection> connection;
+
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock{ jobs_mutex };
+            const bool has_job
+              = jobs_available.wait(lock, stop_token, [this]() -> bool { return !jobs.empty(); });
+            if (!has_job) {
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        std::function<void()> completion;
+        try {
+            // Opened lazily, so a database the backend has not created yet is retried later
+            if (!connection) {
+                connection = std::make_unique<Connection>(db_file);
+            }
+
+            // Posted ahead of the job's result, so only results from before the change are dropped
+            if (checkHistory(*connection)) {
+                const std::scoped_lock lock{ results_mutex };
+                results.emplace_back([this]() -> void { dropHistory(); });
+            }
+
+            completion = job(*connection);
+        } catch (const SQLite::Exception &e) {
+            const DatabaseError error(
+              std::format("Failed to query '{}': {}", db_file.string(), e.what()));
+
+            // Statements may be left in a failed state, start over with the next query
+            connection.reset();
+            completion = [this, message = std::string{ error.what() }]() -> void {
+                error_signal.emit(message);
+            };
+        }
+
+        {
+            const std::scoped_lock lock{ results_mutex };
+            results.push_back(std::move(completion));
+        }
+        dispatcher.emit();
+    }
+}
+
+auto Database::deliverResults() -> void
+{
+    std::vector<std::function<void()>> pending;
+    {
+        const std::scoped_lock lock{ results_mutex };
+        pending.swap(results);
+    }
+
+    for (auto &completion : pending) {
+        completion();
+    }
+}
+
+} // namespace typetrace::frontend
@@ -0,0 +1,189 @@
+#ifndef TYPETRACE_FRONTEND_DATABASE_HPP
+#define TYPETRACE_FRONTEND_DATABASE_HPP
+
+#include "constants.hpp"
+#include "paths.hpp"
+#include "query_cache.hpp"
+#include "types.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <glibmm/dispatcher.h>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <sigc++/signal.h>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace typetrace::frontend {
+
+/// Presses of one key on one day, a row of the verbose table
+struct KeystrokeRow
+{
+    DayNumber day{ 0 };
+    std::uint16_t key_code{ 0 };
+    std::string key_name;
+    std::uint64_t count{ 0 };
+};
+
+/// Position of the last row of a page, the next page starts right after it
+struct PageCursor
+{
+    DayNumber day{ 0 };
+    std::uint16_t key_code{ 0 };
+};
+
+/// Order of the verbose table, both walk the primary key of the keystrokes table
+enum class KeystrokeOrder : std::uint8_t
+{
+    newest_first,
+    oldest_first,
+};
+
+/// Order and filters of the verbose table, applied by SQL
+struct KeystrokeQuery
+{
+    KeystrokeOrder order{ KeystrokeOrder::newest_first };
+    DayNumber first_day{ 0 };
+    DayNumber last_day{ std::numeric_limits<DayNumber>::max() };
+    std::string key_name; ///< Case-insensitive part of the key name, empty for every key
+};
+
+/// One page of the verbose table, `next` is empty on the last page
+struct KeystrokePage
+{
+    std::vector<KeystrokeRow> rows;
+    std::optional<PageCursor> next;
+};
+
+/// Read-only, asynchronous access to the backend's database.
+///
+/// Queries run on a worker thread with its own read-only connection, so the GTK main loop never
+/// waits for SQLite, not even while the backend holds a write transaction. Every callback is
+/// invoked on the main loop, in the order the queries were issued. Must be constructed on the
+/// main loop's thread.
+///
+/// Results are cached until `invalidate()` reports a new backend flush, results that only cover
+/// settled days are kept until an import or merge changes the history. Cached results skip the
+/// query but are delivered like the others, on the main loop after the callbacks of the queries
+/// issued before them.
+///
+/// The cache starts out with the backend's statistics snapshot if there is one of today, so the
+/// total counts, the top keys and the daily counts of the last year are there without a query
+/// however large the database is. They are replaced by queries after the next flush.
+class Database
+{
+  public:
+    template<typename Result>
+    using Callback = std::function<void(Result)>;
+
+    /// Starts the worker, the connection is opened by the first query
+    explicit Database(std::filesystem::path database_file = getDatabaseDir() / DB_FILE_NAME);
+
+    /// Stops the worker, callbacks of unfinished queries are not invoked
+    ~Database();
+
+    Database(const Database &) = delete;
+    auto operator=(const Database &) -> Database & = delete;
+    Database(Database &&) = delete;
+    auto operator=(Database &&) -> Database & = delete;
+
+    /// Queries the total number of presses of every key
+    auto getTotalKeyCounts(Callback<std::vector<KeyCount>> on_result) -> void;
+
+    /// Queries the number of key presses per day from `first_day` on, newest first
+    auto getDailyCounts(DayNumber first_day, Callback<std::vector<DailyCount>> on_result) -> void;
+
+    /// Queries the `limit` most pressed keys from `first_day` on
+    auto getTopKeys(DayNumber first_day,
+                    std::size_t limit,
+                    Callback<std::vector<KeyCount>> on_result) -> void;
+
+    /// Queries `page_size` rows of the verbose table following `after`, or the first page.
+    /// Only pages without filters are cached.
+    auto getKeystrokesPage(const KeystrokeQuery &query,
+                           std::optional<PageCursor> after,
+                           std::size_t page_size,
+                           Callback<KeystrokePage> on_result) -> void;
+
+    /// Drops cached results that a flush may have changed, to be connected to the backend's
+    /// `Flushed` signal. Also has the worker look for an import or merge, which changes days
+    /// whose results are kept across flushes.
+    auto invalidate(std::uint64_t generation) -> void;
+
+    /// Emitted on the main loop with the message of a failed query, its callback is not invoked
+    [[nodiscard]] auto signalError() -> sigc::signal<void(const std::string &)> &;
+
+  private:
+    /// Connection and prepared statements, only touched by the worker
+    struct Connection;
+
+    /// Runs a query on the worker and returns the completion to run on the main loop
+    using Job = std::function<std::function<void()>(Connection &)>;
+
+    /// Queues a query whose result is handed to `on_result` on the main loop
+    template<typename Result>
+    auto submit(std::function<Result(Connection &)> query, Callback<Result> on_result) -> void;
+
+    /// Like `submit()`, but answers from and fills the cache
+    template<typename Result>
+    auto submitCached(const QueryCache::Key &key,
+                      bool immutable,
+                      std::function<Result(Connection &)> query,
+                      Callback<Result> on_result) -> void;
+
+    /// Fills the cache from the statistics snapshot next to the database, if it is of today
+    auto seedFromSnapshot() -> void;
+
+    /// Returns the first day that may still change, the backend may flush keystrokes from
+    /// before midnight a while after it, so that is yesterday
+    [[nodiscard]] static auto firstUnsettledDay() -> DayNumber;
+
+    /// Returns whether the history epoch changed since the worker last read it, which means an
+    /// import or merge has changed settled days. Called on the worker.
+    auto checkHistory(Connection &connection) -> bool;
+
+    /// Drops every cached result, those of settled days too, called on the main loop
+    auto dropHistory() -> void;
+
+    /// Worker loop, runs queued jobs until a stop is requested
+    auto run(const std::stop_token &stop_token) -> void;
+
+    /// Runs the completions the worker has posted, called on the main loop
+    auto deliverResults() -> void;
+
+    std::filesystem::path db_file;
+
+    std::mutex jobs_mutex;
+    std::condition_variable_any jobs_available;
+    std::deque<Job> jobs;
+
+    std::mutex results_mutex;
+    std::vector<std::function<void()>> results;
+
+    // Only accessed by the worker, kept across connections so a reconnect misses no import
+    std::optional<std::int64_t> history_epoch;
+
+    // Only accessed on the main loop
+    QueryCache cache;
+    std::vector<DailyCount> settled_daily_counts;
+    DayNumber settled_first_day{ 0 };
+    DayNumber settled_end_day{ 0 };
+
+    Glib::Dispatcher dispatcher;
+    sigc::signal<void(const std::string &)> error_signal;
+
+    // Declared last so the worker is joined before anything it uses is destroyed
+    std::jthread worker;
+};
+
+} // namespace typetrace::frontend
+
+#endif
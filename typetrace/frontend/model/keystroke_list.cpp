@@ -0,0 +1,195 @@
+#include "keystroke_list.hpp"
+
+#include "database.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <giomm/listmodel.h>
+#include <glibmm/object.h>
+#include <glibmm/objectbase.h>
+#include <glibmm/main.h>
+#include <glibmm/refptr.h>
+#include <memory>
+#include <optional>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace typetrace::frontend {
+
+auto KeystrokeItem::create(std::optional<KeystrokeRow> row) -> Glib::RefPtr<KeystrokeItem>
+{
+    return Glib::make_refptr_for_instance<KeystrokeItem>(new KeystrokeItem(std::move(row)));
+}
+
+KeystrokeItem::KeystrokeItem(std::optional<KeystrokeRow> item_row) :
+  keystroke_row(std::move(item_row))
+{
+}
+
+auto KeystrokeItem::row() const -> const std::optional<KeystrokeRow> &
+{
+    return keystroke_row;
+}
+
+auto KeystrokeList::create(Database &database, KeystrokeQuery initial_query)
+  -> Glib::RefPtr<KeystrokeList>
+{
+    return Glib::make_refptr_for_instance<KeystrokeList>(
+      new KeystrokeList(database, std::move(initial_query)));
+}
+
+KeystrokeList::KeystrokeList(Database &database, KeystrokeQuery initial_query) :
+  Glib::ObjectBase(typeid(KeystrokeList)),
+  Gio::ListModel(),
+  db(database),
+  query(std::move(initial_query)),
+  page_starts{ std::nullopt },
+  placeholder(KeystrokeItem::create())
+{
+    requestPage(0);
+}
+
+auto KeystrokeList::setQuery(KeystrokeQuery new_query) -> void
+{
+    query = std::move(new_query);
+    ++*generation;
+
+    const auto removed = static_cast<guint>(row_count);
+    page_starts = { std::nullopt };
+    row_count = 0;
+    complete = false;
+    cached_pages.clear();
+    lru_order.clear();
+    pending_pages.clear();
+
+    items_changed(0, removed, 0);
+    requestPage(0);
+}
+
+auto KeystrokeList::refresh() -> void
+{
+    setQuery(query);
+}
+
+auto KeystrokeList::get_item_type_vfunc() -> GType
+{
+    return Glib::Object::get_base_type();
+}
+
+auto KeystrokeList::get_n_items_vfunc() -> guint
+{
+    return static_cast<guint>(row_count);
+}
+
+auto KeystrokeList::get_item_vfunc(const guint position) -> gpointer
+{
+    if (position >= row_count) {
+        return nullptr;
+    }
+
+    const std::size_t page = position / PAGE_SIZE;
+
+    // Reaching the last known page loads the next one before the user scrolls to it
+    if (!complete && page + 1 == page_starts.size() - 1) {
+        requestPage(page + 1);
+    }
+
+    const auto cached = cached_pages.find(page);
+    if (cached == cached_pages.end()) {
+        requestPage(page);
+        return placeholder->gobj_copy();
+    }
+
+    touch(cached->second);
+
+    const std::size_t index = position % PAGE_SIZE;
+    const auto &items = cached->second.items;
+    return index < items.size() ? items.at(index)->gobj_copy() : placeholder->gobj_copy();
+}
+
+auto KeystrokeList::requestPage(const std::size_t page) -> void
+{
+    if (page >= page_starts.size() || cached_pages.contains(page)
+        || !pending_pages.insert(page).second) {
+        return;
+    }
+
+    const auto deliver = [this, page, weak_generation = std::weak_ptr{ generation },
+                          requested = *generation](KeystrokePage result) -> void {
+        const auto current = weak_generation.lock();
+        if (current && *current == requested) {
+            onPage(page, std::move(result));
+        }
+    };
+
+    requesting = true;
+    db.getKeystrokesPage(
+      query, page_starts.at(page), PAGE_SIZE, [this, deliver](KeystrokePage result) -> void {
+          // A cached page is handed over right away, possibly from within `get_item_vfunc()`,
+          // where the list must not change
+          if (requesting) {
+              Glib::signal_idle().connect_once(
+                [deliver, result = std::move(result)]() -> void { deliver(result); });
+              return;
+          }
+          deliver(std::move(result));
+      });
+    requesting = false;
+}
+
+auto KeystrokeList::onPage(const std::size_t page, KeystrokePage result) -> void
+{
+    pending_pages.erase(page);
+
+    const std::size_t first_position = page * PAGE_SIZE;
+    const bool first_load = first_position >= row_count;
+
+    // A page fetched again keeps its length, rows the backend added meanwhile show up on refresh
+    const std::size_t length
+      = first_load ? result.rows.size() : std::min(PAGE_SIZE, row_count - first_position);
+
+    std::vector<Glib::RefPtr<KeystrokeItem>> items;
+    items.reserve(length);
+    for (auto &row : result.rows) {
+        if (items.size() == length) {
+            break;
+        }
+        items.push_back(KeystrokeItem::create(std::move(row)));
+    }
+
+    lru_order.push_front(page);
+    cached_pages.insert_or_assign(
+      page, CachedPage{ .items = std::move(items), .lru_position = lru_order.begin() });
+
+    while (cached_pages.size() > MAX_CACHED_PAGES) {
+        cached_pages.erase(lru_order.back());
+        lru_order.pop_back();
+    }
+
+    if (!first_load) {
+        items_changed(static_cast<guint>(first_position),
+                      static_cast<guint>(length),
+                      static_cast<guint>(length));
+        return;
+    }
+
+    row_count += length;
+    if (result.next) {
+        page_starts.push_back(result.next);
+    } else {
+        complete = true;
+    }
+
+    if (length > 0) {
+        items_changed(static_cast<guint>(first_position), 0, static_cast<guint>(length));
+    }
+}
+
+auto KeystrokeList::touch(CachedPage &cached) -> void
+{
+    lru_order.splice(lru_order.begin(), lru_order, cached.lru_position);
+}
+
+} // namespace typetrace::frontend
@@ -0,0 +1,110 @@
+#ifndef TYPETRACE_FRONTEND_KEYSTROKE_LIST_HPP
+#define TYPETRACE_FRONTEND_KEYSTROKE_LIST_HPP
+
+#include "database.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <giomm/listmodel.h>
+#include <glibmm/object.h>
+#include <glibmm/refptr.h>
+#include <list>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace typetrace::frontend {
+
+/// A row of the verbose table as a list item, without a row while its page is loading
+class KeystrokeItem : public Glib::Object
+{
+  public:
+    [[nodiscard]] static auto create(std::optional<KeystrokeRow> row = std::nullopt)
+      -> Glib::RefPtr<KeystrokeItem>;
+
+    /// Returns the row, or nothing if the item is a placeholder
+    [[nodiscard]] auto row() const -> const std::optional<KeystrokeRow> &;
+
+  protected:
+    explicit KeystrokeItem(std::optional<KeystrokeRow> item_row);
+
+  private:
+    std::optional<KeystrokeRow> keystroke_row;
+};
+
+/// Virtualized list of the verbose table that loads its rows page by page.
+///
+/// Pages are fetched through keyset pagination when the view first asks for one of their items,
+/// the last known page also fetches the one after it, so the list grows while the user scrolls
+/// instead of counting the history up front. Only `MAX_CACHED_PAGES` pages are kept, the least
+/// recently used one is dropped first and fetched again from its start cursor when it is
+/// needed. Items of a page that is still loading are placeholders, they are replaced through
+/// `items_changed` once it arrives.
+class KeystrokeList : public Glib::Object, public Gio::ListModel
+{
+  public:
+    /// Rows per page
+    static constexpr std::size_t PAGE_SIZE = 200;
+
+    /// Pages kept in memory, well above what a window shows at once
+    static constexpr std::size_t MAX_CACHED_PAGES = 16;
+
+    /// Creates the list and fetches its first page
+    [[nodiscard]] static auto create(Database &database, KeystrokeQuery initial_query = {})
+      -> Glib::RefPtr<KeystrokeList>;
+
+    /// Replaces order and filters, the list is emptied and loaded again from the first page
+    auto setQuery(KeystrokeQuery new_query) -> void;
+
+    /// Loads the list again with the same query, e.g. after the backend has flushed
+    auto refresh() -> void;
+
+  protected:
+    KeystrokeList(Database &database, KeystrokeQuery initial_query);
+
+    auto get_item_type_vfunc() -> GType override;
+    auto get_n_items_vfunc() -> guint override;
+    auto get_item_vfunc(guint position) -> gpointer override;
+
+  private:
+    /// Items of a loaded page and its place in the LRU order
+    struct CachedPage
+    {
+        std::vector<Glib::RefPtr<KeystrokeItem>> items;
+        std::list<std::size_t>::iterator lru_position;
+    };
+
+    /// Fetches a page whose start cursor is known, unless it is already being fetched
+    auto requestPage(std::size_t page) -> void;
+
+    /// Stores a fetched page and announces its items
+    auto onPage(std::size_t page, KeystrokePage result) -> void;
+
+    /// Marks a cached page as the most recently used one
+    auto touch(CachedPage &cached) -> void;
+
+    Database &db;
+    KeystrokeQuery query;
+
+    /// Start cursor of every page seen so far, the first page starts at the beginning
+    std::vector<std::optional<PageCursor>> page_starts;
+    std::size_t row_count{ 0 };
+    bool complete{ false }; ///< The last page has been loaded
+
+    std::unordered_map<std::size_t, CachedPage> cached_pages;
+    std::list<std::size_t> lru_order; ///< Cached pages, most recently used first
+    std::unordered_set<std::size_t> pending_pages;
+    bool requesting{ false }; ///< A page is being requested, its result must not apply yet
+
+    Glib::RefPtr<KeystrokeItem> placeholder;
+
+    /// Bumped by every new query, results of an older one are dropped. Callbacks hold it weakly,
+    /// so results that arrive after the list is gone are dropped too.
+    std::shared_ptr<std::uint64_t> generation{ std::make_shared<std::uint64_t>(0) };
+};
+
+} // namespace typetrace::frontend
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef TYPETRACE_QUERY_CACHE_HPP
+#define TYPETRACE_QUERY_CACHE_HPP
+
+#include <any>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <utility>
+
+namespace typetrace::frontend {
+
+/// Memoizes query results on the main loop, keyed by query and parameters.
+///
+/// Results are tagged with the backend's flush generation they were queried at and dropped once
+/// another generation is seen, unless they were stored as immutable because they only cover days
+/// the backend no longer writes to. Only `clear()` drops those.
+class QueryCache
+{
+  public:
+    /// SQL text of the query and up to two bound parameters
+    using Key = std::tuple<const char *, std::int64_t, std::int64_t>;
+
+    /// Returns the cached result for `key`, or nullptr if there is none
+    template<typename Result>
+    [[nodiscard]] auto find(const Key &key) const -> const Result *
+    {
+        const auto entry = entries.find(key);
+        return entry != entries.end() ? std::any_cast<Result>(&entry->second.result) : nullptr;
+    }
+
+    /// Caches a result that was queried at `queried_generation`, results that were already
+    /// outdated when they arrived are not cached
+    template<typename Result>
+    auto store(const Key &key,
+               Result result,
+               const std::uint64_t queried_generation,
+               const bool immutable = false) -> void
+    {
+        if (queried_generation == current_generation || immutable) {
+            entries.insert_or_assign(key, Entry{ std::move(result), immutable });
+        }
+    }
+
+    /// Drops every mutable result if `generation` differs from the current one, a restarted
+    /// backend counts from zero again
+    auto invalidate(const std::uint64_t generation) -> void
+    {
+        if (generation == current_generation) {
+            return;
+        }
+
+        current_generation = generation;
+        std::erase_if(entries, [](const auto &entry) -> bool { return !entry.second.immutable; });
+    }
+
+    /// Drops every result, immutable ones too, after the history they cover was changed by an
+    /// import or merge
+    auto clear() -> void { entries.clear(); }
+
+    /// Returns the last flush generation seen
+    [[nodiscard]] auto generation() const -> std::uint64_t { return current_generation; }
+
+  private:
+    struct Entry
+    {
+        std::any result;
+        bool immutable{ false };
+    };
+
+    std::map<Key, Entry> entries;
+    std::uint64_t current_generation{ 0 };
+};
+
+} // namespace typetrace::frontend
+
+#endif
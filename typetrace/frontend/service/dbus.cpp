@@ -0,0 +1,110 @@
+#include "dbus.hpp"
+
+#include "constants.hpp"
+#include "types.hpp"
+
+#include <cstdint>
+#include <giomm/asyncresult.h>
+#include <giomm/dbusconnection.h>
+#include <giomm/dbusproxy.h>
+#include <glibmm/error.h>
+#include <glibmm/refptr.h>
+#include <glibmm/ustring.h>
+#include <glibmm/variant.h>
+#include <optional>
+#include <sigc++/functors/mem_fun.h>
+#include <tuple>
+#include <vector>
+
+namespace typetrace::frontend {
+
+namespace {
+
+/// Converts a `(u day, t sequence, a(q<count>) counts)` message body into per-key counts
+template<typename Count>
+auto parseDayKeyCounts(const Glib::VariantContainerBase &parameters) -> DayKeyCounts
+{
+    using CountsVariant = Glib::Variant<std::vector<std::tuple<guint16, Count>>>;
+
+    DayKeyCounts result;
+    result.day = Glib::VariantBase::cast_dynamic<Glib::Variant<guint32>>(parameters.get_child(0))
+                   .get();
+    result.sequence
+      = Glib::VariantBase::cast_dynamic<Glib::Variant<guint64>>(parameters.get_child(1)).get();
+
+    const auto counts
+      = Glib::VariantBase::cast_dynamic<CountsVariant>(parameters.get_child(2)).get();
+    result.counts.reserve(counts.size());
+
+    for (const auto &[key_code, count] : counts) {
+        result.counts.push_back(KeyCount{
+          .key_code = static_cast<std::uint16_t>(key_code),
+          .count = static_cast<std::uint64_t>(count),
+        });
+    }
+
+    return result;
+}
+
+} // namespace
+
+DbusClient::DbusClient() :
+  proxy(Gio::DBus::Proxy::create_for_bus_sync(Gio::DBus::BusType::SESSION,
+                                              DBUS_SERVICE_NAME,
+                                              DBUS_OBJECT_PATH,
+                                              DBUS_INTERFACE_NAME))
+{
+    proxy->signal_signal().connect(sigc::mem_fun(*this, &DbusClient::onSignal));
+    proxy->property_g_name_owner().signal_changed().connect(
+      sigc::mem_fun(*this, &DbusClient::onNameOwnerChanged));
+}
+
+auto DbusClient::signalKeystrokeDeltas() -> DeltasSignal &
+{
+    return keystroke_deltas;
+}
+
+auto DbusClient::signalFlushed() -> FlushedSignal &
+{
+    return flushed;
+}
+
+auto DbusClient::signalBackendStarted() -> StartedSignal &
+{
+    return backend_started;
+}
+
+auto DbusClient::requestSnapshot(const SnapshotSlot &slot) -> void
+{
+    // A slot bound to a destroyed widget is disconnected, calling it then does nothing
+    proxy->call("GetSnapshot", [this, slot](Glib::RefPtr<Gio::AsyncResult> &result) -> void {
+        std::optional<DayKeyCounts> snapshot;
+        try {
+            snapshot = parseDayKeyCounts<guint64>(proxy->call_finish(result));
+        } catch (const Glib::Error &) {
+            // The backend is not running, the started signal tells when to ask again
+        }
+        slot(snapshot);
+    });
+}
+
+auto DbusClient::onSignal(const Glib::ustring & /*sender_name*/,
+                          const Glib::ustring &signal_name,
+                          const Glib::VariantContainerBase &parameters) -> void
+{
+    if (signal_name == "KeystrokeDeltas") {
+        keystroke_deltas.emit(parseDayKeyCounts<guint32>(parameters));
+    } else if (signal_name == "Flushed") {
+        flushed.emit(
+          Glib::VariantBase::cast_dynamic<Glib::Variant<guint64>>(parameters.get_child(0)).get());
+    }
+}
+
+auto DbusClient::onNameOwnerChanged() -> void
+{
+    if (!proxy->get_name_owner().empty()) {
+        backend_started.emit();
+    }
+}
+
+} // namespace typetrace::frontend
@@ -0,0 +1,76 @@
+#ifndef TYPETRACE_FRONTEND_DBUS_HPP
+#define TYPETRACE_FRONTEND_DBUS_HPP
+
+#include "types.hpp"
+
+#include <giomm/dbusproxy.h>
+#include <glibmm/refptr.h>
+#include <glibmm/ustring.h>
+#include <glibmm/variant.h>
+#include <cstdint>
+#include <optional>
+#include <sigc++/functors/slot.h>
+#include <sigc++/signal.h>
+#include <vector>
+
+namespace typetrace::frontend {
+
+/// Per-key counts of one day, as sent by the backend
+struct DayKeyCounts
+{
+    DayNumber day{ 0 };
+    std::uint64_t sequence{ 0 }; ///< Delta signal the counts belong to, or are up to date with
+    std::vector<KeyCount> counts;
+};
+
+/// Client of the backend's D-Bus interface (see `DbusService` in the backend)
+class DbusClient
+{
+  public:
+    /// Called with the presses per key since the previous delta signal
+    using DeltasSignal = sigc::signal<void(const DayKeyCounts &)>;
+
+    /// Called with the backend's flush generation after keystrokes were committed
+    using FlushedSignal = sigc::signal<void(std::uint64_t)>;
+
+    /// Called when the backend appeared on the bus, its delta sequence starts over
+    using StartedSignal = sigc::signal<void()>;
+
+    /// Called with the reply to `requestSnapshot()`, nullopt if the backend could not be reached
+    using SnapshotSlot = sigc::slot<void(const std::optional<DayKeyCounts> &)>;
+
+    /// Connects to the session bus, the backend does not have to be running yet
+    DbusClient();
+
+    /// Returns the signal that is emitted for every batch of live keystroke deltas
+    [[nodiscard]] auto signalKeystrokeDeltas() -> DeltasSignal &;
+
+    /// Returns the signal that is emitted whenever the backend has written to the database
+    [[nodiscard]] auto signalFlushed() -> FlushedSignal &;
+
+    /// Returns the signal that is emitted whenever the backend (re)started
+    [[nodiscard]] auto signalBackendStarted() -> StartedSignal &;
+
+    /// Asks the backend for today's per-key counts, including keystrokes it has not written to
+    /// the database yet. The main loop keeps running, `slot` is called once the reply arrived.
+    /// Deltas up to the snapshot's sequence are already contained in it.
+    auto requestSnapshot(const SnapshotSlot &slot) -> void;
+
+  private:
+    /// Dispatches signals received from the backend
+    auto onSignal(const Glib::ustring &sender_name,
+                  const Glib::ustring &signal_name,
+                  const Glib::VariantContainerBase &parameters) -> void;
+
+    /// Emits `backend_started` if the bus name got an owner
+    auto onNameOwnerChanged() -> void;
+
+    Glib::RefPtr<Gio::DBus::Proxy> proxy;
+    DeltasSignal keystroke_deltas;
+    FlushedSignal flushed;
+    StartedSignal backend_started;
+};
+
+} // namespace typetrace::frontend
+
+#endif